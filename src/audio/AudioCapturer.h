@@ -8,6 +8,7 @@
 #include <thread>
 #include <atomic>
 #include <iostream>
+#include "AudioDSP.h"
 
 #pragma comment(lib, "ole32.lib")
 #pragma comment(lib, "mmdevapi.lib") 
@@ -135,6 +136,7 @@ private:
     IAudioCaptureClient* captureClient = nullptr;
     std::thread captureThread;
     std::atomic<bool> capturing = false;
+    std::vector<int16_t> pcmData; // Capture thread only
 
     void CaptureLoop(AudioCallback callback, WAVEFORMATEX* mixFormat) {
         audioClient->Start();
@@ -149,21 +151,17 @@ private:
                 DWORD flags;
                 
                 if (SUCCEEDED(captureClient->GetBuffer(&pData, &numFrames, &flags, nullptr, nullptr))) {
-                    // CONVERSION: Float32 -> Int16
-                    std::vector<int16_t> pcmData;
-                    pcmData.reserve(numFrames * mixFormat->nChannels);
+                    // CONVERSION: Float32 -> Int16 into a buffer reused across packets
+                    size_t samples = numFrames * mixFormat->nChannels;
+                    if (pcmData.size() < samples) pcmData.resize(samples);
                     
-                    float* floatData = (float*)pData;
-                    
-                    for (UINT i = 0; i < numFrames * mixFormat->nChannels; i++) {
-                        float sample = floatData[i];
-                        // Hard Clip
-                        if (sample > 1.0f) sample = 1.0f;
-                        if (sample < -1.0f) sample = -1.0f;
-                        pcmData.push_back((int16_t)(sample * 32767.0f));
+                    if (flags & AUDCLNT_BUFFERFLAGS_SILENT) {
+                        memset(pcmData.data(), 0, samples * sizeof(int16_t)); // A SILENT buffer's contents are undefined
+                    } else {
+                        ConvertFloatToInt16((const float*)pData, pcmData.data(), samples);
                     }
                     
-                    callback((uint8_t*)pcmData.data(), pcmData.size() * sizeof(int16_t));
+                    callback((uint8_t*)pcmData.data(), samples * sizeof(int16_t));
                     
                     captureClient->ReleaseBuffer(numFrames);
                 }
@@ -0,0 +1,52 @@
+#pragma once
+#include <emmintrin.h> // SSE2
+#include <cstdint>
+#include <cstddef>
+
+// Silence threshold for DTX: -60 dBFS expressed as a mean square of int16 samples
+#define AUDIO_SILENCE_MEAN_SQUARE 1073.0
+
+// Float32 -> Int16 with hard clipping (WASAPI mix format -> wire format)
+inline void ConvertFloatToInt16(const float* src, int16_t* dst, size_t count) {
+    const __m128 lo = _mm_set1_ps(-1.0f);
+    const __m128 hi = _mm_set1_ps(1.0f);
+    const __m128 scale = _mm_set1_ps(32767.0f);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128 a = _mm_loadu_ps(src + i);
+        __m128 b = _mm_loadu_ps(src + i + 4);
+        a = _mm_mul_ps(_mm_min_ps(_mm_max_ps(a, lo), hi), scale);
+        b = _mm_mul_ps(_mm_min_ps(_mm_max_ps(b, lo), hi), scale);
+        __m128i packed = _mm_packs_epi32(_mm_cvttps_epi32(a), _mm_cvttps_epi32(b));
+        _mm_storeu_si128((__m128i*)(dst + i), packed);
+    }
+    for (; i < count; i++) {
+        float sample = src[i];
+        if (sample > 1.0f) sample = 1.0f;
+        if (sample < -1.0f) sample = -1.0f;
+        dst[i] = (int16_t)(sample * 32767.0f);
+    }
+}
+
+// Mean of squared samples (energy per sample) over interleaved int16 PCM
+inline double MeanSquare(const int16_t* pcm, size_t count) {
+    if (count == 0) return 0.0;
+    __m128i acc = _mm_setzero_si128(); // Two 64-bit lanes
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(pcm + i));
+        __m128i sq = _mm_madd_epi16(v, v); // 4 x (a*a + b*b), fits in uint32
+        acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(sq, zero));
+        acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(sq, zero));
+    }
+    uint64_t lanes[2];
+    _mm_storeu_si128((__m128i*)lanes, acc);
+    uint64_t sum = lanes[0] + lanes[1];
+    for (; i < count; i++) sum += (int64_t)pcm[i] * pcm[i];
+    return (double)sum / count;
+}
+
+inline bool IsSilent(const int16_t* pcm, size_t count) {
+    return MeanSquare(pcm, count) < AUDIO_SILENCE_MEAN_SQUARE;
+}
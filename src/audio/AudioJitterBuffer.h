@@ -0,0 +1,248 @@
+#pragma once
+#include "AudioRedundancy.h"
+#include "../common/Metrics.h"
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+
+// Reorders sequenced audio frames and conceals missing ones:
+// 1. A RED copy carried by a later packet is upsampled in place of the lost frame
+// 2. Otherwise the last pitch period is repeated with a decaying gain (waveform extrapolation)
+// During DTX (comfort-noise frames) the gaps between packets are filled with
+// noise at the signalled level instead of being treated as loss.
+class AudioJitterBuffer {
+public:
+    static const int SLOT_COUNT = 16;
+    static const int MAX_CONCEALED = 5; // ~50ms of extrapolation before going silent
+
+    struct Stats {
+        uint64_t received = 0;
+        uint64_t lost = 0;
+        uint64_t recovered = 0; // Rebuilt from redundant copies
+        uint64_t concealed = 0; // Extrapolated
+        uint64_t comfortNoise = 0; // Frames synthesized during DTX
+    };
+
+    void Reset() {
+        for (auto& s : slots) { s.valid = false; s.pcm.clear(); }
+        started = false;
+        nextSequence = 0;
+        highestSequence = 0;
+        concealedRun = 0;
+        lastFrame.clear();
+        dtxActive = false;
+        noiseLevel = 0;
+        stats = Stats();
+        lossRate = 0.0f;
+    }
+
+    void Push(const uint8_t* data, size_t size) {
+        if (size < sizeof(AudioFrameHeader)) return;
+        AudioFrameHeader header;
+        memcpy(&header, data, sizeof(header));
+        uint32_t seq = ntohl(header.sequence);
+        uint16_t flags = ntohs(header.flags);
+        size_t redundantBytes = ntohs(header.redundantSize);
+        size_t body = size - sizeof(AudioFrameHeader);
+        if (redundantBytes > body) return;
+        size_t primaryBytes = body - redundantBytes;
+        const uint8_t* payload = data + sizeof(AudioFrameHeader);
+
+        if (!started) {
+            started = true;
+            nextSequence = seq;
+            highestSequence = seq;
+        }
+        if ((int32_t)(seq - nextSequence) < 0) return; // Too late, already played or concealed
+        if ((int32_t)(seq - nextSequence) >= SLOT_COUNT) {
+            // Fell too far behind: skip ahead, counting what we never played
+            stats.lost += seq - nextSequence - (SLOT_COUNT - 1);
+            Metrics::Get().Add(Counter::AudioFramesLost, seq - nextSequence - (SLOT_COUNT - 1));
+            nextSequence = seq - (SLOT_COUNT - 1);
+        }
+        if ((int32_t)(seq - highestSequence) > 0) highestSequence = seq;
+        stats.received++;
+
+        Slot& slot = slots[seq % SLOT_COUNT];
+        slot.sequence = seq;
+        slot.valid = true;
+        slot.fromRedundancy = false;
+        slot.comfortNoise = (flags & AUDIO_FLAG_COMFORT_NOISE) != 0;
+        if (slot.comfortNoise) {
+            uint16_t level = 0;
+            if (primaryBytes >= sizeof(level)) memcpy(&level, payload, sizeof(level));
+            slot.noiseLevel = ntohs(level);
+            slot.pcm.clear();
+            return;
+        }
+        slot.pcm.resize(primaryBytes / sizeof(int16_t));
+        memcpy(slot.pcm.data(), payload, slot.pcm.size() * sizeof(int16_t));
+
+        // Redundant copy of seq - 1: only used if the primary never arrived
+        if ((flags & AUDIO_FLAG_REDUNDANT) && redundantBytes > 0) {
+            uint32_t prevSeq = seq - 1;
+            if ((int32_t)(prevSeq - nextSequence) >= 0) {
+                Slot& prev = slots[prevSeq % SLOT_COUNT];
+                if (!prev.valid || prev.sequence != prevSeq) {
+                    size_t monoFrames = redundantBytes / sizeof(int16_t);
+                    prev.sequence = prevSeq;
+                    prev.valid = true;
+                    prev.fromRedundancy = true;
+                    prev.comfortNoise = false;
+                    prev.pcm.resize(monoFrames * 2 * 2);
+                    UpsampleRedundant((const int16_t*)(payload + primaryBytes), monoFrames, prev.pcm.data(), monoFrames * 2);
+                }
+            }
+        }
+    }
+
+    // Frames buffered ahead of the playout point
+    int GetDepth() const {
+        if (!started) return 0;
+        return (int)(highestSequence - nextSequence) + 1;
+    }
+
+    // Next frame in sequence order (interleaved stereo int16).
+    // starving: the output device is about to run dry, so conceal instead of waiting.
+    bool Pop(std::vector<int16_t>& out, bool starving) {
+        if (!started) return false;
+
+        Slot& slot = slots[nextSequence % SLOT_COUNT];
+        if (slot.valid && slot.sequence == nextSequence && slot.comfortNoise) {
+            slot.valid = false;
+            dtxActive = true;
+            noiseLevel = slot.noiseLevel;
+            nextSequence++;
+            concealedRun = 0;
+            UpdateLoss(false);
+            GenerateComfortNoise(out);
+            return true;
+        }
+        if (slot.valid && slot.sequence == nextSequence) {
+            dtxActive = false;
+            out.swap(slot.pcm);
+            slot.valid = false;
+            if (slot.fromRedundancy) {
+                stats.recovered++;
+                Metrics::Get().Add(Counter::AudioFramesRecovered);
+                UpdateLoss(true);
+            } else {
+                UpdateLoss(false);
+            }
+            nextSequence++;
+            concealedRun = 0;
+            lastFrame.assign(out.begin(), out.end());
+            return true;
+        }
+
+        // Missing frame: a gap is confirmed once something later is buffered
+        bool gap = (int32_t)(highestSequence - nextSequence) > 0;
+        if (!gap && !starving) return false;
+        if (!gap && dtxActive) {
+            // Host is in DTX: bridge until the next frame without counting loss
+            GenerateComfortNoise(out);
+            return true;
+        }
+        if (lastFrame.empty() || concealedRun >= MAX_CONCEALED) {
+            if (!gap) return false;
+            out.assign(lastFrame.empty() ? 960 : lastFrame.size(), 0);
+        } else {
+            Extrapolate(out);
+        }
+        if (gap) {
+            stats.lost++;
+            Metrics::Get().Add(Counter::AudioFramesLost);
+            UpdateLoss(true);
+            nextSequence++;
+        }
+        stats.concealed++;
+        Metrics::Get().Add(Counter::AudioFramesConcealed);
+        concealedRun++;
+        return true;
+    }
+
+    float GetLossRate() const { return lossRate; }
+    const Stats& GetStats() const { return stats; }
+
+private:
+    struct Slot {
+        uint32_t sequence = 0;
+        bool valid = false;
+        bool fromRedundancy = false;
+        bool comfortNoise = false;
+        uint16_t noiseLevel = 0;
+        std::vector<int16_t> pcm;
+    };
+
+    Slot slots[SLOT_COUNT];
+    bool started = false;
+    uint32_t nextSequence = 0;
+    uint32_t highestSequence = 0;
+    int concealedRun = 0;
+    size_t concealLag = 0;
+    size_t concealPhase = 0;
+    std::vector<int16_t> lastFrame; // Last real frame, source for extrapolation
+    Stats stats;
+    float lossRate = 0.0f;
+
+    // DTX
+    bool dtxActive = false;
+    uint16_t noiseLevel = 0;
+    uint32_t noiseSeed = 0x12345678;
+
+    void UpdateLoss(bool lostFrame) {
+        // ~1s time constant at 100 packets/s
+        lossRate += ((lostFrame ? 1.0f : 0.0f) - lossRate) * 0.01f;
+    }
+
+    // 10ms of white noise at the signalled RMS level (uniform: RMS = amplitude / sqrt(3))
+    void GenerateComfortNoise(std::vector<int16_t>& out) {
+        out.resize(480 * 2);
+        float amplitude = noiseLevel * 1.732f;
+        for (size_t i = 0; i < out.size(); i++) {
+            noiseSeed = noiseSeed * 1664525u + 1013904223u;
+            float r = (float)(noiseSeed >> 8) / (float)(1 << 24) * 2.0f - 1.0f;
+            out[i] = (int16_t)(r * amplitude);
+        }
+        stats.comfortNoise++;
+    }
+
+    // Repeat the last pitch period of lastFrame, fading out over consecutive concealments
+    void Extrapolate(std::vector<int16_t>& out) {
+        size_t frames = lastFrame.size() / 2;
+        out.resize(frames * 2);
+
+        if (concealedRun == 0) {
+            // Autocorrelation pitch search on the mono mix, 2.5ms..15ms at 48kHz
+            const size_t minLag = 120;
+            size_t maxLag = frames / 2 < 720 ? frames / 2 : 720;
+            concealLag = frames;
+            concealPhase = 0;
+            if (maxLag > minLag) {
+                double bestScore = 0.0;
+                size_t window = frames - maxLag;
+                for (size_t lag = minLag; lag <= maxLag; lag += 2) {
+                    double score = 0.0;
+                    for (size_t i = frames - window; i < frames; i += 4) {
+                        int a = lastFrame[i * 2] + lastFrame[i * 2 + 1];
+                        int b = lastFrame[(i - lag) * 2] + lastFrame[(i - lag) * 2 + 1];
+                        score += (double)a * b;
+                    }
+                    if (score > bestScore) { bestScore = score; concealLag = lag; }
+                }
+            }
+        }
+
+        float gainStart = std::pow(0.5f, (float)concealedRun);
+        float gainEnd = gainStart * 0.5f;
+        size_t periodStart = frames - concealLag;
+        for (size_t i = 0; i < frames; i++) {
+            size_t src = periodStart + ((concealPhase + i) % concealLag);
+            float g = gainStart + (gainEnd - gainStart) * ((float)i / frames);
+            out[i * 2] = (int16_t)(lastFrame[src * 2] * g);
+            out[i * 2 + 1] = (int16_t)(lastFrame[src * 2 + 1] * g);
+        }
+        concealPhase = (concealPhase + frames) % concealLag;
+    }
+};
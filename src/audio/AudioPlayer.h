@@ -5,6 +5,7 @@
 #include <vector>
 #include <thread>
 #include <atomic>
+#include "AudioJitterBuffer.h"
 
 class AudioPlayer {
 public:
@@ -34,37 +35,51 @@ public:
         audioClient->Initialize(AUDCLNT_SHAREMODE_SHARED, 0, 10000000, 0, &fmt, nullptr);
         audioClient->GetService(__uuidof(IAudioRenderClient), (void**)&renderClient);
         audioClient->Start();
+        jitterBuffer.Reset();
         
         enumerator->Release();
         device->Release();
     }
 
+    // Takes one framed packet (see AudioRedundancy.h) and plays whatever is ready
     void QueueAudio(const uint8_t* data, size_t size) {
+        jitterBuffer.Push(data, size);
+        Pump();
+    }
+
+    // Feeds the device from the jitter buffer. Call regularly so gaps get concealed
+    // even while no packets are arriving.
+    void Pump() {
         if (!renderClient) return;
 
-        // Simple "Push" playback (Note: In production, you'd use a circular buffer to handle jitter)
-        // Here we just write whatever fits in the buffer to minimize latency
-        
         UINT32 bufferSize;
         audioClient->GetBufferSize(&bufferSize);
-        
+
         UINT32 padding;
         audioClient->GetCurrentPadding(&padding);
-        
-        UINT32 available = bufferSize - padding;
-        UINT32 incomingFrames = (UINT32)size / 4; // 16-bit stereo = 4 bytes per frame
 
-        if (incomingFrames > available) incomingFrames = available; // Drop excess to catch up
+        // Keep ~40ms queued on the device; below ~10ms we conceal rather than wait
+        const UINT32 targetFrames = 1920;
+        const UINT32 starvingFrames = 480;
+
+        while (padding < targetFrames) {
+            if (!jitterBuffer.Pop(frame, padding < starvingFrames)) break;
+
+            UINT32 incomingFrames = (UINT32)frame.size() / 2; // 16-bit stereo
+            UINT32 available = bufferSize - padding;
+            if (incomingFrames > available) incomingFrames = available; // Drop excess to catch up
+            if (incomingFrames == 0) break;
 
-        if (incomingFrames > 0) {
             BYTE* pBuffer;
-            if (SUCCEEDED(renderClient->GetBuffer(incomingFrames, &pBuffer))) {
-                memcpy(pBuffer, data, incomingFrames * 4);
-                renderClient->ReleaseBuffer(incomingFrames, 0);
-            }
+            if (FAILED(renderClient->GetBuffer(incomingFrames, &pBuffer))) break;
+            memcpy(pBuffer, frame.data(), incomingFrames * 4);
+            renderClient->ReleaseBuffer(incomingFrames, 0);
+            padding += incomingFrames;
         }
     }
 
+    const AudioJitterBuffer& GetJitterBuffer() const { return jitterBuffer; }
+
     void Cleanup() {
         if (audioClient) { audioClient->Stop(); audioClient->Release(); audioClient = nullptr; }
         if (renderClient) { renderClient->Release(); renderClient = nullptr; }
@@ -73,4 +88,6 @@ public:
 private:
     IAudioClient* audioClient = nullptr;
     IAudioRenderClient* renderClient = nullptr;
+    AudioJitterBuffer jitterBuffer;
+    std::vector<int16_t> frame;
 };
\ No newline at end of file
@@ -0,0 +1,141 @@
+#pragma once
+#include <winsock2.h>
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include "AudioDSP.h"
+
+// Audio payload framing (inside PACKET_TYPE_AUDIO)
+// [AudioFrameHeader][primary PCM (48kHz stereo int16)][redundant PCM (24kHz mono int16)]
+#define AUDIO_FLAG_REDUNDANT     0x1 // Carries a low-bitrate copy of frame (sequence - 1)
+#define AUDIO_FLAG_COMFORT_NOISE 0x2 // DTX: no PCM, payload is a uint16 noise RMS level
+
+// Discontinuous transmission: after ~200ms of silence stop sending PCM and
+// only send a comfort-noise frame twice a second (doubles as a keepalive)
+#define AUDIO_DTX_HANGOVER_MS 200
+#define AUDIO_DTX_SID_INTERVAL_MS 500
+
+// Redundancy hysteresis: turn on above 2% measured loss, off again below 0.5%
+#define AUDIO_RED_ENABLE_LOSS  0.02f
+#define AUDIO_RED_DISABLE_LOSS 0.005f
+
+struct AudioFrameHeader {
+    uint32_t sequence;
+    uint16_t flags;
+    uint16_t redundantSize; // Bytes of redundant data at the end of the payload
+};
+
+// Low-bitrate copy: downmix to mono and decimate 2:1 (1/4 of the primary size)
+inline size_t DownsampleForRedundancy(const int16_t* stereo, size_t frames, int16_t* out) {
+    size_t outFrames = frames / 2;
+    for (size_t i = 0; i < outFrames; i++) {
+        const int16_t* s = stereo + i * 4; // Two stereo frames
+        int sum = (int)s[0] + s[1] + s[2] + s[3];
+        out[i] = (int16_t)(sum / 4);
+    }
+    return outFrames;
+}
+
+// Inverse of DownsampleForRedundancy: linear interpolation back to 48kHz stereo
+inline void UpsampleRedundant(const int16_t* mono, size_t monoFrames, int16_t* stereo, size_t frames) {
+    if (monoFrames == 0) {
+        memset(stereo, 0, frames * 4);
+        return;
+    }
+    for (size_t i = 0; i < frames; i++) {
+        size_t idx = i / 2;
+        int16_t a = mono[idx < monoFrames ? idx : monoFrames - 1];
+        int16_t b = mono[idx + 1 < monoFrames ? idx + 1 : monoFrames - 1];
+        int16_t v = (i & 1) ? (int16_t)(((int)a + b) / 2) : a;
+        stereo[i * 2] = v;
+        stereo[i * 2 + 1] = v;
+    }
+}
+
+// Sender side: sequences PCM frames and, while measured loss is high,
+// appends a RED-style low-rate copy of the previous frame to each packet.
+// Silent stretches are replaced by sparse comfort-noise frames (DTX).
+class AudioRedundancyEncoder {
+public:
+    void Reset() {
+        sequence = 0;
+        previousLowRate.clear();
+        redundancyActive = false;
+        silentMs = 0;
+        sinceComfortNoiseMs = 0;
+        inDtx = false;
+    }
+
+    // Fed with the receiver's loss estimate (0..1)
+    void SetMeasuredLoss(float lossRate) {
+        if (!redundancyActive && lossRate >= AUDIO_RED_ENABLE_LOSS) redundancyActive = true;
+        else if (redundancyActive && lossRate <= AUDIO_RED_DISABLE_LOSS) redundancyActive = false;
+    }
+
+    bool IsRedundancyActive() const { return redundancyActive; }
+
+    bool IsInDtx() const { return inDtx; }
+
+    // pcm: interleaved 16-bit stereo. Returned buffer is valid until the next call
+    // and is empty when nothing should be sent (DTX).
+    const std::vector<uint8_t>& Encode(const int16_t* pcm, size_t frames) {
+        int frameMs = (int)(frames / 48);
+        double meanSquare = MeanSquare(pcm, frames * 2);
+        if (meanSquare < AUDIO_SILENCE_MEAN_SQUARE) silentMs += frameMs;
+        else silentMs = 0;
+
+        if (silentMs > AUDIO_DTX_HANGOVER_MS) {
+            if (!inDtx) {
+                inDtx = true;
+                sinceComfortNoiseMs = AUDIO_DTX_SID_INTERVAL_MS; // Announce immediately
+                previousLowRate.clear();
+            }
+            sinceComfortNoiseMs += frameMs;
+            packet.clear();
+            if (sinceComfortNoiseMs < AUDIO_DTX_SID_INTERVAL_MS) return packet;
+            sinceComfortNoiseMs = 0;
+
+            packet.resize(sizeof(AudioFrameHeader) + sizeof(uint16_t));
+            AudioFrameHeader* header = (AudioFrameHeader*)packet.data();
+            header->sequence = htonl(sequence++);
+            header->flags = htons(AUDIO_FLAG_COMFORT_NOISE);
+            header->redundantSize = 0;
+            uint16_t level = htons((uint16_t)std::sqrt(meanSquare));
+            memcpy(packet.data() + sizeof(AudioFrameHeader), &level, sizeof(level));
+            return packet;
+        }
+        inDtx = false;
+
+        bool withRedundancy = redundancyActive && !previousLowRate.empty();
+        size_t primaryBytes = frames * 4;
+        size_t redundantBytes = withRedundancy ? previousLowRate.size() * sizeof(int16_t) : 0;
+
+        packet.resize(sizeof(AudioFrameHeader) + primaryBytes + redundantBytes);
+        AudioFrameHeader* header = (AudioFrameHeader*)packet.data();
+        header->sequence = htonl(sequence++);
+        header->flags = htons(withRedundancy ? AUDIO_FLAG_REDUNDANT : 0);
+        header->redundantSize = htons((uint16_t)redundantBytes);
+
+        uint8_t* dst = packet.data() + sizeof(AudioFrameHeader);
+        memcpy(dst, pcm, primaryBytes);
+        if (withRedundancy) memcpy(dst + primaryBytes, previousLowRate.data(), redundantBytes);
+
+        // Keep a low-rate copy of this frame for the next packet
+        previousLowRate.resize(frames / 2);
+        DownsampleForRedundancy(pcm, frames, previousLowRate.data());
+        return packet;
+    }
+
+private:
+    uint32_t sequence = 0;
+    std::atomic<bool> redundancyActive = false;
+    std::vector<int16_t> previousLowRate;
+    std::vector<uint8_t> packet;
+
+    // DTX
+    int silentMs = 0;
+    int sinceComfortNoiseMs = 0;
+    bool inDtx = false;
+};
@@ -0,0 +1,205 @@
+// Steady-state heap allocation check for the portable pipeline (standalone executable).
+// Build together with video/AnnexBParser.cpp.
+//
+//   AllocCheck [--warmup N] [--frames N]
+//
+// Replaces the global allocator with a counting one, runs the CPU side of the pipeline
+// (Annex-B parse -> packet pool -> send queue -> loopback TCP -> receive -> parse, and
+// audio float->int16 -> RED -> send -> jitter buffer with loss) until warmed up, then
+// fails with exit code 2 if any thread allocates during the measured frames.
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <new>
+#include <cstdlib>
+#include <cmath>
+#include "BenchHarness.h"
+#include "BenchLoopback.h"
+#include "../common/NetworkManager.h"
+#include "../common/PacketPool.h"
+#include "../common/SendQueue.h"
+#include "../audio/AudioDSP.h"
+#include "../audio/AudioRedundancy.h"
+#include "../audio/AudioJitterBuffer.h"
+#include "../video/AnnexBParser.h"
+
+// ===== COUNTING ALLOCATOR =====
+static std::atomic<bool> g_CountAllocations = false;
+static std::atomic<uint64_t> g_Allocations = 0;
+static std::atomic<uint64_t> g_AllocatedBytes = 0;
+
+static void* CountedAlloc(size_t size, size_t alignment) {
+    if (g_CountAllocations.load(std::memory_order_relaxed)) {
+        g_Allocations.fetch_add(1, std::memory_order_relaxed);
+        g_AllocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    }
+    if (size == 0) size = 1;
+#ifdef _MSC_VER
+    void* p = alignment > alignof(std::max_align_t) ? _aligned_malloc(size, alignment) : malloc(size);
+#else
+    void* p = alignment > alignof(std::max_align_t) ? aligned_alloc(alignment, (size + alignment - 1) & ~(alignment - 1))
+                                                     : malloc(size);
+#endif
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+static void CountedFree(void* p, size_t alignment) {
+#ifdef _MSC_VER
+    if (alignment > alignof(std::max_align_t)) { _aligned_free(p); return; }
+#endif
+    (void)alignment;
+    free(p);
+}
+
+void* operator new(size_t size) { return CountedAlloc(size, 0); }
+void* operator new[](size_t size) { return CountedAlloc(size, 0); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    try { return CountedAlloc(size, 0); } catch (...) { return nullptr; }
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    try { return CountedAlloc(size, 0); } catch (...) { return nullptr; }
+}
+void* operator new(size_t size, std::align_val_t align) { return CountedAlloc(size, (size_t)align); }
+void* operator new[](size_t size, std::align_val_t align) { return CountedAlloc(size, (size_t)align); }
+void operator delete(void* p) noexcept { CountedFree(p, 0); }
+void operator delete[](void* p) noexcept { CountedFree(p, 0); }
+void operator delete(void* p, size_t) noexcept { CountedFree(p, 0); }
+void operator delete[](void* p, size_t) noexcept { CountedFree(p, 0); }
+void operator delete(void* p, std::align_val_t align) noexcept { CountedFree(p, (size_t)align); }
+void operator delete[](void* p, std::align_val_t align) noexcept { CountedFree(p, (size_t)align); }
+void operator delete(void* p, size_t, std::align_val_t align) noexcept { CountedFree(p, (size_t)align); }
+void operator delete[](void* p, size_t, std::align_val_t align) noexcept { CountedFree(p, (size_t)align); }
+
+// ===== PIPELINE =====
+const size_t AUDIO_FRAMES = 480;       // 10ms at 48kHz
+const int AUDIO_PACKETS_PER_FRAME = 2; // ~16ms of video per 10ms audio packet, rounded
+
+// Receiver side: parses video, feeds audio through the jitter buffer with a fixed loss
+// pattern (single losses recovered from RED, a double loss concealed)
+class Receiver {
+public:
+    void Start(NetworkManager* net, SOCKET sock) {
+        this->net = net;
+        this->sock = sock;
+        thread = std::thread(&Receiver::Loop, this);
+    }
+    void Join() { if (thread.joinable()) thread.join(); }
+    uint64_t GetReceived() const { return received.load(std::memory_order_acquire); }
+    const AudioJitterBuffer::Stats& GetAudioStats() const { return jitter.GetStats(); }
+
+private:
+    NetworkManager* net = nullptr;
+    SOCKET sock = INVALID_SOCKET;
+    std::thread thread;
+    std::atomic<uint64_t> received = 0;
+    AnnexBParser parser;
+    AudioJitterBuffer jitter;
+    std::vector<uint8_t> buffer;
+    std::vector<int16_t> pcm;
+
+    void Loop() {
+        Tracer::SetThreadName("Receiver");
+        PacketHeader header;
+        uint64_t audioCount = 0;
+        while (net->ReceiveHeader((int)sock, header) && net->ReceiveBody((int)sock, buffer, header.payloadSize)) {
+            if (header.packetType == PACKET_TYPE_VIDEO) {
+                AccessUnitInfo au = parser.ParseAccessUnit(buffer.data(), header.payloadSize);
+                BenchSink(&au, sizeof(au));
+            } else {
+                uint64_t n = audioCount++;
+                bool lost = n % 10 == 3 || n % 50 == 20 || n % 50 == 21;
+                if (!lost) jitter.Push(buffer.data(), header.payloadSize);
+                while (jitter.Pop(pcm, false)) BenchSink(pcm.data(), pcm.size() * 2);
+            }
+            received.fetch_add(1, std::memory_order_release);
+        }
+    }
+};
+
+int main(int argc, char** argv) {
+    int warmupFrames = 300;
+    int measuredFrames = 3000;
+    for (int i = 1; i + 1 < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--warmup") warmupFrames = atoi(argv[++i]);
+        else if (arg == "--frames") measuredFrames = atoi(argv[++i]);
+    }
+
+    NetworkManager net;
+    SOCKET hostSock, clientSock;
+    if (!CreateLoopbackPair(hostSock, clientSock)) {
+        std::cerr << "[AllocCheck] Loopback sockets unavailable" << std::endl;
+        return 1;
+    }
+
+    std::vector<uint8_t> idr = MakeSyntheticAccessUnit(120 * 1024);
+    std::vector<uint8_t> delta = MakeSyntheticAccessUnit(12 * 1024, 0x41);
+    std::vector<float> mix(AUDIO_FRAMES * 2);
+    for (size_t i = 0; i < mix.size(); i++) mix[i] = (float)sin(i * 0.05) * 0.5f;
+    std::vector<int16_t> pcm(mix.size());
+
+    PacketPool pool;
+    AnnexBParser hostParser;
+    AudioRedundancyEncoder red;
+    red.SetMeasuredLoss(1.0f); // Keep the RED path active
+    SendQueue queue;
+    queue.Start(&net, (int)hostSock, nullptr);
+    Receiver receiver;
+    receiver.Start(&net, clientSock);
+
+    uint64_t sent = 0;
+    auto runFrame = [&](int frame) {
+        const std::vector<uint8_t>& au = frame % 60 == 0 ? idr : delta;
+        AccessUnitInfo info = hostParser.ParseAccessUnit(au.data(), au.size());
+        PacketRef video = pool.Acquire(au.data(), au.size());
+        video->packetType = PACKET_TYPE_VIDEO;
+        video->frameId = (uint32_t)frame;
+        video->frameType = (uint32_t)info.frameType;
+        queue.Push(std::move(video));
+        sent++;
+
+        for (int a = 0; a < AUDIO_PACKETS_PER_FRAME; a++) {
+            ConvertFloatToInt16(mix.data(), pcm.data(), pcm.size());
+            const std::vector<uint8_t>& packet = red.Encode(pcm.data(), AUDIO_FRAMES);
+            PacketRef audio = pool.Acquire(packet.data(), packet.size());
+            audio->packetType = PACKET_TYPE_AUDIO;
+            queue.Push(std::move(audio));
+            sent++;
+        }
+        // Lockstep with the receiver so queue depth (and pool size) stay bounded
+        while (receiver.GetReceived() < sent) std::this_thread::yield();
+    };
+
+    for (int i = 0; i < warmupFrames; i++) runFrame(i);
+    size_t poolAfterWarmup = pool.GetAllocatedCount();
+
+    g_CountAllocations = true;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < measuredFrames; i++) runFrame(warmupFrames + i);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    g_CountAllocations = false;
+
+    uint64_t allocations = g_Allocations;
+    uint64_t bytes = g_AllocatedBytes;
+    queue.Stop();
+    shutdown(hostSock, SD_SEND);
+    receiver.Join();
+    closesocket(hostSock);
+    closesocket(clientSock);
+
+    const AudioJitterBuffer::Stats& audio = receiver.GetAudioStats();
+    std::cout << "[AllocCheck] " << measuredFrames << " frames (" << sent << " packets) in " << seconds << "s, pool "
+              << poolAfterWarmup << " -> " << pool.GetAllocatedCount() << " buffers, " << pool.GetHeldBytes() / 1024
+              << " KB" << std::endl;
+    std::cout << "[AllocCheck] Audio: " << audio.received << " received, " << audio.recovered << " recovered, "
+              << audio.concealed << " concealed" << std::endl;
+    if (allocations > 0) {
+        std::cerr << "[AllocCheck] FAIL: " << allocations << " allocations (" << bytes << " bytes) after warm-up, "
+                  << (double)allocations / measuredFrames << " per frame" << std::endl;
+        return 2;
+    }
+    std::cout << "[AllocCheck] OK: no allocations after warm-up" << std::endl;
+    return 0;
+}
@@ -0,0 +1,214 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <iostream>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <ctime>
+#ifdef _MSC_VER
+#include <intrin.h>
+#include <winsock2.h> // Includes windows.h (GetProcessTimes); must come first for the socket benches
+#else
+#include <cpuid.h>
+#endif
+
+// Minimal microbenchmark runner for the src/bench executables.
+// Each benchmark is a batch function run(iterations); the runner calibrates the
+// batch size to BENCH_MIN_BATCH_MS, takes BENCH_REPETITIONS timed batches and
+// reports the median. Results go out as JSON together with the CPU it ran on.
+// Process CPU time (all threads, user + kernel) is sampled around each batch too, so
+// benchmarks that drive helper threads or sockets can report CPU cost, not just latency.
+
+#define BENCH_MIN_BATCH_MS 100
+#define BENCH_REPETITIONS 5
+
+// Keeps the compiler from discarding a kernel whose output is never read
+inline void BenchSink(const void* data, size_t size) {
+    static volatile uint8_t sink;
+    if (size) sink = ((const uint8_t*)data)[0] ^ ((const uint8_t*)data)[size - 1];
+}
+
+// Synthetic H.264 access unit: AUD, SPS/PPS (1080p High), one large slice without start-code emulation.
+// sliceNalHeader 0x65 = IDR, 0x41 = non-IDR reference slice.
+inline std::vector<uint8_t> MakeSyntheticAccessUnit(size_t sliceBytes, uint8_t sliceNalHeader = 0x65) {
+    static const uint8_t prefix[] = {
+        0, 0, 0, 1, 0x09, 0x10,
+        0, 0, 0, 1, 0x67, 0x64, 0x00, 0x28, 0xAC, 0xD9, 0x40, 0x78, 0x02, 0x27, 0xE5, 0xC0, 0x44, 0x00, 0x00, 0x03,
+        0x00, 0x04, 0x00, 0x00, 0x03, 0x00, 0xF0, 0x3C, 0x60, 0xC6, 0x58,
+        0, 0, 0, 1, 0x68, 0xEB, 0xE3, 0xCB, 0x22, 0xC0,
+        0, 0, 0, 1, 0x65, 0x88, 0x84,
+    };
+    std::vector<uint8_t> au(prefix, prefix + sizeof(prefix));
+    au[sizeof(prefix) - 3] = sliceNalHeader;
+    std::mt19937 rng(7);
+    for (size_t i = 0; i < sliceBytes; i++) au.push_back((uint8_t)(1 + rng() % 255)); // No zero bytes
+    return au;
+}
+
+struct CpuInfo {
+    std::string vendor;
+    std::string brand;
+    bool sse2 = false, ssse3 = false, sse41 = false, sse42 = false, avx = false, avx2 = false, avx512f = false;
+    unsigned threads = 0;
+
+    static void Cpuid(int leaf, int sub, unsigned regs[4]) {
+#ifdef _MSC_VER
+        __cpuidex((int*)regs, leaf, sub);
+#else
+        __cpuid_count(leaf, sub, regs[0], regs[1], regs[2], regs[3]);
+#endif
+    }
+
+    static CpuInfo Detect(unsigned threads) {
+        CpuInfo info;
+        info.threads = threads;
+        unsigned r[4];
+        Cpuid(0, 0, r);
+        unsigned maxLeaf = r[0];
+        char vendor[13] = {};
+        memcpy(vendor, &r[1], 4);
+        memcpy(vendor + 4, &r[3], 4);
+        memcpy(vendor + 8, &r[2], 4);
+        info.vendor = vendor;
+        if (maxLeaf >= 1) {
+            Cpuid(1, 0, r);
+            info.sse2 = (r[3] >> 26) & 1;
+            info.ssse3 = (r[2] >> 9) & 1;
+            info.sse41 = (r[2] >> 19) & 1;
+            info.sse42 = (r[2] >> 20) & 1;
+            info.avx = (r[2] >> 28) & 1;
+        }
+        if (maxLeaf >= 7) {
+            Cpuid(7, 0, r);
+            info.avx2 = (r[1] >> 5) & 1;
+            info.avx512f = (r[1] >> 16) & 1;
+        }
+        Cpuid(0x80000000, 0, r);
+        if (r[0] >= 0x80000004) {
+            char brand[49] = {};
+            for (int i = 0; i < 3; i++) {
+                Cpuid(0x80000002 + i, 0, r);
+                memcpy(brand + i * 16, r, 16);
+            }
+            info.brand = brand;
+            info.brand.erase(0, info.brand.find_first_not_of(' '));
+        }
+        return info;
+    }
+
+    std::string ToJson() const {
+        char buf[512];
+        snprintf(buf, sizeof(buf),
+            "{\"vendor\":\"%s\",\"brand\":\"%s\",\"threads\":%u,\"features\":{\"sse2\":%s,\"ssse3\":%s,"
+            "\"sse4_1\":%s,\"sse4_2\":%s,\"avx\":%s,\"avx2\":%s,\"avx512f\":%s}}",
+            vendor.c_str(), brand.c_str(), threads, sse2 ? "true" : "false", ssse3 ? "true" : "false",
+            sse41 ? "true" : "false", sse42 ? "true" : "false", avx ? "true" : "false", avx2 ? "true" : "false",
+            avx512f ? "true" : "false");
+        return buf;
+    }
+};
+
+struct BenchResult {
+    std::string name;
+    uint64_t iterations = 0; // Per timed batch
+    double nsPerOp = 0;
+    double minNsPerOp = 0;
+    double bytesPerOp = 0;
+    double cpuNsPerOp = 0; // Process CPU time, median batch
+};
+
+// User + kernel CPU time of the whole process in nanoseconds
+inline double ProcessCpuNs() {
+#ifdef _MSC_VER
+    FILETIME creation, exit, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) return 0;
+    auto ticks = [](const FILETIME& t) { return ((uint64_t)t.dwHighDateTime << 32) | t.dwLowDateTime; };
+    return (double)(ticks(kernel) + ticks(user)) * 100.0; // 100ns units
+#else
+    return (double)std::clock() * (1e9 / CLOCKS_PER_SEC);
+#endif
+}
+
+class BenchRunner {
+public:
+    // Only benchmarks whose name contains filter run (empty = all)
+    explicit BenchRunner(const std::string& filter = std::string()) : filter(filter) {}
+
+    bool Matches(const char* name) const { return filter.empty() || std::string(name).find(filter) != std::string::npos; }
+
+    template <typename BatchFn>
+    void Run(const char* name, size_t bytesPerOp, BatchFn&& run) {
+        if (!Matches(name)) return;
+
+        // Calibrate: grow the batch until it takes at least BENCH_MIN_BATCH_MS
+        uint64_t iterations = 1;
+        while (true) {
+            double ns = TimeBatch(run, iterations);
+            if (ns >= BENCH_MIN_BATCH_MS * 1e6 || iterations >= (1ull << 40)) break;
+            uint64_t target = ns > 0 ? (uint64_t)(iterations * (BENCH_MIN_BATCH_MS * 1.2e6 / ns)) : iterations * 10;
+            iterations = std::max(iterations * 2, std::min(target, iterations * 100));
+        }
+
+        std::vector<double> samples;
+        std::vector<double> cpuSamples;
+        for (int i = 0; i < BENCH_REPETITIONS; i++) {
+            double cpuStart = ProcessCpuNs();
+            samples.push_back(TimeBatch(run, iterations) / iterations);
+            cpuSamples.push_back((ProcessCpuNs() - cpuStart) / iterations);
+        }
+        std::sort(samples.begin(), samples.end());
+        std::sort(cpuSamples.begin(), cpuSamples.end());
+
+        BenchResult result;
+        result.name = name;
+        result.iterations = iterations;
+        result.nsPerOp = samples[samples.size() / 2];
+        result.minNsPerOp = samples.front();
+        result.bytesPerOp = (double)bytesPerOp;
+        result.cpuNsPerOp = cpuSamples[cpuSamples.size() / 2];
+        results.push_back(result);
+        fprintf(stderr, "%-44s %12.1f ns/op", name, result.nsPerOp);
+        if (bytesPerOp) fprintf(stderr, " %10.1f MB/s", bytesPerOp / result.nsPerOp * 1e3);
+        fprintf(stderr, "\n");
+    }
+
+    const std::vector<BenchResult>& GetResults() const { return results; }
+
+    std::string ToJson(const char* suite, const CpuInfo& cpu) const {
+        std::string json = "{\"suite\":\"";
+        json += suite;
+        json += "\",\"cpu\":" + cpu.ToJson() + ",\"benchmarks\":[";
+        char buf[256];
+        for (size_t i = 0; i < results.size(); i++) {
+            const BenchResult& r = results[i];
+            snprintf(buf, sizeof(buf), "%s{\"name\":\"%s\",\"iterations\":%llu,\"ns_per_op\":%.2f,\"min_ns_per_op\":%.2f,\"cpu_ns_per_op\":%.2f",
+                i ? "," : "", r.name.c_str(), (unsigned long long)r.iterations, r.nsPerOp, r.minNsPerOp, r.cpuNsPerOp);
+            json += buf;
+            if (r.bytesPerOp > 0) {
+                // CPU milliseconds spent per gigabit moved
+                snprintf(buf, sizeof(buf), ",\"bytes_per_op\":%.0f,\"mb_per_s\":%.1f,\"cpu_ms_per_gbit\":%.2f", r.bytesPerOp,
+                    r.bytesPerOp / r.nsPerOp * 1e3, r.cpuNsPerOp / (r.bytesPerOp * 8) * 1e3);
+                json += buf;
+            }
+            json += "}";
+        }
+        json += "]}";
+        return json;
+    }
+
+private:
+    std::string filter;
+    std::vector<BenchResult> results;
+
+    template <typename BatchFn>
+    static double TimeBatch(BatchFn& run, uint64_t iterations) {
+        auto start = std::chrono::steady_clock::now();
+        run(iterations);
+        auto end = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::nano>(end - start).count();
+    }
+};
@@ -0,0 +1,37 @@
+#pragma once
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+// Connected TCP pair over loopback for the src/bench executables (both ends blocking,
+// Nagle off, large buffers). A NetworkManager must exist first (it owns WSAStartup).
+// receiverFlags are WSASocket flags for the receiving end (e.g. WSA_FLAG_REGISTERED_IO).
+inline bool CreateLoopbackPair(SOCKET& sender, SOCKET& receiver, DWORD receiverFlags = 0) {
+    SOCKET listenSock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    int addrLen = sizeof(addr);
+    if (bind(listenSock, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR ||
+        getsockname(listenSock, (sockaddr*)&addr, &addrLen) == SOCKET_ERROR ||
+        listen(listenSock, 1) == SOCKET_ERROR) {
+        closesocket(listenSock);
+        return false;
+    }
+    // The receiver connects, so it is the end created with the requested flags
+    receiver = WSASocketW(AF_INET, SOCK_STREAM, IPPROTO_TCP, nullptr, 0, WSA_FLAG_OVERLAPPED | receiverFlags);
+    if (connect(receiver, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR) {
+        closesocket(listenSock);
+        return false;
+    }
+    sender = accept(listenSock, nullptr, nullptr);
+    closesocket(listenSock);
+    int bufferSize = 4 * 1024 * 1024;
+    BOOL nodelay = TRUE;
+    for (SOCKET s : { sender, receiver }) {
+        setsockopt(s, SOL_SOCKET, SO_SNDBUF, (const char*)&bufferSize, sizeof(bufferSize));
+        setsockopt(s, SOL_SOCKET, SO_RCVBUF, (const char*)&bufferSize, sizeof(bufferSize));
+        setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char*)&nodelay, sizeof(nodelay));
+    }
+    return sender != INVALID_SOCKET;
+}
@@ -0,0 +1,708 @@
+// Hot kernel and transport primitive microbenchmarks (standalone executable).
+// Build together with video/AnnexBParser.cpp.
+//
+//   KernelBench [--filter <substring>] [--out <file.json>]
+//
+// Human-readable results go to stderr, the JSON report (with CPU info) to stdout
+// or --out, so runs can be archived and compared across releases.
+#include <iostream>
+#include <vector>
+#include <string>
+#include <thread>
+#include <random>
+#include <cmath>
+#include <cstring>
+#include "BenchHarness.h"
+#include "BenchLoopback.h"
+#include "../common/NetworkManager.h"
+#include "../common/PacketPool.h"
+#include "../common/SendQueue.h"
+#include "../common/FrameRing.h"
+#include "../common/DatagramSocket.h"
+#include "../common/StreamReceiver.h"
+#include "../common/SharedMemoryRing.h"
+#include "../common/Discovery.h"
+#include "../common/ControlChannel.h"
+#include "../audio/AudioDSP.h"
+#include "../audio/AudioRedundancy.h"
+#include "../audio/AudioJitterBuffer.h"
+#include "../video/AnnexBParser.h"
+#include "../video/PixelConvert.h"
+
+const int FRAME_WIDTH = 1920;
+const int FRAME_HEIGHT = 1080;
+const int ALIGNED_HEIGHT = 1088;
+const size_t AUDIO_FRAMES = 480; // 10ms at 48kHz
+const size_t MTU_PAYLOAD = 1400;
+
+void BenchFraming(BenchRunner& bench) {
+    bench.Run("framing/header_encode_decode", sizeof(PacketHeader), [](uint64_t n) {
+        PacketHeader header = {};
+        for (uint64_t i = 0; i < n; i++) {
+            header = EncodePacketHeader(PACKET_TYPE_VIDEO, (uint32_t)i, 100, 200, (uint32_t)i, 1);
+            DecodePacketHeader(header);
+            BenchSink(&header, sizeof(header));
+        }
+    });
+
+    NetworkManager net;
+    SOCKET sender, receiver;
+    if (!CreateLoopbackPair(sender, receiver)) {
+        std::cerr << "[KernelBench] Loopback sockets unavailable, skipping transport benchmarks" << std::endl;
+        return;
+    }
+    std::vector<uint8_t> body;
+    for (size_t size : { MTU_PAYLOAD, (size_t)64 * 1024 }) {
+        std::vector<uint8_t> payload(size, 0x5A);
+        std::string name = "framing/loopback_send_receive_" + std::to_string(size);
+        bench.Run(name.c_str(), size + sizeof(PacketHeader), [&](uint64_t n) {
+            PacketHeader header;
+            for (uint64_t i = 0; i < n; i++) {
+                net.SendPacket((int)sender, PACKET_TYPE_VIDEO, payload.data(), payload.size(), 0, 0, (uint32_t)i, 2);
+                net.ReceiveHeader((int)receiver, header);
+                net.ReceiveBody((int)receiver, body, header.payloadSize);
+            }
+            BenchSink(body.data(), header.payloadSize);
+        });
+    }
+    closesocket(sender);
+    closesocket(receiver);
+}
+
+void BenchFec(BenchRunner& bench) {
+    std::vector<int16_t> pcm(AUDIO_FRAMES * 2);
+    for (size_t i = 0; i < pcm.size(); i++) pcm[i] = (int16_t)(8000 * sin(i * 0.01)); // Not silent (no DTX)
+
+    AudioRedundancyEncoder encoder;
+    encoder.SetMeasuredLoss(1.0f);
+    bench.Run("fec/red_encode_10ms", AUDIO_FRAMES * 4, [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+            const std::vector<uint8_t>& packet = encoder.Encode(pcm.data(), AUDIO_FRAMES);
+            BenchSink(packet.data(), packet.size());
+        }
+    });
+
+    // Every other packet lost: each Pop pair plays one primary and one frame rebuilt from RED
+    AudioJitterBuffer jitter;
+    std::vector<uint8_t> packet;
+    std::vector<int16_t> out;
+    encoder.Reset();
+    encoder.SetMeasuredLoss(1.0f);
+    bench.Run("fec/red_recover_10ms", AUDIO_FRAMES * 4, [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+            encoder.Encode(pcm.data(), AUDIO_FRAMES); // Lost
+            const std::vector<uint8_t>& kept = encoder.Encode(pcm.data(), AUDIO_FRAMES);
+            jitter.Push(kept.data(), kept.size());
+            jitter.Pop(out, true);
+            jitter.Pop(out, true);
+            BenchSink(out.data(), out.size() * 2);
+        }
+    });
+}
+
+void BenchPixels(BenchRunner& bench) {
+    int pitch = FRAME_WIDTH * 4 + 256; // Staging textures are usually over-aligned
+    std::vector<uint8_t> bgra((size_t)pitch * FRAME_HEIGHT);
+    std::mt19937 rng(3);
+    for (auto& b : bgra) b = (uint8_t)rng();
+    std::vector<uint8_t> nv12((size_t)FRAME_WIDTH * ALIGNED_HEIGHT * 3 / 2);
+    std::vector<uint8_t> padded((size_t)FRAME_WIDTH * ALIGNED_HEIGHT * 4);
+
+    bench.Run("pixel/bgra_to_nv12_1080p", (size_t)FRAME_WIDTH * FRAME_HEIGHT * 4, [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+            ConvertBGRAToNV12(bgra.data(), pitch, FRAME_WIDTH, FRAME_HEIGHT, nv12.data(), FRAME_WIDTH, ALIGNED_HEIGHT);
+        }
+        BenchSink(nv12.data(), nv12.size());
+    });
+    bench.Run("pixel/bgra_padded_copy_1080p", (size_t)FRAME_WIDTH * FRAME_HEIGHT * 4, [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+            CopyBGRAPadded(bgra.data(), pitch, FRAME_WIDTH, FRAME_HEIGHT, padded.data(), FRAME_WIDTH, ALIGNED_HEIGHT);
+        }
+        BenchSink(padded.data(), padded.size());
+    });
+
+    int nv12Pitch = 2048;
+    std::vector<uint8_t> src((size_t)nv12Pitch * ALIGNED_HEIGHT * 3 / 2, 0x80);
+    std::vector<uint8_t> dst(src.size());
+    bench.Run("pixel/nv12_plane_copy_1080p", (size_t)FRAME_WIDTH * FRAME_HEIGHT * 3 / 2, [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+            CopyNV12(src.data(), nv12Pitch, dst.data(), nv12Pitch, FRAME_WIDTH, FRAME_HEIGHT, ALIGNED_HEIGHT);
+        }
+        BenchSink(dst.data(), dst.size());
+    });
+}
+
+void BenchAudio(BenchRunner& bench) {
+    std::vector<float> mix(AUDIO_FRAMES * 2);
+    for (size_t i = 0; i < mix.size(); i++) mix[i] = (float)sin(i * 0.02) * 1.1f; // Some samples clip
+    std::vector<int16_t> pcm(mix.size());
+
+    bench.Run("audio/float_to_int16_10ms", mix.size() * sizeof(float), [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) ConvertFloatToInt16(mix.data(), pcm.data(), mix.size());
+        BenchSink(pcm.data(), pcm.size() * 2);
+    });
+    bench.Run("audio/mean_square_10ms", pcm.size() * 2, [&](uint64_t n) {
+        double sum = 0;
+        for (uint64_t i = 0; i < n; i++) sum += MeanSquare(pcm.data(), pcm.size());
+        BenchSink(&sum, sizeof(sum));
+    });
+
+    std::vector<int16_t> mono(AUDIO_FRAMES / 2);
+    std::vector<int16_t> stereo(AUDIO_FRAMES * 2);
+    bench.Run("audio/resample_down_48k_stereo_to_24k_mono", pcm.size() * 2, [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) DownsampleForRedundancy(pcm.data(), AUDIO_FRAMES, mono.data());
+        BenchSink(mono.data(), mono.size() * 2);
+    });
+    bench.Run("audio/resample_up_24k_mono_to_48k_stereo", stereo.size() * 2, [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) UpsampleRedundant(mono.data(), mono.size(), stereo.data(), AUDIO_FRAMES);
+        BenchSink(stereo.data(), stereo.size() * 2);
+    });
+}
+
+void BenchAnnexB(BenchRunner& bench) {
+    std::vector<uint8_t> au = MakeSyntheticAccessUnit(100 * 1024);
+    bench.Run("annexb/next_nal_scan_100k", au.size(), [&](uint64_t n) {
+        size_t count = 0;
+        for (uint64_t i = 0; i < n; i++) {
+            size_t pos = 0;
+            const uint8_t* nal;
+            size_t nalSize;
+            while (AnnexBParser::NextNal(au.data(), au.size(), pos, nal, nalSize)) count++;
+        }
+        BenchSink(&count, sizeof(count));
+    });
+    AnnexBParser parser(VideoCodec::H264);
+    bench.Run("annexb/parse_access_unit_100k", au.size(), [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+            AccessUnitInfo info = parser.ParseAccessUnit(au.data(), au.size());
+            BenchSink(&info, sizeof(info));
+        }
+    });
+}
+
+void BenchQueues(BenchRunner& bench) {
+    std::vector<uint8_t> payload(MTU_PAYLOAD, 0x11);
+    PacketPool pool;
+    bench.Run("queue/packet_pool_acquire_release_1400", MTU_PAYLOAD, [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+            PacketRef packet = pool.Acquire(payload.data(), payload.size());
+            BenchSink(packet.Data(), 1);
+        }
+    });
+
+    // Producer -> sender thread -> loopback socket; audio packets are never dropped.
+    // Buffered (socket send buffer copy) vs zero-copy (sends straight from the pool buffers).
+    std::vector<uint8_t> frame(64 * 1024, 0x22);
+    for (bool zeroCopy : { false, true }) {
+        NetworkManager net;
+        SOCKET sender, receiver;
+        if (!CreateLoopbackPair(sender, receiver)) return;
+        std::atomic<bool> draining = true;
+        std::thread drain([&]() {
+            std::vector<char> sink(256 * 1024);
+            while (draining && recv(receiver, sink.data(), (int)sink.size(), 0) > 0) {}
+        });
+        SendQueue queue;
+        queue.SetZeroCopy(zeroCopy);
+        queue.SetLatencyBudget(std::chrono::seconds(60)); // Measure the send path, not the drop policy
+        queue.Start(&net, (int)sender, nullptr);
+        auto run = [&](const char* name, const std::vector<uint8_t>& data, uint32_t type) {
+            uint64_t calls = queue.GetStats().sendCalls;
+            uint64_t sent = queue.GetStats().sentPackets;
+            bench.Run(name, data.size(), [&](uint64_t n) {
+                uint64_t target = queue.GetStats().sentPackets + n;
+                for (uint64_t i = 0; i < n; i++) {
+                    PacketRef packet = pool.Acquire(data.data(), data.size());
+                    packet->packetType = type;
+                    queue.Push(std::move(packet));
+                }
+                while (queue.GetStats().sentPackets < target) std::this_thread::yield();
+            });
+            calls = queue.GetStats().sendCalls - calls;
+            if (calls) fprintf(stderr, "  %.2f packets per send call\n", (double)(queue.GetStats().sentPackets - sent) / calls);
+        };
+        if (zeroCopy) {
+            run("queue/send_queue_handoff_1400_zerocopy", payload, PACKET_TYPE_AUDIO);
+            run("queue/send_queue_video_64k_zerocopy", frame, PACKET_TYPE_VIDEO);
+        } else {
+            run("queue/send_queue_handoff_1400", payload, PACKET_TYPE_AUDIO);
+            run("queue/send_queue_video_64k", frame, PACKET_TYPE_VIDEO);
+        }
+        queue.Stop();
+        draining = false;
+        closesocket(sender);
+        drain.join();
+        closesocket(receiver);
+    }
+}
+
+// CPU-buffer backend for the capture pipeline ring: same slot ownership, ordering and
+// backpressure as the D3D11 texture ring, with memcpy standing in for the GPU stages
+struct CpuFrameSlot {
+    std::vector<uint8_t> bgra = std::vector<uint8_t>((size_t)FRAME_WIDTH * FRAME_HEIGHT * 4);
+    uint32_t frameId = 0;
+};
+
+void BenchFrameRing(BenchRunner& bench) {
+    std::vector<uint8_t> frame((size_t)FRAME_WIDTH * FRAME_HEIGHT * 4, 0x3C);
+    FrameRing<CpuFrameSlot, 3> ring;
+    std::atomic<uint64_t> encoded = 0;
+    std::atomic<uint64_t> outOfOrder = 0;
+    std::thread convert([&]() {
+        while (CpuFrameSlot* slot = ring.Acquire(1)) {
+            BenchSink(slot->bgra.data(), 1);
+            ring.Release(1, slot);
+        }
+    });
+    std::thread encode([&]() {
+        uint32_t expected = 0;
+        while (CpuFrameSlot* slot = ring.Acquire(2)) {
+            if (slot->frameId != expected) outOfOrder++;
+            expected = slot->frameId + 1;
+            BenchSink(slot->bgra.data(), 1);
+            encoded.fetch_add(1, std::memory_order_release);
+            ring.Release(2, slot);
+        }
+    });
+
+    uint32_t frameId = 0;
+    bench.Run("queue/frame_ring_3stage_1080p", frame.size(), [&](uint64_t n) {
+        uint64_t target = encoded + n;
+        for (uint64_t i = 0; i < n; i++) {
+            CpuFrameSlot* slot = ring.Acquire(0); // Blocking producer: nothing dropped
+            memcpy(slot->bgra.data(), frame.data(), frame.size());
+            slot->frameId = frameId++;
+            ring.Release(0, slot);
+        }
+        while (encoded.load(std::memory_order_acquire) < target) std::this_thread::yield();
+    });
+    ring.Stop();
+    convert.join();
+    encode.join();
+    if (outOfOrder > 0) {
+        std::cerr << "[KernelBench] FrameRing delivered " << outOfOrder << " frames out of order" << std::endl;
+    }
+}
+
+// One 64KB video chunk per op over a UDP loopback pair, receiver thread reassembling.
+// "batched" hands DATAGRAM_BATCH_SEGMENTS fragments to the kernel per call (USO/URO when
+// the stack offers them), "per_datagram" is the one-datagram-per-call baseline.
+void BenchDatagrams(BenchRunner& bench) {
+    const size_t packetSize = 64 * 1024;
+    const uint64_t datagramsPerPacket = (packetSize + DATAGRAM_PAYLOAD - 1) / DATAGRAM_PAYLOAD;
+    std::vector<uint8_t> payload(packetSize, 0x5A);
+    NetworkManager net;
+    PacketPool pool;
+
+    for (bool batching : { true, false }) {
+        const char* name = batching ? "datagram/send_batched_64k" : "datagram/send_per_datagram_64k";
+        if (!bench.Matches(name)) continue;
+        DatagramSocket sender, receiver;
+        if (!sender.Open(0) || !receiver.Open(0)) return;
+        sockaddr_in peer = {};
+        peer.sin_family = AF_INET;
+        peer.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        peer.sin_port = htons(receiver.GetPort());
+        sender.Connect(peer);
+        sender.SetBatching(batching);
+        receiver.SetBatching(batching);
+
+        DatagramReassembler reassembler(pool);
+        std::atomic<uint64_t> finished = 0; // Completed or given up on
+        std::atomic<bool> receiving = true;
+        std::thread rx([&]() {
+            DatagramView views[256];
+            PacketHeader header;
+            PacketRef packet;
+            while (receiving) {
+                int count = receiver.Receive(views, 256, 10);
+                for (int i = 0; i < count; i++) {
+                    if (reassembler.Push(views[i].data, views[i].size, header, packet)) BenchSink(packet.Data(), packet->size);
+                }
+                const ReassemblyStats& stats = reassembler.GetStats();
+                finished.store(stats.completed + stats.dropped, std::memory_order_release);
+            }
+        });
+
+        uint32_t frameId = 0;
+        bench.Run(name, packetSize, [&](uint64_t n) {
+            uint64_t target = frameId + n;
+            for (uint64_t i = 0; i < n; i++) {
+                sender.SendPacket(PACKET_TYPE_VIDEO, payload.data(), payload.size(), 0, 0, frameId++, 0);
+            }
+            // Loopback may still drop under load: a lost tail packet is only evicted later
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(200);
+            while (finished.load(std::memory_order_acquire) < target && std::chrono::steady_clock::now() < deadline) {
+                std::this_thread::yield();
+            }
+        });
+        receiving = false;
+        rx.join();
+
+        const BenchResult& r = bench.GetResults().back();
+        const ReassemblyStats& stats = reassembler.GetStats();
+        fprintf(stderr, "  %s: %.0f datagrams/s, %.2f CPU ms/Gbit, %llu packets completed, %llu dropped\n",
+            batching ? "batched" : "per-datagram", datagramsPerPacket * 1e9 / r.nsPerOp,
+            r.cpuNsPerOp / (packetSize * 8) * 1e3, (unsigned long long)stats.completed, (unsigned long long)stats.dropped);
+    }
+}
+
+enum class ReceiveMode { Blocking, Readiness, Registered };
+
+// Client-side receive of the framed TCP stream, one packet per call: blocking
+// ReceiveHeader/ReceiveBody (one thread parked in recv), or StreamReceiver in readiness
+// (select + recv) or registered I/O (posted receives + completion queue) mode
+struct StreamReceiveBench {
+    NetworkManager& net;
+    ReceiveMode mode;
+    SOCKET sender = INVALID_SOCKET, receiver = INVALID_SOCKET;
+    StreamReceiver engine;
+    std::vector<uint8_t> body;
+    std::thread thread;
+    std::atomic<bool> sending = true;
+
+    // intervalUs = 0 saturates the connection
+    bool Start(size_t packetSize, int intervalUs) {
+        if (!CreateLoopbackPair(sender, receiver, mode == ReceiveMode::Registered ? WSA_FLAG_REGISTERED_IO : 0)) return false;
+        if (mode != ReceiveMode::Blocking) engine.Start((int)receiver, mode == ReceiveMode::Registered ? IoMode::Registered : IoMode::Readiness);
+        thread = std::thread([this, packetSize, intervalUs]() {
+            std::vector<uint8_t> payload(packetSize, 0x6B);
+            uint32_t frameId = 0;
+            while (sending) {
+                int64_t sentNs = std::chrono::steady_clock::now().time_since_epoch().count();
+                memcpy(payload.data(), &sentNs, sizeof(sentNs));
+                if (!net.SendPacket((int)sender, PACKET_TYPE_VIDEO, payload.data(), payload.size(), 0, 0, frameId++, 0)) break;
+                if (intervalUs) std::this_thread::sleep_for(std::chrono::microseconds(intervalUs));
+            }
+        });
+        return true;
+    }
+
+    // Next packet's one-way latency in ns, or -1 when the connection is gone
+    int64_t Next() {
+        const uint8_t* data = nullptr;
+        PacketHeader header;
+        PacketRef packet;
+        if (mode == ReceiveMode::Blocking) {
+            if (!net.ReceiveHeader((int)receiver, header) || !net.ReceiveBody((int)receiver, body, header.payloadSize)) return -1;
+            data = body.data();
+        } else {
+            while (!engine.Poll(header, packet, 100)) {
+                if (!engine.IsConnected()) return -1;
+            }
+            data = packet.Data();
+        }
+        int64_t sentNs;
+        memcpy(&sentNs, data, sizeof(sentNs));
+        return std::chrono::steady_clock::now().time_since_epoch().count() - sentNs;
+    }
+
+    void Stop() {
+        sending = false;
+        closesocket(receiver); // Fails a sender blocked on a full socket
+        if (thread.joinable()) thread.join();
+        closesocket(sender);
+        engine.Stop();
+    }
+};
+
+// Throughput with a saturating sender, then tail latency with a paced one (1 packet/ms)
+void BenchReceive(BenchRunner& bench) {
+    const size_t packetSize = 64 * 1024;
+    const int latencySamples = 1000;
+    NetworkManager net;
+    const struct { ReceiveMode mode; const char* name; } modes[] = {
+        { ReceiveMode::Blocking, "net/receive_blocking_64k" },
+        { ReceiveMode::Readiness, "net/receive_readiness_64k" },
+        { ReceiveMode::Registered, "net/receive_registered_64k" },
+    };
+    for (const auto& m : modes) {
+        if (!bench.Matches(m.name)) continue;
+        {
+            StreamReceiveBench stream{ net, m.mode };
+            if (!stream.Start(packetSize, 0)) return;
+            bench.Run(m.name, packetSize, [&](uint64_t n) {
+                for (uint64_t i = 0; i < n; i++) {
+                    if (stream.Next() < 0) return;
+                }
+            });
+            stream.Stop();
+        }
+
+        StreamReceiveBench stream{ net, m.mode };
+        if (!stream.Start(packetSize, 1000)) return;
+        std::vector<int64_t> latencies;
+        latencies.reserve(latencySamples);
+        for (int i = 0; i < latencySamples; i++) {
+            int64_t ns = stream.Next();
+            if (ns < 0) break;
+            latencies.push_back(ns);
+        }
+        stream.Stop();
+        if (latencies.empty()) continue;
+        std::sort(latencies.begin(), latencies.end());
+        auto percentile = [&](double p) { return latencies[(size_t)(p * (latencies.size() - 1))] / 1e3; };
+        fprintf(stderr, "  paced 1/ms: p50 %.1f us, p99 %.1f us, p99.9 %.1f us, max %.1f us\n",
+            percentile(0.5), percentile(0.99), percentile(0.999), latencies.back() / 1e3);
+    }
+}
+
+// Writer and reader on two views of one named mapping: the cross-process setup, in one
+// process. Throughput, then one-way handoff latency with the reader spinning (packets
+// 20us apart) and parked on its event (1ms apart).
+void BenchSharedMemory(BenchRunner& bench) {
+    if (!bench.Matches("shm/")) return;
+    std::string name = "ZeroCopyBench" + std::to_string(GetCurrentProcessId());
+    SharedRingWriter writer;
+    SharedRingReader reader;
+    if (!writer.Create(name) || !reader.Open(name)) return;
+
+    const int latencySamples = 2000;
+    std::vector<int64_t> latencies;
+    latencies.reserve(latencySamples);
+    std::atomic<bool> measuring = false;
+    std::atomic<uint64_t> received = 0;
+    std::thread consumer([&]() {
+        PacketHeader header;
+        const uint8_t* payload;
+        while (reader.Read(header, payload, 100) || !reader.IsWriterClosed()) {
+            if (header.payloadSize < sizeof(int64_t)) continue;
+            if (measuring) {
+                int64_t sentNs;
+                memcpy(&sentNs, payload, sizeof(sentNs));
+                latencies.push_back(std::chrono::steady_clock::now().time_since_epoch().count() - sentNs);
+            }
+            BenchSink(payload, header.payloadSize);
+            received.fetch_add(1, std::memory_order_release);
+        }
+    });
+
+    std::vector<uint8_t> packet(MTU_PAYLOAD, 0x4D);
+    auto write = [&]() {
+        int64_t now = std::chrono::steady_clock::now().time_since_epoch().count();
+        memcpy(packet.data(), &now, sizeof(now));
+        while (!writer.Write(PACKET_TYPE_AUDIO, packet.data(), packet.size())) std::this_thread::yield(); // Ring full
+    };
+    bench.Run("shm/handoff_1400", MTU_PAYLOAD, [&](uint64_t n) {
+        uint64_t target = received + n;
+        for (uint64_t i = 0; i < n; i++) write();
+        while (received.load(std::memory_order_acquire) < target) std::this_thread::yield();
+    });
+
+    for (int gapUs : { 20, 1000 }) {
+        while (received.load() < writer.GetStats().written) std::this_thread::yield();
+        latencies.clear();
+        measuring = true;
+        for (int i = 0; i < latencySamples; i++) {
+            uint64_t target = received + 1;
+            write();
+            while (received.load(std::memory_order_acquire) < target) std::this_thread::yield();
+            auto until = std::chrono::steady_clock::now() + std::chrono::microseconds(gapUs);
+            if (gapUs >= 1000) std::this_thread::sleep_until(until);
+            else while (std::chrono::steady_clock::now() < until) {}
+        }
+        measuring = false;
+        std::sort(latencies.begin(), latencies.end());
+        auto percentile = [&](double p) { return latencies[(size_t)(p * (latencies.size() - 1))] / 1e3; };
+        fprintf(stderr, "  handoff, reader %s: p50 %.2f us, p99 %.2f us, max %.2f us\n", gapUs >= 1000 ? "parked" : "spinning",
+            percentile(0.5), percentile(0.99), latencies.back() / 1e3);
+    }
+    writer.Close();
+    consumer.join();
+}
+
+// Join -> connected on this machine: query, beacon, non-blocking TCP connect, polled the
+// way the UI loop polls it. The responder gets its own port, so a running host is not hit.
+void BenchConnect(BenchRunner& bench) {
+    if (!bench.Matches("net/discover_connect")) return;
+    const uint16_t discoveryPort = DISCOVERY_PORT + 100;
+    const int samples = 50;
+    NetworkManager net;
+    SOCKET listenSock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY; // The broadcast query may be answered from the LAN address
+    int addrLen = sizeof(addr);
+    if (bind(listenSock, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR ||
+        getsockname(listenSock, (sockaddr*)&addr, &addrLen) == SOCKET_ERROR || listen(listenSock, 8) == SOCKET_ERROR) {
+        closesocket(listenSock);
+        return;
+    }
+    DiscoveryMessage beacon = {};
+    beacon.streamPort = ntohs(addr.sin_port);
+    strncpy_s(beacon.name, "bench", _TRUNCATE);
+    DiscoveryResponder responder;
+    if (!responder.Start(discoveryPort, beacon)) {
+        closesocket(listenSock);
+        return;
+    }
+    std::atomic<bool> accepting = true;
+    std::thread acceptor([&]() {
+        while (accepting) {
+            fd_set readSet;
+            FD_ZERO(&readSet);
+            FD_SET(listenSock, &readSet);
+            timeval timeout = { 0, 10 * 1000 };
+            if (select(0, &readSet, nullptr, nullptr, &timeout) > 0) closesocket(accept(listenSock, nullptr, nullptr));
+        }
+    });
+
+    std::vector<int64_t> discover;
+    std::vector<int64_t> connect;
+    StreamConnector connector;
+    for (int i = 0; i < samples; i++) {
+        if (!connector.Begin(discoveryPort)) break;
+        ConnectState state;
+        do {
+            state = connector.Poll(1);
+        } while (state == ConnectState::Discovering || state == ConnectState::Connecting);
+        if (state != ConnectState::Connected) break;
+        connect.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(connector.GetElapsed()).count());
+        discover.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(connector.GetDiscoveryTime()).count());
+        closesocket((SOCKET)connector.TakeSocket());
+    }
+    responder.Stop();
+    accepting = false;
+    acceptor.join();
+    closesocket(listenSock);
+    if (connect.empty()) {
+        std::cerr << "[KernelBench] Loopback discovery failed" << std::endl;
+        return;
+    }
+    std::sort(discover.begin(), discover.end());
+    std::sort(connect.begin(), connect.end());
+    auto percentile = [](const std::vector<int64_t>& v, double p) { return v[(size_t)(p * (v.size() - 1))] / 1e6; };
+    fprintf(stderr, "  net/discover_connect (%zu runs): beacon p50 %.2f ms, p99 %.2f ms | connected p50 %.2f ms, p99 %.2f ms, max %.2f ms\n",
+        connect.size(), percentile(discover, 0.5), percentile(discover, 0.99), percentile(connect, 0.5),
+        percentile(connect, 0.99), connect.back() / 1e6);
+}
+
+// Control message latency with keyframes queued ahead of it: four 500KB IDRs, then one
+// control message, sampled until the stream is idle again. "tcp" sends media on the
+// control connection (the fallback), "datagram" on the media channel.
+void BenchControlChannel(BenchRunner& bench) {
+    const size_t keyframeSize = 500 * 1024;
+    const int keyframes = 4;
+    const int samples = 50;
+    NetworkManager net;
+    PacketPool pool;
+    std::vector<uint8_t> keyframe(keyframeSize, 0x3C);
+    for (bool datagrams : { false, true }) {
+        const char* name = datagrams ? "net/control_behind_keyframes_datagram" : "net/control_behind_keyframes_tcp";
+        if (!bench.Matches(name)) continue;
+        SOCKET sender, receiver;
+        DatagramSocket hostMedia, clientMedia;
+        if (!CreateLoopbackPair(sender, receiver) || !hostMedia.Open(0) || !clientMedia.Open(0)) return;
+        sockaddr_in peer = {};
+        peer.sin_family = AF_INET;
+        peer.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        peer.sin_port = htons(clientMedia.GetPort());
+        hostMedia.Connect(peer);
+
+        SendQueue queue;
+        queue.SetLatencyBudget(std::chrono::milliseconds(10000)); // Nothing dropped
+        queue.Start(&net, (int)sender, nullptr);
+        if (datagrams) queue.SetMediaChannel(&hostMedia);
+
+        std::atomic<bool> receiving = true;
+        std::atomic<int64_t> controlArrived = 0;
+        std::atomic<uint64_t> mediaPackets = 0;
+        std::thread tcp([&]() {
+            StreamReceiver stream;
+            stream.Start((int)receiver, IoMode::Readiness);
+            PacketHeader header;
+            PacketRef packet;
+            while (receiving) {
+                if (!stream.Poll(header, packet, 10)) continue;
+                if (header.packetType == PACKET_TYPE_CONTROL) controlArrived = std::chrono::steady_clock::now().time_since_epoch().count();
+                else mediaPackets++;
+            }
+        });
+        std::thread udp([&]() {
+            DatagramReassembler reassembler(pool);
+            DatagramView views[256];
+            PacketHeader header;
+            PacketRef packet;
+            while (receiving) {
+                int count = clientMedia.Receive(views, 256, 10);
+                for (int i = 0; i < count; i++) {
+                    if (reassembler.Push(views[i].data, views[i].size, header, packet)) mediaPackets++;
+                }
+            }
+        });
+
+        std::vector<int64_t> latency;
+        uint32_t frameId = 0;
+        for (int i = 0; i < samples; i++) {
+            uint64_t target = mediaPackets + keyframes;
+            controlArrived = 0;
+            for (int k = 0; k < keyframes; k++) {
+                PacketRef packet = pool.Acquire(keyframe.data(), keyframe.size());
+                packet->packetType = PACKET_TYPE_VIDEO;
+                packet->frameType = (uint32_t)FrameType::IDR;
+                packet->frameId = frameId++;
+                queue.Push(std::move(packet));
+            }
+            int64_t pushed = std::chrono::steady_clock::now().time_since_epoch().count();
+            queue.PushControl(MakeControlPacket(pool, MakeControlMessage(CONTROL_KEYFRAME_REQUEST)));
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+            while ((!controlArrived || mediaPackets < target) && std::chrono::steady_clock::now() < deadline) {
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+            if (!controlArrived) break;
+            latency.push_back(controlArrived - pushed);
+        }
+        receiving = false;
+        tcp.join();
+        udp.join();
+        queue.Stop();
+        closesocket(sender);
+        closesocket(receiver);
+        if (latency.empty()) {
+            std::cerr << "[KernelBench] Control message lost on " << name << std::endl;
+            continue;
+        }
+        std::sort(latency.begin(), latency.end());
+        auto percentile = [&](double p) { return latency[(size_t)(p * (latency.size() - 1))] / 1e6; };
+        fprintf(stderr, "  %s (%zu runs): control p50 %.3f ms, p99 %.3f ms, max %.3f ms behind %d x %zu KB\n", name,
+            latency.size(), percentile(0.5), percentile(0.99), latency.back() / 1e6, keyframes, keyframeSize / 1024);
+    }
+}
+
+int main(int argc, char** argv) {
+    std::string filter;
+    std::string outPath;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--filter" && i + 1 < argc) filter = argv[++i];
+        else if (arg == "--out" && i + 1 < argc) outPath = argv[++i];
+    }
+
+    BenchRunner bench(filter);
+    BenchFraming(bench);
+    BenchFec(bench);
+    BenchPixels(bench);
+    BenchAudio(bench);
+    BenchAnnexB(bench);
+    BenchQueues(bench);
+    BenchFrameRing(bench);
+    BenchDatagrams(bench);
+    BenchReceive(bench);
+    BenchSharedMemory(bench);
+    BenchConnect(bench);
+    BenchControlChannel(bench);
+
+    std::string json = bench.ToJson("kernels", CpuInfo::Detect(std::thread::hardware_concurrency()));
+    if (outPath.empty()) {
+        std::cout << json << std::endl;
+    } else {
+        FILE* f = nullptr;
+        if (fopen_s(&f, outPath.c_str(), "w") != 0 || !f) {
+            std::cerr << "[KernelBench] Cannot write " << outPath << std::endl;
+            return 1;
+        }
+        fputs(json.c_str(), f);
+        fclose(f);
+    }
+    return 0;
+}
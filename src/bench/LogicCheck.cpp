@@ -0,0 +1,518 @@
+// Deterministic correctness checks for the portable components (standalone executable).
+// Build together with video/AnnexBParser.cpp.
+//
+//   LogicCheck [--filter <substring>]
+//
+// Each check drives one component with fixed inputs (no sockets, no timing) and asserts
+// on the outcome. Exits with code 1 if any check fails.
+#include <iostream>
+#include <vector>
+#include <string>
+#include <functional>
+#include <cmath>
+#include <cstring>
+#include "BenchHarness.h"
+#include "../audio/AudioDSP.h"
+#include "../audio/AudioRedundancy.h"
+#include "../audio/AudioJitterBuffer.h"
+#include "../common/ReadbackRing.h"
+#include "../common/DatagramSocket.h"
+#include "../common/SendQueue.h"
+
+class CheckRunner {
+public:
+    explicit CheckRunner(const std::string& filter) : filter(filter) {}
+
+    void Run(const char* name, const std::function<void()>& check) {
+        if (!filter.empty() && std::string(name).find(filter) == std::string::npos) return;
+        current = name;
+        int before = failures;
+        check();
+        ran++;
+        if (failures == before) std::cout << "[LogicCheck] " << name << ": OK" << std::endl;
+        else failedChecks++;
+    }
+
+    // Records a failure of the running check
+    void Expect(bool condition, const std::string& what) {
+        if (condition) return;
+        failures++;
+        std::cerr << "[LogicCheck] " << current << ": FAIL " << what << std::endl;
+    }
+
+    int GetRan() const { return ran; }
+    int GetFailed() const { return failedChecks; }
+
+private:
+    std::string filter;
+    std::string current;
+    int failures = 0;
+    int failedChecks = 0;
+    int ran = 0;
+};
+
+// ===== AUDIO =====
+const size_t AUDIO_FRAMES = 480; // 10ms at 48kHz
+const int AUDIO_CHECK_PACKETS = 1000;
+const int AUDIO_PLAYOUT_DELAY = 4; // Frames buffered before playback starts (40ms)
+
+// 10ms reference frame: 440Hz + 1kHz, same on both channels
+static void MakeReferenceFrame(int index, std::vector<int16_t>& out) {
+    out.resize(AUDIO_FRAMES * 2);
+    for (size_t i = 0; i < AUDIO_FRAMES; i++) {
+        double t = (double)(index * AUDIO_FRAMES + i) / 48000.0;
+        int16_t v = (int16_t)(8000.0 * sin(6.283185307179586 * 440.0 * t) + 4000.0 * sin(6.283185307179586 * 1000.0 * t));
+        out[i * 2] = v;
+        out[i * 2 + 1] = v;
+    }
+}
+
+// Fixed impairment: a single loss every 10 packets, a burst of two every 50, and every
+// 7th packet delayed by 1..3 frames (within the playout delay) or 8 frames (too late)
+static bool AudioLost(int n) { return n % 10 == 3 || n % 50 == 20 || n % 50 == 21; }
+static bool AudioBurstLost(int n) { return n % 50 == 20 || n % 50 == 21; }
+static int AudioDelay(int n) {
+    if (n == 0 || n % 7 != 0) return 0; // The first packet starts the sequence
+    return n % 91 == 0 ? 8 : 1 + (n / 7) % 3;
+}
+
+struct AudioScore {
+    double snrDb = 0.0;        // Whole signal
+    double singleLossSnrDb = 0.0; // Only the frames lost alone on the wire
+    AudioJitterBuffer::Stats stats;
+    int frames = 0;
+};
+
+static double SnrDb(double signal, double noise) {
+    return noise <= 0.0 ? 200.0 : 10.0 * log10(signal / noise);
+}
+
+// Reference signal -> RED encoder -> loss/jitter -> jitter buffer at a fixed playout
+// rate, scored against the reference frame by frame
+static AudioScore PlayImpaired(bool redundancy) {
+    AudioRedundancyEncoder encoder;
+    encoder.SetMeasuredLoss(redundancy ? 1.0f : 0.0f);
+    std::vector<std::vector<uint8_t>> arrivals[AUDIO_CHECK_PACKETS + 16];
+    std::vector<int16_t> reference;
+    for (int n = 0; n < AUDIO_CHECK_PACKETS; n++) {
+        MakeReferenceFrame(n, reference);
+        const std::vector<uint8_t>& packet = encoder.Encode(reference.data(), AUDIO_FRAMES);
+        if (!AudioLost(n)) arrivals[n + AudioDelay(n)].push_back(packet);
+    }
+
+    AudioJitterBuffer jitter;
+    AudioScore score;
+    double signal = 0.0, noise = 0.0, singleSignal = 0.0, singleNoise = 0.0;
+    std::vector<int16_t> out;
+    auto play = [&]() {
+        if (!jitter.Pop(out, false)) return false;
+        MakeReferenceFrame(score.frames, reference);
+        double frameSignal = 0.0, frameNoise = 0.0;
+        for (size_t i = 0; i < reference.size(); i++) {
+            double diff = i < out.size() ? (double)out[i] - reference[i] : reference[i];
+            frameSignal += (double)reference[i] * reference[i];
+            frameNoise += diff * diff;
+        }
+        signal += frameSignal;
+        noise += frameNoise;
+        if (AudioLost(score.frames) && !AudioBurstLost(score.frames)) {
+            singleSignal += frameSignal;
+            singleNoise += frameNoise;
+        }
+        score.frames++;
+        return true;
+    };
+    // One frame per 10ms tick once the playout delay has built up, then drain
+    for (int tick = 0; tick < AUDIO_CHECK_PACKETS + 16; tick++) {
+        for (const std::vector<uint8_t>& packet : arrivals[tick]) jitter.Push(packet.data(), packet.size());
+        if (tick >= AUDIO_PLAYOUT_DELAY) play();
+    }
+    while (play()) {}
+
+    score.snrDb = SnrDb(signal, noise);
+    score.singleLossSnrDb = SnrDb(singleSignal, singleNoise);
+    score.stats = jitter.GetStats();
+    return score;
+}
+
+void CheckAudio(CheckRunner& check) {
+    check.Run("audio/red_playback_under_loss", [&]() {
+        AudioScore red = PlayImpaired(true);
+        AudioScore plain = PlayImpaired(false);
+        std::cout << "[LogicCheck]   RED: " << red.snrDb << " dB (single losses " << red.singleLossSnrDb << " dB), "
+                  << red.stats.recovered << " recovered, " << red.stats.concealed << " concealed | no RED: "
+                  << plain.snrDb << " dB (single losses " << plain.singleLossSnrDb << " dB)" << std::endl;
+        check.Expect(red.frames == AUDIO_CHECK_PACKETS, "every sequence number played out once");
+        // Every packet lost alone is carried by its successor's redundant copy
+        int singleLosses = 0;
+        for (int n = 0; n + 1 < AUDIO_CHECK_PACKETS; n++) singleLosses += AudioLost(n) && !AudioBurstLost(n) && !AudioLost(n + 1);
+        check.Expect((int)red.stats.recovered >= singleLosses, "single losses recovered from RED");
+        check.Expect(red.singleLossSnrDb >= 15.0, "recovered frames within 15 dB SNR of the reference");
+        check.Expect(red.snrDb >= 12.0, "whole signal within 12 dB SNR with RED");
+        check.Expect(red.snrDb >= plain.snrDb + 6.0, "RED improves whole-signal SNR by 6 dB");
+        check.Expect(plain.stats.recovered == 0, "no recovery without RED");
+        check.Expect(plain.stats.concealed >= plain.stats.lost, "every loss without RED concealed");
+    });
+}
+
+// ===== READBACK RING =====
+
+// CPU stand-in for a staging texture: holds the frame copied into it, readable from `readyAt`
+struct FakeStaging {
+    uint32_t frame = 0;
+    int readyAt = 0;
+};
+
+// Fake GPU clock plus everything the read callback saw
+struct FakeReadback {
+    int now = 0;
+    std::vector<uint32_t> delivered;
+    int forced = 0;        // Reads that had to wait for the GPU
+    bool contentOk = true; // Each buffer held the frame it was tagged with
+
+    auto Reader() {
+        return [this](FakeStaging& buffer, uint32_t tag, bool wait) {
+            if (now < buffer.readyAt) {
+                if (!wait) return false;
+                forced++;
+            }
+            contentOk &= buffer.frame == tag;
+            delivered.push_back(tag);
+            return true;
+        };
+    }
+};
+
+static bool InOrder(const std::vector<uint32_t>& delivered, uint32_t count) {
+    if (delivered.size() != count) return false;
+    for (uint32_t i = 0; i < count; i++) {
+        if (delivered[i] != i) return false;
+    }
+    return true;
+}
+
+void CheckReadbackRing(CheckRunner& check) {
+    check.Run("readback_ring/in_order_delivery", [&]() {
+        // Later frames finishing first must not overtake an unfinished older one
+        ReadbackRing<FakeStaging> ring(3);
+        FakeReadback gpu;
+        const int latency[3] = { 5, 1, 1 };
+        for (uint32_t frame = 0; frame < 3; frame++) {
+            FakeStaging& buffer = ring.Next(frame, gpu.Reader());
+            buffer.frame = frame;
+            buffer.readyAt = latency[frame];
+        }
+        gpu.now = 2;
+        check.Expect(ring.Poll(gpu.Reader()) == 0, "nothing read while the oldest is still drawing");
+        gpu.now = 5;
+        check.Expect(ring.Poll(gpu.Reader()) == 3, "all three read once the oldest finishes");
+        check.Expect(InOrder(gpu.delivered, 3) && gpu.contentOk, "delivered in submission order");
+        check.Expect(gpu.forced == 0 && ring.GetPending() == 0, "no forced waits, nothing left pending");
+    });
+
+    check.Run("readback_ring/full_ring_forces_oldest", [&]() {
+        ReadbackRing<FakeStaging> ring(3);
+        FakeReadback gpu;
+        for (uint32_t frame = 0; frame < 3; frame++) {
+            FakeStaging& buffer = ring.Next(frame, gpu.Reader());
+            buffer.frame = frame;
+            buffer.readyAt = 100;
+        }
+        check.Expect(gpu.forced == 0 && ring.GetPending() == 3, "filling the ring doesn't wait");
+        FakeStaging& fourth = ring.Next(3, gpu.Reader());
+        check.Expect(gpu.forced == 1 && gpu.delivered.size() == 1 && gpu.delivered[0] == 0, "fourth frame forces frame 0 only");
+        check.Expect(&fourth == &ring.At(0), "fourth frame reuses the buffer it freed");
+        fourth.frame = 3;
+        fourth.readyAt = 100;
+        check.Expect(ring.GetPending() == 3, "pending stays at the depth");
+        check.Expect(ring.Poll(gpu.Reader()) == 0, "poll doesn't wait");
+        ring.Drain(gpu.Reader());
+        check.Expect(InOrder(gpu.delivered, 4) && gpu.contentOk, "drain delivers the rest in order");
+        check.Expect(gpu.forced == 4, "drain waits for each");
+    });
+
+    check.Run("readback_ring/wraparound", [&]() {
+        // Many laps with a varying GPU latency, polled once per frame like the encoder
+        ReadbackRing<FakeStaging> ring(3);
+        FakeReadback gpu;
+        const uint32_t frames = 100;
+        size_t maxPending = 0;
+        std::vector<int> uses(ring.Depth());
+        for (uint32_t frame = 0; frame < frames; frame++, gpu.now++) {
+            ring.Poll(gpu.Reader());
+            FakeStaging& buffer = ring.Next(frame, gpu.Reader());
+            for (size_t i = 0; i < ring.Depth(); i++) uses[i] += &buffer == &ring.At(i);
+            buffer.frame = frame;
+            buffer.readyAt = gpu.now + 1 + (int)(frame % 5); // 1..5 frames
+            if (ring.GetPending() > maxPending) maxPending = ring.GetPending();
+        }
+        ring.Drain(gpu.Reader());
+        check.Expect(InOrder(gpu.delivered, frames) && gpu.contentOk, "every frame delivered once, in order");
+        check.Expect(maxPending <= ring.Depth(), "never more pending than the depth");
+        check.Expect(gpu.forced > 0 && gpu.forced < (int)frames, "slow frames forced, the rest read without waiting");
+        bool evenUse = true;
+        for (int count : uses) evenUse &= count >= (int)frames / 3 - 1 && count <= (int)frames / 3 + 1;
+        check.Expect(evenUse, "buffers reused round robin");
+    });
+}
+
+// ===== DATAGRAM REASSEMBLY =====
+
+// Fragments one framed packet the way DatagramSocket::SendPacket does, without a socket
+static std::vector<std::vector<uint8_t>> MakeFragments(uint32_t packetId, size_t payloadSize, uint32_t frameId = 0) {
+    std::vector<uint8_t> stream(sizeof(PacketHeader) + payloadSize);
+    PacketHeader header = EncodePacketHeader(PACKET_TYPE_VIDEO, (uint32_t)payloadSize, -1, -1, frameId, 0);
+    memcpy(stream.data(), &header, sizeof(header));
+    for (size_t i = 0; i < payloadSize; i++) stream[sizeof(header) + i] = (uint8_t)(i * 7 + frameId);
+
+    uint16_t count = (uint16_t)((stream.size() + DATAGRAM_PAYLOAD - 1) / DATAGRAM_PAYLOAD);
+    std::vector<std::vector<uint8_t>> fragments;
+    for (uint16_t index = 0; index < count; index++) {
+        size_t offset = (size_t)index * DATAGRAM_PAYLOAD;
+        size_t end = std::min(offset + DATAGRAM_PAYLOAD, stream.size());
+        FragmentHeader fragment = { htonl(packetId), htons(index), htons(count) };
+        std::vector<uint8_t> datagram((const uint8_t*)&fragment, (const uint8_t*)&fragment + sizeof(fragment));
+        datagram.insert(datagram.end(), stream.begin() + offset, stream.begin() + end);
+        fragments.push_back(std::move(datagram));
+    }
+    return fragments;
+}
+
+// A lone fragment claiming `count` fragments in total
+static std::vector<uint8_t> MakeClaimFragment(uint32_t packetId, uint16_t index, uint16_t count) {
+    FragmentHeader fragment = { htonl(packetId), htons(index), htons(count) };
+    std::vector<uint8_t> datagram((const uint8_t*)&fragment, (const uint8_t*)&fragment + sizeof(fragment));
+    datagram.resize(sizeof(fragment) + (index + 1 < count ? DATAGRAM_PAYLOAD : 16), 0xAB);
+    return datagram;
+}
+
+void CheckReassembly(CheckRunner& check) {
+    check.Run("reassembly/hostile_fragment_count", [&]() {
+        PacketPool pool;
+        DatagramReassembler reassembler(pool);
+        PacketHeader header;
+        PacketRef packet;
+        // 65535 * 1200 bytes would be ~78MB per slot, and would stay the pool's buffer size
+        for (uint16_t index : { 0, 1, 65534 }) {
+            std::vector<uint8_t> hostile = MakeClaimFragment(1, index, 65535);
+            check.Expect(!reassembler.Push(hostile.data(), hostile.size(), header, packet), "hostile fragment completes nothing");
+        }
+        std::vector<uint8_t> overLimit = MakeClaimFragment(2, 0, DATAGRAM_MAX_FRAGMENTS + 1);
+        reassembler.Push(overLimit.data(), overLimit.size(), header, packet);
+        check.Expect(reassembler.GetStats().malformed == 4, "counts past DATAGRAM_MAX_FRAGMENTS rejected as malformed");
+        check.Expect(pool.GetAllocatedCount() == 0, "nothing allocated for them");
+
+        // The stream carries on, and the pool's buffers stay sized to real packets
+        bool completed = false;
+        for (const std::vector<uint8_t>& fragment : MakeFragments(3, 5000, 3)) {
+            completed = reassembler.Push(fragment.data(), fragment.size(), header, packet);
+        }
+        check.Expect(completed && header.frameId == 3 && packet.Size() == 5000, "next real packet reassembled");
+        check.Expect(completed && packet->data.size() < 64 * 1024, "pool buffers not inflated");
+
+        std::vector<uint8_t> atLimit = MakeClaimFragment(4, 0, DATAGRAM_MAX_FRAGMENTS);
+        reassembler.Push(atLimit.data(), atLimit.size(), header, packet);
+        check.Expect(reassembler.GetStats().malformed == 4, "DATAGRAM_MAX_FRAGMENTS itself accepted");
+    });
+
+    check.Run("reassembly/reorder_window_keeps_newer", [&]() {
+        PacketPool pool;
+        DatagramReassembler reassembler(pool);
+        PacketHeader header;
+        PacketRef packet;
+        uint64_t delivered = 0;
+        auto push = [&](const std::vector<uint8_t>& fragment) {
+            if (!reassembler.Push(fragment.data(), fragment.size(), header, packet)) return false;
+            delivered++;
+            return true;
+        };
+        push(MakeFragments(0, 100)[0]); // Sets the floor, so losses after it are counted
+        const uint32_t stuckId = 1;
+        const uint32_t lastInWindow = stuckId + DATAGRAM_REORDER_WINDOW;
+        // Packet 1 loses its second fragment; two packets past the window are still arriving
+        std::vector<std::vector<uint8_t>> stuck = MakeFragments(stuckId, 2000);
+        std::vector<std::vector<uint8_t>> inFlightA = MakeFragments(lastInWindow + 2, 2000, 7);
+        std::vector<std::vector<uint8_t>> inFlightB = MakeFragments(lastInWindow + 3, 2000);
+        push(stuck[0]);
+        push(inFlightA[0]);
+        push(inFlightB[0]);
+        for (uint32_t id = stuckId + 1; id <= lastInWindow; id++) push(MakeFragments(id, 100, id)[0]);
+        check.Expect(reassembler.GetStats().dropped == 0, "oldest kept while within the window");
+        check.Expect(!push(MakeFragments(3, 100, 3)[0]), "late duplicate of a packet completed ahead ignored");
+
+        push(MakeFragments(lastInWindow + 1, 100)[0]);
+        check.Expect(reassembler.GetStats().dropped == 1, "only the packet past the window evicted");
+        check.Expect(push(inFlightA[1]) && header.frameId == 7, "newer in-flight packet still completes");
+        check.Expect(push(inFlightB[1]), "second in-flight packet still completes");
+        check.Expect(!push(stuck[1]), "fragment of the evicted packet ignored");
+        check.Expect(!push(MakeFragments(5, 100, 5)[0]), "duplicate behind the floor ignored");
+        const ReassemblyStats& stats = reassembler.GetStats();
+        check.Expect(delivered == lastInWindow + 3 && stats.completed == delivered, "every other packet delivered once");
+        check.Expect(stats.lost == 1, "one packet lost");
+    });
+}
+
+// ===== PACKET POOL =====
+
+void CheckPacketPool(CheckRunner& check) {
+    check.Run("packet_pool/small_packets_stay_small", [&]() {
+        PacketPool pool;
+        const size_t idrSize = 300 * 1024;
+        // Three cursor or control packets for every audio packet
+        auto small = [&](int i) { return pool.Acquire(nullptr, i % 4 == 0 ? 3000 : 16); };
+        const size_t idrBytes = 512 * 1024;                            // 300 KB, a power-of-two class
+        const size_t smallBytes = 128 * 4096 + 384 * PACKET_POOL_MIN_BUFFER;
+
+        // An IDR first, then the recorder's queue full of small packets
+        pool.Acquire(nullptr, idrSize);
+        std::vector<PacketRef> held;
+        for (int i = 0; i < 512; i++) held.push_back(small(i));
+        check.Expect(pool.GetHeldBytes() == idrBytes + smallBytes,
+                     "small packets held in small buffers (" + std::to_string(pool.GetHeldBytes()) + " bytes)");
+
+        // Same traffic again: every buffer reused, none grown
+        size_t buffers = pool.GetAllocatedCount();
+        held.clear();
+        for (int round = 0; round < 3; round++) {
+            PacketRef frame = pool.Acquire(nullptr, idrSize);
+            for (int i = 0; i < 512; i++) held.push_back(small(i));
+            held.clear();
+        }
+        check.Expect(pool.GetAllocatedCount() == buffers, "steady state allocates no buffers");
+        check.Expect(pool.GetHeldBytes() == idrBytes + smallBytes, "and grows none");
+    });
+}
+
+// ===== SEND QUEUE DROP POLICY =====
+
+// A SendQueue that never sends media, so whatever stays queued is what the drop policy
+// kept. Queues are built under a budget of an hour (the policy stays idle), then one
+// fresh audio packet under SEND_CHECK_BUDGET runs it over packets stamped long ago.
+const auto SEND_CHECK_BUDGET = std::chrono::seconds(1);
+const auto SEND_CHECK_STALE = std::chrono::seconds(10);
+
+struct HeldSendQueue {
+    PacketPool pool; // Outlives the queue's references
+    SendQueue queue;
+    int keyframeRequests = 0;
+
+    HeldSendQueue() {
+        queue.SetHoldMedia(true);
+        queue.SetLatencyBudget(std::chrono::hours(1));
+        queue.Start(nullptr, -1, [this]() { keyframeRequests++; });
+    }
+
+    // Returns a second reference, so the check can tell whether the queue still holds it
+    PacketRef Push(uint32_t packetType, FrameType frameType, bool stale) {
+        uint8_t payload[16] = {};
+        PacketRef packet = pool.Acquire(payload, sizeof(payload));
+        packet->packetType = packetType;
+        packet->frameType = (uint32_t)frameType;
+        if (stale) packet->timestamp -= SEND_CHECK_STALE;
+        PacketRef mine = packet;
+        queue.Push(std::move(packet));
+        return mine;
+    }
+
+    PacketRef Video(FrameType frameType, bool stale = true) { return Push(PACKET_TYPE_VIDEO, frameType, stale); }
+    PacketRef Audio(bool stale = true) { return Push(PACKET_TYPE_AUDIO, FrameType::UNKNOWN, stale); }
+
+    // Runs the policy under the real budget
+    PacketRef Squeeze() {
+        queue.SetLatencyBudget(SEND_CHECK_BUDGET);
+        return Audio(false);
+    }
+};
+
+static bool Queued(const PacketRef& packet) { return packet->refCount.load() > 1; }
+
+void CheckSendQueue(CheckRunner& check) {
+    check.Run("send_queue/non_reference_dropped_newest_kept", [&]() {
+        HeldSendQueue held;
+        PacketRef first = held.Video(FrameType::NON_REFERENCE);
+        PacketRef audio = held.Audio();
+        PacketRef second = held.Video(FrameType::NON_REFERENCE);
+        PacketRef reference = held.Video(FrameType::REFERENCE, false);
+        PacketRef newest = held.Video(FrameType::NON_REFERENCE);
+        held.Squeeze();
+        const SendQueueStats& stats = held.queue.GetStats();
+        check.Expect(stats.droppedNonReference == 2 && !Queued(first) && !Queued(second), "older non-reference frames dropped");
+        check.Expect(Queued(newest), "newest video kept although non-reference");
+        check.Expect(Queued(reference) && Queued(audio), "reference frame and audio kept");
+        check.Expect(stats.droppedSuperseded == 0 && stats.droppedDeepCut == 0, "back under budget after step 1");
+        check.Expect(held.keyframeRequests == 0 && held.queue.GetDepth() == 4, "no keyframe requested");
+    });
+
+    check.Run("send_queue/superseded_by_newest_idr", [&]() {
+        HeldSendQueue held;
+        PacketRef oldIdr = held.Video(FrameType::IDR);
+        PacketRef before1 = held.Video(FrameType::REFERENCE);
+        PacketRef audio = held.Audio();
+        PacketRef before2 = held.Video(FrameType::REFERENCE);
+        PacketRef idr = held.Video(FrameType::IDR);
+        PacketRef after = held.Video(FrameType::REFERENCE);
+        held.Squeeze();
+        const SendQueueStats& stats = held.queue.GetStats();
+        check.Expect(stats.droppedSuperseded == 3, "frames before the newest IDR counted as superseded");
+        check.Expect(!Queued(oldIdr) && !Queued(before1) && !Queued(before2), "frames before the newest IDR dropped");
+        check.Expect(Queued(idr) && Queued(after), "newest IDR kept although stale, and what follows it");
+        check.Expect(Queued(audio), "audio before the IDR kept");
+        check.Expect(stats.droppedDeepCut == 0 && held.keyframeRequests == 0, "no deep cut, no keyframe requested");
+    });
+
+    check.Run("send_queue/deep_cut_awaits_idr", [&]() {
+        HeldSendQueue held;
+        PacketRef reference1 = held.Video(FrameType::REFERENCE);
+        PacketRef audio = held.Audio();
+        PacketRef reference2 = held.Video(FrameType::REFERENCE);
+        held.Squeeze();
+        const SendQueueStats& stats = held.queue.GetStats();
+        check.Expect(stats.droppedDeepCut == 2 && !Queued(reference1) && !Queued(reference2), "whole reference chain cut");
+        check.Expect(held.keyframeRequests == 1 && stats.keyframeRequests == 1, "keyframe requested once");
+
+        // Fresh frames now: nothing is over budget, they are refused only for lack of an IDR
+        PacketRef waiting1 = held.Video(FrameType::REFERENCE, false);
+        PacketRef waiting2 = held.Video(FrameType::NON_REFERENCE, false);
+        check.Expect(stats.droppedAwaitingIdr == 2 && !Queued(waiting1) && !Queued(waiting2), "non-IDR frames refused until the IDR");
+        check.Expect(held.keyframeRequests == 1, "no further keyframe requests while waiting");
+        PacketRef idr = held.Video(FrameType::IDR, false);
+        PacketRef next = held.Video(FrameType::REFERENCE, false);
+        check.Expect(Queued(idr) && Queued(next) && stats.droppedAwaitingIdr == 2, "video resumes at the IDR");
+        check.Expect(Queued(audio), "audio kept through the cut");
+    });
+
+    check.Run("send_queue/audio_never_dropped", [&]() {
+        HeldSendQueue held;
+        held.queue.SetLatencyBudget(std::chrono::milliseconds(0));
+        std::vector<PacketRef> audio;
+        const FrameType pattern[] = { FrameType::IDR, FrameType::NON_REFERENCE, FrameType::REFERENCE };
+        for (int i = 0; i < 30; i++) {
+            audio.push_back(held.Audio());
+            held.Video(pattern[i % 3]);
+        }
+        for (int i = 0; i < 10; i++) audio.push_back(held.Audio());
+        size_t kept = 0;
+        for (const PacketRef& packet : audio) kept += Queued(packet) ? 1 : 0;
+        const SendQueueStats& stats = held.queue.GetStats();
+        check.Expect(kept == audio.size(), "every audio packet still queued");
+        check.Expect(stats.droppedNonReference + stats.droppedSuperseded + stats.droppedDeepCut > 0, "video was dropped meanwhile");
+    });
+}
+
+int main(int argc, char** argv) {
+    std::string filter;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--filter" && i + 1 < argc) filter = argv[++i];
+    }
+
+    CheckRunner check(filter);
+    CheckAudio(check);
+    CheckReadbackRing(check);
+    CheckReassembly(check);
+    CheckPacketPool(check);
+    CheckSendQueue(check);
+
+    std::cout << "[LogicCheck] " << check.GetRan() - check.GetFailed() << "/" << check.GetRan() << " checks passed" << std::endl;
+    return check.GetFailed() > 0 ? 1 : 0;
+}
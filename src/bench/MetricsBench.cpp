@@ -0,0 +1,74 @@
+// Metrics hot-path overhead benchmark (standalone executable).
+// Measures Metrics::Record / Add from 1..N concurrent threads, checks that
+// merged snapshots account for every sample, and fails if a record costs more than the budget.
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <cstdlib>
+#include "../common/Metrics.h"
+
+const double RECORD_BUDGET_NS = 20.0;
+const uint64_t RECORDS_PER_THREAD = 20000000;
+
+// Returns ns per Record() with `threads` writers running concurrently
+double RunRecord(int threads) {
+    MetricsSnapshot before = Metrics::Get().Snapshot();
+    std::vector<std::thread> workers;
+    std::vector<double> nsPerRecord(threads);
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([t, &nsPerRecord]() {
+            Metrics& metrics = Metrics::Get();
+            uint64_t value = 1000 + t; // Spread over a few hundred buckets
+            auto start = std::chrono::steady_clock::now();
+            for (uint64_t i = 0; i < RECORDS_PER_THREAD; i++) {
+                metrics.Record(Stage::Encode, value);
+                value = value * 2862933555777941757ull + 3037000493ull;
+                value = (value >> 40) + 500; // 500ns .. ~16ms
+            }
+            auto end = std::chrono::steady_clock::now();
+            nsPerRecord[t] = std::chrono::duration<double, std::nano>(end - start).count() / RECORDS_PER_THREAD;
+        });
+    }
+    for (auto& w : workers) w.join();
+
+    MetricsSnapshot delta = Metrics::Get().Snapshot().Since(before);
+    uint64_t expected = RECORDS_PER_THREAD * threads;
+    if (delta.Get(Stage::Encode).count != expected) {
+        std::cerr << "[MetricsBench] Lost samples: " << delta.Get(Stage::Encode).count << " of " << expected << std::endl;
+        exit(2);
+    }
+    double worst = 0;
+    for (double ns : nsPerRecord) if (ns > worst) worst = ns;
+    return worst;
+}
+
+double RunScopedTimer() {
+    const uint64_t count = 5000000;
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < count; i++) {
+        ScopedStageTimer timer(Stage::Convert);
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / count;
+}
+
+int main() {
+    int hw = (int)std::thread::hardware_concurrency();
+    if (hw < 1) hw = 1;
+    bool pass = true;
+
+    std::cout << "{\"benchmark\":\"metrics\",\"budget_ns\":" << RECORD_BUDGET_NS << ",\"record\":[";
+    bool first = true;
+    for (int threads = 1; ; threads *= 2) {
+        if (threads > hw) threads = hw;
+        double ns = RunRecord(threads);
+        if (ns > RECORD_BUDGET_NS) pass = false;
+        std::cout << (first ? "" : ",") << "{\"threads\":" << threads << ",\"ns_per_record\":" << ns << "}";
+        first = false;
+        if (threads == hw) break;
+    }
+    std::cout << "],\"scoped_timer_ns\":" << RunScopedTimer()
+              << ",\"pass\":" << (pass ? "true" : "false") << "}" << std::endl;
+    return pass ? 0 : 1;
+}
@@ -0,0 +1,389 @@
+// Annex-B parser fuzz driver (standalone executable).
+// Build together with video/AnnexBParser.cpp.
+//
+//   ParserFuzz [--corpus <dir>] [--iterations N] [--seed N]
+//   ParserFuzz --write-seeds <dir>
+//
+// Runs every corpus file (src/bench/fuzz/annexb) through both codecs, then N deterministic
+// mutations of each (bit flips, byte overwrites, inserted start codes, truncation,
+// duplicated chunks). Build with -fsanitize=address,undefined to catch memory errors;
+// without sanitizers it still checks that an accepted SPS describes a sane picture.
+// --write-seeds regenerates the seed corpus from the bitstreams described below.
+// Define PARSER_FUZZ_LIBFUZZER to build a libFuzzer target instead of main().
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <vector>
+#include <string>
+#include <random>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include "../video/AnnexBParser.h"
+
+#define FUZZ_DEFAULT_ITERATIONS 2000
+#define FUZZ_MAX_INPUT (64 * 1024)
+
+// ===== INVARIANTS =====
+
+static bool SequenceSane(const SequenceInfo& info) {
+    if (!info.valid) return true;
+    return info.codedWidth > 0 && info.codedWidth <= SPS_MAX_DIMENSION &&
+           info.codedHeight > 0 && info.codedHeight <= SPS_MAX_DIMENSION &&
+           info.width > 0 && info.width <= info.codedWidth &&
+           info.height > 0 && info.height <= info.codedHeight &&
+           info.log2MaxFrameNum >= 4 && info.log2MaxFrameNum <= SPS_MAX_LOG2_COUNTER &&
+           info.log2MaxPocLsb >= 4 && info.log2MaxPocLsb <= SPS_MAX_LOG2_COUNTER &&
+           info.bitDepthLuma >= 8 && info.bitDepthLuma <= SPS_MAX_BIT_DEPTH &&
+           (info.fpsNum == 0) == (info.fpsDen == 0); // Timing is both or neither
+}
+
+// Runs one input through everything the receive path calls. Returns false on a broken invariant.
+static bool ParseInput(const uint8_t* data, size_t size) {
+    bool ok = true;
+    for (VideoCodec codec : { VideoCodec::H264, VideoCodec::HEVC }) {
+        AnnexBParser parser(codec);
+        // Twice, so the second pass parses slices against whatever SPS the first accepted
+        for (int pass = 0; pass < 2; pass++) {
+            AccessUnitInfo info = parser.ParseAccessUnit(data, size);
+            ok &= SequenceSane(parser.GetSequenceInfo());
+            ok &= info.frameNum < 0 || info.frameNum < (1 << SPS_MAX_LOG2_COUNTER);
+        }
+    }
+
+    size_t pos = 0;
+    const uint8_t* nal = nullptr;
+    size_t nalSize = 0;
+    while (AnnexBParser::NextNal(data, size, pos, nal, nalSize)) {
+        if (nalSize == 0) continue;
+        ok &= nal >= data && nal + nalSize <= data + size;
+        SequenceInfo h264, hevc;
+        if (AnnexBParser::ParseH264Sps(nal, nalSize, h264)) ok &= SequenceSane(h264);
+        if (AnnexBParser::ParseHevcSps(nal, nalSize, hevc)) ok &= SequenceSane(hevc);
+    }
+    return ok;
+}
+
+#ifdef PARSER_FUZZ_LIBFUZZER
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    if (!ParseInput(data, size)) __builtin_trap();
+    return 0;
+}
+
+#else
+
+// ===== MUTATIONS =====
+
+static void Mutate(std::vector<uint8_t>& input, std::mt19937& rng) {
+    int edits = 1 + (int)(rng() % 4);
+    for (int e = 0; e < edits; e++) {
+        size_t size = input.size();
+        size_t at = size ? rng() % size : 0;
+        switch (rng() % 6) {
+        case 0: // Bit flip
+            if (size) input[at] ^= (uint8_t)(1u << (rng() % 8));
+            break;
+        case 1: { // Interesting byte
+            static const uint8_t values[] = { 0x00, 0x01, 0x03, 0x7F, 0x80, 0xFF };
+            if (size) input[at] = values[rng() % sizeof(values)];
+            break;
+        }
+        case 2: { // Start code, splitting a NAL
+            static const uint8_t startCode[] = { 0, 0, 1 };
+            input.insert(input.begin() + at, startCode, startCode + sizeof(startCode));
+            break;
+        }
+        case 3: // Truncate
+            input.resize(at);
+            break;
+        case 4: { // Duplicate a chunk
+            if (!size) break;
+            size_t length = 1 + rng() % std::min<size_t>(size - at, 64);
+            std::vector<uint8_t> chunk(input.begin() + at, input.begin() + at + length);
+            input.insert(input.begin() + rng() % (size + 1), chunk.begin(), chunk.end());
+            break;
+        }
+        default: // Run of zeros (long Exp-Golomb prefixes)
+            input.insert(input.begin() + at, 1 + rng() % 8, 0x00);
+            break;
+        }
+        if (input.size() > FUZZ_MAX_INPUT) input.resize(FUZZ_MAX_INPUT);
+    }
+}
+
+// ===== SEED CORPUS =====
+
+// RBSP writer that inserts emulation prevention bytes like an encoder does
+class BitWriter {
+public:
+    void Bits(uint32_t value, int count) {
+        for (int i = count - 1; i >= 0; i--) Bit(i < 32 ? (value >> i) & 1 : 0);
+    }
+    void Flag(bool value) { Bit(value ? 1 : 0); }
+    void UE(uint32_t value) {
+        uint64_t coded = (uint64_t)value + 1;
+        int length = 0;
+        while ((coded >> length) > 1) length++;
+        Bits(0, length);
+        for (int i = length; i >= 0; i--) Bit((uint32_t)(coded >> i) & 1);
+    }
+
+    // rbsp_trailing_bits, then the escaped NAL behind a start code
+    void AppendNal(std::vector<uint8_t>& out) {
+        Bit(1);
+        while (bitCount) Bit(0);
+        static const uint8_t startCode[] = { 0, 0, 0, 1 };
+        out.insert(out.end(), startCode, startCode + sizeof(startCode));
+        int zeros = 0;
+        for (size_t i = 0; i < bytes.size(); i++) {
+            uint8_t b = bytes[i];
+            if (i >= header && zeros >= 2 && b <= 3) {
+                out.push_back(0x03);
+                zeros = 0;
+            }
+            out.push_back(b);
+            zeros = (b == 0) ? zeros + 1 : 0;
+        }
+    }
+
+    // NAL header bytes are written raw
+    void Header(std::initializer_list<uint8_t> headerBytes) {
+        bytes.assign(headerBytes);
+        header = bytes.size();
+    }
+
+private:
+    std::vector<uint8_t> bytes;
+    size_t header = 0;
+    uint8_t current = 0;
+    int bitCount = 0;
+
+    void Bit(uint32_t bit) {
+        current = (uint8_t)((current << 1) | bit);
+        if (++bitCount == 8) {
+            bytes.push_back(current);
+            current = 0;
+            bitCount = 0;
+        }
+    }
+};
+
+struct H264SpsFields {
+    uint32_t log2MaxFrameNumMinus4 = 4;
+    uint32_t log2MaxPocLsbMinus4 = 4;
+    uint32_t widthMbsMinus1 = 119;  // 1920
+    uint32_t heightMapUnitsMinus1 = 67; // 1088
+    uint32_t cropBottom = 8;        // 1088 -> 1080
+    uint32_t unitsInTick = 1;
+    uint32_t timeScale = 120;       // 60 fps
+};
+
+static void WriteH264Sps(std::vector<uint8_t>& out, const H264SpsFields& f) {
+    BitWriter w;
+    w.Header({ 0x67 });
+    w.Bits(66, 8); // Baseline (no chroma format fields)
+    w.Bits(0xC0, 8);
+    w.Bits(40, 8);
+    w.UE(0);       // seq_parameter_set_id
+    w.UE(f.log2MaxFrameNumMinus4);
+    w.UE(0);       // pic_order_cnt_type
+    w.UE(f.log2MaxPocLsbMinus4);
+    w.UE(1);       // max_num_ref_frames
+    w.Flag(false);
+    w.UE(f.widthMbsMinus1);
+    w.UE(f.heightMapUnitsMinus1);
+    w.Flag(true);  // frame_mbs_only_flag
+    w.Flag(true);  // direct_8x8_inference_flag
+    w.Flag(true);  // frame_cropping_flag
+    w.UE(0); w.UE(0); w.UE(0); w.UE(f.cropBottom / 2);
+    w.Flag(true);  // vui_parameters_present_flag
+    w.Flag(false); w.Flag(false);
+    w.Flag(true);  // video_signal_type_present_flag
+    w.Bits(5, 3); w.Flag(false); w.Flag(true);
+    w.Bits(1, 8); w.Bits(1, 8); w.Bits(1, 8); // BT.709
+    w.Flag(false);
+    w.Flag(true);  // timing_info_present_flag
+    w.Bits(f.unitsInTick, 32); w.Bits(f.timeScale, 32);
+    w.AppendNal(out);
+}
+
+static void WriteH264Slice(std::vector<uint8_t>& out, bool idr, uint32_t frameNum, int log2MaxFrameNum) {
+    BitWriter w;
+    w.Header({ (uint8_t)(idr ? 0x65 : 0x41) });
+    w.UE(0);              // first_mb_in_slice
+    w.UE(idr ? 7 : 5);    // slice_type (I / P, all slices)
+    w.UE(0);              // pic_parameter_set_id
+    w.Bits(frameNum, log2MaxFrameNum);
+    for (int i = 0; i < 24; i++) w.Bits(0x5A + i, 8); // Stand-in for slice data
+    w.AppendNal(out);
+}
+
+static std::vector<uint8_t> H264AccessUnit(const H264SpsFields& sps, bool idr, uint32_t frameNum) {
+    static const uint8_t aud[] = { 0, 0, 0, 1, 0x09, 0x10 };
+    std::vector<uint8_t> out(aud, aud + sizeof(aud));
+    WriteH264Sps(out, sps);
+    BitWriter pps;
+    pps.Header({ 0x68 });
+    pps.UE(0); pps.UE(0); pps.Flag(false); pps.Flag(false);
+    pps.AppendNal(out);
+    WriteH264Slice(out, idr, frameNum, (int)sps.log2MaxFrameNumMinus4 + 4);
+    return out;
+}
+
+static void WriteHevcSps(std::vector<uint8_t>& out, uint32_t log2MaxPocLsbMinus4) {
+    BitWriter w;
+    w.Header({ 0x42, 0x01 });
+    w.Bits(0, 4);  // sps_video_parameter_set_id
+    w.Bits(0, 3);  // sps_max_sub_layers_minus1
+    w.Flag(true);
+    w.Bits(0, 3);  // profile_space, tier
+    w.Bits(1, 5);  // Main
+    w.Bits(0x60000000, 32);
+    w.Bits(0x9000, 16); w.Bits(0, 32);
+    w.Bits(123, 8); // Level 4.1
+    w.UE(0);       // sps_seq_parameter_set_id
+    w.UE(1);       // chroma_format_idc
+    w.UE(1920);
+    w.UE(1088);
+    w.Flag(true);  // conformance_window_flag
+    w.UE(0); w.UE(0); w.UE(0); w.UE(4);
+    w.UE(0); w.UE(0); // bit depths
+    w.UE(log2MaxPocLsbMinus4);
+    w.Flag(true);
+    w.UE(1); w.UE(0); w.UE(0);
+    w.UE(0); w.UE(3); w.UE(0); w.UE(3); w.UE(0); w.UE(0);
+    w.Flag(false); // scaling_list_enabled_flag
+    w.Flag(false); w.Flag(true);
+    w.Flag(false); // pcm_enabled_flag
+    w.UE(1);       // num_short_term_ref_pic_sets
+    w.UE(1); w.UE(0); w.UE(0); w.Flag(true);
+    w.Flag(true);  // long_term_ref_pics_present_flag
+    w.UE(1); w.Bits(0, log2MaxPocLsbMinus4 + 4); w.Flag(true);
+    w.Flag(true); w.Flag(true);
+    w.Flag(false); // vui_parameters_present_flag
+    w.AppendNal(out);
+}
+
+static std::vector<uint8_t> HevcAccessUnit(uint32_t log2MaxPocLsbMinus4, bool idr) {
+    std::vector<uint8_t> out;
+    BitWriter vps;
+    vps.Header({ 0x40, 0x01 });
+    vps.Bits(0x0C01FFFF, 32);
+    vps.AppendNal(out);
+    WriteHevcSps(out, log2MaxPocLsbMinus4);
+    BitWriter pps;
+    pps.Header({ 0x44, 0x01 });
+    pps.UE(0); pps.UE(0); pps.Flag(false); pps.Flag(false); pps.Bits(0, 3);
+    pps.AppendNal(out);
+    BitWriter slice;
+    slice.Header({ (uint8_t)((idr ? HEVC_NAL_IDR_W_RADL : 1) << 1), 0x01 });
+    slice.Flag(true); // first_slice_segment_in_pic_flag
+    if (idr) slice.Flag(false);
+    slice.UE(0);      // slice_pic_parameter_set_id
+    slice.UE(idr ? 2 : 1);
+    if (!idr) slice.Bits(5, log2MaxPocLsbMinus4 + 4);
+    for (int i = 0; i < 24; i++) slice.Bits(0xA5 - i, 8);
+    slice.AppendNal(out);
+    return out;
+}
+
+static bool WriteSeeds(const std::string& dir) {
+    std::vector<std::pair<std::string, std::vector<uint8_t>>> seeds;
+    H264SpsFields sps;
+    seeds.push_back({ "h264_idr.264", H264AccessUnit(sps, true, 0) });
+    seeds.push_back({ "h264_p.264", H264AccessUnit(sps, false, 17) });
+    H264SpsFields longFrameNum = sps;
+    longFrameNum.log2MaxFrameNumMinus4 = 12; // Largest accepted
+    seeds.push_back({ "h264_log2_max.264", H264AccessUnit(longFrameNum, false, 0xFFFF) });
+    H264SpsFields log2Overflow = sps;
+    log2Overflow.log2MaxFrameNumMinus4 = 60;
+    seeds.push_back({ "h264_sps_log2_overflow.264", H264AccessUnit(log2Overflow, false, 1) });
+    H264SpsFields pocOverflow = sps;
+    pocOverflow.log2MaxPocLsbMinus4 = 0xFFFFFFF0;
+    seeds.push_back({ "h264_sps_poc_overflow.264", H264AccessUnit(pocOverflow, true, 0) });
+    H264SpsFields hugeWidth = sps;
+    hugeWidth.widthMbsMinus1 = 0x7FFFFFFF; // widthMbs * 16 overflows int
+    seeds.push_back({ "h264_sps_huge_width.264", H264AccessUnit(hugeWidth, true, 0) });
+    H264SpsFields hugeCrop = sps;
+    hugeCrop.cropBottom = 0xFFFFFFF0;
+    seeds.push_back({ "h264_sps_huge_crop.264", H264AccessUnit(hugeCrop, true, 0) });
+    H264SpsFields tickWrap = sps;
+    tickWrap.unitsInTick = 0x80000000; // unitsInTick * 2 wraps to 0
+    seeds.push_back({ "h264_sps_tick_wrap.264", H264AccessUnit(tickWrap, true, 0) });
+    H264SpsFields tickWrapSmall = sps;
+    tickWrapSmall.unitsInTick = 0x80000001; // ... or to 2, a bogus 60 fps
+    seeds.push_back({ "h264_sps_tick_wrap_small.264", H264AccessUnit(tickWrapSmall, true, 0) });
+    std::vector<uint8_t> truncated = H264AccessUnit(sps, true, 0);
+    truncated.resize(20);
+    seeds.push_back({ "h264_truncated_sps.264", truncated });
+    seeds.push_back({ "hevc_idr.265", HevcAccessUnit(4, true) });
+    seeds.push_back({ "hevc_trail.265", HevcAccessUnit(4, false) });
+    seeds.push_back({ "hevc_sps_log2_overflow.265", HevcAccessUnit(40, false) });
+    seeds.push_back({ "start_codes_only.bin", { 0, 0, 1, 0, 0, 0, 1, 0, 0, 1, 0, 0, 0, 0, 1 } });
+    std::vector<uint8_t> escapes = { 0, 0, 0, 1, 0x67 };
+    for (int i = 0; i < 64; i++) escapes.insert(escapes.end(), { 0, 0, 3 });
+    seeds.push_back({ "emulation_prevention.264", escapes });
+
+    for (const auto& seed : seeds) {
+        std::ofstream file(dir + "/" + seed.first, std::ios::binary);
+        if (!file.write((const char*)seed.second.data(), (std::streamsize)seed.second.size())) {
+            std::cerr << "[ParserFuzz] Can't write " << dir << "/" << seed.first << std::endl;
+            return false;
+        }
+    }
+    std::cout << "[ParserFuzz] Wrote " << seeds.size() << " seeds to " << dir << std::endl;
+    return true;
+}
+
+int main(int argc, char** argv) {
+    std::string corpus = "fuzz/annexb";
+    std::string seedDir;
+    int iterations = FUZZ_DEFAULT_ITERATIONS;
+    uint32_t seed = 1;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--corpus" && i + 1 < argc) corpus = argv[++i];
+        else if (arg == "--iterations" && i + 1 < argc) iterations = atoi(argv[++i]);
+        else if (arg == "--seed" && i + 1 < argc) seed = (uint32_t)atoi(argv[++i]);
+        else if (arg == "--write-seeds" && i + 1 < argc) seedDir = argv[++i];
+    }
+    if (!seedDir.empty()) return WriteSeeds(seedDir) ? 0 : 1;
+
+    std::vector<std::pair<std::string, std::vector<uint8_t>>> inputs;
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(corpus, error)) {
+        if (!entry.is_regular_file()) continue;
+        std::ifstream file(entry.path(), std::ios::binary);
+        inputs.push_back({ entry.path().filename().string(),
+                           std::vector<uint8_t>(std::istreambuf_iterator<char>(file), {}) });
+    }
+    if (inputs.empty()) {
+        std::cerr << "[ParserFuzz] No corpus files in " << corpus << std::endl;
+        return 1;
+    }
+
+    int failures = 0;
+    size_t runs = 0;
+    std::mt19937 rng(seed);
+    for (const auto& input : inputs) {
+        if (!ParseInput(input.second.data(), input.second.size())) {
+            std::cerr << "[ParserFuzz] " << input.first << ": invariant broken" << std::endl;
+            failures++;
+        }
+        runs++;
+        for (int i = 0; i < iterations; i++) {
+            std::vector<uint8_t> mutated = input.second;
+            Mutate(mutated, rng);
+            runs++;
+            if (ParseInput(mutated.data(), mutated.size())) continue;
+            std::cerr << "[ParserFuzz] " << input.first << " mutation " << i << " (seed " << seed << "): invariant broken" << std::endl;
+            failures++;
+        }
+    }
+    std::cout << "[ParserFuzz] " << inputs.size() << " corpus files, " << runs << " inputs, "
+              << failures << " failures" << std::endl;
+    return failures > 0 ? 1 : 0;
+}
+
+#endif
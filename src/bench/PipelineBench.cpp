@@ -0,0 +1,673 @@
+// End-to-end headless pipeline benchmark (standalone executable).
+// Build together with video/HardwareEncoder.cpp, video/HardwareDecoder.cpp and video/AnnexBParser.cpp.
+//
+//   PipelineBench [--frames N] [--width W] [--height H] [--fps F (0 = flat out)]
+//                 [--delay-ms D] [--jitter-ms J] [--rate-mbps R] [--expect-drops 1]
+//                 [--startup N] [--thresholds <file>] [--write-thresholds <file>] [--out <file.json>]
+//
+// synthetic source -> HardwareEncoder -> SendQueue -> loopback TCP (optionally through an
+// impaired link) -> HardwareDecoder -> sink, in one process. Host and client each get their
+// own D3D11 device like the real app. Exits with 3 when a metric regresses past its threshold.
+// Baselines are measured, never estimated: write them on the reference machine with
+// --write-thresholds and commit the file that produces (none is committed yet).
+//
+// --expect-drops 1 checks the send queue's drop policy under congestion: with --rate-mbps
+// below the encoded rate the run fails unless video was cut (deep cut and keyframe request)
+// and frames still reached the sink, e.g. PipelineBench --fps 60 --rate-mbps 4 --expect-drops 1
+//
+// --startup N adds N timed session starts (join -> first pixel) through the real discovery
+// and stream ports, with and without the fast-start handshake. --frames 0 runs only those.
+#include <windows.h>
+#include <psapi.h>
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <random>
+#include <algorithm>
+#include "BenchLoopback.h"
+#include "../common/NetworkManager.h"
+#include "../common/PacketPool.h"
+#include "../common/SendQueue.h"
+#include "../common/Metrics.h"
+#include "../video/HardwareEncoder.h"
+#include "../video/HardwareDecoder.h"
+
+#pragma comment(lib, "d3d11.lib")
+#pragma comment(lib, "psapi.lib")
+
+using Microsoft::WRL::ComPtr;
+
+#define PIPELINE_DEFAULT_TOLERANCE_PCT 10.0
+#define PIPELINE_SOURCE_SCROLL 8   // Pixels the synthetic scene pans per frame
+#define PIPELINE_TIMESTAMP_RING 256
+#define PIPELINE_LINK_QUEUE_MS 20   // Traffic a rate-capped link buffers before it stops reading
+#define PIPELINE_LINK_SOCKET_BUFFER (64 * 1024) // Host send and link receive buffers under a rate cap
+
+// Animated BGRA frames without a desktop: a wide random scene panned a few pixels per frame,
+// so the encoder sees real motion. Uploading a window of the scene is one UpdateSubresource.
+class SyntheticSource {
+public:
+    bool Initialize(ID3D11Device* device, int width, int height) {
+        this->width = width;
+        scenePitch = width * 2 * 4;
+        scene.resize((size_t)scenePitch * height);
+        std::mt19937 rng(11);
+        for (int y = 0; y < height; y++) {
+            uint8_t* row = scene.data() + (size_t)y * scenePitch;
+            for (int x = 0; x < width * 2; x++) {
+                bool block = ((x / 64) + (y / 64)) % 3 == 0; // Flat areas between textured ones
+                uint8_t noise = block ? 0 : (uint8_t)(rng() & 0x3F);
+                row[x * 4 + 0] = (uint8_t)(x / 8 + noise);
+                row[x * 4 + 1] = (uint8_t)(y / 4 + noise);
+                row[x * 4 + 2] = (uint8_t)((x + y) / 16 + noise);
+                row[x * 4 + 3] = 255;
+            }
+        }
+
+        D3D11_TEXTURE2D_DESC desc = {};
+        desc.Width = width;
+        desc.Height = height;
+        desc.MipLevels = 1;
+        desc.ArraySize = 1;
+        desc.Format = DXGI_FORMAT_B8G8R8A8_UNORM; // Same as a desktop duplication frame
+        desc.SampleDesc.Count = 1;
+        desc.Usage = D3D11_USAGE_DEFAULT;
+        desc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+        return SUCCEEDED(device->CreateTexture2D(&desc, nullptr, &texture));
+    }
+
+    ID3D11Texture2D* Next(ID3D11DeviceContext* ctx, uint32_t frameIndex) {
+        size_t offset = (size_t)((frameIndex * PIPELINE_SOURCE_SCROLL) % width) * 4;
+        ctx->UpdateSubresource(texture.Get(), 0, nullptr, scene.data() + offset, scenePitch, 0);
+        return texture.Get();
+    }
+
+private:
+    int width = 0;
+    UINT scenePitch = 0;
+    std::vector<uint8_t> scene;
+    ComPtr<ID3D11Texture2D> texture;
+};
+
+// Forwards framed packets between two sockets with added delay, jitter and a bandwidth cap.
+// The reader never waits on delay, so delay does not throttle throughput. Under a bandwidth
+// cap it stops reading once PIPELINE_LINK_QUEUE_MS of traffic waits at the bottleneck, with
+// a small receive buffer, so the backlog reaches the host's send queue as on a real link.
+class ImpairedLink {
+public:
+    ~ImpairedLink() { Stop(); }
+
+    void Start(NetworkManager* net, SOCKET in, SOCKET out, double delayMs, double jitterMs, double rateMbps) {
+        this->net = net;
+        this->in = in;
+        this->out = out;
+        this->delayMs = delayMs;
+        this->jitterMs = jitterMs;
+        this->rateMbps = rateMbps;
+        if (rateMbps > 0) {
+            int receiveBuffer = PIPELINE_LINK_SOCKET_BUFFER;
+            setsockopt(in, SOL_SOCKET, SO_RCVBUF, (const char*)&receiveBuffer, sizeof(receiveBuffer));
+        }
+        running = true;
+        reader = std::thread(&ImpairedLink::ReadLoop, this);
+        writer = std::thread(&ImpairedLink::WriteLoop, this);
+    }
+
+    void Stop() {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            running = false;
+        }
+        wake.notify_all();
+        if (reader.joinable()) reader.join();
+        if (writer.joinable()) writer.join();
+    }
+
+private:
+    NetworkManager* net = nullptr;
+    SOCKET in = INVALID_SOCKET;
+    SOCKET out = INVALID_SOCKET;
+    double delayMs = 0;
+    double jitterMs = 0;
+    double rateMbps = 0;
+
+    PacketPool pool;
+    std::deque<PacketRef> held; // timestamp = release time, non-decreasing
+    std::mutex lock;
+    std::condition_variable wake;
+    bool running = false;
+    std::thread reader;
+    std::thread writer;
+
+    void ReadLoop() {
+        Tracer::SetThreadName("Link");
+        std::mt19937 rng(5);
+        std::uniform_real_distribution<double> jitter(0.0, jitterMs);
+        std::vector<uint8_t> body;
+        auto linkFree = std::chrono::steady_clock::now();
+        auto lastRelease = linkFree;
+        PacketHeader header;
+        while (true) {
+            if (rateMbps > 0) std::this_thread::sleep_until(linkFree - std::chrono::milliseconds(PIPELINE_LINK_QUEUE_MS));
+            if (!net->ReceiveHeader((int)in, header) || !net->ReceiveBody((int)in, body, header.payloadSize)) break;
+            auto now = std::chrono::steady_clock::now();
+            auto release = now + std::chrono::microseconds((int64_t)((delayMs + jitter(rng)) * 1000.0));
+            if (rateMbps > 0) {
+                // Serialization on the bottleneck: each packet leaves after the previous one finished
+                linkFree = std::max(linkFree, now) +
+                    std::chrono::microseconds((int64_t)((header.payloadSize + sizeof(PacketHeader)) * 8 / rateMbps));
+                release = std::max(release, linkFree);
+            }
+            release = std::max(release, lastRelease); // TCP delivers in order
+            lastRelease = release;
+
+            PacketRef packet = pool.Acquire(body.data(), header.payloadSize);
+            packet->packetType = header.packetType;
+            packet->frameId = header.frameId;
+            packet->frameType = header.frameType;
+            packet->cursorX = header.cursorX;
+            packet->cursorY = header.cursorY;
+            packet->timestamp = release;
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                held.push_back(std::move(packet));
+            }
+            wake.notify_one();
+        }
+        // Upstream closed: let the writer flush what is held, then close downstream
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            held.push_back(PacketRef());
+        }
+        wake.notify_one();
+    }
+
+    void WriteLoop() {
+        while (true) {
+            PacketRef packet;
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                wake.wait(guard, [this] { return !running || !held.empty(); });
+                if (!running) break;
+                packet = std::move(held.front());
+                held.pop_front();
+            }
+            if (!packet) break;
+            std::this_thread::sleep_until(packet->timestamp);
+            if (!net->SendPacket((int)out, packet->packetType, packet.Data(), packet.Size(), packet->cursorX,
+                                 packet->cursorY, packet->frameId, packet->frameType)) break;
+        }
+        shutdown(out, SD_SEND);
+    }
+};
+
+struct PipelineOptions {
+    int frames = 600;
+    int width = 1920;
+    int height = 1080;
+    double fps = 0.0;
+    double delayMs = 0.0;
+    double jitterMs = 0.0;
+    double rateMbps = 0.0;
+    bool expectDrops = false;
+    int startupRuns = 0;
+    std::string thresholdsPath;
+    std::string writeThresholdsPath;
+    std::string outPath;
+};
+
+// Ordered metric list; everything except fps is lower-is-better
+typedef std::vector<std::pair<std::string, double>> PipelineResults;
+
+bool HigherIsBetter(const std::string& metric) {
+    return metric == "fps";
+}
+
+bool CreateDevice(ComPtr<ID3D11Device>& device, ComPtr<ID3D11DeviceContext>& context) {
+    D3D_FEATURE_LEVEL featureLevels[] = { D3D_FEATURE_LEVEL_11_1, D3D_FEATURE_LEVEL_11_0 };
+    return SUCCEEDED(D3D11CreateDevice(nullptr, D3D_DRIVER_TYPE_HARDWARE, nullptr, 0, featureLevels, 2,
+                                       D3D11_SDK_VERSION, &device, nullptr, &context));
+}
+
+uint64_t ProcessCpuTime100ns() {
+    FILETIME creation, exit, kernel, user;
+    GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user);
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernel.dwLowDateTime; k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime; u.HighPart = user.dwHighDateTime;
+    return k.QuadPart + u.QuadPart;
+}
+
+bool RunPipeline(const PipelineOptions& opt, PipelineResults& results) {
+    ComPtr<ID3D11Device> hostDevice, clientDevice;
+    ComPtr<ID3D11DeviceContext> hostContext, clientContext;
+    if (!CreateDevice(hostDevice, hostContext) || !CreateDevice(clientDevice, clientContext)) {
+        std::cerr << "[PipelineBench] D3D11CreateDevice failed" << std::endl;
+        return false;
+    }
+    SyntheticSource source;
+    HardwareEncoder encoder;
+    HardwareDecoder decoder;
+    if (!source.Initialize(hostDevice.Get(), opt.width, opt.height) ||
+        !encoder.Initialize(hostDevice.Get(), opt.width, opt.height) ||
+        !decoder.Initialize(clientDevice.Get(), opt.width, opt.height)) {
+        std::cerr << "[PipelineBench] Pipeline initialization failed" << std::endl;
+        return false;
+    }
+
+    NetworkManager net;
+    SOCKET hostSock, clientSock;
+    if (!CreateLoopbackPair(hostSock, clientSock)) return false;
+    ImpairedLink link;
+    SOCKET linkIn = INVALID_SOCKET, linkOut = INVALID_SOCKET;
+    if (opt.delayMs > 0 || opt.jitterMs > 0 || opt.rateMbps > 0) {
+        // host -> linkIn | link | linkOut -> client
+        linkIn = clientSock;
+        if (!CreateLoopbackPair(linkOut, clientSock)) return false;
+        link.Start(&net, linkIn, linkOut, opt.delayMs, opt.jitterMs, opt.rateMbps);
+        if (opt.rateMbps > 0) {
+            // Loopback pairs get 4MB buffers, seconds of backlog at a few Mbps that would hide
+            // the congestion from the send queue
+            int sendBuffer = PIPELINE_LINK_SOCKET_BUFFER;
+            setsockopt(hostSock, SOL_SOCKET, SO_SNDBUF, (const char*)&sendBuffer, sizeof(sendBuffer));
+        }
+    }
+
+    // Source time per frame id, read back at the sink for the end-to-end latency
+    std::atomic<int64_t> sourceTimes[PIPELINE_TIMESTAMP_RING] = {};
+    auto nowNs = []() {
+        return (int64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    };
+
+    std::atomic<int> framesAtSink = 0;
+    std::thread client([&]() {
+        Tracer::SetThreadName("Client");
+        Metrics& metrics = Metrics::Get();
+        std::vector<uint8_t> buffer;
+        PacketHeader header;
+        while (true) {
+            auto receiveStart = std::chrono::steady_clock::now();
+            if (!net.ReceiveHeader((int)clientSock, header) ||
+                !net.ReceiveBody((int)clientSock, buffer, header.payloadSize)) break;
+            metrics.Record(Stage::Receive, std::chrono::steady_clock::now() - receiveStart);
+            metrics.Add(Counter::PacketsReceived);
+            metrics.Add(Counter::BytesReceived, header.payloadSize + sizeof(PacketHeader));
+            if (header.packetType != PACKET_TYPE_VIDEO) continue;
+            Tracer::SetCurrentFrame(header.frameId);
+
+            ID3D11Texture2D* decoded;
+            {
+                ScopedStageTimer decodeTimer(Stage::Decode);
+                decoded = decoder.Decode(buffer.data(), header.payloadSize, clientContext.Get());
+            }
+            if (!decoded) continue;
+            // Sink: the frame is complete once the decoder hands it out
+            metrics.Add(Counter::FramesDecoded);
+            metrics.Add(Counter::FramesPresented);
+            int64_t sourceNs = sourceTimes[header.frameId % PIPELINE_TIMESTAMP_RING].load(std::memory_order_relaxed);
+            if (sourceNs) metrics.Record(Stage::EndToEnd, (uint64_t)(nowNs() - sourceNs));
+            framesAtSink++;
+        }
+        while (decoder.DrainOutput()) framesAtSink++;
+    });
+
+    PacketPool pool;
+    AnnexBParser hostParser;
+    SendQueue sendQueue;
+    sendQueue.Start(&net, (int)hostSock, [&encoder]() { encoder.RequestKeyframe(); });
+
+    MetricsSnapshot before = Metrics::Get().Snapshot();
+    uint64_t cpuBefore = ProcessCpuTime100ns();
+    auto start = std::chrono::steady_clock::now();
+    uint64_t packetsQueued = 0;
+    Tracer::SetThreadName("Source");
+    for (int i = 0; i < opt.frames; i++) {
+        if (opt.fps > 0) std::this_thread::sleep_until(start + std::chrono::microseconds((int64_t)(i * 1e6 / opt.fps)));
+        Tracer::SetCurrentFrame((uint32_t)i);
+        sourceTimes[i % PIPELINE_TIMESTAMP_RING].store(nowNs(), std::memory_order_relaxed);
+        ID3D11Texture2D* frame = source.Next(hostContext.Get(), (uint32_t)i);
+        Metrics::Get().Add(Counter::FramesCaptured);
+        encoder.EncodeFrame(frame, hostContext.Get(), [&](const uint8_t* data, size_t size) {
+            Metrics::Get().Add(Counter::FramesEncoded);
+            Metrics::Get().Add(Counter::EncodedBytes, size);
+            PacketRef packet = pool.Acquire(data, size);
+            packet->packetType = PACKET_TYPE_VIDEO;
+            packet->frameId = (uint32_t)i;
+            packet->frameType = (uint32_t)hostParser.ParseAccessUnit(data, size).frameType;
+            sendQueue.Push(std::move(packet));
+            packetsQueued++;
+        });
+    }
+
+    // Drain: every queued packet on the wire, then close so the client sees the end of stream
+    const SendQueueStats& sq = sendQueue.GetStats();
+    while (sq.sentPackets + sq.droppedNonReference + sq.droppedSuperseded + sq.droppedDeepCut +
+           sq.droppedAwaitingIdr < packetsQueued) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    sendQueue.Stop();
+    shutdown(hostSock, SD_SEND);
+    client.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    uint64_t cpu100ns = ProcessCpuTime100ns() - cpuBefore;
+    MetricsSnapshot delta = Metrics::Get().Snapshot().Since(before);
+    link.Stop();
+    for (SOCKET s : { hostSock, clientSock, linkIn, linkOut }) {
+        if (s != INVALID_SOCKET) closesocket(s);
+    }
+    encoder.Cleanup();
+    decoder.Cleanup();
+
+    PROCESS_MEMORY_COUNTERS memory = {};
+    GetProcessMemoryInfo(GetCurrentProcess(), &memory, sizeof(memory));
+
+    int sinkFrames = framesAtSink;
+    uint64_t encodedFrames = delta.Get(Counter::FramesEncoded);
+    std::cerr << "[PipelineBench] " << opt.frames << " source frames, " << encodedFrames << " encoded, "
+              << sinkFrames << " at sink in " << seconds << "s" << std::endl;
+    std::cerr << "[PipelineBench] Send queue dropped " << sq.droppedNonReference << " non-reference, "
+              << sq.droppedSuperseded << " superseded, " << sq.droppedDeepCut << " deep cut, " << sq.droppedAwaitingIdr
+              << " awaiting IDR; " << sq.keyframeRequests << " keyframe requests" << std::endl;
+    if (sinkFrames == 0) return false;
+    if (opt.expectDrops && (sq.droppedDeepCut == 0 || sq.keyframeRequests == 0)) {
+        std::cerr << "[PipelineBench] Expected the drop policy to cut video and request a keyframe; is --rate-mbps "
+                     "below the encoded rate?" << std::endl;
+        return false;
+    }
+
+    results.push_back({ "fps", sinkFrames / seconds });
+    const Stage stages[] = { Stage::Convert, Stage::Encode, Stage::Send, Stage::Receive, Stage::Decode, Stage::EndToEnd };
+    for (Stage s : stages) {
+        const StageSummary& st = delta.Get(s);
+        if (st.count == 0) continue; // Not every encoder path has a separate convert step
+        results.push_back({ std::string(StageName(s)) + "_p50_ms", st.PercentileUs(50) / 1000.0 });
+        results.push_back({ std::string(StageName(s)) + "_p99_ms", st.PercentileUs(99) / 1000.0 });
+    }
+    results.push_back({ "cpu_ms_per_frame", cpu100ns / 1e4 / sinkFrames });
+    results.push_back({ "bytes_per_frame", encodedFrames ? (double)delta.Get(Counter::EncodedBytes) / encodedFrames : 0.0 });
+    results.push_back({ "peak_working_set_mb", memory.PeakWorkingSetSize / (1024.0 * 1024.0) });
+    return true;
+}
+
+struct StartupTimes {
+    double connectMs = 0;      // Join -> stream socket connected
+    double decoderReadyMs = 0; // Join -> decoder and converter created
+    double firstPixelMs = 0;   // Join -> first frame decoded and converted to BGRA on the GPU
+};
+
+// One session start the way main.cpp does it. fastStart: the host creates its encoder and
+// sends the parameter sets before any frame, so the client's decoder is ready when the
+// IDR lands. Otherwise the old order: encoder created after the client connects, decoder
+// after the first frame arrives.
+bool RunStartupOnce(const PipelineOptions& opt, bool fastStart, StartupTimes& times) {
+    ComPtr<ID3D11Device> hostDevice, clientDevice;
+    ComPtr<ID3D11DeviceContext> hostContext, clientContext;
+    SyntheticSource source;
+    if (!CreateDevice(hostDevice, hostContext) || !CreateDevice(clientDevice, clientContext) ||
+        !source.Initialize(hostDevice.Get(), opt.width, opt.height)) {
+        return false;
+    }
+    NetworkManager net;
+    std::atomic<bool> done = false;
+    std::atomic<bool> hostExited = false;
+    std::thread host([&]() {
+        HardwareEncoder encoder;
+        bool encoderReady = false;
+        std::vector<uint8_t> parameterSets;
+        if (fastStart) {
+            encoderReady = encoder.Initialize(hostDevice.Get(), opt.width, opt.height);
+            if (encoderReady) encoder.GetParameterSets(parameterSets);
+        }
+        int sock = -1;
+        bool connected = net.WaitForReceiver(sock);
+        if (!connected || done) { // done: the client gave up and connected only to end the wait
+            if (connected) closesocket(sock);
+            hostExited = true;
+            return;
+        }
+        if (fastStart) net.SendPacket(sock, PACKET_TYPE_STREAM_INFO, parameterSets.data(), parameterSets.size());
+        if (!encoderReady) encoderReady = encoder.Initialize(hostDevice.Get(), opt.width, opt.height);
+        // Capture rate until the client has a picture; readback encoders emit a frame late
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; encoderReady && !done && i < 600; i++) {
+            std::this_thread::sleep_until(start + std::chrono::microseconds(i * 16667));
+            Tracer::SetCurrentFrame(i);
+            encoder.EncodeFrame(source.Next(hostContext.Get(), i), hostContext.Get(), [&](const uint8_t* data, size_t size) {
+                net.SendPacket(sock, PACKET_TYPE_VIDEO, data, size, -1, -1, i);
+            });
+        }
+        while (!done) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        encoder.Cleanup();
+        closesocket(sock);
+        hostExited = true;
+    });
+
+    auto join = std::chrono::steady_clock::now();
+    auto sinceJoin = [&]() { return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - join).count(); };
+    int sock = -1;
+    if (!net.FindAndConnect(sock)) {
+        std::cerr << "[PipelineBench] Startup: no host found" << std::endl;
+        // The host waits in accept on a listen socket of its own: connect to it directly until
+        // it has noticed (it may not be listening yet), so it exits before the locals it uses
+        // go away and the next run can bind the stream port
+        done = true;
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(STREAM_PORT);
+        while (!hostExited) {
+            SOCKET wake = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+            connect(wake, (sockaddr*)&addr, sizeof(addr));
+            closesocket(wake);
+            if (!hostExited) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        host.join();
+        return false;
+    }
+    times.connectMs = sinceJoin();
+
+    HardwareDecoder decoder;
+    VideoProcessor converter;
+    AnnexBParser parser;
+    bool ready = false;
+    D3D11_QUERY_DESC fenceDesc = {};
+    fenceDesc.Query = D3D11_QUERY_EVENT;
+    ComPtr<ID3D11Query> fence;
+    clientDevice->CreateQuery(&fenceDesc, &fence);
+    std::vector<uint8_t> buffer;
+    PacketHeader header;
+    while (net.ReceiveHeader(sock, header) && net.ReceiveBody(sock, buffer, header.payloadSize)) {
+        if (!ready && header.payloadSize > 0 &&
+            (header.packetType == PACKET_TYPE_STREAM_INFO || header.packetType == PACKET_TYPE_VIDEO)) {
+            parser.ParseAccessUnit(buffer.data(), header.payloadSize);
+            const SequenceInfo& seq = parser.GetSequenceInfo();
+            if (seq.valid) {
+                decoder.Initialize(clientDevice.Get(), seq.width, seq.height);
+                converter.Initialize(clientDevice.Get(), seq.width, seq.height);
+                converter.ConvertNV12ToBGRA(converter.GetOutputTexture()); // Warm-up, as InitClientVideo
+                ready = true;
+                times.decoderReadyMs = sinceJoin();
+            }
+        }
+        if (!ready || header.packetType != PACKET_TYPE_VIDEO) continue;
+        ID3D11Texture2D* decoded = decoder.Decode(buffer.data(), header.payloadSize, clientContext.Get());
+        if (!decoded) continue;
+        converter.ConvertNV12ToBGRA(decoded);
+        clientContext->End(fence.Get());
+        while (clientContext->GetData(fence.Get(), nullptr, 0, 0) == S_FALSE) {}
+        times.firstPixelMs = sinceJoin();
+        break;
+    }
+    closesocket(sock); // Client side first, so the host's stream port isn't left in TIME_WAIT
+    done = true;
+    host.join();
+    decoder.Cleanup();
+    return times.firstPixelMs > 0;
+}
+
+bool RunStartup(const PipelineOptions& opt, PipelineResults& results) {
+    for (bool fastStart : { true, false }) {
+        std::vector<StartupTimes> runs;
+        for (int i = 0; i < opt.startupRuns; i++) {
+            StartupTimes times;
+            if (!RunStartupOnce(opt, fastStart, times)) return false;
+            std::cerr << "[PipelineBench] Startup (" << (fastStart ? "fast" : "lazy") << "): connected " << times.connectMs
+                      << " ms, decoder ready " << times.decoderReadyMs << " ms, first pixel " << times.firstPixelMs << " ms" << std::endl;
+            runs.push_back(times);
+        }
+        auto median = [&](double StartupTimes::*field) {
+            std::vector<double> values;
+            for (const StartupTimes& t : runs) values.push_back(t.*field);
+            std::sort(values.begin(), values.end());
+            return values[values.size() / 2];
+        };
+        if (fastStart) {
+            results.push_back({ "startup_connect_ms", median(&StartupTimes::connectMs) });
+            results.push_back({ "startup_decoder_ready_ms", median(&StartupTimes::decoderReadyMs) });
+            results.push_back({ "startup_first_pixel_ms", median(&StartupTimes::firstPixelMs) });
+        } else {
+            results.push_back({ "startup_lazy_first_pixel_ms", median(&StartupTimes::firstPixelMs) });
+        }
+    }
+    return true;
+}
+
+// Thresholds file: "<metric> <baseline> [tolerance_pct]" per line, '#' comments, and
+// an optional "tolerance_pct <value>" line setting the default tolerance
+struct Threshold {
+    std::string metric;
+    double baseline = 0;
+    double tolerancePct = -1; // < 0: file default
+};
+
+bool LoadThresholds(const std::string& path, std::vector<Threshold>& thresholds, double& defaultTolerance) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "[PipelineBench] Cannot read " << path << std::endl;
+        return false;
+    }
+    std::string line;
+    while (std::getline(file, line)) {
+        size_t hash = line.find('#');
+        if (hash != std::string::npos) line.erase(hash);
+        std::istringstream fields(line);
+        Threshold t;
+        if (!(fields >> t.metric >> t.baseline)) continue;
+        if (t.metric == "tolerance_pct") {
+            defaultTolerance = t.baseline;
+            continue;
+        }
+        fields >> t.tolerancePct;
+        thresholds.push_back(t);
+    }
+    return true;
+}
+
+// Returns the number of regressions
+int CheckThresholds(const PipelineResults& results, const std::vector<Threshold>& thresholds, double defaultTolerance) {
+    int regressions = 0;
+    for (const Threshold& t : thresholds) {
+        auto it = std::find_if(results.begin(), results.end(), [&](const auto& r) { return r.first == t.metric; });
+        if (it == results.end()) {
+            std::cerr << "[PipelineBench] " << t.metric << ": not measured in this run, skipped" << std::endl;
+            continue;
+        }
+        double tolerance = t.tolerancePct >= 0 ? t.tolerancePct : defaultTolerance;
+        double limit = HigherIsBetter(t.metric) ? t.baseline * (1.0 - tolerance / 100.0)
+                                                : t.baseline * (1.0 + tolerance / 100.0);
+        bool regressed = HigherIsBetter(t.metric) ? it->second < limit : it->second > limit;
+        double changePct = t.baseline != 0 ? (it->second - t.baseline) / t.baseline * 100.0 : 0.0;
+        fprintf(stderr, "%-24s %10.3f  baseline %10.3f  %+6.1f%%  %s\n", t.metric.c_str(), it->second, t.baseline,
+                changePct, regressed ? "REGRESSED" : "ok");
+        if (regressed) regressions++;
+    }
+    return regressions;
+}
+
+bool WriteThresholds(const std::string& path, const PipelineResults& results, double tolerance, const PipelineOptions& opt) {
+    std::ofstream file(path);
+    if (!file) return false;
+    file << "# PipelineBench baselines: " << opt.width << "x" << opt.height << ", " << opt.frames << " frames, fps "
+         << opt.fps << ", delay " << opt.delayMs << "ms, jitter " << opt.jitterMs << "ms, rate " << opt.rateMbps << " Mbps\n";
+    file << "# <metric> <baseline> [tolerance_pct]\n";
+    file << "tolerance_pct " << tolerance << "\n";
+    for (const auto& r : results) file << r.first << " " << r.second << "\n";
+    return true;
+}
+
+std::string ToJson(const PipelineResults& results, const PipelineOptions& opt) {
+    char buf[256];
+    snprintf(buf, sizeof(buf), "{\"suite\":\"pipeline\",\"config\":{\"frames\":%d,\"width\":%d,\"height\":%d,"
+             "\"fps\":%.1f,\"delay_ms\":%.1f,\"jitter_ms\":%.1f,\"rate_mbps\":%.1f},\"metrics\":{",
+             opt.frames, opt.width, opt.height, opt.fps, opt.delayMs, opt.jitterMs, opt.rateMbps);
+    std::string json = buf;
+    for (size_t i = 0; i < results.size(); i++) {
+        snprintf(buf, sizeof(buf), "%s\"%s\":%.3f", i ? "," : "", results[i].first.c_str(), results[i].second);
+        json += buf;
+    }
+    json += "}}";
+    return json;
+}
+
+int main(int argc, char** argv) {
+    PipelineOptions opt;
+    for (int i = 1; i + 1 < argc; i++) {
+        std::string arg = argv[i];
+        const char* value = argv[i + 1];
+        if (arg == "--frames") opt.frames = atoi(value);
+        else if (arg == "--width") opt.width = atoi(value);
+        else if (arg == "--height") opt.height = atoi(value);
+        else if (arg == "--fps") opt.fps = atof(value);
+        else if (arg == "--delay-ms") opt.delayMs = atof(value);
+        else if (arg == "--jitter-ms") opt.jitterMs = atof(value);
+        else if (arg == "--rate-mbps") opt.rateMbps = atof(value);
+        else if (arg == "--expect-drops") opt.expectDrops = atoi(value) != 0;
+        else if (arg == "--startup") opt.startupRuns = atoi(value);
+        else if (arg == "--thresholds") opt.thresholdsPath = value;
+        else if (arg == "--write-thresholds") opt.writeThresholdsPath = value;
+        else if (arg == "--out") opt.outPath = value;
+        else continue;
+        i++;
+    }
+
+    PipelineResults results;
+    if (opt.frames > 0 && !RunPipeline(opt, results)) return 1;
+    if (opt.startupRuns > 0 && !RunStartup(opt, results)) return 1;
+    if (results.empty()) return 1;
+
+    std::string json = ToJson(results, opt);
+    if (opt.outPath.empty()) {
+        std::cout << json << std::endl;
+    } else {
+        std::ofstream out(opt.outPath);
+        out << json << std::endl;
+    }
+
+    double tolerance = PIPELINE_DEFAULT_TOLERANCE_PCT;
+    int regressions = 0;
+    if (!opt.thresholdsPath.empty()) {
+        std::vector<Threshold> thresholds;
+        if (!LoadThresholds(opt.thresholdsPath, thresholds, tolerance)) return 1;
+        regressions = CheckThresholds(results, thresholds, tolerance);
+    } else {
+        for (const auto& r : results) fprintf(stderr, "%-24s %10.3f\n", r.first.c_str(), r.second);
+    }
+    if (!opt.writeThresholdsPath.empty()) {
+        if (!WriteThresholds(opt.writeThresholdsPath, results, tolerance, opt)) return 1;
+        std::cerr << "[PipelineBench] Saved baselines to " << opt.writeThresholdsPath << std::endl;
+    }
+    if (regressions > 0) {
+        std::cerr << "[PipelineBench] " << regressions << " metric(s) regressed" << std::endl;
+        return 3;
+    }
+    return 0;
+}
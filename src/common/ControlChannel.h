@@ -0,0 +1,130 @@
+#pragma once
+#include <winsock2.h>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <cstdint>
+#include <cstring>
+#include "NetworkManager.h"
+#include "PacketPool.h"
+#include "StreamReceiver.h"
+
+// Session control messages. A session has two channels:
+//   - Control: the TCP connection. Reliable and ordered, low volume: handshake, feedback
+//     and configuration, framed as PACKET_TYPE_CONTROL packets.
+//   - Media: video and audio over a DatagramSocket pair once the client has offered a
+//     UDP port (CONTROL_MEDIA_ENDPOINT). Loss-tolerant: a lost video packet costs a
+//     keyframe request, lost audio is covered by the redundancy framing.
+// Until the media endpoint is set up (or if it can't be) media stays on the TCP stream.
+// The host moves media over only once the client has confirmed a full-size probe
+// datagram (CONTROL_MEDIA_PROBE -> CONTROL_MEDIA_CONFIRM), and moves it back, announcing
+// CONTROL_MEDIA_ENDPOINT 0, if no receiver report shows media arriving by the deadline.
+
+#define CONTROL_MEDIA_ENDPOINT 1   // Either way: my media UDP port (values[0]; 0 = keep media on TCP)
+#define CONTROL_KEYFRAME_REQUEST 2 // Client -> host: the decoder lost sync, send an IDR
+#define CONTROL_RECEIVER_REPORT 3  // Client -> host: media packets completed / lost / dropped (cumulative)
+#define CONTROL_CURSOR_SHAPE_REQUEST 4 // Client -> host: re-send cursor shape values[0] (not in the client cache)
+#define CONTROL_MEDIA_PROBE 5      // Host -> client, on the media channel: padded to a full datagram
+#define CONTROL_MEDIA_CONFIRM 6    // Client -> host: a probe arrived, media may move to the media channel
+
+#define CONTROL_REPORT_INTERVAL_MS 500        // Receiver report period
+#define CONTROL_KEYFRAME_REQUEST_GAP_MS 100   // At most one keyframe request per this interval
+#define CONTROL_MEDIA_PROBE_INTERVAL_MS 100   // Probe period until the client confirms
+#define CONTROL_MEDIA_CONFIRM_TIMEOUT_MS 2000 // For the probe confirmation, then for a report of media arriving
+
+// Payload of a PACKET_TYPE_CONTROL packet, network byte order on the wire
+struct ControlMessage {
+    uint32_t kind; // CONTROL_*
+    uint32_t values[3];
+};
+
+inline ControlMessage MakeControlMessage(uint32_t kind, uint32_t a = 0, uint32_t b = 0, uint32_t c = 0) {
+    ControlMessage message;
+    message.kind = kind;
+    message.values[0] = a;
+    message.values[1] = b;
+    message.values[2] = c;
+    return message;
+}
+
+inline void EncodeControlMessage(const ControlMessage& message, uint8_t* out) {
+    uint32_t fields[4] = { htonl(message.kind), htonl(message.values[0]), htonl(message.values[1]), htonl(message.values[2]) };
+    memcpy(out, fields, sizeof(fields));
+}
+
+inline bool DecodeControlMessage(const uint8_t* data, size_t size, ControlMessage& out) {
+    if (size < sizeof(ControlMessage)) return false;
+    uint32_t fields[4];
+    memcpy(fields, data, sizeof(fields));
+    out.kind = ntohl(fields[0]);
+    for (int i = 0; i < 3; i++) out.values[i] = ntohl(fields[i + 1]);
+    return true;
+}
+
+// Blocking send on the control connection (the client side, which sends no media on it)
+inline bool SendControl(NetworkManager& net, int sock, const ControlMessage& message) {
+    uint8_t payload[sizeof(ControlMessage)];
+    EncodeControlMessage(message, payload);
+    return net.SendPacket(sock, PACKET_TYPE_CONTROL, payload, sizeof(payload));
+}
+
+// Pooled packet for SendQueue::PushControl (the host side)
+inline PacketRef MakeControlPacket(PacketPool& pool, const ControlMessage& message) {
+    uint8_t payload[sizeof(ControlMessage)];
+    EncodeControlMessage(message, payload);
+    PacketRef packet = pool.Acquire(payload, sizeof(payload));
+    packet->packetType = PACKET_TYPE_CONTROL;
+    return packet;
+}
+
+// Host side: reads the control messages the client sends on the stream socket, on its own
+// thread so feedback is acted on while capture and the sender are busy. The socket is
+// shared with the SendQueue, which only writes to it.
+class ControlReceiver {
+public:
+    using Handler = std::function<void(const ControlMessage&)>;
+
+    ~ControlReceiver() { Stop(); }
+
+    void Start(int sock, Handler onMessage) {
+        Stop();
+        this->sock = sock;
+        this->onMessage = onMessage;
+        running = true;
+        reader = std::thread(&ControlReceiver::ReceiveLoop, this);
+    }
+
+    // After closing the socket, or while it is still open
+    void Stop() {
+        running = false;
+        if (reader.joinable()) reader.join();
+    }
+
+    uint64_t GetReceived() const { return received; }
+
+private:
+    int sock = -1;
+    Handler onMessage;
+    std::thread reader;
+    std::atomic<bool> running = false;
+    std::atomic<uint64_t> received = 0;
+
+    void ReceiveLoop() {
+        Tracer::SetThreadName("Control");
+        StreamReceiver stream;
+        if (!stream.Start(sock, IoMode::Readiness)) return;
+        PacketHeader header;
+        PacketRef packet;
+        ControlMessage message;
+        while (running) {
+            // Bounded wait, so Stop is noticed without relying on the close to wake select
+            if (!stream.Poll(header, packet, 100)) {
+                if (!stream.IsConnected()) break;
+                continue;
+            }
+            if (header.packetType != PACKET_TYPE_CONTROL || !DecodeControlMessage(packet.Data(), packet.Size(), message)) continue;
+            received++;
+            if (onMessage) onMessage(message);
+        }
+    }
+};
@@ -0,0 +1,158 @@
+#pragma once
+#include <winsock2.h>
+#include <windows.h>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include "NetworkManager.h"
+#include "PacketPool.h"
+
+// Pointer position and visibility as standalone PACKET_TYPE_CURSOR messages, sent the
+// moment they change instead of riding on the next video packet. The client overlay then
+// follows the mouse at input rate, not at frame rate plus encode/decode latency.
+// Updates take the media channel ahead of queued media (SendQueue::PushCursor, newest
+// wins). A lost update is superseded by the next one, and a cursor that stops moving is
+// re-sent every CURSOR_REFRESH_MS so its final position always arrives.
+//
+// The pointer is never part of the video: the client composites it from a shape it has
+// cached. Every update names its shape by a content hash (shapeId). The host sends each
+// shape once, as a PACKET_TYPE_CURSOR_SHAPE on the reliable control lane, and again only
+// if the client asks for it (CONTROL_CURSOR_SHAPE_REQUEST) after evicting it from its
+// LRU cache. So an unchanged pointer shape costs a few bytes per update, and moving the
+// pointer never changes encoded pixels.
+
+#define CURSOR_POLL_INTERVAL_US 1000 // Host sampling period (1 kHz)
+#define CURSOR_REFRESH_MS 250        // Re-send an unchanged cursor this often
+#define CURSOR_FLAG_VISIBLE 0x1
+#define CURSOR_SHAPE_MAX_SIZE 256    // Larger shapes are not sent
+#define CURSOR_SHAPE_CACHE 16        // Client LRU entries (the host keeps twice as many for resends)
+#define CURSOR_SHAPE_REQUEST_GAP_MS 500
+
+// Payload of a PACKET_TYPE_CURSOR packet, network byte order on the wire
+struct CursorMessage {
+    uint32_t sequence; // Per session; datagrams may arrive out of order
+    int32_t x;         // Captured-frame pixels
+    int32_t y;
+    uint32_t flags;    // CURSOR_FLAG_*
+    uint32_t shapeId;  // CursorShape::id, 0 = not known yet
+};
+
+inline void EncodeCursorMessage(const CursorMessage& message, uint8_t* out) {
+    uint32_t fields[5] = { htonl(message.sequence), htonl((uint32_t)message.x), htonl((uint32_t)message.y),
+                           htonl(message.flags), htonl(message.shapeId) };
+    memcpy(out, fields, sizeof(fields));
+}
+
+inline bool DecodeCursorMessage(const uint8_t* data, size_t size, CursorMessage& out) {
+    if (size < sizeof(CursorMessage)) return false;
+    uint32_t fields[5];
+    memcpy(fields, data, sizeof(fields));
+    out.sequence = ntohl(fields[0]);
+    out.x = (int32_t)ntohl(fields[1]);
+    out.y = (int32_t)ntohl(fields[2]);
+    out.flags = ntohl(fields[3]);
+    out.shapeId = ntohl(fields[4]);
+    return true;
+}
+
+// A pointer image: BGRA with straight alpha, rows of width * 4 bytes
+struct CursorShape {
+    uint32_t id = 0; // HashCursorShape
+    uint16_t width = 0;
+    uint16_t height = 0;
+    int16_t hotX = 0;
+    int16_t hotY = 0;
+    std::vector<uint8_t> pixels;
+};
+
+// Prefix of a PACKET_TYPE_CURSOR_SHAPE payload (the pixels follow), network byte order
+struct CursorShapeHeader {
+    uint32_t id;
+    uint16_t width;
+    uint16_t height;
+    int16_t hotX;
+    int16_t hotY;
+};
+
+// FNV-1a over the size, hotspot and pixels; never 0
+inline uint32_t HashCursorShape(const CursorShape& shape) {
+    uint32_t hash = 2166136261u;
+    auto mix = [&hash](const uint8_t* data, size_t size) {
+        for (size_t i = 0; i < size; i++) hash = (hash ^ data[i]) * 16777619u;
+    };
+    int16_t geometry[4] = { (int16_t)shape.width, (int16_t)shape.height, shape.hotX, shape.hotY };
+    mix((const uint8_t*)geometry, sizeof(geometry));
+    mix(shape.pixels.data(), shape.pixels.size());
+    return hash ? hash : 1;
+}
+
+inline PacketRef MakeCursorShapePacket(PacketPool& pool, const CursorShape& shape) {
+    PacketRef packet = pool.Acquire(nullptr, sizeof(CursorShapeHeader) + shape.pixels.size());
+    CursorShapeHeader header;
+    header.id = htonl(shape.id);
+    header.width = htons(shape.width);
+    header.height = htons(shape.height);
+    header.hotX = (int16_t)htons((uint16_t)shape.hotX);
+    header.hotY = (int16_t)htons((uint16_t)shape.hotY);
+    memcpy(packet->data.data(), &header, sizeof(header));
+    memcpy(packet->data.data() + sizeof(header), shape.pixels.data(), shape.pixels.size());
+    packet->packetType = PACKET_TYPE_CURSOR_SHAPE;
+    return packet;
+}
+
+inline bool DecodeCursorShape(const uint8_t* data, size_t size, CursorShape& out) {
+    if (size < sizeof(CursorShapeHeader)) return false;
+    CursorShapeHeader header;
+    memcpy(&header, data, sizeof(header));
+    out.id = ntohl(header.id);
+    out.width = ntohs(header.width);
+    out.height = ntohs(header.height);
+    out.hotX = (int16_t)ntohs((uint16_t)header.hotX);
+    out.hotY = (int16_t)ntohs((uint16_t)header.hotY);
+    size_t pixelBytes = (size_t)out.width * out.height * 4;
+    if (out.width == 0 || out.height == 0 || out.width > CURSOR_SHAPE_MAX_SIZE || out.height > CURSOR_SHAPE_MAX_SIZE ||
+        size - sizeof(header) != pixelBytes) {
+        return false;
+    }
+    out.pixels.assign(data + sizeof(header), data + size);
+    return true;
+}
+
+inline PacketRef MakeCursorPacket(PacketPool& pool, const CursorMessage& message) {
+    uint8_t payload[sizeof(CursorMessage)];
+    EncodeCursorMessage(message, payload);
+    PacketRef packet = pool.Acquire(payload, sizeof(payload));
+    packet->packetType = PACKET_TYPE_CURSOR;
+    packet->cursorX = message.x;
+    packet->cursorY = message.y;
+    return packet;
+}
+
+// Client side: the newest cursor update received. Once the host sends cursor messages,
+// the positions in video packet headers are stale by comparison and are ignored.
+class CursorState {
+public:
+    void Reset() { active = false; }
+
+    // False for an update older than the one already applied
+    bool Apply(const CursorMessage& message) {
+        if (active && (int32_t)(message.sequence - last.sequence) <= 0) return false;
+        last = message;
+        active = true;
+        return true;
+    }
+
+    bool IsActive() const { return active; }
+
+    // {-1, -1} while hidden
+    POINT GetPosition() const {
+        if (!active || !(last.flags & CURSOR_FLAG_VISIBLE)) return { -1, -1 };
+        return { last.x, last.y };
+    }
+
+    uint32_t GetShapeId() const { return active ? last.shapeId : 0; }
+
+private:
+    CursorMessage last = {};
+    bool active = false;
+};
@@ -0,0 +1,488 @@
+#pragma once
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <mswsock.h>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include "NetworkManager.h"
+#include "PacketPool.h"
+#include "Tracer.h"
+
+// UDP transport for framed packets. A packet (PacketHeader + payload, the same framing as
+// the TCP stream) is split into fixed-size fragments, each prefixed with a FragmentHeader.
+//
+// Syscalls are batched with the Windows UDP offloads, the counterpart of Linux
+// UDP_SEGMENT/UDP_GRO with sendmmsg/recvmmsg:
+//   - Send (USO, UDP_SEND_MSG_SIZE): up to DATAGRAM_BATCH_SEGMENTS fragments go down in
+//     one WSASendMsg. The headers and the caller's payload are gathered straight from
+//     where they are, so the payload is never copied.
+//   - Receive (URO, UDP_RECV_MAX_COALESCED_SIZE): one WSARecvMsg returns a run of
+//     coalesced datagrams plus their segment size.
+// Without the offloads (older Windows, or SetBatching(false) as the benchmark baseline)
+// each datagram costs one call.
+
+#define DATAGRAM_PAYLOAD 1200        // Fragment payload; keeps datagrams under common path MTUs
+#define DATAGRAM_BATCH_SEGMENTS 48   // Fragments per send call (48 * 1208 bytes stays under 64KB)
+#define DATAGRAM_RECV_BUFFER (256 * 1024)
+#define DATAGRAM_COALESCED_MAX 65535 // Largest coalesced run URO may return in one receive
+#define DATAGRAM_REASSEMBLY_SLOTS 4  // Packets being reassembled at once (older ones are dropped)
+#define DATAGRAM_REORDER_WINDOW 64   // Packet ids an incomplete packet may trail the newest completed one by
+// Largest packet carried (header included): a 4K IDR at the top bitrate is a few MB.
+// The receiver rejects fragment counts past this before allocating anything.
+#define DATAGRAM_MAX_PACKET (8 * 1024 * 1024)
+#define DATAGRAM_MAX_FRAGMENTS ((DATAGRAM_MAX_PACKET + DATAGRAM_PAYLOAD - 1) / DATAGRAM_PAYLOAD)
+
+#ifndef UDP_SEND_MSG_SIZE
+#define UDP_SEND_MSG_SIZE 2
+#endif
+#ifndef UDP_RECV_MAX_COALESCED_SIZE
+#define UDP_RECV_MAX_COALESCED_SIZE 3
+#endif
+#ifndef UDP_COALESCED_INFO
+#define UDP_COALESCED_INFO 3
+#endif
+
+// Prefix of every datagram, network byte order
+struct FragmentHeader {
+    uint32_t packetId; // Per-socket packet sequence number
+    uint16_t index;
+    uint16_t count;
+};
+
+#define DATAGRAM_SEGMENT ((int)(sizeof(FragmentHeader) + DATAGRAM_PAYLOAD))
+
+// One received datagram, pointing into the socket's receive buffer
+struct DatagramView {
+    const uint8_t* data;
+    size_t size;
+};
+
+class DatagramSocket {
+public:
+    DatagramSocket() = default;
+    DatagramSocket(const DatagramSocket&) = delete;
+    DatagramSocket& operator=(const DatagramSocket&) = delete;
+    ~DatagramSocket() { Close(); }
+
+    // Binds to `port` (0 = any). The socket is non-blocking; Receive waits with select.
+    bool Open(uint16_t port) {
+        Close();
+        sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        if (sock == INVALID_SOCKET) return false;
+
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = INADDR_ANY;
+        addr.sin_port = htons(port);
+        if (bind(sock, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR) {
+            Close();
+            return false;
+        }
+        u_long nonBlocking = 1;
+        ioctlsocket(sock, FIONBIO, &nonBlocking);
+        int bufferSize = 4 * 1024 * 1024; // A few IDR frames of headroom
+        setsockopt(sock, SOL_SOCKET, SO_SNDBUF, (const char*)&bufferSize, sizeof(bufferSize));
+        setsockopt(sock, SOL_SOCKET, SO_RCVBUF, (const char*)&bufferSize, sizeof(bufferSize));
+
+        // Both offloads are optional, the kernel rejects them before Windows 10 2004 / 11
+        DWORD segment = DATAGRAM_SEGMENT;
+        sendOffload = setsockopt(sock, IPPROTO_UDP, UDP_SEND_MSG_SIZE, (const char*)&segment, sizeof(segment)) == 0;
+        DWORD coalesced = DATAGRAM_COALESCED_MAX;
+        receiveCoalescing =
+            setsockopt(sock, IPPROTO_UDP, UDP_RECV_MAX_COALESCED_SIZE, (const char*)&coalesced, sizeof(coalesced)) == 0;
+
+        GUID recvMsgId = WSAID_WSARECVMSG;
+        DWORD bytes = 0;
+        if (WSAIoctl(sock, SIO_GET_EXTENSION_FUNCTION_POINTER, &recvMsgId, sizeof(recvMsgId), &recvMsg, sizeof(recvMsg),
+                     &bytes, nullptr, nullptr) == SOCKET_ERROR) {
+            recvMsg = nullptr;
+            receiveCoalescing = false;
+        }
+        recvBuffer.resize(DATAGRAM_RECV_BUFFER);
+        std::cout << "[Datagram] Bound port " << GetPort() << " | send offload " << (sendOffload ? "on" : "off")
+                  << " | receive coalescing " << (receiveCoalescing ? "on" : "off") << std::endl;
+        return true;
+    }
+
+    // Fixes the peer, so sends need no address and only its datagrams are received
+    bool Connect(const sockaddr_in& peer) {
+        return connect(sock, (const sockaddr*)&peer, sizeof(peer)) != SOCKET_ERROR;
+    }
+
+    void Close() {
+        if (sock != INVALID_SOCKET) closesocket(sock);
+        sock = INVALID_SOCKET;
+    }
+
+    uint16_t GetPort() const {
+        sockaddr_in addr = {};
+        int len = sizeof(addr);
+        if (getsockname(sock, (sockaddr*)&addr, &len) == SOCKET_ERROR) return 0;
+        return ntohs(addr.sin_port);
+    }
+
+    SOCKET GetSocket() const { return sock; }
+    bool IsSendOffloaded() const { return sendOffload && batching; }
+    bool IsReceiveCoalesced() const { return receiveCoalescing && batching; }
+
+    // false = one datagram per call even when the offloads are available (benchmark baseline)
+    void SetBatching(bool enabled) {
+        batching = enabled;
+        DWORD segment = enabled ? DATAGRAM_SEGMENT : 0; // 0 turns the offload off
+        DWORD coalesced = enabled ? DATAGRAM_COALESCED_MAX : 0;
+        if (sendOffload) setsockopt(sock, IPPROTO_UDP, UDP_SEND_MSG_SIZE, (const char*)&segment, sizeof(segment));
+        if (receiveCoalescing) {
+            setsockopt(sock, IPPROTO_UDP, UDP_RECV_MAX_COALESCED_SIZE, (const char*)&coalesced, sizeof(coalesced));
+        }
+    }
+
+    // Fragments and sends one framed packet; `data` is read in place (no copy)
+    bool SendPacket(uint32_t type, const uint8_t* data, size_t size, int x = -1, int y = -1, uint32_t frameId = 0,
+                    uint32_t frameType = 0) {
+        if (sock == INVALID_SOCKET) return false;
+        TRACE_SCOPE(type == PACKET_TYPE_VIDEO ? "SendDatagrams" : "SendAudioDatagram", frameId);
+
+        PacketHeader header = EncodePacketHeader(type, (uint32_t)size, x, y, frameId, frameType);
+        size_t total = sizeof(header) + size;
+        if (total > DATAGRAM_MAX_PACKET) return false; // The receiver would reject it
+        uint16_t count = (uint16_t)((total + DATAGRAM_PAYLOAD - 1) / DATAGRAM_PAYLOAD);
+        uint32_t packetId = nextPacketId++;
+
+        // Walk the logical [header | payload] stream fragment by fragment
+        size_t offset = 0;
+        uint16_t index = 0;
+        while (index < count) {
+            int fragments = 0;
+            int buffers = 0;
+            while (index < count && fragments < DATAGRAM_BATCH_SEGMENTS) {
+                FragmentHeader& fragment = fragmentHeaders[fragments];
+                fragment.packetId = htonl(packetId);
+                fragment.index = htons(index);
+                fragment.count = htons(count);
+                int first = buffers;
+                AddBuffer(buffers, &fragment, sizeof(fragment));
+                size_t end = offset + DATAGRAM_PAYLOAD < total ? offset + DATAGRAM_PAYLOAD : total;
+                if (offset < sizeof(header)) {
+                    AddBuffer(buffers, (const uint8_t*)&header + offset, (end < sizeof(header) ? end : sizeof(header)) - offset);
+                }
+                if (end > sizeof(header)) {
+                    size_t from = offset > sizeof(header) ? offset - sizeof(header) : 0;
+                    AddBuffer(buffers, data + from, end - sizeof(header) - from);
+                }
+                if (!IsSendOffloaded() && !SendBuffers(first, buffers - first)) return false;
+                offset = end;
+                index++;
+                fragments++;
+            }
+            // Every fragment but the packet's last is exactly DATAGRAM_SEGMENT bytes, so USO
+            // splits the batch back into the same datagrams
+            if (IsSendOffloaded() && !SendBuffers(0, buffers)) return false;
+            sentDatagrams += fragments;
+        }
+        return true;
+    }
+
+    // Waits up to timeoutMs for the first datagram, then takes whatever else is already
+    // queued (up to maxViews). Views stay valid until the next call. Returns the count,
+    // 0 on timeout, -1 on a socket error.
+    int Receive(DatagramView* views, int maxViews, int timeoutMs) {
+        if (sock == INVALID_SOCKET) return -1;
+        fd_set readSet;
+        FD_ZERO(&readSet);
+        FD_SET(sock, &readSet);
+        timeval timeout = { timeoutMs / 1000, (timeoutMs % 1000) * 1000 };
+        int ready = select((int)sock + 1, &readSet, nullptr, nullptr, &timeout);
+        if (ready < 0) return -1;
+        if (ready == 0) return 0;
+
+        int count = 0;
+        size_t used = 0;
+        while (count < maxViews) {
+            size_t room = recvBuffer.size() - used;
+            uint8_t* dst = recvBuffer.data() + used;
+            int segment = 0;
+            int received;
+            if (IsReceiveCoalesced()) {
+                if (room < DATAGRAM_COALESCED_MAX) break;
+                received = ReceiveCoalesced(dst, DATAGRAM_COALESCED_MAX, segment);
+            } else {
+                if (room < (size_t)DATAGRAM_SEGMENT) break;
+                received = recv(sock, (char*)dst, DATAGRAM_SEGMENT, 0);
+            }
+            if (received == SOCKET_ERROR) {
+                int error = WSAGetLastError();
+                if (error == WSAEWOULDBLOCK) break;
+                if (error == WSAEMSGSIZE || error == WSAECONNRESET) continue; // Oversized / ICMP unreachable: skip
+                return count > 0 ? count : -1;
+            }
+            if (segment <= 0) segment = received;
+            for (int pos = 0; pos < received && count < maxViews; pos += segment) {
+                views[count].data = dst + pos;
+                views[count].size = (size_t)(received - pos < segment ? received - pos : segment);
+                count++;
+            }
+            used += received;
+        }
+        receivedDatagrams += count;
+        return count;
+    }
+
+    uint64_t GetSentDatagrams() const { return sentDatagrams; }
+    uint64_t GetReceivedDatagrams() const { return receivedDatagrams; }
+
+private:
+    SOCKET sock = INVALID_SOCKET;
+    bool sendOffload = false;
+    bool receiveCoalescing = false;
+    bool batching = true;
+    LPFN_WSARECVMSG recvMsg = nullptr;
+    uint32_t nextPacketId = 0;
+    uint64_t sentDatagrams = 0;
+    uint64_t receivedDatagrams = 0;
+
+    FragmentHeader fragmentHeaders[DATAGRAM_BATCH_SEGMENTS];
+    WSABUF sendBuffers[DATAGRAM_BATCH_SEGMENTS * 3]; // Fragment header, packet header part, payload part
+    std::vector<uint8_t> recvBuffer;
+
+    void AddBuffer(int& buffers, const void* data, size_t size) {
+        sendBuffers[buffers].buf = (CHAR*)data;
+        sendBuffers[buffers].len = (ULONG)size;
+        buffers++;
+    }
+
+    bool SendBuffers(int first, int count) {
+        WSAMSG msg = {};
+        msg.lpBuffers = sendBuffers + first;
+        msg.dwBufferCount = (DWORD)count;
+        DWORD sent = 0;
+        while (WSASendMsg(sock, &msg, 0, &sent, nullptr, nullptr) == SOCKET_ERROR) {
+            if (WSAGetLastError() != WSAEWOULDBLOCK) return false;
+            // Send buffer full: wait for room rather than dropping fragments
+            fd_set writeSet;
+            FD_ZERO(&writeSet);
+            FD_SET(sock, &writeSet);
+            timeval timeout = { 0, 100000 };
+            if (select((int)sock + 1, nullptr, &writeSet, nullptr, &timeout) < 0) return false;
+        }
+        return true;
+    }
+
+    // One WSARecvMsg; `segment` gets the coalesced datagram size (0 if not coalesced)
+    int ReceiveCoalesced(uint8_t* dst, size_t size, int& segment) {
+        WSABUF data = { (ULONG)size, (CHAR*)dst };
+        char control[WSA_CMSG_SPACE(sizeof(DWORD))] = {};
+        WSAMSG msg = {};
+        msg.lpBuffers = &data;
+        msg.dwBufferCount = 1;
+        msg.Control.buf = control;
+        msg.Control.len = sizeof(control);
+        DWORD received = 0;
+        if (recvMsg(sock, &msg, &received, nullptr, nullptr) == SOCKET_ERROR) return SOCKET_ERROR;
+        segment = 0;
+        for (WSACMSGHDR* cmsg = WSA_CMSG_FIRSTHDR(&msg); cmsg; cmsg = WSA_CMSG_NXTHDR(&msg, cmsg)) {
+            if (cmsg->cmsg_level == IPPROTO_UDP && cmsg->cmsg_type == UDP_COALESCED_INFO) {
+                segment = (int)*(DWORD*)WSA_CMSG_DATA(cmsg);
+            }
+        }
+        return (int)received;
+    }
+};
+
+struct ReassemblyStats {
+    uint64_t completed = 0;
+    uint64_t dropped = 0;   // Evicted incomplete (a fragment was lost)
+    uint64_t lost = 0;      // Skipped without completing: sequence gaps, including the dropped ones
+    uint64_t malformed = 0; // Bad fragment header or inconsistent sizes
+};
+
+// Rebuilds framed packets from fragments in any order. The payload lands directly in a
+// pooled PacketBuffer (one copy, out of the receive buffer), with the PacketHeader fields
+// filled in. At most DATAGRAM_REASSEMBLY_SLOTS packets are open; starting another drops
+// the oldest incomplete one, and so does completing a packet more than
+// DATAGRAM_REORDER_WINDOW ids newer. Newer incomplete packets keep waiting.
+class DatagramReassembler {
+public:
+    explicit DatagramReassembler(PacketPool& pool) : pool(pool) { completedAhead.reserve(DATAGRAM_REORDER_WINDOW + 1); }
+
+    // Returns true when `datagram` completed a packet
+    bool Push(const uint8_t* datagram, size_t size, PacketHeader& outHeader, PacketRef& outPacket) {
+        if (size < sizeof(FragmentHeader)) return Malformed();
+        FragmentHeader fragment;
+        memcpy(&fragment, datagram, sizeof(fragment));
+        uint32_t packetId = ntohl(fragment.packetId);
+        uint16_t index = ntohs(fragment.index);
+        uint16_t count = ntohs(fragment.count);
+        const uint8_t* payload = datagram + sizeof(fragment);
+        size_t payloadSize = size - sizeof(fragment);
+        if (count == 0 || count > DATAGRAM_MAX_FRAGMENTS || index >= count || payloadSize > DATAGRAM_PAYLOAD ||
+            (index + 1 < count && payloadSize != DATAGRAM_PAYLOAD)) {
+            return Malformed();
+        }
+        if (hasFloor && (int32_t)(packetId - floorId) < 0) return false; // Late fragment of a finished packet
+
+        Slot* slot = FindSlot(packetId, count);
+        if (!slot) return false; // Already completed, or older than every open packet and no room
+        if (slot->count != count) return Malformed();
+        if (slot->seen[index]) return false; // Duplicate
+        slot->seen[index] = 1;
+        slot->received++;
+
+        // Fragment 0 starts with the PacketHeader; the payload buffer holds only the body
+        size_t offset = (size_t)index * DATAGRAM_PAYLOAD;
+        if (offset < sizeof(PacketHeader)) {
+            size_t headerPart = payloadSize < sizeof(PacketHeader) - offset ? payloadSize : sizeof(PacketHeader) - offset;
+            memcpy((uint8_t*)&slot->header + offset, payload, headerPart);
+            payload += headerPart;
+            payloadSize -= headerPart;
+            offset += headerPart;
+        }
+        if (payloadSize > 0) memcpy(slot->packet->data.data() + offset - sizeof(PacketHeader), payload, payloadSize);
+        if (index + 1 == count) slot->totalSize = offset + payloadSize;
+
+        if (slot->received < count) return false;
+
+        PacketHeader header = slot->header;
+        DecodePacketHeader(header);
+        if (slot->totalSize != sizeof(PacketHeader) + header.payloadSize) {
+            Release(*slot);
+            return Malformed();
+        }
+        PacketRef packet = std::move(slot->packet);
+        packet->size = header.payloadSize;
+        packet->packetType = header.packetType;
+        packet->frameId = header.frameId;
+        packet->frameType = header.frameType;
+        packet->cursorX = header.cursorX;
+        packet->cursorY = header.cursorY;
+        Release(*slot);
+        completedAhead.push_back(packetId);
+        if (OldestOpen(packetId)) Advance(packetId + 1);
+        for (Slot* oldest; (oldest = OldestSlot()) && (int32_t)(packetId - oldest->packetId) > DATAGRAM_REORDER_WINDOW;) {
+            Evict(*oldest);
+        }
+        stats.completed++;
+        outHeader = header;
+        outPacket = std::move(packet);
+        return true;
+    }
+
+    // Drops every open packet (e.g. on a stream restart)
+    void Reset() {
+        for (Slot& slot : slots) Release(slot);
+        completedAhead.clear();
+        hasFloor = false;
+    }
+
+    const ReassemblyStats& GetStats() const { return stats; }
+
+private:
+    struct Slot {
+        bool active = false;
+        uint32_t packetId = 0;
+        uint16_t count = 0;
+        uint16_t received = 0;
+        size_t totalSize = 0;
+        PacketHeader header = {};
+        std::vector<uint8_t> seen; // Capacity kept between packets
+        PacketRef packet;
+    };
+
+    PacketPool& pool;
+    Slot slots[DATAGRAM_REASSEMBLY_SLOTS];
+    bool hasFloor = false;
+    uint32_t floorId = 0; // Fragments of packets before this one are ignored
+    std::vector<uint32_t> completedAhead; // Completed at or past the floor, while an older one is open
+    ReassemblyStats stats;
+
+    bool Malformed() {
+        stats.malformed++;
+        return false;
+    }
+
+    Slot* FindSlot(uint32_t packetId, uint16_t count) {
+        Slot* freeSlot = nullptr;
+        for (Slot& slot : slots) {
+            if (slot.active && slot.packetId == packetId) return &slot;
+            if (!slot.active) freeSlot = &slot;
+        }
+        if (CompletedAhead(packetId)) return nullptr; // Late duplicate while an older packet is open
+        if (!freeSlot) {
+            Slot* oldest = OldestSlot();
+            if ((int32_t)(packetId - oldest->packetId) < 0) return nullptr;
+            Evict(*oldest);
+            freeSlot = oldest;
+        }
+        freeSlot->active = true;
+        freeSlot->packetId = packetId;
+        freeSlot->count = count;
+        freeSlot->received = 0;
+        freeSlot->totalSize = 0;
+        freeSlot->seen.assign(count, 0);
+        freeSlot->packet = pool.Acquire(nullptr, (size_t)count * DATAGRAM_PAYLOAD);
+        return freeSlot;
+    }
+
+    Slot* OldestSlot() {
+        Slot* oldest = nullptr;
+        for (Slot& slot : slots) {
+            if (slot.active && (!oldest || (int32_t)(slot.packetId - oldest->packetId) < 0)) oldest = &slot;
+        }
+        return oldest;
+    }
+
+    // Gives up on an incomplete packet; it must be the oldest open one
+    void Evict(Slot& slot) {
+        stats.dropped++;
+        Advance(slot.packetId + 1);
+        Release(slot);
+    }
+
+    bool CompletedAhead(uint32_t packetId) const {
+        for (uint32_t id : completedAhead) {
+            if (id == packetId) return true;
+        }
+        return false;
+    }
+
+    bool OldestOpen(uint32_t packetId) const {
+        for (const Slot& slot : slots) {
+            if (slot.active && (int32_t)(slot.packetId - packetId) < 0) return false;
+        }
+        return true;
+    }
+
+    // Moves the floor up to `id`, then past the completed packets right behind it; every
+    // packet skipped on the way that never completed is lost
+    void Advance(uint32_t id) {
+        if (hasFloor && (int32_t)(id - floorId) <= 0) return;
+        uint32_t skipped = hasFloor ? id - floorId : 0; // Unknown before the first packet
+        for (size_t i = 0; i < completedAhead.size();) {
+            if ((int32_t)(completedAhead[i] - id) < 0) {
+                if (skipped > 0) skipped--;
+                completedAhead[i] = completedAhead.back();
+                completedAhead.pop_back();
+            } else {
+                i++;
+            }
+        }
+        stats.lost += skipped;
+        floorId = id;
+        hasFloor = true;
+        for (size_t i = 0; i < completedAhead.size();) {
+            if (completedAhead[i] != floorId) {
+                i++;
+                continue;
+            }
+            completedAhead[i] = completedAhead.back();
+            completedAhead.pop_back();
+            floorId++;
+            i = 0;
+        }
+    }
+
+    void Release(Slot& slot) {
+        slot.active = false;
+        slot.packet.Reset();
+    }
+};
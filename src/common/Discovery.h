@@ -0,0 +1,343 @@
+#pragma once
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <cstdint>
+#include <cstring>
+
+// Host discovery and connection setup.
+//
+// Query/response instead of periodic announcements: the client broadcasts a query (and
+// repeats it every DISCOVERY_QUERY_INTERVAL_MS until something answers), and every host
+// that is waiting for a receiver answers at once, unicast, with a beacon describing
+// itself. A client therefore finds a host within one LAN round trip rather than waiting
+// up to a second for the next announcement.
+//
+// StreamConnector is the client side as a non-blocking state machine (discover ->
+// connect -> connected/failed) that is polled from the UI loop.
+
+#define DISCOVERY_MAGIC 0x5A434453        // "ZCDS"
+#define DISCOVERY_VERSION 1
+#define DISCOVERY_QUERY_INTERVAL_MS 25    // Query resend while no host has answered
+#define DISCOVERY_TIMEOUT_MS 2000
+#define CONNECT_TIMEOUT_MS 2000
+
+#define DISCOVERY_MSG_QUERY 1
+#define DISCOVERY_MSG_BEACON 2
+
+// Beacon capability flags
+#define DISCOVERY_CAP_AUDIO 0x1           // Streams audio next to the video
+#define DISCOVERY_CAP_REPLAY 0x2          // Serving a recording (--replay-host), not a live desktop
+
+#define DISCOVERY_CODEC_H264 0x48323634   // "H264"
+
+// Query and beacon share one layout, network byte order. A query only fills the first
+// four fields; a beacon echoes the query's nonce so answers to an older query are ignored.
+struct DiscoveryMessage {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t message;      // DISCOVERY_MSG_*
+    uint32_t nonce;
+    uint16_t streamPort;   // TCP port the host accepts the stream connection on
+    uint16_t capabilities; // DISCOVERY_CAP_*
+    uint16_t width;        // Capture size
+    uint16_t height;
+    uint32_t codec;        // DISCOVERY_CODEC_*
+    char name[32];         // Host name, NUL-terminated
+};
+
+inline void EncodeDiscoveryMessage(DiscoveryMessage& msg) {
+    msg.magic        = htonl(msg.magic);
+    msg.version      = htons(msg.version);
+    msg.message      = htons(msg.message);
+    msg.nonce        = htonl(msg.nonce);
+    msg.streamPort   = htons(msg.streamPort);
+    msg.capabilities = htons(msg.capabilities);
+    msg.width        = htons(msg.width);
+    msg.height       = htons(msg.height);
+    msg.codec        = htonl(msg.codec);
+}
+
+inline bool DecodeDiscoveryMessage(DiscoveryMessage& msg, int size) {
+    if (size != (int)sizeof(DiscoveryMessage)) return false;
+    msg.magic        = ntohl(msg.magic);
+    msg.version      = ntohs(msg.version);
+    msg.message      = ntohs(msg.message);
+    msg.nonce        = ntohl(msg.nonce);
+    msg.streamPort   = ntohs(msg.streamPort);
+    msg.capabilities = ntohs(msg.capabilities);
+    msg.width        = ntohs(msg.width);
+    msg.height       = ntohs(msg.height);
+    msg.codec        = ntohl(msg.codec);
+    msg.name[sizeof(msg.name) - 1] = 0;
+    return msg.magic == DISCOVERY_MAGIC && msg.version == DISCOVERY_VERSION;
+}
+
+// Host side: answers queries on the discovery port from its own thread until Stop
+class DiscoveryResponder {
+public:
+    ~DiscoveryResponder() { Stop(); }
+
+    // `beacon` describes this host; magic, version, message and nonce are filled in here
+    bool Start(uint16_t discoveryPort, const DiscoveryMessage& beacon) {
+        Stop();
+        sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        if (sock == INVALID_SOCKET) return false;
+        // Several hosts on one machine (e.g. a replay host next to a live one) all answer
+        BOOL reuse = TRUE;
+        setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = INADDR_ANY;
+        addr.sin_port = htons(discoveryPort);
+        if (bind(sock, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR) {
+            std::cerr << "[Discovery] Cannot bind port " << discoveryPort << " (" << WSAGetLastError() << ")" << std::endl;
+            closesocket(sock);
+            sock = INVALID_SOCKET;
+            return false;
+        }
+        this->beacon = beacon;
+        this->beacon.magic = DISCOVERY_MAGIC;
+        this->beacon.version = DISCOVERY_VERSION;
+        this->beacon.message = DISCOVERY_MSG_BEACON;
+        running = true;
+        thread = std::thread(&DiscoveryResponder::Run, this);
+        std::cout << "[Discovery] Answering queries on port " << discoveryPort << std::endl;
+        return true;
+    }
+
+    void Stop() {
+        running = false;
+        if (sock != INVALID_SOCKET) closesocket(sock); // Unblocks the select
+        if (thread.joinable()) thread.join();
+        sock = INVALID_SOCKET;
+    }
+
+    uint64_t GetAnswered() const { return answered; }
+
+private:
+    SOCKET sock = INVALID_SOCKET;
+    DiscoveryMessage beacon = {};
+    std::atomic<bool> running = false;
+    std::atomic<uint64_t> answered = 0;
+    std::thread thread;
+
+    void Run() {
+        while (running) {
+            fd_set readSet;
+            FD_ZERO(&readSet);
+            FD_SET(sock, &readSet);
+            timeval timeout = { 0, 100 * 1000 }; // Rechecks `running`
+            if (select(0, &readSet, nullptr, nullptr, &timeout) <= 0) continue;
+
+            DiscoveryMessage query;
+            sockaddr_in from = {};
+            int fromLen = sizeof(from);
+            int len = recvfrom(sock, (char*)&query, sizeof(query), 0, (sockaddr*)&from, &fromLen);
+            if (len <= 0 || !DecodeDiscoveryMessage(query, len) || query.message != DISCOVERY_MSG_QUERY) continue;
+
+            DiscoveryMessage reply = beacon;
+            reply.nonce = query.nonce;
+            EncodeDiscoveryMessage(reply);
+            sendto(sock, (const char*)&reply, sizeof(reply), 0, (sockaddr*)&from, fromLen);
+            answered++;
+        }
+    }
+};
+
+enum class ConnectState {
+    Idle,
+    Discovering, // Query sent, waiting for a beacon
+    Connecting,  // Non-blocking TCP connect in progress
+    Connected,   // TakeSocket hands the stream socket over
+    Failed       // See GetError
+};
+
+// Client side. Begin, then Poll from one thread until Connected or Failed; nothing in
+// here blocks for longer than the wait passed to Poll.
+class StreamConnector {
+public:
+    ~StreamConnector() { Cancel(); }
+
+    bool Begin(uint16_t discoveryPort) {
+        Cancel();
+        udpSock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        if (udpSock == INVALID_SOCKET) return Fail("no UDP socket");
+        BOOL broadcast = TRUE;
+        setsockopt(udpSock, SOL_SOCKET, SO_BROADCAST, (const char*)&broadcast, sizeof(broadcast));
+        sockaddr_in local = {};
+        local.sin_family = AF_INET;
+        local.sin_addr.s_addr = INADDR_ANY;
+        local.sin_port = 0; // Answers come back unicast to whatever port we got
+        if (bind(udpSock, (sockaddr*)&local, sizeof(local)) == SOCKET_ERROR) return Fail("cannot bind discovery socket");
+        u_long nonBlocking = 1;
+        ioctlsocket(udpSock, FIONBIO, &nonBlocking);
+
+        this->discoveryPort = discoveryPort;
+        nonce = std::random_device()();
+        start = std::chrono::steady_clock::now();
+        state = ConnectState::Discovering;
+        SendQuery();
+        return true;
+    }
+
+    // Advances the state machine, waiting up to waitMs for the socket it is blocked on
+    ConnectState Poll(int waitMs = 0) {
+        if (state == ConnectState::Discovering) PollDiscovery(waitMs);
+        else if (state == ConnectState::Connecting) PollConnect(waitMs);
+        return state;
+    }
+
+    // The connected stream socket (blocking, Nagle off, Registered I/O capable); back to Idle
+    int TakeSocket() {
+        SOCKET s = tcpSock;
+        tcpSock = INVALID_SOCKET;
+        state = ConnectState::Idle;
+        return (int)s;
+    }
+
+    void Cancel() {
+        if (udpSock != INVALID_SOCKET) closesocket(udpSock);
+        if (tcpSock != INVALID_SOCKET) closesocket(tcpSock);
+        udpSock = INVALID_SOCKET;
+        tcpSock = INVALID_SOCKET;
+        state = ConnectState::Idle;
+    }
+
+    ConnectState GetState() const { return state; }
+    const char* GetError() const { return error; }
+    const DiscoveryMessage& GetHost() const { return host; }  // Valid from Connecting on
+    const sockaddr_in& GetHostAddress() const { return hostAddr; }
+    std::chrono::steady_clock::duration GetDiscoveryTime() const { return discovered - start; }
+    std::chrono::steady_clock::duration GetElapsed() const { return std::chrono::steady_clock::now() - start; }
+
+private:
+    ConnectState state = ConnectState::Idle;
+    SOCKET udpSock = INVALID_SOCKET;
+    SOCKET tcpSock = INVALID_SOCKET;
+    uint16_t discoveryPort = 0;
+    uint32_t nonce = 0;
+    DiscoveryMessage host = {};
+    sockaddr_in hostAddr = {};
+    const char* error = "";
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::time_point lastQuery;
+    std::chrono::steady_clock::time_point discovered;
+
+    bool Fail(const char* reason) {
+        std::cerr << "[Discovery] Connect failed: " << reason << std::endl;
+        Cancel();
+        error = reason;
+        state = ConnectState::Failed;
+        return false;
+    }
+
+    static int ElapsedMs(std::chrono::steady_clock::time_point since) {
+        return (int)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - since).count();
+    }
+
+    void SendQuery() {
+        DiscoveryMessage query = {};
+        query.magic = DISCOVERY_MAGIC;
+        query.version = DISCOVERY_VERSION;
+        query.message = DISCOVERY_MSG_QUERY;
+        query.nonce = nonce;
+        EncodeDiscoveryMessage(query);
+        sockaddr_in to = {};
+        to.sin_family = AF_INET;
+        to.sin_port = htons(discoveryPort);
+        // Broadcast for the LAN, loopback for a host on this machine
+        for (u_long target : { (u_long)INADDR_BROADCAST, (u_long)INADDR_LOOPBACK }) {
+            to.sin_addr.s_addr = htonl(target);
+            sendto(udpSock, (const char*)&query, sizeof(query), 0, (sockaddr*)&to, sizeof(to));
+        }
+        lastQuery = std::chrono::steady_clock::now();
+    }
+
+    static bool WaitFor(SOCKET s, bool write, int waitMs, fd_set* errorSet = nullptr) {
+        fd_set set;
+        FD_ZERO(&set);
+        FD_SET(s, &set);
+        if (errorSet) {
+            FD_ZERO(errorSet);
+            FD_SET(s, errorSet);
+        }
+        timeval timeout = { waitMs / 1000, (waitMs % 1000) * 1000 };
+        return select(0, write ? nullptr : &set, write ? &set : nullptr, errorSet, &timeout) > 0;
+    }
+
+    void PollDiscovery(int waitMs) {
+        int untilQuery = DISCOVERY_QUERY_INTERVAL_MS - ElapsedMs(lastQuery);
+        WaitFor(udpSock, false, waitMs < untilQuery ? waitMs : (untilQuery > 0 ? untilQuery : 0));
+        while (true) {
+            DiscoveryMessage beacon;
+            sockaddr_in from = {};
+            int fromLen = sizeof(from);
+            int len = recvfrom(udpSock, (char*)&beacon, sizeof(beacon), 0, (sockaddr*)&from, &fromLen);
+            if (len <= 0) break; // WSAEWOULDBLOCK: nothing (more) queued
+            if (!DecodeDiscoveryMessage(beacon, len) || beacon.message != DISCOVERY_MSG_BEACON || beacon.nonce != nonce) continue;
+            // First host to answer wins; it is also the closest one
+            host = beacon;
+            hostAddr = from;
+            hostAddr.sin_port = htons(beacon.streamPort);
+            discovered = std::chrono::steady_clock::now();
+            closesocket(udpSock);
+            udpSock = INVALID_SOCKET;
+            char ip[INET_ADDRSTRLEN] = {};
+            inet_ntop(AF_INET, &hostAddr.sin_addr, ip, sizeof(ip));
+            std::cout << "[Discovery] Found '" << host.name << "' at " << ip << ":" << host.streamPort << " ("
+                      << host.width << "x" << host.height << ") after "
+                      << std::chrono::duration<double, std::milli>(GetDiscoveryTime()).count() << " ms" << std::endl;
+            StartConnect();
+            return;
+        }
+        if (ElapsedMs(start) >= DISCOVERY_TIMEOUT_MS) {
+            Fail("no host answered");
+            return;
+        }
+        if (ElapsedMs(lastQuery) >= DISCOVERY_QUERY_INTERVAL_MS) SendQuery();
+    }
+
+    void StartConnect() {
+        // Registered I/O capable, for StreamReceiver; plain send/recv work on it as usual
+        tcpSock = WSASocketW(AF_INET, SOCK_STREAM, IPPROTO_TCP, nullptr, 0, WSA_FLAG_OVERLAPPED | WSA_FLAG_REGISTERED_IO);
+        if (tcpSock == INVALID_SOCKET) {
+            Fail("no TCP socket");
+            return;
+        }
+        BOOL nodelay = TRUE;
+        setsockopt(tcpSock, IPPROTO_TCP, TCP_NODELAY, (const char*)&nodelay, sizeof(nodelay));
+        u_long nonBlocking = 1;
+        ioctlsocket(tcpSock, FIONBIO, &nonBlocking);
+        if (connect(tcpSock, (sockaddr*)&hostAddr, sizeof(hostAddr)) == SOCKET_ERROR && WSAGetLastError() != WSAEWOULDBLOCK) {
+            Fail("connect refused");
+            return;
+        }
+        state = ConnectState::Connecting;
+    }
+
+    void PollConnect(int waitMs) {
+        // Windows reports a failed non-blocking connect in the except set, not the write set
+        fd_set errorSet;
+        if (WaitFor(tcpSock, true, waitMs, &errorSet)) {
+            int soError = 0;
+            int len = sizeof(soError);
+            getsockopt(tcpSock, SOL_SOCKET, SO_ERROR, (char*)&soError, &len);
+            if (soError != 0 || FD_ISSET(tcpSock, &errorSet)) {
+                Fail("connect refused");
+                return;
+            }
+            u_long nonBlocking = 0; // The stream code expects blocking sends and receives
+            ioctlsocket(tcpSock, FIONBIO, &nonBlocking);
+            state = ConnectState::Connected;
+            std::cout << "[Discovery] Connected after " << std::chrono::duration<double, std::milli>(GetElapsed()).count()
+                      << " ms" << std::endl;
+            return;
+        }
+        if (ElapsedMs(discovered) >= CONNECT_TIMEOUT_MS) Fail("connect timed out");
+    }
+};
@@ -0,0 +1,108 @@
+#pragma once
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <cstddef>
+
+#define FRAME_RING_DEFAULT_SLOTS 3 // One frame in each of capture, convert and encode
+
+// Bounded ring of frame slots handed through a fixed chain of pipeline stages
+// (stage 0 produces, the last stage hands the slot back to stage 0). Every slot is owned
+// by exactly one stage at a time and each stage sees slots in production order, so
+// frames can't be reordered or skipped between stages. One thread per stage.
+//
+// Backpressure: the producer either blocks in Acquire(0) or, if it must not stall
+// (e.g. while holding a DXGI frame), drops the frame when TryAcquire(0) returns null.
+// Slot is the backend payload (GPU textures + fences, or plain CPU buffers in tests).
+template <typename Slot, int StageCount>
+class FrameRing {
+public:
+    static_assert(StageCount >= 2, "A ring needs a producer and at least one consumer stage");
+
+    explicit FrameRing(size_t capacity = FRAME_RING_DEFAULT_SLOTS) : slots(capacity), states(capacity) {}
+    FrameRing(const FrameRing&) = delete;
+    FrameRing& operator=(const FrameRing&) = delete;
+
+    size_t Capacity() const { return slots.size(); }
+    Slot& At(size_t index) { return slots[index]; }
+
+    // Next slot for `stage`, blocking until the previous stage has released it.
+    // Returns nullptr once the ring is stopped.
+    Slot* Acquire(int stage) {
+        std::unique_lock<std::mutex> guard(lock);
+        cv.wait(guard, [&]() { return stopped || IsReady(stage); });
+        if (stopped) return nullptr;
+        return Take(stage);
+    }
+
+    // Non-blocking Acquire: nullptr when the next slot isn't ready (or the ring is stopped)
+    Slot* TryAcquire(int stage) {
+        std::lock_guard<std::mutex> guard(lock);
+        if (stopped || !IsReady(stage)) return nullptr;
+        return Take(stage);
+    }
+
+    // Hands the slot to the next stage (the last stage frees it for the producer)
+    void Release(int stage, Slot* slot) {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            State& state = states[IndexOf(slot)];
+            state.held = false;
+            state.owner = (stage + 1) % StageCount;
+            if (state.owner == 0) inFlight--;
+        }
+        cv.notify_all();
+    }
+
+    // Wakes every waiting stage; Acquire returns nullptr until Reset
+    void Stop() {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopped = true;
+        }
+        cv.notify_all();
+    }
+
+    // Frees every slot (no stage may hold one) and reopens the ring
+    void Reset() {
+        std::lock_guard<std::mutex> guard(lock);
+        for (State& state : states) state = State();
+        for (size_t& cursor : cursors) cursor = 0;
+        inFlight = 0;
+        stopped = false;
+    }
+
+    // Slots produced but not yet released by the last stage
+    size_t GetDepth() {
+        std::lock_guard<std::mutex> guard(lock);
+        return inFlight;
+    }
+
+    size_t IndexOf(const Slot* slot) const { return (size_t)(slot - slots.data()); }
+
+private:
+    struct State {
+        int owner = 0;     // Stage the slot is waiting for (or being worked on by)
+        bool held = false; // Acquired and not yet released
+    };
+    std::vector<Slot> slots;
+    std::vector<State> states;
+    size_t cursors[StageCount] = {}; // Next slot index per stage, always in production order
+    size_t inFlight = 0;
+    bool stopped = false;
+    std::mutex lock;
+    std::condition_variable cv;
+
+    bool IsReady(int stage) const {
+        const State& state = states[cursors[stage]];
+        return state.owner == stage && !state.held;
+    }
+
+    Slot* Take(int stage) {
+        size_t index = cursors[stage];
+        states[index].held = true;
+        cursors[stage] = (index + 1) % slots.size();
+        if (stage == 0) inFlight++;
+        return &slots[index];
+    }
+};
@@ -0,0 +1,28 @@
+#pragma once
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+// Non-owning reference to a callable, for callbacks invoked only while the call they
+// are passed to is running (e.g. the per-frame encoder output callback). Unlike
+// std::function it never allocates, whatever the lambda captures; the referenced
+// callable must outlive the FunctionRef, so never store one.
+template <typename Signature>
+class FunctionRef;
+
+template <typename R, typename... Args>
+class FunctionRef<R(Args...)> {
+public:
+    template <typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, FunctionRef>>>
+    FunctionRef(F&& callable)
+        : object((void*)std::addressof(callable)),
+          invoke([](void* object, Args... args) -> R {
+              return (*(std::remove_reference_t<F>*)object)(std::forward<Args>(args)...);
+          }) {}
+
+    R operator()(Args... args) const { return invoke(object, std::forward<Args>(args)...); }
+
+private:
+    void* object;
+    R (*invoke)(void*, Args...);
+};
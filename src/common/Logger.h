@@ -0,0 +1,255 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdarg>
+#include <cstring>
+
+// Asynchronous logger for real-time paths.
+// LOG_* formats into a slot of a bounded lock-free MPSC ring and returns; a
+// background thread batches the lines out to stdout/stderr. A full ring drops
+// the message (counted) rather than blocking the caller.
+//
+//   LOG_INFO("Decoder", "%d frames decoded", frameCount);
+//   LOG_WARN_RATE("Capturer", 1, "AcquireNextFrame failed: 0x%08X", hr); // At most 1/s from this line
+//
+// Levels below LOG_MIN_LEVEL compile to nothing. Each call site is limited to
+// LOG_DEFAULT_RATE lines per second unless it uses a *_RATE variant; suppressed
+// lines are reported on the next line that gets through.
+
+#define LOG_LEVEL_TRACE 0
+#define LOG_LEVEL_DEBUG 1
+#define LOG_LEVEL_INFO  2
+#define LOG_LEVEL_WARN  3
+#define LOG_LEVEL_ERROR 4
+
+#ifndef LOG_MIN_LEVEL
+#ifdef NDEBUG
+#define LOG_MIN_LEVEL LOG_LEVEL_INFO
+#else
+#define LOG_MIN_LEVEL LOG_LEVEL_DEBUG
+#endif
+#endif
+
+#define LOG_RING_SIZE 1024       // Slots, power of two
+#define LOG_MESSAGE_SIZE 240
+#define LOG_DEFAULT_RATE 20      // Lines per second per call site
+
+struct LogRecord {
+    std::atomic<uint64_t> sequence;
+    uint64_t timeNs;
+    uint32_t threadId;
+    uint32_t suppressed;
+    int level;
+    const char* tag;
+    char message[LOG_MESSAGE_SIZE];
+};
+
+// Per call-site limiter: fixed one-second windows, lock-free
+class LogRateLimit {
+public:
+    explicit LogRateLimit(uint32_t perSecond) : perSecond(perSecond) {}
+
+    // Returns true if the line may be logged; suppressedOut gets the count dropped since the last pass
+    bool Allow(uint64_t nowNs, uint32_t& suppressedOut) {
+        uint64_t window = nowNs / 1000000000ull;
+        uint64_t current = windowStart.load(std::memory_order_relaxed);
+        if (window != current && windowStart.compare_exchange_strong(current, window, std::memory_order_relaxed)) {
+            count.store(0, std::memory_order_relaxed);
+        }
+        if (count.fetch_add(1, std::memory_order_relaxed) >= perSecond) {
+            suppressed.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        suppressedOut = suppressed.exchange(0, std::memory_order_relaxed);
+        return true;
+    }
+
+private:
+    uint32_t perSecond;
+    std::atomic<uint64_t> windowStart = 0;
+    std::atomic<uint32_t> count = 0;
+    std::atomic<uint32_t> suppressed = 0;
+};
+
+class Logger {
+public:
+    static Logger& Get() {
+        static Logger instance;
+        return instance;
+    }
+
+    static uint64_t NowNs() {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void Write(int level, const char* tag, LogRateLimit& limit, const char* format, ...) {
+        uint64_t now = NowNs();
+        uint32_t suppressed = 0;
+        if (!limit.Allow(now, suppressed)) return;
+
+        // Bounded MPMC queue (Vyukov): claim a slot whose sequence matches the position
+        uint64_t pos = head.load(std::memory_order_relaxed);
+        LogRecord* record;
+        while (true) {
+            record = &ring[pos & (LOG_RING_SIZE - 1)];
+            uint64_t seq = record->sequence.load(std::memory_order_acquire);
+            int64_t diff = (int64_t)seq - (int64_t)pos;
+            if (diff == 0) {
+                if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            } else {
+                pos = head.load(std::memory_order_relaxed);
+            }
+        }
+
+        record->timeNs = now;
+        record->threadId = CurrentThreadId();
+        record->suppressed = suppressed;
+        record->level = level;
+        record->tag = tag;
+        va_list args;
+        va_start(args, format);
+        vsnprintf(record->message, LOG_MESSAGE_SIZE, format, args);
+        va_end(args);
+        record->sequence.store(pos + 1, std::memory_order_release);
+
+        if (level >= LOG_LEVEL_ERROR) wake.notify_one();
+    }
+
+    // Blocks until everything logged so far has been written
+    void Flush() {
+        std::unique_lock<std::mutex> guard(flushLock);
+        uint64_t target = head.load(std::memory_order_acquire);
+        wake.notify_one();
+        flushed.wait(guard, [&] { return written >= target || !running; });
+    }
+
+    uint64_t GetDroppedCount() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+    LogRecord ring[LOG_RING_SIZE];
+    std::atomic<uint64_t> head = 0;
+    uint64_t tail = 0;    // Flusher only
+    uint64_t written = 0; // Records fwritten so far; published from tail under flushLock
+    std::atomic<uint64_t> dropped = 0;
+    uint64_t reportedDropped = 0;
+    uint64_t startNs;
+
+    std::thread flusher;
+    std::mutex flushLock;
+    std::condition_variable wake;
+    std::condition_variable flushed;
+    bool running = true;
+
+    Logger() : startNs(NowNs()) {
+        for (uint64_t i = 0; i < LOG_RING_SIZE; i++) ring[i].sequence.store(i, std::memory_order_relaxed);
+        flusher = std::thread(&Logger::FlushLoop, this);
+    }
+
+    ~Logger() {
+        {
+            std::lock_guard<std::mutex> guard(flushLock);
+            running = false;
+        }
+        wake.notify_one();
+        if (flusher.joinable()) flusher.join();
+    }
+
+    static uint32_t CurrentThreadId() {
+        thread_local uint32_t id = (uint32_t)std::hash<std::thread::id>()(std::this_thread::get_id());
+        return id;
+    }
+
+    static char LevelChar(int level) {
+        static const char chars[] = { 'T', 'D', 'I', 'W', 'E' };
+        return (level >= 0 && level <= LOG_LEVEL_ERROR) ? chars[level] : '?';
+    }
+
+    // Formats ready records into one buffer per stream and writes each with a single call
+    bool Drain() {
+        static char out[LOG_RING_SIZE * 64];
+        static char err[LOG_RING_SIZE * 16];
+        size_t outLen = 0;
+        size_t errLen = 0;
+        bool any = false;
+        while (true) {
+            LogRecord& record = ring[tail & (LOG_RING_SIZE - 1)];
+            if (record.sequence.load(std::memory_order_acquire) != tail + 1) break;
+
+            char line[LOG_MESSAGE_SIZE + 96];
+            int n = snprintf(line, sizeof(line), "[%9.3f] %c [%s] %s", (record.timeNs - startNs) / 1e9,
+                             LevelChar(record.level), record.tag, record.message);
+            if (n < 0) n = 0;
+            if (n > (int)sizeof(line) - 1) n = (int)sizeof(line) - 1;
+            if (record.suppressed) n += snprintf(line + n, sizeof(line) - n, " (+%u suppressed)", record.suppressed);
+            if (n > (int)sizeof(line) - 2) n = (int)sizeof(line) - 2;
+            line[n++] = '\n';
+
+            bool toErr = record.level >= LOG_LEVEL_WARN;
+            char* buffer = toErr ? err : out;
+            size_t& len = toErr ? errLen : outLen;
+            size_t capacity = toErr ? sizeof(err) : sizeof(out);
+            if (len + n > capacity) {
+                fwrite(buffer, 1, len, toErr ? stderr : stdout);
+                len = 0;
+            }
+            memcpy(buffer + len, line, n);
+            len += n;
+
+            record.sequence.store(tail + LOG_RING_SIZE, std::memory_order_release);
+            tail++;
+            any = true;
+        }
+        uint64_t lost = dropped.load(std::memory_order_relaxed);
+        if (lost != reportedDropped) {
+            int n = snprintf(err + errLen, sizeof(err) - errLen, "[Logger] %llu messages dropped (ring full)\n",
+                             (unsigned long long)(lost - reportedDropped));
+            if (n > 0) errLen += n;
+            reportedDropped = lost;
+        }
+        if (outLen) { fwrite(out, 1, outLen, stdout); fflush(stdout); }
+        if (errLen) { fwrite(err, 1, errLen, stderr); fflush(stderr); }
+        return any;
+    }
+
+    void FlushLoop() {
+        std::unique_lock<std::mutex> guard(flushLock);
+        while (true) {
+            wake.wait_for(guard, std::chrono::milliseconds(20));
+            bool stop = !running;
+            guard.unlock();
+            Drain();
+            guard.lock();
+            written = tail;
+            flushed.notify_all();
+            if (stop) break;
+        }
+    }
+};
+
+#define LOG_WRITE_RATE(level, rate, tag, ...)                                   \
+    do {                                                                        \
+        if constexpr ((level) >= LOG_MIN_LEVEL) {                               \
+            static LogRateLimit logSiteLimit(rate);                             \
+            Logger::Get().Write(level, tag, logSiteLimit, __VA_ARGS__);         \
+        }                                                                       \
+    } while (0)
+
+#define LOG_TRACE(tag, ...) LOG_WRITE_RATE(LOG_LEVEL_TRACE, LOG_DEFAULT_RATE, tag, __VA_ARGS__)
+#define LOG_DEBUG(tag, ...) LOG_WRITE_RATE(LOG_LEVEL_DEBUG, LOG_DEFAULT_RATE, tag, __VA_ARGS__)
+#define LOG_INFO(tag, ...)  LOG_WRITE_RATE(LOG_LEVEL_INFO, LOG_DEFAULT_RATE, tag, __VA_ARGS__)
+#define LOG_WARN(tag, ...)  LOG_WRITE_RATE(LOG_LEVEL_WARN, LOG_DEFAULT_RATE, tag, __VA_ARGS__)
+#define LOG_ERROR(tag, ...) LOG_WRITE_RATE(LOG_LEVEL_ERROR, LOG_DEFAULT_RATE, tag, __VA_ARGS__)
+
+#define LOG_DEBUG_RATE(tag, rate, ...) LOG_WRITE_RATE(LOG_LEVEL_DEBUG, rate, tag, __VA_ARGS__)
+#define LOG_INFO_RATE(tag, rate, ...)  LOG_WRITE_RATE(LOG_LEVEL_INFO, rate, tag, __VA_ARGS__)
+#define LOG_WARN_RATE(tag, rate, ...)  LOG_WRITE_RATE(LOG_LEVEL_WARN, rate, tag, __VA_ARGS__)
+#define LOG_ERROR_RATE(tag, rate, ...) LOG_WRITE_RATE(LOG_LEVEL_ERROR, rate, tag, __VA_ARGS__)
@@ -0,0 +1,305 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Metrics registry: per-stage latency histograms, counters and gauges.
+// Every thread records into its own cache-line aligned shard with plain
+// relaxed stores (no locked instructions); readers merge all shards on Snapshot().
+
+enum class Stage : int {
+    Capture,  // Desktop present -> frame acquired
+    Convert,  // BGRA -> NV12 submit
+    Encode,   // Encoder call
+    Send,     // Encoder output -> written to the socket (includes queueing)
+    Receive,  // Header + body read
+    Decode,   // Decoder call
+    Present,  // Swap chain present
+    EndToEnd, // Host capture -> client decode, from the in-frame latency probe
+    Connect,    // Join -> stream socket connected (discovery + TCP handshake)
+    FirstFrame, // Join -> first frame decoded (time to first frame)
+    Count
+};
+
+enum class Counter : int {
+    FramesCaptured,
+    FramesEncoded,
+    EncodedBytes,
+    PacketsSent,
+    BytesSent,
+    PacketsReceived,
+    BytesReceived,
+    FramesDecoded,
+    FramesPresented,
+    AudioFramesLost,
+    AudioFramesRecovered, // Rebuilt from RED copies
+    AudioFramesConcealed,
+    CaptureFramesDropped, // Capture pipeline ring full
+    Count
+};
+
+enum class Gauge : int {
+    SendQueueDepth,
+    EncodedFrameBytes,
+    AudioJitterDepth,
+    EncoderQP,           // Average QP of the last frame (NVENC only, 0 = not reported)
+    CaptureRingDepth,    // Frames between capture and the end of encode
+    Count
+};
+
+inline const char* StageName(Stage s) {
+    static const char* names[] = { "capture", "convert", "encode", "send", "receive", "decode", "present", "end_to_end",
+                                   "connect", "first_frame" };
+    return names[(int)s];
+}
+
+inline const char* CounterName(Counter c) {
+    static const char* names[] = { "frames_captured", "frames_encoded", "encoded_bytes", "packets_sent", "bytes_sent",
+                                   "packets_received", "bytes_received", "frames_decoded", "frames_presented",
+                                   "audio_frames_lost", "audio_frames_recovered", "audio_frames_concealed",
+                                   "capture_frames_dropped" };
+    return names[(int)c];
+}
+
+inline const char* GaugeName(Gauge g) {
+    static const char* names[] = { "send_queue_depth", "encoded_frame_bytes", "audio_jitter_depth", "encoder_qp",
+                                   "capture_ring_depth" };
+    return names[(int)g];
+}
+
+#define METRICS_STAGES ((int)Stage::Count)
+#define METRICS_COUNTERS ((int)Counter::Count)
+#define METRICS_GAUGES ((int)Gauge::Count)
+#define METRICS_MAX_SHARDS 32
+// 4 buckets per power of two (max 25% relative error), 0ns .. ~68s
+#define METRICS_BUCKETS 144
+
+// Log-bucketed histogram index for a value in nanoseconds
+inline int MetricsBucket(uint64_t ns) {
+    if (ns < 4) return (int)ns;
+#ifdef _MSC_VER
+    unsigned long msb;
+    _BitScanReverse64(&msb, ns);
+#else
+    int msb = 63 - __builtin_clzll(ns);
+#endif
+    int index = 4 + ((int)msb - 2) * 4 + (int)((ns >> (msb - 2)) & 3);
+    return index < METRICS_BUCKETS ? index : METRICS_BUCKETS - 1;
+}
+
+// Lower bound of a bucket in nanoseconds
+inline uint64_t MetricsBucketFloor(int index) {
+    if (index < 4) return (uint64_t)index;
+    int msb = (index - 4) / 4 + 2;
+    uint64_t sub = (uint64_t)((index - 4) % 4);
+    return (4 + sub) << (msb - 2);
+}
+
+struct alignas(64) MetricsShard {
+    std::atomic<uint64_t> buckets[METRICS_STAGES][METRICS_BUCKETS];
+    std::atomic<uint64_t> count[METRICS_STAGES];
+    std::atomic<uint64_t> sum[METRICS_STAGES];
+    std::atomic<uint64_t> max[METRICS_STAGES];
+    std::atomic<uint64_t> counters[METRICS_COUNTERS];
+    bool shared = false; // Overflow shard, written by several threads
+};
+
+struct StageSummary {
+    uint64_t count = 0;
+    uint64_t sumNs = 0;
+    uint64_t maxNs = 0;
+    uint64_t buckets[METRICS_BUCKETS] = {};
+
+    double MeanUs() const { return count ? sumNs / 1000.0 / count : 0.0; }
+
+    // Percentile (0..100) in microseconds, interpolated inside the bucket
+    double PercentileUs(double p) const {
+        if (count == 0) return 0.0;
+        uint64_t rank = (uint64_t)(p / 100.0 * (count - 1));
+        uint64_t seen = 0;
+        for (int i = 0; i < METRICS_BUCKETS; i++) {
+            if (seen + buckets[i] > rank) {
+                uint64_t lo = MetricsBucketFloor(i);
+                uint64_t hi = i + 1 < METRICS_BUCKETS ? MetricsBucketFloor(i + 1) : lo;
+                double frac = buckets[i] > 1 ? (double)(rank - seen) / (buckets[i] - 1) : 0.5;
+                double ns = lo + (hi - lo) * frac;
+                if (ns > (double)maxNs) ns = (double)maxNs;
+                return ns / 1000.0;
+            }
+            seen += buckets[i];
+        }
+        return maxNs / 1000.0;
+    }
+};
+
+struct MetricsSnapshot {
+    StageSummary stages[METRICS_STAGES];
+    uint64_t counters[METRICS_COUNTERS] = {};
+    int64_t gauges[METRICS_GAUGES] = {};
+    std::chrono::steady_clock::time_point time;
+
+    const StageSummary& Get(Stage s) const { return stages[(int)s]; }
+    uint64_t Get(Counter c) const { return counters[(int)c]; }
+    int64_t Get(Gauge g) const { return gauges[(int)g]; }
+
+    // Activity between an earlier snapshot and this one (max stays cumulative)
+    MetricsSnapshot Since(const MetricsSnapshot& earlier) const {
+        MetricsSnapshot delta = *this;
+        for (int s = 0; s < METRICS_STAGES; s++) {
+            delta.stages[s].count -= earlier.stages[s].count;
+            delta.stages[s].sumNs -= earlier.stages[s].sumNs;
+            for (int b = 0; b < METRICS_BUCKETS; b++) delta.stages[s].buckets[b] -= earlier.stages[s].buckets[b];
+        }
+        for (int c = 0; c < METRICS_COUNTERS; c++) delta.counters[c] -= earlier.counters[c];
+        return delta;
+    }
+
+    std::string ToJson() const {
+        std::string json = "{\"stages\":{";
+        char buf[256];
+        for (int s = 0; s < METRICS_STAGES; s++) {
+            const StageSummary& st = stages[s];
+            snprintf(buf, sizeof(buf),
+                "%s\"%s\":{\"count\":%llu,\"mean_us\":%.2f,\"p50_us\":%.2f,\"p90_us\":%.2f,\"p99_us\":%.2f,\"max_us\":%.2f}",
+                s ? "," : "", StageName((Stage)s), (unsigned long long)st.count, st.MeanUs(),
+                st.PercentileUs(50), st.PercentileUs(90), st.PercentileUs(99), st.maxNs / 1000.0);
+            json += buf;
+        }
+        json += "},\"counters\":{";
+        for (int c = 0; c < METRICS_COUNTERS; c++) {
+            snprintf(buf, sizeof(buf), "%s\"%s\":%llu", c ? "," : "", CounterName((Counter)c), (unsigned long long)counters[c]);
+            json += buf;
+        }
+        json += "},\"gauges\":{";
+        for (int g = 0; g < METRICS_GAUGES; g++) {
+            snprintf(buf, sizeof(buf), "%s\"%s\":%lld", g ? "," : "", GaugeName((Gauge)g), (long long)gauges[g]);
+            json += buf;
+        }
+        json += "}}";
+        return json;
+    }
+};
+
+class Metrics {
+public:
+    static Metrics& Get() {
+        static Metrics instance;
+        return instance;
+    }
+
+    void Record(Stage stage, uint64_t ns) {
+        MetricsShard& shard = LocalShard();
+        int s = (int)stage;
+        if (!shard.shared) {
+            Bump(shard.buckets[s][MetricsBucket(ns)], 1);
+            Bump(shard.count[s], 1);
+            Bump(shard.sum[s], ns);
+            if (ns > shard.max[s].load(std::memory_order_relaxed)) shard.max[s].store(ns, std::memory_order_relaxed);
+        } else {
+            shard.buckets[s][MetricsBucket(ns)].fetch_add(1, std::memory_order_relaxed);
+            shard.count[s].fetch_add(1, std::memory_order_relaxed);
+            shard.sum[s].fetch_add(ns, std::memory_order_relaxed);
+            uint64_t prev = shard.max[s].load(std::memory_order_relaxed);
+            while (ns > prev && !shard.max[s].compare_exchange_weak(prev, ns, std::memory_order_relaxed)) {}
+        }
+    }
+
+    void Record(Stage stage, std::chrono::steady_clock::duration d) {
+        long long ns = std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+        Record(stage, ns > 0 ? (uint64_t)ns : 0);
+    }
+
+    void Add(Counter counter, uint64_t value = 1) {
+        MetricsShard& shard = LocalShard();
+        if (!shard.shared) Bump(shard.counters[(int)counter], value);
+        else shard.counters[(int)counter].fetch_add(value, std::memory_order_relaxed);
+    }
+
+    void Set(Gauge gauge, int64_t value) { gauges[(int)gauge].store(value, std::memory_order_relaxed); }
+
+    MetricsSnapshot Snapshot() const {
+        MetricsSnapshot snap;
+        snap.time = std::chrono::steady_clock::now();
+        uint32_t used = usedShards.load(std::memory_order_acquire);
+        for (int i = 0; i < METRICS_MAX_SHARDS; i++) {
+            if (!(used & (1u << i))) continue; // Never leased, still all zero
+            const MetricsShard& shard = shards[i];
+            for (int s = 0; s < METRICS_STAGES; s++) {
+                StageSummary& st = snap.stages[s];
+                st.count += shard.count[s].load(std::memory_order_relaxed);
+                st.sumNs += shard.sum[s].load(std::memory_order_relaxed);
+                uint64_t m = shard.max[s].load(std::memory_order_relaxed);
+                if (m > st.maxNs) st.maxNs = m;
+                for (int b = 0; b < METRICS_BUCKETS; b++) st.buckets[b] += shard.buckets[s][b].load(std::memory_order_relaxed);
+            }
+            for (int c = 0; c < METRICS_COUNTERS; c++) snap.counters[c] += shard.counters[c].load(std::memory_order_relaxed);
+        }
+        for (int g = 0; g < METRICS_GAUGES; g++) snap.gauges[g] = gauges[g].load(std::memory_order_relaxed);
+        return snap;
+    }
+
+private:
+    Metrics() {
+        memset((void*)shards, 0, sizeof(shards)); // std::atomic<uint64_t> is trivially zeroable
+        shards[METRICS_MAX_SHARDS - 1].shared = true;
+        for (auto& g : gauges) g = 0;
+    }
+
+    MetricsShard shards[METRICS_MAX_SHARDS];
+    std::atomic<uint32_t> freeShards = (1u << (METRICS_MAX_SHARDS - 1)) - 1; // Last shard is the shared one
+    std::atomic<uint32_t> usedShards = 0; // Shards that have ever been leased (Snapshot skips the rest)
+    std::atomic<int64_t> gauges[METRICS_GAUGES];
+
+    // Returns the thread's shard to the free set when the thread exits (its totals are kept)
+    struct ShardLease {
+        Metrics* owner = nullptr;
+        MetricsShard* shard = nullptr;
+        ~ShardLease() {
+            if (shard && !shard->shared) owner->freeShards.fetch_or(1u << (shard - owner->shards), std::memory_order_release);
+        }
+    };
+
+    // Only the owning thread writes an exclusive shard, so a relaxed load + store is enough
+    static void Bump(std::atomic<uint64_t>& value, uint64_t n) {
+        value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    MetricsShard& LocalShard() {
+        thread_local ShardLease lease;
+        if (!lease.shard) {
+            lease.owner = this;
+            lease.shard = &shards[METRICS_MAX_SHARDS - 1];
+            int leased = METRICS_MAX_SHARDS - 1;
+            uint32_t mask = freeShards.load(std::memory_order_relaxed);
+            while (mask) {
+                uint32_t bit = mask & (~mask + 1);
+                if (freeShards.compare_exchange_weak(mask, mask & ~bit, std::memory_order_acquire)) {
+                    int index = 0;
+                    while (!(bit & (1u << index))) index++;
+                    lease.shard = &shards[index];
+                    leased = index;
+                    break;
+                }
+            }
+            usedShards.fetch_or(1u << leased, std::memory_order_release);
+        }
+        return *lease.shard;
+    }
+};
+
+// Records the lifetime of the scope into a stage histogram
+class ScopedStageTimer {
+public:
+    explicit ScopedStageTimer(Stage stage) : stage(stage), start(std::chrono::steady_clock::now()) {}
+    ~ScopedStageTimer() { Metrics::Get().Record(stage, std::chrono::steady_clock::now() - start); }
+
+private:
+    Stage stage;
+    std::chrono::steady_clock::time_point start;
+};
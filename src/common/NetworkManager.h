@@ -6,6 +6,8 @@
 #include <vector>
 #include <thread>
 #include <atomic>
+#include "Tracer.h"
+#include "Discovery.h"
 
 #pragma comment(lib, "ws2_32.lib")
 
@@ -15,14 +17,41 @@
 // Packet Types
 #define PACKET_TYPE_VIDEO 0
 #define PACKET_TYPE_AUDIO 1
+#define PACKET_TYPE_STREAM_INFO 2 // First on a new stream: the encoder's Annex-B SPS/PPS (may be empty)
+#define PACKET_TYPE_CONTROL 3     // ControlMessage (ControlChannel.h), only ever on the TCP connection
+#define PACKET_TYPE_CURSOR 4      // CursorMessage (CursorChannel.h), independent of video frames
+#define PACKET_TYPE_CURSOR_SHAPE 5 // CursorShapeHeader + BGRA pixels, sent once per shape (reliable lane)
 
 struct PacketHeader {
-    uint32_t packetType; // 0=Video, 1=Audio
+    uint32_t packetType; // PACKET_TYPE_*
     uint32_t payloadSize;
     int32_t  cursorX;    // Ignored for Audio
     int32_t  cursorY;    // Ignored for Audio
+    uint32_t frameId;    // Video: capture frame number (ties host and client trace events together)
+    uint32_t frameType;  // Video: FrameType (IDR / reference / non-reference)
 };
 
+// Wire framing: every field travels in network byte order
+inline PacketHeader EncodePacketHeader(uint32_t type, uint32_t size, int x, int y, uint32_t frameId, uint32_t frameType) {
+    PacketHeader header;
+    header.packetType  = htonl(type);
+    header.payloadSize = htonl(size);
+    header.cursorX     = htonl(x);
+    header.cursorY     = htonl(y);
+    header.frameId     = htonl(frameId);
+    header.frameType   = htonl(frameType);
+    return header;
+}
+
+inline void DecodePacketHeader(PacketHeader& header) {
+    header.packetType  = ntohl(header.packetType);
+    header.payloadSize = ntohl(header.payloadSize);
+    header.cursorX     = ntohl(header.cursorX);
+    header.cursorY     = ntohl(header.cursorY);
+    header.frameId     = ntohl(header.frameId);
+    header.frameType   = ntohl(header.frameType);
+}
+
 class NetworkManager {
 public:
     NetworkManager() {
@@ -44,7 +73,9 @@ public:
         return select(0, &readSet, nullptr, nullptr, &timeout) > 0;
     }
 
-    bool WaitForReceiver(int& outClientSocket) {
+    // Accepts one receiver on STREAM_PORT, answering discovery queries while it waits.
+    // `capabilities` (DISCOVERY_CAP_*) go into the beacon.
+    bool WaitForReceiver(int& outClientSocket, uint16_t capabilities = 0) {
         SOCKET listenSock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
         if (listenSock == INVALID_SOCKET) return false;
 
@@ -59,29 +90,22 @@ public:
         }
         listen(listenSock, 1);
 
-        std::atomic<bool> searching = true;
-        std::thread broadcaster([&]() {
-            SOCKET udpSock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
-            BOOL broadcast = TRUE;
-            setsockopt(udpSock, SOL_SOCKET, SO_BROADCAST, (char*)&broadcast, sizeof(broadcast));
-            sockaddr_in broadcastAddr = {};
-            broadcastAddr.sin_family = AF_INET;
-            broadcastAddr.sin_port = htons(DISCOVERY_PORT);
-            broadcastAddr.sin_addr.s_addr = INADDR_BROADCAST;
-            const char* msg = "DISCOVER_DXGI_STREAM";
-            while (searching) {
-                sendto(udpSock, msg, (int)strlen(msg), 0, (sockaddr*)&broadcastAddr, sizeof(broadcastAddr));
-                std::this_thread::sleep_for(std::chrono::seconds(1));
-            }
-            closesocket(udpSock);
-        });
+        // Listening before answering, so a client can connect as soon as it has the beacon
+        DiscoveryMessage beacon = {};
+        beacon.streamPort = STREAM_PORT;
+        beacon.capabilities = capabilities;
+        beacon.width = (uint16_t)GetSystemMetrics(SM_CXSCREEN);
+        beacon.height = (uint16_t)GetSystemMetrics(SM_CYSCREEN);
+        beacon.codec = DISCOVERY_CODEC_H264;
+        gethostname(beacon.name, sizeof(beacon.name) - 1);
+        DiscoveryResponder responder;
+        responder.Start(DISCOVERY_PORT, beacon);
 
         sockaddr_in clientAddr;
         int clientLen = sizeof(clientAddr);
         SOCKET client = accept(listenSock, (sockaddr*)&clientAddr, &clientLen);
 
-        searching = false;
-        if (broadcaster.joinable()) broadcaster.join();
+        responder.Stop();
         closesocket(listenSock);
 
         if (client == INVALID_SOCKET) return false;
@@ -89,54 +113,53 @@ public:
         return true;
     }
 
-    // UPDATED: Now accepts packetType
-    void SendPacket(int clientSock, uint32_t type, const uint8_t* data, size_t size, int x = -1, int y = -1) {
-        if (clientSock == INVALID_SOCKET) return;
+    // UPDATED: Now accepts packetType. Returns false if the connection failed.
+    // Header and payload go down in one gathered WSASend, so the header never leaves as a
+    // segment of its own.
+    bool SendPacket(int clientSock, uint32_t type, const uint8_t* data, size_t size, int x = -1, int y = -1,
+                    uint32_t frameId = 0, uint32_t frameType = 0) {
+        if (clientSock == INVALID_SOCKET) return false;
+        TRACE_SCOPE(type == PACKET_TYPE_VIDEO ? "SendPacket" : "SendAudio", frameId);
+
+        PacketHeader header = EncodePacketHeader(type, (uint32_t)size, x, y, frameId, frameType);
+        WSABUF buffers[2];
+        buffers[0].buf = (CHAR*)&header;
+        buffers[0].len = sizeof(header);
+        buffers[1].buf = (CHAR*)data;
+        buffers[1].len = (ULONG)size;
+        return SendBuffers(clientSock, buffers, size > 0 ? 2 : 1);
+    }
 
-        PacketHeader header;
-        header.packetType  = htonl(type);
-        header.payloadSize = htonl((uint32_t)size);
-        header.cursorX     = htonl(x);
-        header.cursorY     = htonl(y);
-        
-        send((SOCKET)clientSock, (char*)&header, sizeof(header), 0);
-        
-        int totalSent = 0;
-        while (totalSent < (int)size) {
-            int sent = send((SOCKET)clientSock, (const char*)(data + totalSent), (int)(size - totalSent), 0);
-            if (sent <= 0) break;
-            totalSent += sent;
+    // Blocking gathered send of every buffer; advances `buffers` past partial sends
+    bool SendBuffers(int sock, WSABUF* buffers, DWORD count) {
+        while (count > 0) {
+            DWORD sent = 0;
+            if (WSASend((SOCKET)sock, buffers, count, &sent, 0, nullptr, nullptr) == SOCKET_ERROR) return false;
+            if (sent == 0) return false;
+            while (count > 0 && sent >= buffers->len) {
+                sent -= buffers->len;
+                buffers++;
+                count--;
+            }
+            if (count > 0) {
+                buffers->buf += sent;
+                buffers->len -= sent;
+            }
         }
+        return true;
     }
 
+    // Blocking discovery + connect, for callers without a loop to poll a StreamConnector from
     bool FindAndConnect(int& outServerSocket) {
-        SOCKET udpSock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
-        DWORD udpTimeout = 2000;
-        setsockopt(udpSock, SOL_SOCKET, SO_RCVTIMEO, (const char*)&udpTimeout, sizeof(udpTimeout));
-        sockaddr_in recvAddr = {};
-        recvAddr.sin_family = AF_INET;
-        recvAddr.sin_port = htons(DISCOVERY_PORT);
-        recvAddr.sin_addr.s_addr = INADDR_ANY;
-        if (bind(udpSock, (sockaddr*)&recvAddr, sizeof(recvAddr)) == SOCKET_ERROR) {
-            closesocket(udpSock); return false;
-        }
-
-        char buffer[1024];
-        sockaddr_in senderAddr;
-        int senderLen = sizeof(senderAddr);
-        int len = recvfrom(udpSock, buffer, sizeof(buffer), 0, (sockaddr*)&senderAddr, &senderLen);
-        closesocket(udpSock);
-
-        if (len > 0) {
-            SOCKET tcpSock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-            senderAddr.sin_port = htons(STREAM_PORT);
-            connect(tcpSock, (sockaddr*)&senderAddr, sizeof(senderAddr));
-            BOOL nodelay = TRUE;
-            setsockopt(tcpSock, IPPROTO_TCP, TCP_NODELAY, (char*)&nodelay, sizeof(nodelay));
-            outServerSocket = (int)tcpSock;
-            return true;
-        }
-        return false;
+        StreamConnector connector;
+        if (!connector.Begin(DISCOVERY_PORT)) return false;
+        ConnectState state;
+        do {
+            state = connector.Poll(DISCOVERY_QUERY_INTERVAL_MS);
+        } while (state == ConnectState::Discovering || state == ConnectState::Connecting);
+        if (state != ConnectState::Connected) return false;
+        outServerSocket = connector.TakeSocket();
+        return true;
     }
 
     bool ReceiveHeader(int serverSock, PacketHeader& outHeader) {
@@ -147,14 +170,12 @@ public:
             if (ret <= 0) return false;
             bytesReceived += ret;
         }
-        outHeader.packetType  = ntohl(outHeader.packetType);
-        outHeader.payloadSize = ntohl(outHeader.payloadSize);
-        outHeader.cursorX     = ntohl(outHeader.cursorX);
-        outHeader.cursorY     = ntohl(outHeader.cursorY);
+        DecodePacketHeader(outHeader);
         return true;
     }
 
     bool ReceiveBody(int serverSock, std::vector<uint8_t>& buffer, uint32_t size) {
+        TRACE_SCOPE("ReceiveBody", Tracer::GetCurrentFrame());
         if (buffer.size() < size) buffer.resize(size);
         uint32_t totalRead = 0;
         while (totalRead < size) {
@@ -0,0 +1,193 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+
+#define PACKET_POOL_MIN_BUFFER 256 // Smallest buffer size class
+#define PACKET_POOL_CLASSES 40     // Power-of-two size classes from PACKET_POOL_MIN_BUFFER up
+
+class PacketPool;
+
+// One encoded packet plus the metadata needed to frame and schedule it.
+// Shared by reference between the sender and any taps, never copied.
+struct PacketBuffer {
+    std::vector<uint8_t> data; // Sized to the buffer's size class once, kept when recycled
+    size_t size = 0;
+
+    uint32_t packetType = 0;
+    uint32_t frameId = 0;
+    uint32_t frameType = 0;    // FrameType for video packets
+    int32_t cursorX = -1;
+    int32_t cursorY = -1;
+    std::chrono::steady_clock::time_point timestamp;
+
+    std::atomic<int> refCount = 0;
+    PacketPool* pool = nullptr;
+};
+
+// Intrusive reference to a pooled PacketBuffer (returns it to the pool on last release)
+class PacketRef {
+public:
+    PacketRef() = default;
+    explicit PacketRef(PacketBuffer* buffer) : buffer(buffer) { if (buffer) buffer->refCount++; }
+    PacketRef(const PacketRef& other) : buffer(other.buffer) { if (buffer) buffer->refCount++; }
+    PacketRef(PacketRef&& other) noexcept : buffer(other.buffer) { other.buffer = nullptr; }
+    ~PacketRef() { Reset(); }
+
+    PacketRef& operator=(const PacketRef& other) {
+        if (this != &other) {
+            if (other.buffer) other.buffer->refCount++;
+            Reset();
+            buffer = other.buffer;
+        }
+        return *this;
+    }
+
+    PacketRef& operator=(PacketRef&& other) noexcept {
+        if (this != &other) {
+            Reset();
+            buffer = other.buffer;
+            other.buffer = nullptr;
+        }
+        return *this;
+    }
+
+    void Reset();
+
+    PacketBuffer* operator->() const { return buffer; }
+    PacketBuffer* Get() const { return buffer; }
+    explicit operator bool() const { return buffer != nullptr; }
+
+    const uint8_t* Data() const { return buffer->data.data(); }
+    size_t Size() const { return buffer->size; }
+
+private:
+    PacketBuffer* buffer = nullptr;
+};
+
+// Buffers come in power-of-two size classes with a free list each, and a buffer only ever
+// carries packets of its own class. A cursor update or an audio packet therefore never holds
+// an IDR-sized buffer (the host shares one pool between all packet types, and the recorder
+// may keep hundreds of them queued), at the cost of up to 2x slack per buffer. Once every
+// class has as many buffers as it has packets in flight, Acquire never allocates.
+class PacketPool {
+public:
+    PacketPool() = default;
+    PacketPool(const PacketPool&) = delete;
+    PacketPool& operator=(const PacketPool&) = delete;
+
+    // Takes a free buffer of the payload's size class and copies the payload into it
+    PacketRef Acquire(const uint8_t* src, size_t size) {
+        int sizeClass = SizeClass(size);
+        PacketBuffer* buffer = nullptr;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            std::vector<PacketBuffer*>& freeList = freeLists[sizeClass];
+            if (!freeList.empty()) {
+                buffer = freeList.back();
+                freeList.pop_back();
+            } else {
+                buffers.push_back(std::make_unique<PacketBuffer>());
+                buffer = buffers.back().get();
+                buffer->pool = this;
+                heldBytes += ClassBytes(sizeClass);
+            }
+        }
+        if (buffer->data.empty()) buffer->data.resize(ClassBytes(sizeClass));
+        if (src) memcpy(buffer->data.data(), src, size);
+        buffer->size = size;
+        buffer->packetType = 0;
+        buffer->frameId = 0;
+        buffer->frameType = 0;
+        buffer->cursorX = -1;
+        buffer->cursorY = -1;
+        buffer->timestamp = std::chrono::steady_clock::now();
+        return PacketRef(buffer);
+    }
+
+    void Recycle(PacketBuffer* buffer) {
+        std::lock_guard<std::mutex> guard(lock);
+        freeLists[SizeClass(buffer->data.size())].push_back(buffer);
+    }
+
+    size_t GetAllocatedCount() {
+        std::lock_guard<std::mutex> guard(lock);
+        return buffers.size();
+    }
+
+    // Payload bytes of every buffer the pool owns, in use or free
+    size_t GetHeldBytes() {
+        std::lock_guard<std::mutex> guard(lock);
+        return heldBytes;
+    }
+
+private:
+    std::mutex lock;
+    std::vector<PacketBuffer*> freeLists[PACKET_POOL_CLASSES];
+    size_t heldBytes = 0;
+    std::vector<std::unique_ptr<PacketBuffer>> buffers; // Owns every buffer ever handed out
+
+    static size_t ClassBytes(int sizeClass) { return (size_t)PACKET_POOL_MIN_BUFFER << sizeClass; }
+
+    static int SizeClass(size_t size) {
+        int sizeClass = 0;
+        while (sizeClass + 1 < PACKET_POOL_CLASSES && ClassBytes(sizeClass) < size) sizeClass++;
+        return sizeClass;
+    }
+};
+
+inline void PacketRef::Reset() {
+    if (buffer && --buffer->refCount == 0) buffer->pool->Recycle(buffer);
+    buffer = nullptr;
+}
+
+// FIFO of packet references on a single vector: pop_front advances a head index and the
+// consumed prefix is compacted away instead of growing the storage, so once the vector
+// has reached the deepest queue seen, pushing and popping never allocate (unlike std::deque).
+class PacketQueue {
+public:
+    using iterator = std::vector<PacketRef>::iterator;
+    using const_iterator = std::vector<PacketRef>::const_iterator;
+    using reverse_iterator = std::reverse_iterator<iterator>;
+
+    void push_back(PacketRef packet) {
+        if (items.size() == items.capacity() && head > 0) {
+            items.erase(items.begin(), items.begin() + head);
+            head = 0;
+        }
+        items.push_back(std::move(packet));
+    }
+
+    PacketRef& front() { return items[head]; }
+
+    void pop_front() {
+        items[head++].Reset();
+        if (head == items.size()) clear();
+    }
+
+    // Keeps the capacity
+    void clear() {
+        items.clear();
+        head = 0;
+    }
+
+    size_t size() const { return items.size() - head; }
+    bool empty() const { return head == items.size(); }
+
+    iterator begin() { return items.begin() + head; }
+    iterator end() { return items.end(); }
+    const_iterator begin() const { return items.begin() + head; }
+    const_iterator end() const { return items.end(); }
+    reverse_iterator rbegin() { return reverse_iterator(end()); }
+    reverse_iterator rend() { return reverse_iterator(begin()); }
+
+    iterator erase(iterator it) { return items.erase(it); }
+
+private:
+    std::vector<PacketRef> items;
+    size_t head = 0;
+};
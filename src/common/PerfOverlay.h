@@ -0,0 +1,149 @@
+#pragma once
+#include <chrono>
+#include <cstdio>
+#include "Metrics.h"
+#include "../imgui/imgui.h"
+
+// Live performance graphs for the control panel, fed from the metrics registry.
+// A snapshot is merged only every PERF_OVERLAY_INTERVAL_MS; the per-frame cost
+// is drawing a handful of PlotLines from fixed-size histories (no allocation).
+
+#define PERF_OVERLAY_INTERVAL_MS 250
+#define PERF_OVERLAY_HISTORY 120   // 30s at 4 samples per second
+
+// Fixed-size history ring, plotted oldest to newest via PlotLines' values_offset
+struct PerfSeries {
+    float values[PERF_OVERLAY_HISTORY] = {};
+    int offset = 0;
+    float last = 0.0f;
+
+    void Push(float v) {
+        values[offset] = v;
+        offset = (offset + 1) % PERF_OVERLAY_HISTORY;
+        last = v;
+    }
+
+    float Max() const {
+        float m = 0.0f;
+        for (float v : values) if (v > m) m = v;
+        return m;
+    }
+
+    void Plot(const char* label, const char* format, float height = 40.0f) const {
+        char overlay[64];
+        snprintf(overlay, sizeof(overlay), format, last);
+        float top = Max();
+        ImGui::PlotLines(label, values, PERF_OVERLAY_HISTORY, offset, overlay, 0.0f, top > 0 ? top * 1.1f : 1.0f,
+                         ImVec2(0, height));
+    }
+};
+
+class PerfOverlay {
+public:
+    void Reset() {
+        *this = PerfOverlay();
+    }
+
+    // host: plot the send side (encode/send), otherwise the receive side (decode/present)
+    void Draw(bool host) {
+        auto drawStart = std::chrono::steady_clock::now();
+        Update(host, drawStart);
+
+        ImGui::SetNextWindowPos(ImVec2(370, 10), ImGuiCond_FirstUseEver);
+        ImGui::SetNextWindowSize(ImVec2(380, 0), ImGuiCond_FirstUseEver);
+        ImGui::SetNextWindowBgAlpha(0.75f);
+        if (ImGui::Begin("Performance")) {
+            bitrate.Plot("Mbps", "%.1f Mbps");
+            fps.Plot(host ? "Encoded fps" : "Presented fps", "%.0f fps");
+            if (host) {
+                frameSize.Plot("Frame KB", "%.1f KB avg");
+                if (qp.last > 0) qp.Plot("QP", "QP %.0f");
+                else ImGui::TextDisabled("QP: not reported by this encoder");
+            } else {
+                audioLost.Plot("Audio lost/s", "%.0f lost/s");
+                audioRecovered.Plot("RED recovered/s", "%.0f recovered/s");
+                jitterDepth.Plot("Jitter depth", "%.0f frames");
+                ImGui::Text("Audio total: %llu lost, %llu recovered, %llu concealed",
+                    (unsigned long long)current.Get(Counter::AudioFramesLost),
+                    (unsigned long long)current.Get(Counter::AudioFramesRecovered),
+                    (unsigned long long)current.Get(Counter::AudioFramesConcealed));
+            }
+
+            if (ImGui::BeginTable("Stages", 4, ImGuiTableFlags_SizingStretchSame | ImGuiTableFlags_RowBg)) {
+                ImGui::TableSetupColumn("Stage (ms)");
+                ImGui::TableSetupColumn("p50");
+                ImGui::TableSetupColumn("p90");
+                ImGui::TableSetupColumn("p99");
+                ImGui::TableHeadersRow();
+                for (int s = 0; s < METRICS_STAGES; s++) {
+                    if (stageCount[s] == 0) continue;
+                    ImGui::TableNextRow();
+                    ImGui::TableNextColumn(); ImGui::TextUnformatted(StageName((Stage)s));
+                    ImGui::TableNextColumn(); ImGui::Text("%.2f", stageP50[s]);
+                    ImGui::TableNextColumn(); ImGui::Text("%.2f", stageP90[s]);
+                    ImGui::TableNextColumn(); ImGui::Text("%.2f", stageP99[s].last);
+                }
+                ImGui::EndTable();
+            }
+            if (ImGui::TreeNode("p99 history")) {
+                for (int s = 0; s < METRICS_STAGES; s++) {
+                    if (stageCount[s] > 0) stageP99[s].Plot(StageName((Stage)s), "%.2f ms", 30.0f);
+                }
+                ImGui::TreePop();
+            }
+            ImGui::TextDisabled("Overlay: %.0f us", drawUs);
+        }
+        ImGui::End();
+        drawUs = std::chrono::duration<float, std::micro>(std::chrono::steady_clock::now() - drawStart).count();
+    }
+
+private:
+    MetricsSnapshot current;
+    bool primed = false;
+
+    PerfSeries bitrate;
+    PerfSeries fps;
+    PerfSeries frameSize;
+    PerfSeries qp;
+    PerfSeries audioLost;
+    PerfSeries audioRecovered;
+    PerfSeries jitterDepth;
+    PerfSeries stageP99[METRICS_STAGES];
+    float stageP50[METRICS_STAGES] = {};
+    float stageP90[METRICS_STAGES] = {};
+    uint64_t stageCount[METRICS_STAGES] = {};
+    float drawUs = 0.0f;
+
+    void Update(bool host, std::chrono::steady_clock::time_point now) {
+        if (primed && now - current.time < std::chrono::milliseconds(PERF_OVERLAY_INTERVAL_MS)) return;
+        MetricsSnapshot next = Metrics::Get().Snapshot();
+        if (!primed) {
+            current = next;
+            primed = true;
+            return;
+        }
+        MetricsSnapshot delta = next.Since(current);
+        float seconds = std::chrono::duration<float>(next.time - current.time).count();
+        current = next;
+        if (seconds <= 0.0f) return;
+
+        uint64_t bytes = host ? delta.Get(Counter::BytesSent) : delta.Get(Counter::BytesReceived);
+        uint64_t frames = host ? delta.Get(Counter::FramesEncoded) : delta.Get(Counter::FramesPresented);
+        uint64_t encoded = delta.Get(Counter::EncodedBytes);
+        bitrate.Push(bytes * 8.0f / 1e6f / seconds);
+        fps.Push(frames / seconds);
+        frameSize.Push(frames ? encoded / 1024.0f / frames : 0.0f);
+        qp.Push((float)next.Get(Gauge::EncoderQP));
+        audioLost.Push(delta.Get(Counter::AudioFramesLost) / seconds);
+        audioRecovered.Push(delta.Get(Counter::AudioFramesRecovered) / seconds);
+        jitterDepth.Push((float)next.Get(Gauge::AudioJitterDepth));
+
+        for (int s = 0; s < METRICS_STAGES; s++) {
+            const StageSummary& st = delta.stages[s];
+            stageCount[s] = next.stages[s].count; // Keep showing stages that ran at some point
+            stageP50[s] = (float)st.PercentileUs(50) / 1000.0f;
+            stageP90[s] = (float)st.PercentileUs(90) / 1000.0f;
+            stageP99[s].Push((float)st.PercentileUs(99) / 1000.0f);
+        }
+    }
+};
@@ -0,0 +1,75 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#define READBACK_RING_DEPTH 3
+
+// Schedules asynchronous GPU -> CPU readbacks over a small ring of staging buffers:
+// frame N is copied into a free buffer while frames N-1.. are mapped once the GPU is done
+// with them, instead of flushing and blocking in Map on every frame. Buffers complete
+// strictly in submission order. When every buffer is still pending, the oldest one is
+// forced (blocking), which bounds the added latency to Depth() - 1 frames; in steady
+// state the previous frame is ready by the next Poll, so it costs one frame.
+//
+// Generic over the buffer type (a staging texture, or a plain CPU buffer in tests).
+// The caller supplies `read(Buffer&, uint32_t tag, bool wait) -> bool`, which consumes
+// the buffer and returns false only if wait is false and the data isn't ready yet
+// (D3D11_MAP_FLAG_DO_NOT_WAIT -> DXGI_ERROR_WAS_STILL_DRAWING). Single-threaded.
+template <typename Buffer>
+class ReadbackRing {
+public:
+    explicit ReadbackRing(size_t depth = READBACK_RING_DEPTH) : slots(depth) {}
+
+    size_t Depth() const { return slots.size(); }
+    Buffer& At(size_t index) { return slots[index].buffer; }
+    size_t GetPending() const { return pending; }
+
+    // Buffer to copy the next frame into, tagged (e.g. with the frame ID) for the read
+    template <typename Read>
+    Buffer& Next(uint32_t tag, Read&& read) {
+        if (pending == slots.size()) ReadOldest(read, true);
+        Slot& slot = slots[(head + pending) % slots.size()];
+        slot.tag = tag;
+        pending++;
+        return slot.buffer;
+    }
+
+    // Consumes every finished readback, oldest first; returns how many were read
+    template <typename Read>
+    size_t Poll(Read&& read) {
+        size_t count = 0;
+        while (pending > 0 && ReadOldest(read, false)) count++;
+        return count;
+    }
+
+    // Blocks until every pending readback has been consumed
+    template <typename Read>
+    void Drain(Read&& read) {
+        while (pending > 0) ReadOldest(read, true);
+    }
+
+    // Forgets pending readbacks (e.g. on cleanup) without reading them
+    void Reset() {
+        head = 0;
+        pending = 0;
+    }
+
+private:
+    struct Slot {
+        Buffer buffer;
+        uint32_t tag = 0;
+    };
+    std::vector<Slot> slots;
+    size_t head = 0; // Oldest pending
+    size_t pending = 0;
+
+    template <typename Read>
+    bool ReadOldest(Read& read, bool wait) {
+        Slot& slot = slots[head];
+        if (!read(slot.buffer, slot.tag, wait) && !wait) return false;
+        head = (head + 1) % slots.size();
+        pending--;
+        return true;
+    }
+};
@@ -0,0 +1,449 @@
+#pragma once
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include "NetworkManager.h"
+#include "DatagramSocket.h"
+#include "PacketPool.h"
+#include "Metrics.h"
+#include "Logger.h"
+#include "../video/AnnexBParser.h"
+
+// Queued video older than this is stale and gets dropped
+#define SEND_LATENCY_BUDGET_MS 50
+#define SEND_BATCH_PACKETS 16 // Packets framed into one WSASend (a packet plus the audio queued behind it)
+#define SEND_IN_FLIGHT 4      // Overlapped sends outstanding; keeps a zero-copy socket busy
+
+struct SendQueueStats {
+    std::atomic<uint64_t> sentPackets = 0;
+    std::atomic<uint64_t> sentBytes = 0;
+    std::atomic<uint64_t> droppedNonReference = 0;  // Disposable frames, nothing depends on them
+    std::atomic<uint64_t> droppedSuperseded = 0;    // Older than a queued IDR
+    std::atomic<uint64_t> droppedDeepCut = 0;       // Reference frames cut while over budget
+    std::atomic<uint64_t> droppedAwaitingIdr = 0;   // Produced after a deep cut, before the next IDR
+    std::atomic<uint64_t> keyframeRequests = 0;
+    std::atomic<uint64_t> sendCalls = 0;             // WSASend calls (packets per call = coalescing)
+    std::atomic<uint64_t> controlPackets = 0;        // Of sentPackets, PushControl ones
+    std::atomic<uint64_t> datagramPackets = 0;       // Of sentPackets, sent on the media channel
+    std::atomic<uint64_t> datagramFailures = 0;      // Media packets the datagram socket refused
+    std::atomic<uint64_t> cursorPackets = 0;         // Of sentPackets, PushCursor ones
+    std::atomic<uint64_t> cursorSuperseded = 0;      // Cursor updates replaced before they were sent
+};
+
+// Host-side send queue. A sender thread drains packets to the socket so capture
+// and encode never block on TCP. When the socket backs up and queued video
+// exceeds the latency budget, frames are dropped in order of how cheap they are:
+//   1. Non-reference frames
+//   2. Anything before the newest queued IDR
+//   3. Everything (then a keyframe is requested and video resumes at the next IDR)
+// A frame another queued frame depends on is never dropped on its own. Audio is never dropped.
+//
+// Each send is one gathered, overlapped WSASend: header + payload of the packet at the
+// head, plus any audio packets queued right behind it. Up to SEND_IN_FLIGHT sends are
+// outstanding and each keeps its PacketRefs until it completes. In zero-copy mode the
+// socket send buffer is 0, so Winsock transmits straight out of the pooled buffers and
+// they return to the pool when the send completes. Off by default: with a single send
+// outstanding (one frame at a time) a zero-size buffer can wait on a delayed ACK.
+//
+// Control packets (PushControl) have a queue of their own, are never dropped and always
+// go out before the next media batch. Once SetMediaChannel hands it a DatagramSocket,
+// media leaves on that instead, so the TCP connection carries control only and a control
+// message never sits behind a keyframe in the socket buffer. With media on TCP it can
+// still wait behind the sends already handed to the kernel. Cursor updates (PushCursor)
+// come next: one pending at most, a newer one replaces it, sent on the media channel.
+class SendQueue {
+public:
+    using KeyframeRequestCallback = std::function<void()>;
+
+    ~SendQueue() { Stop(); }
+
+    void Start(NetworkManager* net, int socket, KeyframeRequestCallback onKeyframeNeeded) {
+        Stop();
+        this->net = net;
+        this->socket = socket;
+        this->onKeyframeNeeded = onKeyframeNeeded;
+        if (zeroCopy) {
+            int sendBuffer = 0;
+            setsockopt((SOCKET)socket, SOL_SOCKET, SO_SNDBUF, (const char*)&sendBuffer, sizeof(sendBuffer));
+        }
+        awaitingIdr = false;
+        media = nullptr;
+        running = true;
+        sender = std::thread(&SendQueue::SendLoop, this);
+    }
+
+    void Stop() {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            running = false;
+        }
+        wake.notify_all();
+        if (sender.joinable()) sender.join();
+        std::lock_guard<std::mutex> guard(lock);
+        queue.clear();
+        controlQueue.clear();
+        cursor.Reset();
+    }
+
+    void SetLatencyBudget(std::chrono::milliseconds budget) { latencyBudgetMs = (int)budget.count(); }
+
+    // Leaves queued media (video and audio) unsent, as a stalled socket would; control and
+    // cursor updates still go out and the drop policy runs as usual. For deterministic checks.
+    void SetHoldMedia(bool hold) {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            holdMedia = hold;
+        }
+        wake.notify_one();
+    }
+
+    // Before Start: send straight from packet buffers (sets SO_SNDBUF to 0 on the socket)
+    void SetZeroCopy(bool enabled) { zeroCopy = enabled; }
+
+    // Moves media (video and audio) onto `channel`, a connected DatagramSocket, or back to
+    // the TCP stream with nullptr. Takes effect at the next packet; may be called while
+    // running. The socket must stay open until Stop.
+    void SetMediaChannel(DatagramSocket* channel) {
+        std::lock_guard<std::mutex> guard(lock);
+        media = channel;
+    }
+
+    bool HasMediaChannel() {
+        std::lock_guard<std::mutex> guard(lock);
+        return media != nullptr;
+    }
+
+    // Never blocks or drops; goes out ahead of queued media
+    void PushControl(PacketRef packet) {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (!running) return;
+            controlQueue.push_back(std::move(packet));
+        }
+        wake.notify_one();
+    }
+
+    // Newest wins: replaces an update not sent yet. Goes out after control, ahead of media.
+    void PushCursor(PacketRef packet) {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (!running) return;
+            if (cursor) stats.cursorSuperseded++;
+            cursor = std::move(packet);
+        }
+        wake.notify_one();
+    }
+
+    // Never blocks. Video packets need frameType set.
+    void Push(PacketRef packet) {
+        bool requestKeyframe = false;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (!running) return;
+            if (packet->packetType == PACKET_TYPE_VIDEO && awaitingIdr) {
+                if (packet->frameType != (uint32_t)FrameType::IDR) {
+                    stats.droppedAwaitingIdr++;
+                    return;
+                }
+                awaitingIdr = false;
+            }
+            queue.push_back(std::move(packet));
+            requestKeyframe = ApplyDropPolicy(std::chrono::steady_clock::now());
+            Metrics::Get().Set(Gauge::SendQueueDepth, (int64_t)queue.size());
+        }
+        wake.notify_one();
+        if (requestKeyframe) {
+            stats.keyframeRequests++;
+            LOG_WARN_RATE("SendQueue", 2, "Over latency budget, requesting keyframe");
+            if (onKeyframeNeeded) onKeyframeNeeded();
+        }
+    }
+
+    const SendQueueStats& GetStats() const { return stats; }
+
+    void ResetStats() {
+        stats.sentPackets = 0;
+        stats.sentBytes = 0;
+        stats.droppedNonReference = 0;
+        stats.droppedSuperseded = 0;
+        stats.droppedDeepCut = 0;
+        stats.droppedAwaitingIdr = 0;
+        stats.keyframeRequests = 0;
+        stats.sendCalls = 0;
+        stats.controlPackets = 0;
+        stats.datagramPackets = 0;
+        stats.datagramFailures = 0;
+        stats.cursorPackets = 0;
+        stats.cursorSuperseded = 0;
+    }
+
+    size_t GetDepth() {
+        std::lock_guard<std::mutex> guard(lock);
+        return queue.size();
+    }
+
+private:
+    NetworkManager* net = nullptr;
+    int socket = -1;
+    KeyframeRequestCallback onKeyframeNeeded;
+
+    PacketQueue queue;
+    PacketQueue controlQueue;
+    PacketRef cursor; // Pending cursor update
+    DatagramSocket* media = nullptr; // Media channel, nullptr = media on TCP
+    std::mutex lock;
+    std::condition_variable wake;
+    std::thread sender;
+    bool running = false;
+    bool awaitingIdr = false;
+    bool zeroCopy = false;
+    bool holdMedia = false;
+    std::atomic<int> latencyBudgetMs = SEND_LATENCY_BUDGET_MS;
+    SendQueueStats stats;
+
+    static bool IsVideo(const PacketRef& p) { return p->packetType == PACKET_TYPE_VIDEO; }
+
+    // Age of the oldest queued video packet
+    std::chrono::steady_clock::duration QueuedVideoAge(std::chrono::steady_clock::time_point now) const {
+        for (const PacketRef& p : queue) {
+            if (IsVideo(p)) return now - p->timestamp;
+        }
+        return std::chrono::steady_clock::duration::zero();
+    }
+
+    bool OverBudget(std::chrono::steady_clock::time_point now) const {
+        return QueuedVideoAge(now) > std::chrono::milliseconds(latencyBudgetMs.load());
+    }
+
+    // Called with the lock held. Returns true if a keyframe must be requested.
+    bool ApplyDropPolicy(std::chrono::steady_clock::time_point now) {
+        if (!OverBudget(now)) return false;
+
+        // 1. Non-reference frames (the newest is kept, it is the freshest picture we have)
+        const PacketRef* newestVideo = nullptr;
+        for (auto it = queue.rbegin(); it != queue.rend(); ++it) {
+            if (IsVideo(*it)) { newestVideo = &*it; break; }
+        }
+        PacketBuffer* keep = newestVideo ? newestVideo->Get() : nullptr;
+        for (auto it = queue.begin(); it != queue.end();) {
+            if (IsVideo(*it) && it->Get() != keep && (*it)->frameType == (uint32_t)FrameType::NON_REFERENCE) {
+                stats.droppedNonReference++;
+                it = queue.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        if (!OverBudget(now)) return false;
+
+        // 2. Everything older than the newest queued IDR
+        auto lastIdr = queue.end();
+        for (auto it = queue.begin(); it != queue.end(); ++it) {
+            if (IsVideo(*it) && (*it)->frameType == (uint32_t)FrameType::IDR) lastIdr = it;
+        }
+        if (lastIdr != queue.end()) {
+            // Counted rather than compared against lastIdr, which erase() invalidates
+            size_t before = lastIdr - queue.begin();
+            for (auto it = queue.begin(); before > 0; before--) {
+                if (IsVideo(*it)) {
+                    stats.droppedSuperseded++;
+                    it = queue.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+            // The IDR itself is the new head of the video chain; keep it even if stale
+            return false;
+        }
+
+        // 3. Deep cut: the remaining frames form one dependency chain, drop all of it
+        for (auto it = queue.begin(); it != queue.end();) {
+            if (IsVideo(*it)) {
+                stats.droppedDeepCut++;
+                it = queue.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        awaitingIdr = true;
+        return true;
+    }
+
+    // One gathered WSASend and the packets it references, or media packets for the datagram channel
+    struct SendBatch {
+        WSAOVERLAPPED overlapped = {};
+        PacketHeader headers[SEND_BATCH_PACKETS];
+        WSABUF buffers[SEND_BATCH_PACKETS * 2];
+        PacketRef packets[SEND_BATCH_PACKETS];
+        size_t count = 0;
+        DWORD bytes = 0;
+        bool pending = false;
+        DatagramSocket* datagrams = nullptr; // Set: send on the media channel instead
+    };
+
+    // Takes all queued control packets, or else the pending cursor update, or else the head
+    // media packet plus the audio queued right behind it (lock held)
+    void TakeBatch(SendBatch& batch) {
+        batch.count = 0;
+        batch.datagrams = nullptr;
+        if (!controlQueue.empty()) {
+            do {
+                batch.packets[batch.count++] = std::move(controlQueue.front());
+                controlQueue.pop_front();
+            } while (batch.count < SEND_BATCH_PACKETS && !controlQueue.empty());
+            return;
+        }
+        batch.datagrams = media;
+        if (cursor) {
+            batch.packets[batch.count++] = std::move(cursor);
+            return;
+        }
+        do {
+            batch.packets[batch.count++] = std::move(queue.front());
+            queue.pop_front();
+        } while (batch.count < SEND_BATCH_PACKETS && !queue.empty() && !IsVideo(queue.front()));
+    }
+
+    bool Submit(SendBatch& batch) {
+        DWORD buffers = 0;
+        batch.bytes = 0;
+        for (size_t i = 0; i < batch.count; i++) {
+            const PacketRef& packet = batch.packets[i];
+            batch.headers[i] = EncodePacketHeader(packet->packetType, (uint32_t)packet.Size(), packet->cursorX,
+                                                  packet->cursorY, packet->frameId, packet->frameType);
+            batch.buffers[buffers].buf = (CHAR*)&batch.headers[i];
+            batch.buffers[buffers++].len = sizeof(PacketHeader);
+            if (packet.Size() > 0) {
+                batch.buffers[buffers].buf = (CHAR*)packet.Data();
+                batch.buffers[buffers++].len = (ULONG)packet.Size();
+            }
+            batch.bytes += (DWORD)(sizeof(PacketHeader) + packet.Size());
+        }
+        uint32_t type = batch.packets[0]->packetType;
+        TRACE_SCOPE(type == PACKET_TYPE_VIDEO ? "SendPacket" : type == PACKET_TYPE_CONTROL ? "SendControl" :
+                    type == PACKET_TYPE_CURSOR ? "SendCursor" : "SendAudio",
+                    batch.packets[0]->frameId);
+        DWORD sent = 0;
+        WSAResetEvent(batch.overlapped.hEvent);
+        if (WSASend((SOCKET)socket, batch.buffers, buffers, &sent, 0, &batch.overlapped, nullptr) == SOCKET_ERROR &&
+            WSAGetLastError() != WSA_IO_PENDING) {
+            return false;
+        }
+        batch.pending = true;
+        stats.sendCalls++;
+        return true;
+    }
+
+    // Waits for (or, with wait false, checks) a send; false if it failed
+    bool Complete(SendBatch& batch, bool wait, bool& done) {
+        done = false;
+        if (!batch.pending) return true;
+        DWORD sent = 0, flags = 0;
+        if (!WSAGetOverlappedResult((SOCKET)socket, &batch.overlapped, &sent, wait ? TRUE : FALSE, &flags)) {
+            if (!wait && WSAGetLastError() == WSA_IO_INCOMPLETE) return true;
+            batch.pending = false;
+            for (size_t i = 0; i < batch.count; i++) batch.packets[i].Reset();
+            return false;
+        }
+        batch.pending = false;
+        done = true;
+        auto now = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < batch.count; i++) CountSent(batch.packets[i], now);
+        return sent == batch.bytes;
+    }
+
+    // Datagram sends are synchronous, the batch is done on return. A refused packet is
+    // dropped; a receiver that went away shows up on the TCP connection.
+    void SendDatagrams(SendBatch& batch) {
+        for (size_t i = 0; i < batch.count; i++) {
+            PacketRef& packet = batch.packets[i];
+            if (batch.datagrams->SendPacket(packet->packetType, packet.Data(), packet.Size(), packet->cursorX,
+                                            packet->cursorY, packet->frameId, packet->frameType)) {
+                stats.datagramPackets++;
+                CountSent(packet, std::chrono::steady_clock::now());
+            } else {
+                stats.datagramFailures++;
+                LOG_WARN_RATE("SendQueue", 2, "Datagram send failed: %d", WSAGetLastError());
+                packet.Reset();
+            }
+        }
+    }
+
+    void CountSent(PacketRef& packet, std::chrono::steady_clock::time_point now) {
+        Metrics& metrics = Metrics::Get();
+        stats.sentPackets++;
+        stats.sentBytes += packet.Size();
+        if (packet->packetType == PACKET_TYPE_CONTROL) stats.controlPackets++;
+        if (packet->packetType == PACKET_TYPE_CURSOR) stats.cursorPackets++;
+        metrics.Add(Counter::PacketsSent);
+        metrics.Add(Counter::BytesSent, packet.Size());
+        if (IsVideo(packet)) metrics.Record(Stage::Send, now - packet->timestamp);
+        packet.Reset(); // Back to the pool
+    }
+
+    void SendLoop() {
+        Tracer::SetThreadName("Sender");
+        SendBatch batches[SEND_IN_FLIGHT];
+        for (SendBatch& batch : batches) batch.overlapped.hEvent = WSACreateEvent();
+        size_t oldest = 0; // Sends on one socket complete in submission order
+        size_t inFlight = 0;
+        // Retires the oldest send, waiting for it or only if it has finished; false on failure
+        auto retire = [&](bool wait) {
+            bool done = false;
+            if (!Complete(batches[oldest], wait, done)) return false;
+            if (done) {
+                oldest = (oldest + 1) % SEND_IN_FLIGHT;
+                inFlight--;
+            }
+            return true;
+        };
+        auto ready = [this] { return !running || (!queue.empty() && !holdMedia) || !controlQueue.empty() || (bool)cursor; };
+
+        bool ok = true;
+        while (ok) {
+            if (inFlight == SEND_IN_FLIGHT && !(ok = retire(true))) break;
+            SendBatch& batch = batches[(oldest + inFlight) % SEND_IN_FLIGHT];
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                // While idle with sends in flight, retire them every 1ms so buffers and stats don't lag
+                while (ok && inFlight > 0 && !wake.wait_for(guard, std::chrono::milliseconds(1), ready)) {
+                    guard.unlock();
+                    size_t before;
+                    do {
+                        before = inFlight;
+                        ok = retire(false);
+                    } while (ok && inFlight > 0 && inFlight < before);
+                    guard.lock();
+                }
+                if (ok) wake.wait(guard, ready);
+                if (!running || !ok) break;
+                TakeBatch(batch);
+            }
+            if (batch.datagrams) {
+                SendDatagrams(batch);
+                continue;
+            }
+            if (!(ok = Submit(batch))) {
+                for (size_t i = 0; i < batch.count; i++) batch.packets[i].Reset();
+                break;
+            }
+            inFlight++;
+        }
+        if (!ok) {
+            LOG_ERROR("SendQueue", "Send failed, stopping sender");
+            std::lock_guard<std::mutex> guard(lock);
+            running = false;
+            queue.clear();
+            controlQueue.clear();
+            cursor.Reset();
+        }
+        // The kernel may still be reading the buffers (closing the socket cancels the sends)
+        bool done;
+        for (SendBatch& batch : batches) {
+            Complete(batch, true, done);
+            WSACloseEvent(batch.overlapped.hEvent);
+        }
+    }
+};
@@ -0,0 +1,260 @@
+#pragma once
+#include <windows.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <iostream>
+#include <cstdint>
+#include <cstring>
+#include "NetworkManager.h"
+
+// Same-host packet transport: a ring of framed packets (PacketHeader in wire order +
+// payload, as on the TCP stream) in a named file mapping, for a receiver, recorder or
+// analytics process running next to the host. One writer process, one reader process.
+//
+// The writer copies each packet into the mapping once; the reader gets a pointer into
+// the mapping and parses it in place. The ring positions are lock-free atomics in the
+// shared control block. The reader spins briefly for new data, then parks on a named
+// auto-reset event that the writer only signals while the reader is parked.
+// Nothing is written while no reader is attached, and when the reader falls behind new
+// packets are dropped (counted) rather than blocking the writer.
+
+#define SHM_RING_CAPACITY (32 * 1024 * 1024) // Ring bytes, excluding the control block
+#define SHM_RING_MAGIC 0x48534348            // "HCSH"
+#define SHM_RING_SPIN 4000                   // Polls before the reader parks on the event
+#define SHM_RING_WRAP 0x80000000u            // Record flag: skip to the start of the ring
+#define SHARED_TAP_NAME "ZeroCopyStream"     // Ring the host publishes its stream to
+
+struct SharedRingControl {
+    uint32_t magic;
+    uint32_t controlSize; // Offset of the ring bytes in the mapping
+    uint64_t capacity;
+    alignas(64) std::atomic<uint64_t> writePos; // Written by the writer only
+    alignas(64) std::atomic<uint64_t> readPos;  // Written by the reader only
+    std::atomic<uint32_t> readerWaiting;
+    std::atomic<uint32_t> readerAttached;
+    alignas(64) std::atomic<uint32_t> writerClosed;
+};
+
+// Record prefix: total record size (8-byte aligned, may carry SHM_RING_WRAP), then the header
+struct SharedRecord {
+    uint32_t size;
+    uint32_t reserved;
+    PacketHeader header;
+};
+
+struct SharedRingStats {
+    std::atomic<uint64_t> written = 0;
+    std::atomic<uint64_t> dropped = 0; // Reader too far behind (or the packet doesn't fit)
+};
+
+// Shared by the writer and the reader: the mapping, the control block and the event
+class SharedRingView {
+public:
+    ~SharedRingView() { Unmap(); }
+
+    bool IsOpen() const { return control != nullptr; }
+    const std::string& GetName() const { return name; }
+
+protected:
+    std::string name;
+    HANDLE mapping = nullptr;
+    HANDLE dataEvent = nullptr;
+    SharedRingControl* control = nullptr;
+    uint8_t* ring = nullptr;
+    bool existed = false; // Create found the mapping already there (e.g. a restarted writer)
+
+    static size_t ControlSize() { return (sizeof(SharedRingControl) + 4095) & ~(size_t)4095; }
+
+    bool Map(const std::string& ringName, bool create) {
+        name = ringName;
+        std::string path = "Local\\" + ringName;
+        if (create) {
+            uint64_t size = ControlSize() + (uint64_t)SHM_RING_CAPACITY;
+            mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, (DWORD)(size >> 32),
+                                         (DWORD)(size & 0xFFFFFFFF), path.c_str());
+            existed = mapping && GetLastError() == ERROR_ALREADY_EXISTS;
+            dataEvent = CreateEventA(nullptr, FALSE, FALSE, (path + ".data").c_str());
+        } else {
+            mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, path.c_str());
+            dataEvent = OpenEventA(EVENT_MODIFY_STATE | SYNCHRONIZE, FALSE, (path + ".data").c_str());
+        }
+        if (!mapping || !dataEvent) {
+            std::cerr << "[SharedRing] Cannot " << (create ? "create " : "open ") << ringName << " (" << GetLastError() << ")" << std::endl;
+            Unmap();
+            return false;
+        }
+        control = (SharedRingControl*)MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+        if (!control) {
+            Unmap();
+            return false;
+        }
+        ring = (uint8_t*)control + ControlSize();
+        return true;
+    }
+
+    void Unmap() {
+        if (control) UnmapViewOfFile(control);
+        if (mapping) CloseHandle(mapping);
+        if (dataEvent) CloseHandle(dataEvent);
+        control = nullptr;
+        ring = nullptr;
+        mapping = nullptr;
+        dataEvent = nullptr;
+    }
+};
+
+// Host side. Write may be called from several threads (video and audio); they are
+// serialized in-process, so the ring itself stays single-producer.
+class SharedRingWriter : public SharedRingView {
+public:
+    ~SharedRingWriter() { Close(); }
+
+    bool Create(const std::string& ringName) {
+        Close();
+        if (!Map(ringName, true)) return false;
+        if (!existed || control->magic != SHM_RING_MAGIC) {
+            control->capacity = SHM_RING_CAPACITY;
+            control->controlSize = (uint32_t)ControlSize();
+            control->writePos.store(0);
+            control->readPos.store(0);
+            control->readerWaiting.store(0);
+            control->readerAttached.store(0);
+            control->magic = SHM_RING_MAGIC;
+        }
+        control->writerClosed.store(0);
+        std::cout << "[SharedRing] Publishing to " << ringName << " (" << SHM_RING_CAPACITY / (1024 * 1024) << " MB)" << std::endl;
+        return true;
+    }
+
+    // Wakes the reader, which sees the ring as closed once it is drained
+    void Close() {
+        std::lock_guard<std::mutex> guard(lock);
+        if (!control) return;
+        control->writerClosed.store(1);
+        SetEvent(dataEvent);
+        Unmap();
+    }
+
+    // Copies one framed packet into the ring; false if dropped or no reader is attached
+    bool Write(uint32_t type, const uint8_t* data, size_t size, int x = -1, int y = -1, uint32_t frameId = 0, uint32_t frameType = 0) {
+        std::lock_guard<std::mutex> guard(lock);
+        if (!control || !control->readerAttached.load(std::memory_order_acquire)) return false;
+        uint64_t capacity = control->capacity;
+        uint64_t need = (sizeof(SharedRecord) + size + 7) & ~(uint64_t)7;
+        uint64_t writePos = control->writePos.load(std::memory_order_relaxed);
+        uint64_t readPos = control->readPos.load(std::memory_order_acquire);
+        uint64_t offset = writePos % capacity;
+        uint64_t padding = offset + need > capacity ? capacity - offset : 0; // Records never wrap
+        if (need > capacity / 2 || writePos + padding + need - readPos > capacity) {
+            stats.dropped++;
+            return false;
+        }
+        if (padding) {
+            SharedRecord* wrap = (SharedRecord*)(ring + offset);
+            wrap->size = (uint32_t)padding | SHM_RING_WRAP;
+        }
+        SharedRecord* record = (SharedRecord*)(ring + (writePos + padding) % capacity);
+        record->size = (uint32_t)need;
+        record->header = EncodePacketHeader(type, (uint32_t)size, x, y, frameId, frameType);
+        if (size) memcpy(record + 1, data, size);
+        // seq_cst pairs with the reader's readerWaiting store, so a parked reader is always woken
+        control->writePos.store(writePos + padding + need);
+        if (control->readerWaiting.load()) SetEvent(dataEvent);
+        stats.written++;
+        return true;
+    }
+
+    const SharedRingStats& GetStats() const { return stats; }
+
+private:
+    std::mutex lock;
+    SharedRingStats stats;
+};
+
+// Consumer side (another process). Single-threaded.
+class SharedRingReader : public SharedRingView {
+public:
+    ~SharedRingReader() { Close(); }
+
+    // Starts at the writer's current position; older packets are skipped
+    bool Open(const std::string& ringName) {
+        Close();
+        if (!Map(ringName, false)) return false;
+        if (control->magic != SHM_RING_MAGIC) {
+            std::cerr << "[SharedRing] " << ringName << " is not a packet ring" << std::endl;
+            Unmap();
+            return false;
+        }
+        control->readPos.store(control->writePos.load());
+        control->readerAttached.store(1);
+        pending = 0;
+        return true;
+    }
+
+    void Close() {
+        if (!control) return;
+        control->readerAttached.store(0);
+        Unmap();
+    }
+
+    // Next packet, waiting up to timeoutMs (-1 = forever). `payload` points into the
+    // mapping and stays valid until the next Read. False on timeout or once the writer
+    // has closed and the ring is drained (see IsWriterClosed).
+    bool Read(PacketHeader& outHeader, const uint8_t*& payload, int timeoutMs = -1) {
+        if (!control) return false;
+        uint64_t capacity = control->capacity;
+        uint64_t readPos = control->readPos.load(std::memory_order_relaxed) + pending;
+        if (pending) control->readPos.store(readPos, std::memory_order_release); // Frees the previous packet
+        pending = 0;
+
+        if (!WaitForData(readPos, timeoutMs)) return false;
+        SharedRecord* record = (SharedRecord*)(ring + readPos % capacity);
+        if (record->size & SHM_RING_WRAP) {
+            readPos += record->size & ~SHM_RING_WRAP;
+            control->readPos.store(readPos, std::memory_order_release);
+            if (!WaitForData(readPos, timeoutMs)) return false;
+            record = (SharedRecord*)(ring + readPos % capacity);
+        }
+        outHeader = record->header;
+        DecodePacketHeader(outHeader);
+        payload = (const uint8_t*)(record + 1);
+        pending = record->size;
+        return true;
+    }
+
+    bool IsWriterClosed() const { return control && control->writerClosed.load() && !HasData(control->readPos.load() + pending); }
+
+private:
+    uint64_t pending = 0; // Size of the record handed out by the last Read
+
+    bool HasData(uint64_t readPos) const { return control->writePos.load(std::memory_order_acquire) != readPos; }
+
+    bool WaitForData(uint64_t readPos, int timeoutMs) {
+        for (int i = 0; i < SHM_RING_SPIN; i++) {
+            if (HasData(readPos)) return true;
+            YieldProcessor();
+        }
+        if (timeoutMs == 0) return false;
+        ULONGLONG deadline = GetTickCount64() + (timeoutMs < 0 ? 0 : timeoutMs);
+        while (!HasData(readPos)) {
+            if (control->writerClosed.load()) return false;
+            control->readerWaiting.store(1);
+            // Recheck after announcing, or a packet written in between is missed until the next one
+            if (!HasData(readPos)) {
+                DWORD wait = INFINITE;
+                if (timeoutMs >= 0) {
+                    ULONGLONG now = GetTickCount64();
+                    if (now >= deadline) {
+                        control->readerWaiting.store(0);
+                        return false;
+                    }
+                    wait = (DWORD)(deadline - now);
+                }
+                WaitForSingleObject(dataEvent, wait);
+            }
+            control->readerWaiting.store(0);
+        }
+        return true;
+    }
+};
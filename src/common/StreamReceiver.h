@@ -0,0 +1,266 @@
+#pragma once
+#include <winsock2.h>
+#include <mswsock.h>
+#include <iostream>
+#include <cstdint>
+#include <cstring>
+#include "NetworkManager.h"
+#include "PacketPool.h"
+#include "Tracer.h"
+#include "Logger.h"
+
+#define STREAM_RECV_DEPTH 8              // Receives kept posted on the socket
+#define STREAM_RECV_SLICE (64 * 1024)    // Registered buffer slice per receive
+
+enum class IoMode {
+    Readiness,  // select() + recv() into one slice (the original client loop, batched)
+    Registered  // Registered I/O: posted receives into registered buffers, completion queue
+};
+
+// Completion-driven receive engine for the framed TCP stream (NetworkManager framing).
+// In Registered mode STREAM_RECV_DEPTH receives stay posted on the socket at all times,
+// each into its own slice of one registered region, and a slice is re-posted as soon
+// as its bytes are parsed, so the kernel always has somewhere to put data and a steady
+// stream costs no system call per packet. Completions are consumed strictly in posting
+// order. Packet bodies are parsed straight out of the slices into pooled PacketBuffers.
+//
+// Registered I/O needs a socket created with WSA_FLAG_REGISTERED_IO (StreamConnector
+// does); otherwise, or on systems without it, Start falls back to Readiness mode.
+// Single-threaded: Poll from one thread.
+class StreamReceiver {
+public:
+    StreamReceiver() = default;
+    StreamReceiver(const StreamReceiver&) = delete;
+    StreamReceiver& operator=(const StreamReceiver&) = delete;
+    ~StreamReceiver() { Stop(); }
+
+    bool Start(int sock, IoMode requested = IoMode::Registered) {
+        Stop();
+        if (sock == -1) return false;
+        this->sock = (SOCKET)sock;
+        region = (uint8_t*)VirtualAlloc(nullptr, (size_t)STREAM_RECV_DEPTH * STREAM_RECV_SLICE, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+        if (!region) return false;
+        mode = IoMode::Readiness;
+        connected = true;
+        if (requested == IoMode::Registered && StartRegistered()) mode = IoMode::Registered;
+        std::cout << "[Net] Receive engine: " << (mode == IoMode::Registered ? "registered I/O" : "readiness") << std::endl;
+        return connected;
+    }
+
+    // Call after closing the socket: posted receives reference the registered region
+    void Stop() {
+        CloseRegistered();
+        if (region) {
+            VirtualFree(region, 0, MEM_RELEASE);
+            region = nullptr;
+        }
+        for (Slice& slice : slices) slice = Slice();
+        for (bool& done : completed) done = false;
+        nextSlice = 0;
+        headerBytes = 0;
+        body.Reset();
+        sock = INVALID_SOCKET;
+        connected = false;
+    }
+
+    // Next complete packet, waiting up to timeoutMs for data (0 = only what has arrived).
+    // Returns false when none is ready or the connection is gone (see IsConnected).
+    bool Poll(PacketHeader& outHeader, PacketRef& outPacket, int timeoutMs = 0) {
+        if (!region) return false;
+        bool waited = false;
+        while (true) {
+            Slice& slice = slices[mode == IoMode::Registered ? nextSlice : 0];
+            if (slice.consumed < slice.filled) {
+                if (Parse(slice, outHeader, outPacket)) return true;
+                continue;
+            }
+            if (slice.filled > 0) Recycle(slice);
+            if (!connected) return false;
+            if (!Fill(waited ? 0 : timeoutMs)) return false;
+            waited = true;
+        }
+    }
+
+    bool IsConnected() const { return connected; }
+    IoMode GetMode() const { return mode; }
+
+private:
+    struct Slice {
+        size_t filled = 0;   // Bytes received (0 while the receive is posted)
+        size_t consumed = 0; // Bytes parsed
+    };
+
+    SOCKET sock = INVALID_SOCKET;
+    IoMode mode = IoMode::Readiness;
+    bool connected = false;
+    uint8_t* region = nullptr;
+    Slice slices[STREAM_RECV_DEPTH];
+    uint32_t nextSlice = 0; // Oldest posted receive, i.e. the next bytes of the stream
+
+    RIO_EXTENSION_FUNCTION_TABLE rio = {};
+    RIO_BUFFERID bufferId = RIO_INVALID_BUFFERID;
+    RIO_CQ cq = RIO_INVALID_CQ;
+    RIO_RQ rq = RIO_INVALID_RQ;
+    HANDLE event = nullptr;
+    bool completed[STREAM_RECV_DEPTH] = {}; // Completion seen, waiting for its turn
+    size_t completedBytes[STREAM_RECV_DEPTH] = {};
+
+    PacketPool pool;
+    PacketHeader header = {};
+    size_t headerBytes = 0;
+    PacketRef body;
+    size_t bodyBytes = 0;
+
+    bool StartRegistered() {
+        GUID functionTableId = WSAID_MULTIPLE_RIO;
+        DWORD bytes = 0;
+        if (WSAIoctl(sock, SIO_GET_MULTIPLE_EXTENSION_FUNCTION_POINTER, &functionTableId, sizeof(functionTableId),
+                     &rio, sizeof(rio), &bytes, nullptr, nullptr) != 0) {
+            return false;
+        }
+        event = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+        bufferId = rio.RIORegisterBuffer((PCHAR)region, (DWORD)STREAM_RECV_DEPTH * STREAM_RECV_SLICE);
+        RIO_NOTIFICATION_COMPLETION notification = {};
+        notification.Type = RIO_EVENT_COMPLETION;
+        notification.Event.EventHandle = event;
+        notification.Event.NotifyReset = TRUE;
+        if (event && bufferId != RIO_INVALID_BUFFERID) cq = rio.RIOCreateCompletionQueue(STREAM_RECV_DEPTH, &notification);
+        if (cq != RIO_INVALID_CQ) rq = rio.RIOCreateRequestQueue(sock, STREAM_RECV_DEPTH, 1, 1, 1, cq, cq, nullptr);
+        if (rq == RIO_INVALID_RQ) {
+            std::cerr << "[Net] Registered I/O unavailable (" << WSAGetLastError() << "), using readiness mode" << std::endl;
+            CloseRegistered();
+            return false;
+        }
+        for (uint32_t i = 0; i < STREAM_RECV_DEPTH && connected; i++) Post(i);
+        return true;
+    }
+
+    void CloseRegistered() {
+        if (cq != RIO_INVALID_CQ) {
+            rio.RIOCloseCompletionQueue(cq);
+            cq = RIO_INVALID_CQ;
+        }
+        rq = RIO_INVALID_RQ; // Freed with the socket
+        if (bufferId != RIO_INVALID_BUFFERID) {
+            rio.RIODeregisterBuffer(bufferId);
+            bufferId = RIO_INVALID_BUFFERID;
+        }
+        if (event) {
+            CloseHandle(event);
+            event = nullptr;
+        }
+    }
+
+    bool Post(uint32_t index) {
+        RIO_BUF buf;
+        buf.BufferId = bufferId;
+        buf.Offset = index * STREAM_RECV_SLICE;
+        buf.Length = STREAM_RECV_SLICE;
+        if (!rio.RIOReceive(rq, &buf, 1, 0, (PVOID)(uintptr_t)index)) {
+            LOG_ERROR("Net", "RIOReceive failed: %d", WSAGetLastError());
+            connected = false;
+            return false;
+        }
+        return true;
+    }
+
+    // Hands a fully parsed slice back to the kernel
+    void Recycle(Slice& slice) {
+        slice = Slice();
+        if (mode != IoMode::Registered) return;
+        if (connected) Post(nextSlice);
+        nextSlice = (nextSlice + 1) % STREAM_RECV_DEPTH;
+    }
+
+    // Makes the next stream bytes available in the current slice
+    bool Fill(int timeoutMs) {
+        if (mode == IoMode::Readiness) {
+            if (timeoutMs >= 0) {
+                fd_set readSet;
+                FD_ZERO(&readSet);
+                FD_SET(sock, &readSet);
+                timeval timeout = { timeoutMs / 1000, (timeoutMs % 1000) * 1000 };
+                if (select(0, &readSet, nullptr, nullptr, &timeout) <= 0) return false;
+            }
+            int ret = recv(sock, (char*)region, STREAM_RECV_SLICE, 0);
+            if (ret <= 0) {
+                connected = false;
+                return false;
+            }
+            slices[0].filled = (size_t)ret;
+            return true;
+        }
+
+        if (!completed[nextSlice]) {
+            Dequeue();
+            if (!completed[nextSlice] && timeoutMs != 0) {
+                rio.RIONotify(cq);
+                WaitForSingleObject(event, timeoutMs < 0 ? INFINITE : (DWORD)timeoutMs);
+                Dequeue();
+            }
+            if (!completed[nextSlice]) return false;
+        }
+        completed[nextSlice] = false;
+        size_t bytes = completedBytes[nextSlice];
+        if (bytes == 0) {
+            connected = false; // Graceful close or error, later slices carry nothing
+            return false;
+        }
+        slices[nextSlice].filled = bytes;
+        return true;
+    }
+
+    void Dequeue() {
+        RIORESULT results[STREAM_RECV_DEPTH];
+        ULONG count = rio.RIODequeueCompletion(cq, results, STREAM_RECV_DEPTH);
+        if (count == RIO_CORRUPT_CQ) {
+            LOG_ERROR("Net", "Registered I/O completion queue corrupt");
+            connected = false;
+            return;
+        }
+        for (ULONG i = 0; i < count; i++) {
+            uint32_t index = (uint32_t)results[i].RequestContext;
+            completed[index] = true;
+            completedBytes[index] = results[i].Status == 0 ? results[i].BytesTransferred : 0;
+        }
+    }
+
+    // Consumes slice bytes until one packet is complete
+    bool Parse(Slice& slice, PacketHeader& outHeader, PacketRef& outPacket) {
+        const uint8_t* data = region + (mode == IoMode::Registered ? (size_t)nextSlice * STREAM_RECV_SLICE : 0);
+        while (slice.consumed < slice.filled) {
+            size_t available = slice.filled - slice.consumed;
+            const uint8_t* src = data + slice.consumed;
+            if (headerBytes < sizeof(PacketHeader)) {
+                size_t chunk = sizeof(PacketHeader) - headerBytes;
+                if (chunk > available) chunk = available;
+                memcpy((uint8_t*)&header + headerBytes, src, chunk);
+                headerBytes += chunk;
+                slice.consumed += chunk;
+                if (headerBytes < sizeof(PacketHeader)) return false;
+                DecodePacketHeader(header);
+                if (header.packetType == PACKET_TYPE_VIDEO) Tracer::SetCurrentFrame(header.frameId);
+                body = pool.Acquire(nullptr, header.payloadSize); // Timestamp: first byte of the packet
+                body->packetType = header.packetType;
+                body->frameId = header.frameId;
+                body->frameType = header.frameType;
+                body->cursorX = header.cursorX;
+                body->cursorY = header.cursorY;
+                bodyBytes = 0;
+            } else {
+                size_t chunk = header.payloadSize - bodyBytes;
+                if (chunk > available) chunk = available;
+                memcpy(body->data.data() + bodyBytes, src, chunk);
+                bodyBytes += chunk;
+                slice.consumed += chunk;
+            }
+            if (bodyBytes == header.payloadSize) {
+                headerBytes = 0;
+                outHeader = header;
+                outPacket = std::move(body);
+                return true;
+            }
+        }
+        return false;
+    }
+};
@@ -0,0 +1,515 @@
+#pragma once
+#include <windows.h>
+#include <deque>
+#include <vector>
+#include <string>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <cstring>
+#include <cstdint>
+#include "NetworkManager.h"
+#include "PacketPool.h"
+#include "Logger.h"
+#include "../video/AnnexBParser.h"
+
+// Recording tee: shares the encoder's PacketBuffers with the send queue and muxes
+// them into Matroska (H.264 + 48kHz stereo PCM) on its own thread.
+// Push never blocks; when the disk falls behind, packets are dropped instead of
+// stalling capture, and video resumes at an IDR requested through the callback
+// (the encoder runs an infinite GOP, so one would otherwise never come).
+// Output goes out in RECORDER_BLOCK_SIZE unbuffered overlapped writes, up to
+// RECORDER_WRITE_DEPTH in flight, retired through an I/O completion port.
+
+#define RECORDER_QUEUE_CAPACITY 512
+#define RECORDER_BLOCK_SIZE (1 << 20)   // Multiple of any sector size
+#define RECORDER_SECTOR_SIZE 4096
+#define RECORDER_WRITE_DEPTH 4          // Blocks being filled or written
+#define RECORDER_CLUSTER_MAX_MS 5000
+
+#define RECORDER_TRACK_VIDEO 1
+#define RECORDER_TRACK_AUDIO 2
+
+struct RecorderStats {
+    std::atomic<uint64_t> packetsWritten = 0;
+    std::atomic<uint64_t> bytesWritten = 0;   // Submitted to disk
+    std::atomic<uint64_t> droppedPackets = 0; // Queue full, waiting for an IDR, or audio >32s behind
+    std::atomic<uint64_t> keyframeRequests = 0;
+    std::atomic<uint64_t> writeStalls = 0;    // Writer waited on a block still in flight
+};
+
+// Matroska element IDs
+namespace Mkv {
+    const uint32_t EBML = 0x1A45DFA3;
+    const uint32_t EBMLVersion = 0x4286;
+    const uint32_t EBMLReadVersion = 0x42F7;
+    const uint32_t EBMLMaxIDLength = 0x42F2;
+    const uint32_t EBMLMaxSizeLength = 0x42F3;
+    const uint32_t DocType = 0x4282;
+    const uint32_t DocTypeVersion = 0x4287;
+    const uint32_t DocTypeReadVersion = 0x4285;
+    const uint32_t Segment = 0x18538067;
+    const uint32_t Info = 0x1549A966;
+    const uint32_t TimecodeScale = 0x2AD7B1;
+    const uint32_t MuxingApp = 0x4D80;
+    const uint32_t WritingApp = 0x5741;
+    const uint32_t Tracks = 0x1654AE6B;
+    const uint32_t TrackEntry = 0xAE;
+    const uint32_t TrackNumber = 0xD7;
+    const uint32_t TrackUID = 0x73C5;
+    const uint32_t TrackType = 0x83;
+    const uint32_t CodecID = 0x86;
+    const uint32_t CodecPrivate = 0x63A2;
+    const uint32_t Video = 0xE0;
+    const uint32_t PixelWidth = 0xB0;
+    const uint32_t PixelHeight = 0xBA;
+    const uint32_t Audio = 0xE1;
+    const uint32_t SamplingFrequency = 0xB5;
+    const uint32_t Channels = 0x9F;
+    const uint32_t BitDepth = 0x6264;
+    const uint32_t Cluster = 0x1F43B675;
+    const uint32_t Timecode = 0xE7;
+    const uint32_t SimpleBlock = 0xA3;
+    const uint64_t UnknownSize = 0x01FFFFFFFFFFFFFFull;
+}
+
+// Small EBML builder for the header elements (sizes known up front)
+class EbmlWriter {
+public:
+    std::vector<uint8_t> bytes;
+
+    void Id(uint32_t id) {
+        if (id > 0xFFFFFF) bytes.push_back((uint8_t)(id >> 24));
+        if (id > 0xFFFF) bytes.push_back((uint8_t)(id >> 16));
+        if (id > 0xFF) bytes.push_back((uint8_t)(id >> 8));
+        bytes.push_back((uint8_t)id);
+    }
+
+    void Size(uint64_t size) {
+        if (size == Mkv::UnknownSize) {
+            for (int i = 7; i >= 0; i--) bytes.push_back((uint8_t)(size >> (i * 8)));
+            return;
+        }
+        int len = 1;
+        while (len < 8 && size >= (1ull << (7 * len)) - 1) len++;
+        uint64_t marked = size | (1ull << (7 * len));
+        for (int i = len - 1; i >= 0; i--) bytes.push_back((uint8_t)(marked >> (i * 8)));
+    }
+
+    void Uint(uint32_t id, uint64_t value) {
+        int len = 1;
+        while (len < 8 && (value >> (8 * len)) != 0) len++;
+        Id(id);
+        Size(len);
+        for (int i = len - 1; i >= 0; i--) bytes.push_back((uint8_t)(value >> (i * 8)));
+    }
+
+    void Float(uint32_t id, double value) {
+        uint64_t raw;
+        memcpy(&raw, &value, sizeof(raw));
+        Id(id);
+        Size(8);
+        for (int i = 7; i >= 0; i--) bytes.push_back((uint8_t)(raw >> (i * 8)));
+    }
+
+    void Binary(uint32_t id, const void* data, size_t size) {
+        Id(id);
+        Size(size);
+        const uint8_t* p = (const uint8_t*)data;
+        bytes.insert(bytes.end(), p, p + size);
+    }
+
+    void String(uint32_t id, const char* str) { Binary(id, str, strlen(str)); }
+
+    void Master(uint32_t id, const EbmlWriter& child) { Binary(id, child.bytes.data(), child.bytes.size()); }
+};
+
+class StreamRecorder {
+public:
+    using KeyframeRequestCallback = std::function<void()>;
+
+    ~StreamRecorder() { Stop(); }
+
+    bool Start(const std::string& path, KeyframeRequestCallback onKeyframeNeeded) {
+        Stop();
+        file = CreateFileA(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS,
+                           FILE_FLAG_OVERLAPPED | FILE_FLAG_NO_BUFFERING, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            std::cerr << "[Recorder] Cannot create " << path << " (" << GetLastError() << ")" << std::endl;
+            return false;
+        }
+        this->path = path;
+        this->onKeyframeNeeded = onKeyframeNeeded;
+        port = CreateIoCompletionPort(file, nullptr, 0, 1);
+        if (!port) {
+            std::cerr << "[Recorder] Cannot create completion port (" << GetLastError() << ")" << std::endl;
+            CloseHandle(file);
+            file = INVALID_HANDLE_VALUE;
+            return false;
+        }
+
+        for (WriteBlock& block : blocks) {
+            // VirtualAlloc is page aligned, which satisfies FILE_FLAG_NO_BUFFERING
+            block.data = (uint8_t*)VirtualAlloc(nullptr, RECORDER_BLOCK_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+            block.used = 0;
+            block.pending = false;
+            memset(&block.overlapped, 0, sizeof(OVERLAPPED));
+        }
+        current = 0;
+        fileOffset = 0;
+        headerWritten = false;
+        needIdr = true;
+        dropUntilIdr = false;
+        clusterOpen = false;
+        audioSamples = 0;
+
+        running = true;
+        writer = std::thread(&StreamRecorder::WriterLoop, this);
+        std::cout << "[Recorder] Recording to " << path << std::endl;
+        return true;
+    }
+
+    void Stop() {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (!running) return;
+            running = false;
+        }
+        wake.notify_all();
+        if (writer.joinable()) writer.join();
+        FinishFile();
+        std::cout << "[Recorder] Stopped, " << stats.bytesWritten / 1024 / 1024 << " MB written" << std::endl;
+    }
+
+    bool IsRecording() const { return running; }
+
+    // Shares the buffer (no copy). Video packets need frameType set; audio is raw 48kHz stereo int16.
+    void Push(const PacketRef& packet) {
+        bool requestKeyframe = false;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (!running) return;
+            bool video = packet->packetType == PACKET_TYPE_VIDEO;
+            bool idr = video && packet->frameType == (uint32_t)FrameType::IDR;
+            if (queue.size() >= RECORDER_QUEUE_CAPACITY) {
+                stats.droppedPackets++;
+                // Ask again if the IDR we were waiting for is the one dropped
+                requestKeyframe = video && (!dropUntilIdr || idr);
+                if (video) dropUntilIdr = true;
+            } else if (video && dropUntilIdr && !idr) {
+                stats.droppedPackets++;
+            } else {
+                if (idr) dropUntilIdr = false;
+                queue.push_back(packet);
+            }
+        }
+        if (requestKeyframe) {
+            stats.keyframeRequests++;
+            LOG_WARN_RATE("Recorder", 2, "Disk behind, dropping video until the next IDR");
+            if (onKeyframeNeeded) onKeyframeNeeded();
+            return;
+        }
+        wake.notify_one();
+    }
+
+    const RecorderStats& GetStats() const { return stats; }
+
+private:
+    struct WriteBlock {
+        uint8_t* data = nullptr;
+        size_t used = 0;
+        OVERLAPPED overlapped = {};
+        bool pending = false;
+    };
+
+    std::string path;
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE port = nullptr; // Completions of the block writes
+    WriteBlock blocks[RECORDER_WRITE_DEPTH];
+    int current = 0;
+    uint64_t fileOffset = 0; // Offset of blocks[current] in the file
+
+    std::deque<PacketRef> queue;
+    std::mutex lock;
+    std::condition_variable wake;
+    std::thread writer;
+    std::atomic<bool> running = false;
+    bool dropUntilIdr = false;
+    KeyframeRequestCallback onKeyframeNeeded;
+    RecorderStats stats;
+
+    // Muxer state (writer thread only)
+    AnnexBParser parser;
+    bool headerWritten = false;
+    bool needIdr = true;
+    bool clusterOpen = false;
+    std::chrono::steady_clock::time_point startTime;
+    int64_t clusterTimecode = 0;
+    uint64_t audioSamples = 0;
+    std::chrono::steady_clock::time_point audioStart;
+
+    void WriterLoop() {
+        std::deque<PacketRef> batch;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                wake.wait(guard, [this] { return !running || !queue.empty(); });
+                batch.swap(queue);
+                if (batch.empty() && !running) break;
+            }
+            for (PacketRef& packet : batch) {
+                if (packet->packetType == PACKET_TYPE_VIDEO) WriteVideo(packet);
+                else if (packet->packetType == PACKET_TYPE_AUDIO) WriteAudio(packet);
+            }
+            batch.clear();
+        }
+    }
+
+    // --- Output blocks ---
+    void Emit(const void* data, size_t size) {
+        const uint8_t* src = (const uint8_t*)data;
+        while (size > 0) {
+            WriteBlock& block = blocks[current];
+            size_t chunk = RECORDER_BLOCK_SIZE - block.used;
+            if (chunk > size) chunk = size;
+            memcpy(block.data + block.used, src, chunk);
+            block.used += chunk;
+            src += chunk;
+            size -= chunk;
+            if (block.used == RECORDER_BLOCK_SIZE) SubmitBlock();
+        }
+    }
+
+    void Emit(const EbmlWriter& w) { Emit(w.bytes.data(), w.bytes.size()); }
+
+    // Retires finished writes, waiting up to timeoutMs for the first one
+    bool ReapCompletions(DWORD timeoutMs) {
+        OVERLAPPED_ENTRY entries[RECORDER_WRITE_DEPTH];
+        ULONG count = 0;
+        if (!GetQueuedCompletionStatusEx(port, entries, RECORDER_WRITE_DEPTH, &count, timeoutMs, FALSE)) return false;
+        for (ULONG i = 0; i < count; i++) {
+            WriteBlock* block = CONTAINING_RECORD(entries[i].lpOverlapped, WriteBlock, overlapped);
+            block->pending = false;
+            if (entries[i].Internal != 0) LOG_ERROR_RATE("Recorder", 1, "Block write failed: 0x%08llx", (unsigned long long)entries[i].Internal);
+        }
+        return true;
+    }
+
+    void WaitBlock(WriteBlock& block) {
+        while (block.pending && ReapCompletions(INFINITE)) {}
+    }
+
+    // Writes a block at `offset`; it stays pending until its completion is reaped
+    void WriteAt(WriteBlock& block, uint64_t offset, DWORD size) {
+        block.overlapped.Offset = (DWORD)(offset & 0xFFFFFFFF);
+        block.overlapped.OffsetHigh = (DWORD)(offset >> 32);
+        // Completes through the port even when WriteFile finishes synchronously
+        if (WriteFile(file, block.data, size, nullptr, &block.overlapped) || GetLastError() == ERROR_IO_PENDING) {
+            block.pending = true;
+        } else {
+            LOG_ERROR_RATE("Recorder", 1, "WriteFile failed: %lu", GetLastError());
+        }
+    }
+
+    // Queues the current block and moves on to the next free one
+    void SubmitBlock() {
+        WriteAt(blocks[current], fileOffset, RECORDER_BLOCK_SIZE);
+        fileOffset += RECORDER_BLOCK_SIZE;
+        stats.bytesWritten += RECORDER_BLOCK_SIZE;
+
+        current = (current + 1) % RECORDER_WRITE_DEPTH;
+        WriteBlock& next = blocks[current];
+        if (next.pending) {
+            ReapCompletions(0);
+            if (next.pending) stats.writeStalls++;
+            WaitBlock(next);
+        }
+        next.used = 0;
+    }
+
+    // Writes the sector-padded tail, then trims the file to its real length
+    void FinishFile() {
+        if (file == INVALID_HANDLE_VALUE) return;
+        WriteBlock& block = blocks[current];
+        uint64_t length = fileOffset + block.used;
+        if (block.used > 0) {
+            size_t padded = (block.used + RECORDER_SECTOR_SIZE - 1) & ~(size_t)(RECORDER_SECTOR_SIZE - 1);
+            memset(block.data + block.used, 0, padded - block.used);
+            WriteAt(block, fileOffset, (DWORD)padded);
+            stats.bytesWritten += block.used;
+        }
+        for (WriteBlock& b : blocks) {
+            WaitBlock(b);
+            VirtualFree(b.data, 0, MEM_RELEASE);
+            b.data = nullptr;
+        }
+        CloseHandle(file);
+        file = INVALID_HANDLE_VALUE;
+        CloseHandle(port);
+        port = nullptr;
+
+        // Unbuffered handles can only write whole sectors; trim through a normal handle
+        HANDLE trim = CreateFileA(path.c_str(), GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (trim != INVALID_HANDLE_VALUE) {
+            LARGE_INTEGER end;
+            end.QuadPart = (LONGLONG)length;
+            SetFilePointerEx(trim, end, nullptr, FILE_BEGIN);
+            SetEndOfFile(trim);
+            CloseHandle(trim);
+        }
+        std::lock_guard<std::mutex> guard(lock);
+        queue.clear();
+    }
+
+    // --- Muxing ---
+    int64_t ElapsedMs(std::chrono::steady_clock::time_point t) const {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(t - startTime).count();
+    }
+
+    void WriteHeader(const AccessUnitInfo& au) {
+        const SequenceInfo& seq = parser.GetSequenceInfo();
+
+        EbmlWriter ebml;
+        ebml.Uint(Mkv::EBMLVersion, 1);
+        ebml.Uint(Mkv::EBMLReadVersion, 1);
+        ebml.Uint(Mkv::EBMLMaxIDLength, 4);
+        ebml.Uint(Mkv::EBMLMaxSizeLength, 8);
+        ebml.String(Mkv::DocType, "matroska");
+        ebml.Uint(Mkv::DocTypeVersion, 4);
+        ebml.Uint(Mkv::DocTypeReadVersion, 2);
+
+        EbmlWriter head;
+        head.Master(Mkv::EBML, ebml);
+        head.Id(Mkv::Segment);
+        head.Size(Mkv::UnknownSize); // Stays playable if we never get to finish it
+
+        EbmlWriter info;
+        info.Uint(Mkv::TimecodeScale, 1000000); // 1ms
+        info.String(Mkv::MuxingApp, "ZeroCopy");
+        info.String(Mkv::WritingApp, "ZeroCopy");
+        head.Master(Mkv::Info, info);
+
+        // avcC from the in-band SPS/PPS
+        std::vector<uint8_t> avcC = {
+            1, au.sps.data[1], au.sps.data[2], au.sps.data[3],
+            0xFF, // 4-byte NAL lengths
+            0xE1, (uint8_t)(au.sps.size >> 8), (uint8_t)au.sps.size
+        };
+        avcC.insert(avcC.end(), au.sps.data, au.sps.data + au.sps.size);
+        avcC.push_back(1);
+        avcC.push_back((uint8_t)(au.pps.size >> 8));
+        avcC.push_back((uint8_t)au.pps.size);
+        avcC.insert(avcC.end(), au.pps.data, au.pps.data + au.pps.size);
+
+        EbmlWriter video;
+        video.Uint(Mkv::PixelWidth, seq.width);
+        video.Uint(Mkv::PixelHeight, seq.height);
+        EbmlWriter videoTrack;
+        videoTrack.Uint(Mkv::TrackNumber, RECORDER_TRACK_VIDEO);
+        videoTrack.Uint(Mkv::TrackUID, RECORDER_TRACK_VIDEO);
+        videoTrack.Uint(Mkv::TrackType, 1);
+        videoTrack.String(Mkv::CodecID, "V_MPEG4/ISO/AVC");
+        videoTrack.Binary(Mkv::CodecPrivate, avcC.data(), avcC.size());
+        videoTrack.Master(Mkv::Video, video);
+
+        EbmlWriter audio;
+        audio.Float(Mkv::SamplingFrequency, 48000.0);
+        audio.Uint(Mkv::Channels, 2);
+        audio.Uint(Mkv::BitDepth, 16);
+        EbmlWriter audioTrack;
+        audioTrack.Uint(Mkv::TrackNumber, RECORDER_TRACK_AUDIO);
+        audioTrack.Uint(Mkv::TrackUID, RECORDER_TRACK_AUDIO);
+        audioTrack.Uint(Mkv::TrackType, 2);
+        audioTrack.String(Mkv::CodecID, "A_PCM/INT/LIT");
+        audioTrack.Master(Mkv::Audio, audio);
+
+        EbmlWriter tracks;
+        tracks.Master(Mkv::TrackEntry, videoTrack);
+        tracks.Master(Mkv::TrackEntry, audioTrack);
+        head.Master(Mkv::Tracks, tracks);
+
+        Emit(head);
+        headerWritten = true;
+    }
+
+    // Cluster timecodes never go backwards: a block older than its cluster gets a negative
+    // relative timecode (audio trailing the keyframe that opened the cluster)
+    void OpenCluster(int64_t timecode) {
+        if (clusterOpen && timecode < clusterTimecode) timecode = clusterTimecode;
+        EbmlWriter cluster;
+        cluster.Id(Mkv::Cluster);
+        cluster.Size(Mkv::UnknownSize);
+        cluster.Uint(Mkv::Timecode, (uint64_t)timecode);
+        Emit(cluster);
+        clusterTimecode = timecode;
+        clusterOpen = true;
+    }
+
+    void WriteBlockHeader(int track, int64_t timecode, bool keyframe, size_t payloadSize) {
+        EbmlWriter block;
+        block.Id(Mkv::SimpleBlock);
+        block.Size(payloadSize + 4);
+        block.bytes.push_back((uint8_t)(0x80 | track));
+        int16_t relative = (int16_t)(timecode - clusterTimecode);
+        block.bytes.push_back((uint8_t)(relative >> 8));
+        block.bytes.push_back((uint8_t)relative);
+        block.bytes.push_back(keyframe ? 0x80 : 0x00);
+        Emit(block);
+    }
+
+    void WriteVideo(const PacketRef& packet) {
+        bool keyframe = packet->frameType == (uint32_t)FrameType::IDR;
+        AccessUnitInfo au = parser.ParseAccessUnit(packet.Data(), packet.Size());
+        if (needIdr) {
+            if (!keyframe || !au.sps.data || !au.pps.data) return;
+            needIdr = false;
+        }
+        if (!headerWritten) {
+            startTime = packet->timestamp;
+            WriteHeader(au);
+        }
+
+        int64_t timecode = ElapsedMs(packet->timestamp);
+        if (!clusterOpen || keyframe || timecode - clusterTimecode > RECORDER_CLUSTER_MAX_MS) OpenCluster(timecode);
+
+        // Annex-B -> 4-byte length prefixes, written straight into the output block
+        const uint8_t* data = packet.Data();
+        size_t size = packet.Size();
+        size_t payload = 0;
+        size_t pos = 0;
+        const uint8_t* nal;
+        size_t nalSize;
+        while (AnnexBParser::NextNal(data, size, pos, nal, nalSize)) payload += 4 + nalSize;
+
+        WriteBlockHeader(RECORDER_TRACK_VIDEO, timecode, keyframe, payload);
+        pos = 0;
+        while (AnnexBParser::NextNal(data, size, pos, nal, nalSize)) {
+            uint8_t length[4] = { (uint8_t)(nalSize >> 24), (uint8_t)(nalSize >> 16), (uint8_t)(nalSize >> 8), (uint8_t)nalSize };
+            Emit(length, 4);
+            Emit(nal, nalSize);
+        }
+        stats.packetsWritten++;
+    }
+
+    void WriteAudio(const PacketRef& packet) {
+        if (!headerWritten) return; // Nothing before the first IDR
+
+        // Timestamps follow the sample count so capture jitter does not smear the track
+        if (audioSamples == 0) audioStart = packet->timestamp < startTime ? startTime : packet->timestamp;
+        int64_t timecode = ElapsedMs(audioStart) + (int64_t)(audioSamples / 48);
+        audioSamples += packet.Size() / 4;
+
+        if (!clusterOpen || timecode - clusterTimecode > RECORDER_CLUSTER_MAX_MS) OpenCluster(timecode);
+        if (timecode - clusterTimecode < INT16_MIN) { // Beyond a block's relative timecode
+            stats.droppedPackets++;
+            return;
+        }
+        WriteBlockHeader(RECORDER_TRACK_AUDIO, timecode, true, packet.Size());
+        Emit(packet.Data(), packet.Size());
+        stats.packetsWritten++;
+    }
+};
@@ -0,0 +1,288 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <windows.h>
+
+// Frame pipeline tracer. TRACE_SCOPE records a complete event (name, frame ID,
+// start, duration) into the calling thread's single-producer ring; Dump() drains
+// every ring into Chrome JSON (chrome://tracing, ui.perfetto.dev) or Perfetto protobuf.
+// Disabled cost is one relaxed load and a branch per scope.
+
+#define TRACE_RING_SIZE 16384 // Events per thread, power of two
+#define TRACE_MAX_THREADS 32
+
+struct TraceEvent {
+    const char* name; // String literal
+    uint32_t frameId;
+    uint32_t threadId;
+    uint64_t startNs;
+    uint64_t durationNs;
+};
+
+// Written by one thread, drained by the dumping thread. Full rings drop new events.
+struct TraceRing {
+    TraceEvent events[TRACE_RING_SIZE];
+    std::atomic<uint64_t> head = 0;
+    std::atomic<uint64_t> tail = 0;
+    std::atomic<uint64_t> dropped = 0;
+    uint32_t threadId = 0;
+    char threadName[32] = {};
+};
+
+class Tracer {
+public:
+    static Tracer& Get() {
+        static Tracer instance;
+        return instance;
+    }
+
+    static bool IsEnabled() { return Get().enabled.load(std::memory_order_relaxed); }
+
+    static uint64_t NowNs() {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Frame being processed on this thread (set by the capture loop / receiver, read by later stages)
+    static void SetCurrentFrame(uint32_t frameId) { CurrentFrame() = frameId; }
+    static uint32_t GetCurrentFrame() { return CurrentFrame(); }
+
+    static void SetThreadName(const char* name) {
+        TraceRing* ring = Get().LocalRing();
+        if (ring) strncpy_s(ring->threadName, name, _TRUNCATE);
+    }
+
+    // Discards anything recorded earlier and starts recording
+    void Start() {
+        for (auto& slot : rings) {
+            TraceRing* ring = slot.load(std::memory_order_acquire);
+            if (ring) ring->tail.store(ring->head.load(std::memory_order_acquire), std::memory_order_release);
+        }
+        startNs = NowNs();
+        enabled = true;
+    }
+
+    void Stop() { enabled = false; }
+
+    void Emit(const char* name, uint32_t frameId, uint64_t start, uint64_t end) {
+        TraceRing* ring = LocalRing();
+        if (!ring) return;
+        uint64_t head = ring->head.load(std::memory_order_relaxed);
+        if (head - ring->tail.load(std::memory_order_acquire) >= TRACE_RING_SIZE) {
+            ring->dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        TraceEvent& e = ring->events[head & (TRACE_RING_SIZE - 1)];
+        e.name = name;
+        e.frameId = frameId;
+        e.threadId = ring->threadId;
+        e.startNs = start;
+        e.durationNs = end - start;
+        ring->head.store(head + 1, std::memory_order_release);
+    }
+
+    // Drains every ring and writes <basePath>.json (Chrome) and <basePath>.pftrace (Perfetto)
+    bool Dump(const std::string& basePath) {
+        std::vector<TraceEvent> events;
+        std::vector<std::pair<uint32_t, std::string>> threads;
+        for (auto& slot : rings) {
+            TraceRing* ring = slot.load(std::memory_order_acquire);
+            if (!ring) continue;
+            threads.emplace_back(ring->threadId, ring->threadName);
+            uint64_t head = ring->head.load(std::memory_order_acquire);
+            uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+            for (; tail < head; tail++) events.push_back(ring->events[tail & (TRACE_RING_SIZE - 1)]);
+            ring->tail.store(tail, std::memory_order_release);
+        }
+        // Rings are reused after a thread exits; every thread with events still needs a track
+        for (const TraceEvent& e : events) {
+            bool known = false;
+            for (const auto& t : threads) known = known || t.first == e.threadId;
+            if (!known) threads.emplace_back(e.threadId, std::string());
+        }
+        // Events are emitted when a scope ends; order by start (outer scope first) so slices nest
+        std::sort(events.begin(), events.end(), [](const TraceEvent& a, const TraceEvent& b) {
+            return a.startNs != b.startNs ? a.startNs < b.startNs : a.durationNs > b.durationNs;
+        });
+        return WriteChromeJson(basePath + ".json", events, threads) &&
+               WritePerfetto(basePath + ".pftrace", events, threads);
+    }
+
+    uint64_t GetDroppedCount() const {
+        uint64_t total = 0;
+        for (auto& slot : rings) {
+            TraceRing* ring = slot.load(std::memory_order_acquire);
+            if (ring) total += ring->dropped.load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+private:
+    std::atomic<bool> enabled = false;
+    uint64_t startNs = 0;
+    std::atomic<TraceRing*> rings[TRACE_MAX_THREADS] = {}; // Published once, kept for the process lifetime
+    std::atomic<uint32_t> freeRings = 0xFFFFFFFF;
+
+    // Minimal protobuf encoder for the Perfetto export
+    struct ProtoWriter {
+        std::vector<uint8_t> bytes;
+        void Raw(uint64_t v) {
+            while (v >= 0x80) { bytes.push_back((uint8_t)(v | 0x80)); v >>= 7; }
+            bytes.push_back((uint8_t)v);
+        }
+        void Varint(uint32_t field, uint64_t v) { Raw((uint64_t)field << 3); Raw(v); }
+        void Bytes(uint32_t field, const void* data, size_t size) {
+            Raw(((uint64_t)field << 3) | 2);
+            Raw(size);
+            bytes.insert(bytes.end(), (const uint8_t*)data, (const uint8_t*)data + size);
+        }
+        void String(uint32_t field, const char* s) { Bytes(field, s, strlen(s)); }
+        void Message(uint32_t field, const ProtoWriter& m) { Bytes(field, m.bytes.data(), m.bytes.size()); }
+    };
+
+    static void AppendPacket(std::vector<uint8_t>& out, const ProtoWriter& packet) {
+        ProtoWriter trace;
+        trace.Message(1, packet); // Trace.packet
+        out.insert(out.end(), trace.bytes.begin(), trace.bytes.end());
+    }
+
+    static uint32_t& CurrentFrame() {
+        thread_local uint32_t frameId = 0;
+        return frameId;
+    }
+
+    double RelativeUs(uint64_t ns) const { return ns > startNs ? (ns - startNs) / 1000.0 : 0.0; }
+
+    // Chrome trace event format ("X" complete events, timestamps in microseconds)
+    bool WriteChromeJson(const std::string& path, const std::vector<TraceEvent>& events,
+                         const std::vector<std::pair<uint32_t, std::string>>& threads) const {
+        FILE* f = nullptr;
+        if (fopen_s(&f, path.c_str(), "w") != 0 || !f) return false;
+        fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", f);
+        bool first = true;
+        uint32_t pid = GetCurrentProcessId();
+        for (const auto& thread : threads) {
+            if (thread.second.empty()) continue;
+            fprintf(f, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%u,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                first ? "" : ",\n", pid, thread.first, thread.second.c_str());
+            first = false;
+        }
+        for (const TraceEvent& e : events) {
+            fprintf(f, "%s{\"ph\":\"X\",\"name\":\"%s\",\"pid\":%u,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%u}}",
+                first ? "" : ",\n", e.name, pid, e.threadId, RelativeUs(e.startNs), e.durationNs / 1000.0, e.frameId);
+            first = false;
+        }
+        fputs("\n]}\n", f);
+        fclose(f);
+        return true;
+    }
+
+    // Perfetto TracePacket stream: one thread track per thread, slice begin/end pairs
+    bool WritePerfetto(const std::string& path, const std::vector<TraceEvent>& events,
+                       const std::vector<std::pair<uint32_t, std::string>>& threads) const {
+        std::vector<uint8_t> out;
+        uint32_t pid = GetCurrentProcessId();
+        for (const auto& t : threads) {
+            ProtoWriter thread;
+            thread.Varint(1, pid);              // ThreadDescriptor.pid
+            thread.Varint(2, t.first);          // ThreadDescriptor.tid
+            if (!t.second.empty()) thread.String(5, t.second.c_str());
+            ProtoWriter track;
+            track.Varint(1, TrackUuid(pid, t.first)); // TrackDescriptor.uuid
+            track.Message(4, thread);           // TrackDescriptor.thread
+            ProtoWriter packet;
+            packet.Varint(10, 1);               // trusted_packet_sequence_id
+            packet.Message(60, track);          // track_descriptor
+            AppendPacket(out, packet);
+        }
+        for (const TraceEvent& e : events) {
+            uint64_t trackUuid = TrackUuid(pid, e.threadId);
+            ProtoWriter frame;
+            frame.String(10, "frame");          // DebugAnnotation.name
+            frame.Varint(3, e.frameId);         // DebugAnnotation.uint_value
+
+            ProtoWriter begin;
+            begin.Message(4, frame);            // TrackEvent.debug_annotations
+            begin.Varint(9, 1);                 // TrackEvent.type = SLICE_BEGIN
+            begin.Varint(11, trackUuid);        // TrackEvent.track_uuid
+            begin.String(23, e.name);           // TrackEvent.name
+            ProtoWriter beginPacket;
+            beginPacket.Varint(8, e.startNs);   // timestamp
+            beginPacket.Varint(10, 1);
+            beginPacket.Message(11, begin);     // track_event
+            AppendPacket(out, beginPacket);
+
+            ProtoWriter end;
+            end.Varint(9, 2);                   // SLICE_END
+            end.Varint(11, trackUuid);
+            ProtoWriter endPacket;
+            endPacket.Varint(8, e.startNs + e.durationNs);
+            endPacket.Varint(10, 1);
+            endPacket.Message(11, end);
+            AppendPacket(out, endPacket);
+        }
+        FILE* f = nullptr;
+        if (fopen_s(&f, path.c_str(), "wb") != 0 || !f) return false;
+        fwrite(out.data(), 1, out.size(), f);
+        fclose(f);
+        return true;
+    }
+
+    static uint64_t TrackUuid(uint32_t pid, uint32_t tid) { return ((uint64_t)pid << 32) | tid; }
+
+    // Rings are allocated on a thread's first event and handed back when it exits
+    struct RingLease {
+        Tracer* owner = nullptr;
+        int index = -1;
+        ~RingLease() { if (index >= 0) owner->freeRings.fetch_or(1u << index, std::memory_order_release); }
+    };
+
+    TraceRing* LocalRing() {
+        thread_local RingLease lease;
+        if (lease.index < 0) {
+            uint32_t mask = freeRings.load(std::memory_order_relaxed);
+            while (true) {
+                if (!mask) return nullptr;
+                uint32_t bit = mask & (~mask + 1);
+                if (freeRings.compare_exchange_weak(mask, mask & ~bit, std::memory_order_acquire)) {
+                    int index = 0;
+                    while (!(bit & (1u << index))) index++;
+                    TraceRing* ring = rings[index].load(std::memory_order_acquire);
+                    if (!ring) ring = new TraceRing();
+                    ring->threadId = GetCurrentThreadId();
+                    ring->threadName[0] = 0;
+                    rings[index].store(ring, std::memory_order_release);
+                    lease.owner = this;
+                    lease.index = index;
+                    break;
+                }
+            }
+        }
+        return rings[lease.index].load(std::memory_order_relaxed);
+    }
+};
+
+class ScopedTrace {
+public:
+    ScopedTrace(const char* name, uint32_t frameId) : name(name), frameId(frameId) {
+        if (Tracer::IsEnabled()) start = Tracer::NowNs();
+    }
+    ~ScopedTrace() {
+        if (start && Tracer::IsEnabled()) Tracer::Get().Emit(name, frameId, start, Tracer::NowNs());
+    }
+
+private:
+    const char* name;
+    uint32_t frameId;
+    uint64_t start = 0;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name, frameId) ScopedTrace TRACE_CONCAT(traceScope_, __LINE__)(name, frameId)
@@ -5,6 +5,7 @@
 #include <tchar.h>
 #include <vector>
 #include <string>
+#include <ctime>
 
 // ImGui Includes
 #include "imgui/imgui.h"
@@ -13,12 +14,30 @@
 
 // Your Systems
 #include "common/NetworkManager.h"
+#include "common/ControlChannel.h"
+#include "common/CursorChannel.h"
+#include "common/DatagramSocket.h"
+#include "common/PacketPool.h"
+#include "common/SendQueue.h"
+#include "common/StreamRecorder.h"
+#include "common/StreamReceiver.h"
+#include "common/SharedMemoryRing.h"
+#include "common/Metrics.h"
+#include "common/Tracer.h"
+#include "common/PerfOverlay.h"
 #include "video/DXGICapturer.h"
+#include "video/CursorTracker.h"
+#include "video/CursorOverlay.h"
 #include "video/HardwareEncoder.h"
+#include "video/CapturePipeline.h"
 #include "video/HardwareDecoder.h" 
 #include "video/VideoProcessor.h"
+#include "video/AnnexBParser.h"
+#include "video/ReplaySource.h"
+#include "video/LatencyProbe.h"
 #include "audio/AudioCapturer.h" 
 #include "audio/AudioPlayer.h"   
+#include "audio/AudioRedundancy.h"
 
 #pragma comment(lib, "d3d11.lib")
 
@@ -39,9 +58,30 @@ std::string g_StatusMsg = "Ready";
 
 // Host
 DXGICapturer g_Capturer;
+CursorTracker g_CursorTracker; // Pointer updates at 1 kHz, independent of video frames
 HardwareEncoder g_Encoder;
+CapturePipeline g_CapturePipeline; // Capture -> convert -> encode threads
 AudioCapturer g_AudioCap;
-size_t g_BytesSent = 0;
+AudioRedundancyEncoder g_AudioRed;
+PacketPool g_PacketPool;
+SendQueue g_SendQueue;
+AnnexBParser g_HostParser; // Tags outgoing frames for the drop policy
+StreamRecorder g_Recorder;
+bool g_RecordEnabled = false;
+bool g_ZeroCopySend = false; // Send video straight from the packet pool (SO_SNDBUF = 0)
+SharedRingWriter g_SharedTap;  // Same-host consumers (recorder, analytics) read the stream from here
+bool g_SharedTapEnabled = false;
+ControlReceiver g_ControlReceiver; // Client feedback on the stream socket
+DatagramSocket g_MediaChannel;     // Media over UDP, once the client has offered a port
+// Moving media onto g_MediaChannel: probe -> client confirms -> switched -> a receiver
+// report shows media arriving. Fallback: back on TCP for the rest of the session.
+enum class HostMedia { Tcp, Probing, Switched, Datagrams, Fallback };
+std::mutex g_HostMediaLock; // Control reader thread vs. UI loop
+HostMedia g_HostMedia = HostMedia::Tcp;
+std::chrono::steady_clock::time_point g_HostMediaDeadline;
+std::chrono::steady_clock::time_point g_LastMediaProbe;
+std::atomic<float> g_MediaLoss = 0.0f; // Latest receiver report
+std::atomic<uint64_t> g_ClientKeyframeRequests = 0;
 
 
 // Audio Selection
@@ -50,13 +90,42 @@ int g_SelectedAudioIndex = 0;
 
 
 // Client
+StreamConnector g_Connector; // Discovery + non-blocking connect, polled from the UI loop
+std::chrono::steady_clock::time_point g_JoinTime; // Start of the connect/first-frame measurements
+bool g_FirstFrameDecoded = false;
+StreamReceiver g_Receiver; // Registered I/O receive engine for the stream socket
+DatagramSocket g_ClientMedia; // Media channel, offered to the host on connect
+PacketPool g_MediaPool;
+DatagramReassembler g_MediaReassembler(g_MediaPool);
+bool g_MediaOverDatagrams = false; // Datagram media has arrived; media still on TCP is stale
+ReassemblyStats g_ReportedMedia;   // Reassembly stats at the last receiver report
+uint64_t g_LossHandled = 0;        // Lost packets already covered by a keyframe request
+std::chrono::steady_clock::time_point g_LastReceiverReport;
+std::chrono::steady_clock::time_point g_LastKeyframeRequest;
 HardwareDecoder g_Decoder;
 VideoProcessor g_Converter;
 AudioPlayer g_AudioPlay;
 ID3D11Texture2D* g_DisplayTexture = nullptr; 
 ID3D11ShaderResourceView* g_DisplaySRV = nullptr; 
 POINT g_RemoteCursor = { -1, -1 };
+CursorState g_CursorState; // Cursor channel updates; override the video header positions
+CursorOverlay g_CursorOverlay; // Pointer shapes from the host, drawn over the video
 bool g_ClientInit = false;
+AnnexBParser g_StreamParser;
+int g_StreamWidth = 1920;
+int g_StreamHeight = 1080;
+uint32_t g_DisplayFrameId = 0;
+
+// Tracing
+bool g_TraceEnabled = false;
+
+// Performance overlay
+PerfOverlay g_PerfOverlay;
+bool g_ShowPerfOverlay = true;
+
+// Latency probe (host stamps, client reads)
+bool g_ProbeEnabled = false;
+LatencyProbeReader g_ProbeReader;
 
 extern IMGUI_IMPL_API LRESULT ImGui_ImplWin32_WndProcHandler(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
 
@@ -115,7 +184,425 @@ LRESULT WINAPI WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam) {
     return DefWindowProc(hWnd, msg, wParam, lParam);
 }
 
-int main(int, char**) {
+// Writes the current metrics snapshot next to the executable
+void ExportMetrics() {
+    std::string json = Metrics::Get().Snapshot().ToJson();
+    char fileName[64];
+    sprintf_s(fileName, "metrics_%lld.json", (long long)time(nullptr));
+    FILE* f = nullptr;
+    if (fopen_s(&f, fileName, "w") == 0 && f) {
+        fputs(json.c_str(), f);
+        fclose(f);
+        std::cout << "[Metrics] Saved " << fileName << std::endl;
+    }
+    ImGui::SetClipboardText(json.c_str());
+}
+
+void DrawTraceControls() {
+    if (ImGui::Checkbox("Trace Pipeline", &g_TraceEnabled)) {
+        if (g_TraceEnabled) Tracer::Get().Start();
+        else Tracer::Get().Stop();
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Dump Trace")) {
+        char baseName[64];
+        sprintf_s(baseName, "trace_%lld", (long long)time(nullptr));
+        if (Tracer::Get().Dump(baseName)) std::cout << "[Tracer] Saved " << baseName << ".json / .pftrace" << std::endl;
+    }
+}
+
+// Creates the decoder and converter from g_StreamParser's SPS, from the handshake or the
+// first video packet, and runs one conversion so the video processor's first real blit
+// doesn't pay for its setup
+bool InitClientVideo() {
+    const SequenceInfo& seq = g_StreamParser.GetSequenceInfo();
+    if (!seq.valid) return false;
+    g_StreamWidth = seq.width;
+    g_StreamHeight = seq.height;
+    g_Decoder.Initialize(g_pd3dDevice, g_StreamWidth, g_StreamHeight);
+    g_Converter.Initialize(g_pd3dDevice, g_StreamWidth, g_StreamHeight);
+    g_Converter.ConvertNV12ToBGRA(g_Converter.GetOutputTexture());
+    g_ClientInit = true;
+    std::cout << "[Client] Video pipeline ready for " << g_StreamWidth << "x" << g_StreamHeight << " after "
+              << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - g_JoinTime).count()
+              << " ms" << std::endl;
+    return true;
+}
+
+// Host: feedback and configuration from the client, on the control reader thread
+void OnHostControl(const ControlMessage& message) {
+    switch (message.kind) {
+    case CONTROL_MEDIA_ENDPOINT: {
+        uint16_t port = (uint16_t)message.values[0];
+        sockaddr_in peer = {};
+        int peerLen = sizeof(peer);
+        std::lock_guard<std::mutex> guard(g_HostMediaLock);
+        if (port == 0 || g_HostMedia != HostMedia::Tcp ||
+            getpeername((SOCKET)g_Socket, (sockaddr*)&peer, &peerLen) == SOCKET_ERROR) {
+            break;
+        }
+        peer.sin_port = htons(port);
+        if (!g_MediaChannel.Open(0) || !g_MediaChannel.Connect(peer)) {
+            std::cerr << "[Host] Media channel unavailable, media stays on TCP" << std::endl;
+            g_MediaChannel.Close();
+            break;
+        }
+        // Our port first, so the client can lock its socket to us before the probes arrive.
+        // Media stays on TCP until the client confirms one (PollHostMedia).
+        g_SendQueue.PushControl(MakeControlPacket(g_PacketPool, MakeControlMessage(CONTROL_MEDIA_ENDPOINT, g_MediaChannel.GetPort())));
+        g_HostMedia = HostMedia::Probing;
+        g_HostMediaDeadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(CONTROL_MEDIA_CONFIRM_TIMEOUT_MS);
+        std::cout << "[Host] Probing media channel: UDP " << g_MediaChannel.GetPort() << " -> " << port << std::endl;
+        break;
+    }
+    case CONTROL_MEDIA_CONFIRM: {
+        std::lock_guard<std::mutex> guard(g_HostMediaLock);
+        if (g_HostMedia != HostMedia::Probing) break;
+        g_SendQueue.SetMediaChannel(&g_MediaChannel);
+        g_Encoder.RequestKeyframe(); // Datagram media opens with an IDR
+        g_HostMedia = HostMedia::Switched;
+        g_HostMediaDeadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(CONTROL_MEDIA_CONFIRM_TIMEOUT_MS);
+        std::cout << "[Host] Media channel confirmed, media on UDP" << std::endl;
+        break;
+    }
+    case CONTROL_KEYFRAME_REQUEST:
+        g_ClientKeyframeRequests++;
+        g_Encoder.RequestKeyframe();
+        break;
+    case CONTROL_RECEIVER_REPORT: {
+        uint32_t completed = message.values[0];
+        uint32_t lost = message.values[1];
+        if (completed > 0) {
+            std::lock_guard<std::mutex> guard(g_HostMediaLock);
+            if (g_HostMedia == HostMedia::Switched) g_HostMedia = HostMedia::Datagrams;
+        }
+        if (completed + lost == 0) break;
+        float loss = (float)lost / (float)(completed + lost);
+        g_MediaLoss = loss;
+        g_AudioRed.SetMeasuredLoss(loss);
+        break;
+    }
+    case CONTROL_CURSOR_SHAPE_REQUEST:
+        g_CursorTracker.ResendShape(message.values[0]);
+        break;
+    }
+}
+
+// Host, from the UI loop: probes the media channel until the client confirms one, and
+// returns media to TCP when a deadline passes without confirmation
+void PollHostMedia() {
+    std::lock_guard<std::mutex> guard(g_HostMediaLock);
+    auto now = std::chrono::steady_clock::now();
+    if (g_HostMedia == HostMedia::Probing) {
+        if (now >= g_HostMediaDeadline) {
+            std::cerr << "[Host] No probe confirmed on the media channel, media stays on TCP" << std::endl;
+            g_SendQueue.PushControl(MakeControlPacket(g_PacketPool, MakeControlMessage(CONTROL_MEDIA_ENDPOINT, 0)));
+            g_HostMedia = HostMedia::Fallback;
+        } else if (now - g_LastMediaProbe >= std::chrono::milliseconds(CONTROL_MEDIA_PROBE_INTERVAL_MS)) {
+            // Full-size datagram: proves the path carries media fragments, not just small ones
+            uint8_t probe[DATAGRAM_PAYLOAD - sizeof(PacketHeader)] = {};
+            EncodeControlMessage(MakeControlMessage(CONTROL_MEDIA_PROBE), probe);
+            g_MediaChannel.SendPacket(PACKET_TYPE_CONTROL, probe, sizeof(probe));
+            g_LastMediaProbe = now;
+        }
+    } else if (g_HostMedia == HostMedia::Switched && now >= g_HostMediaDeadline) {
+        std::cerr << "[Host] No media reported on the media channel, back to TCP" << std::endl;
+        g_SendQueue.SetMediaChannel(nullptr); // The socket stays open until the session ends
+        g_SendQueue.PushControl(MakeControlPacket(g_PacketPool, MakeControlMessage(CONTROL_MEDIA_ENDPOINT, 0)));
+        g_Encoder.RequestKeyframe();
+        g_HostMedia = HostMedia::Fallback;
+    }
+}
+
+// Client: opens the media socket and offers its port to the host (0 if it can't be opened,
+// then media stays on TCP)
+void StartClientMedia() {
+    g_CursorState.Reset();
+    g_MediaReassembler.Reset();
+    g_MediaOverDatagrams = false;
+    g_ReportedMedia = g_MediaReassembler.GetStats();
+    g_LossHandled = g_ReportedMedia.lost;
+    g_LastReceiverReport = g_LastKeyframeRequest = std::chrono::steady_clock::now();
+    uint16_t port = g_ClientMedia.Open(0) ? g_ClientMedia.GetPort() : 0;
+    SendControl(g_Net, g_Socket, MakeControlMessage(CONTROL_MEDIA_ENDPOINT, port));
+}
+
+// Client: keyframe requests on loss and periodic receiver reports, on the control channel
+void SendMediaFeedback() {
+    if (!g_MediaOverDatagrams) return;
+    const ReassemblyStats& stats = g_MediaReassembler.GetStats();
+    auto now = std::chrono::steady_clock::now();
+    if (stats.lost > g_LossHandled && now - g_LastKeyframeRequest >= std::chrono::milliseconds(CONTROL_KEYFRAME_REQUEST_GAP_MS)) {
+        // The lost packet may have been audio; a spare IDR is cheaper than a smeared picture
+        SendControl(g_Net, g_Socket, MakeControlMessage(CONTROL_KEYFRAME_REQUEST));
+        g_LossHandled = stats.lost;
+        g_LastKeyframeRequest = now;
+    }
+    if (now - g_LastReceiverReport >= std::chrono::milliseconds(CONTROL_REPORT_INTERVAL_MS)) {
+        SendControl(g_Net, g_Socket, MakeControlMessage(CONTROL_RECEIVER_REPORT,
+            (uint32_t)(stats.completed - g_ReportedMedia.completed), (uint32_t)(stats.lost - g_ReportedMedia.lost),
+            (uint32_t)(stats.dropped - g_ReportedMedia.dropped)));
+        g_ReportedMedia = stats;
+        g_LastReceiverReport = now;
+    }
+}
+
+void StopClientMedia() {
+    g_ClientMedia.Close();
+    g_MediaReassembler.Reset();
+    g_MediaOverDatagrams = false;
+}
+
+// Client: one packet from either channel
+void HandleStreamPacket(const PacketHeader& header, PacketRef& packet, bool fromDatagram) {
+    const uint8_t* payload = packet.Data();
+    // From the packet's first byte to its last
+    Metrics::Get().Record(Stage::Receive, std::chrono::steady_clock::now() - packet->timestamp);
+    Metrics::Get().Add(Counter::PacketsReceived);
+    Metrics::Get().Add(Counter::BytesReceived, header.payloadSize + sizeof(PacketHeader));
+
+    bool media = header.packetType == PACKET_TYPE_VIDEO || header.packetType == PACKET_TYPE_AUDIO;
+    if (media && !fromDatagram && g_MediaOverDatagrams) return; // Sent before the switch, already overtaken
+
+    if (header.packetType == PACKET_TYPE_VIDEO) {
+        // --- HANDLE VIDEO ---
+        if (!g_CursorState.IsActive()) {
+            g_RemoteCursor.x = header.cursorX;
+            g_RemoteCursor.y = header.cursorY;
+        }
+
+        if (!g_ClientInit) {
+            // No parameter sets in the handshake: size the decoder from the stream's
+            // SPS; nothing decodes before one arrives
+            g_StreamParser.ParseAccessUnit(payload, header.payloadSize);
+            if (!InitClientVideo()) return;
+        }
+
+        ID3D11Texture2D* decoded = nullptr;
+        {
+            ScopedStageTimer decodeTimer(Stage::Decode);
+            decoded = g_Decoder.Decode(payload, header.payloadSize, g_pd3dDeviceContext);
+        }
+        if (decoded) {
+            Metrics::Get().Add(Counter::FramesDecoded);
+            if (!g_FirstFrameDecoded) {
+                g_FirstFrameDecoded = true;
+                auto firstFrame = std::chrono::steady_clock::now() - g_JoinTime;
+                Metrics::Get().Record(Stage::FirstFrame, firstFrame);
+                std::cout << "[Client] First frame after "
+                          << std::chrono::duration<double, std::milli>(firstFrame).count() << " ms" << std::endl;
+            }
+            if (g_ProbeEnabled) {
+                if (!g_ProbeReader.IsActive()) {
+                    char fileName[64];
+                    sprintf_s(fileName, "latency_%lld.csv", (long long)time(nullptr));
+                    g_ProbeReader.Start(g_pd3dDevice, fileName);
+                }
+                g_ProbeReader.Submit(g_pd3dDeviceContext, decoded);
+            }
+            g_DisplayFrameId = header.frameId;
+            ID3D11Texture2D* newTex = g_Converter.ConvertNV12ToBGRA(decoded);
+            if (newTex && newTex != g_DisplayTexture) {
+                g_DisplayTexture = newTex;
+                if (g_DisplaySRV) { g_DisplaySRV->Release(); g_DisplaySRV = nullptr; }
+                g_pd3dDevice->CreateShaderResourceView(g_DisplayTexture, nullptr, &g_DisplaySRV);
+            }
+        }
+    }
+    else if (header.packetType == PACKET_TYPE_AUDIO) {
+        // --- HANDLE AUDIO ---
+        g_AudioPlay.QueueAudio(payload, header.payloadSize);
+    }
+    else if (header.packetType == PACKET_TYPE_STREAM_INFO) {
+        // --- HANDSHAKE --- the decoder is ready before the first frame arrives
+        if (!g_ClientInit && header.payloadSize > 0) {
+            g_StreamParser.ParseAccessUnit(payload, header.payloadSize);
+            InitClientVideo();
+        }
+    }
+    else if (header.packetType == PACKET_TYPE_CURSOR) {
+        // --- CURSOR --- drawn at the next UI frame, whatever the video is doing
+        CursorMessage cursor;
+        if (DecodeCursorMessage(payload, header.payloadSize, cursor) && g_CursorState.Apply(cursor)) {
+            g_RemoteCursor = g_CursorState.GetPosition();
+        }
+    }
+    else if (header.packetType == PACKET_TYPE_CURSOR_SHAPE) {
+        CursorShape shape;
+        if (DecodeCursorShape(payload, header.payloadSize, shape)) g_CursorOverlay.AddShape(g_pd3dDevice, shape);
+    }
+    else if (header.packetType == PACKET_TYPE_CONTROL) {
+        ControlMessage message;
+        if (!DecodeControlMessage(payload, header.payloadSize, message)) return;
+        if (message.kind == CONTROL_MEDIA_ENDPOINT && message.values[0] != 0) {
+            // Only the host's datagrams from here on
+            sockaddr_in host = g_Connector.GetHostAddress();
+            host.sin_port = htons((uint16_t)message.values[0]);
+            g_ClientMedia.Connect(host);
+        } else if (message.kind == CONTROL_MEDIA_ENDPOINT && !fromDatagram) {
+            // The host gave up on the media channel: media is back on TCP, and a straggling
+            // datagram must not make the TCP media look stale again
+            std::cerr << "[Client] Media channel given up, media on TCP" << std::endl;
+            StopClientMedia();
+        } else if (message.kind == CONTROL_MEDIA_PROBE && fromDatagram) {
+            SendControl(g_Net, g_Socket, MakeControlMessage(CONTROL_MEDIA_CONFIRM));
+        }
+    }
+}
+
+// Client: every datagram already queued on the media channel
+void ReceiveMediaDatagrams() {
+    DatagramView views[256];
+    PacketHeader header;
+    PacketRef packet;
+    int count;
+    while ((count = g_ClientMedia.Receive(views, 256, 0)) > 0) {
+        for (int i = 0; i < count; i++) {
+            if (!g_MediaReassembler.Push(views[i].data, views[i].size, header, packet)) continue;
+            if (header.packetType == PACKET_TYPE_VIDEO || header.packetType == PACKET_TYPE_AUDIO) g_MediaOverDatagrams = true;
+            HandleStreamPacket(header, packet, true);
+        }
+    }
+}
+
+// ===== REPLAY =====
+// --replay <file>      : decode a recorded stream without a window and report fps / latency
+// --replay-host <file> : serve a recorded stream to a client instead of capturing
+// --fps N              : pacing (default: stream timing), 0 = flat out
+void ReportLatency(const char* label, LatencyStats& latency) {
+    std::cout << "[Replay] " << label << " latency ms: p50 " << latency.Percentile(50)
+              << " | p90 " << latency.Percentile(90) << " | p99 " << latency.Percentile(99)
+              << " | max " << latency.Percentile(100) << std::endl;
+}
+
+// HardwareDecoder and the client's handshake only know H.264
+bool IsReplayableCodec(const ReplaySource& source) {
+    if (source.GetCodec() == VideoCodec::H264) return true;
+    std::cerr << "[Replay] HEVC streams can't be replayed yet: decoding is H.264 only" << std::endl;
+    return false;
+}
+
+int RunReplayDecode(ReplaySource& source, double fps) {
+    if (!IsReplayableCodec(source)) return 1;
+    ComPtr<ID3D11Device> device;
+    ComPtr<ID3D11DeviceContext> context;
+    if (FAILED(D3D11CreateDevice(nullptr, D3D_DRIVER_TYPE_HARDWARE, nullptr, 0, nullptr, 0,
+                                 D3D11_SDK_VERSION, &device, nullptr, &context))) {
+        std::cerr << "[Replay] D3D11CreateDevice failed" << std::endl;
+        return 1;
+    }
+    const SequenceInfo& seq = source.GetSequenceInfo();
+    HardwareDecoder decoder;
+    if (!decoder.Initialize(device.Get(), seq.width, seq.height)) return 1;
+
+    // Decoders may hold frames back; outputs are matched to submissions in order
+    const size_t RING = 64;
+    std::chrono::steady_clock::time_point submitted[RING];
+    size_t submitCount = 0;
+    size_t outputCount = 0;
+
+    size_t frameCount = source.GetFrameCount();
+    LatencyStats decodeLatency;
+    LatencyStats submitLatency;
+    decodeLatency.Reserve(frameCount);
+    submitLatency.Reserve(frameCount);
+
+    ReplayPacer pacer;
+    pacer.Start(fps);
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < frameCount; i++) {
+        pacer.WaitForFrame(i);
+        const ReplayFrame& frame = source.GetFrame(i);
+        auto t0 = std::chrono::steady_clock::now();
+        submitted[submitCount++ % RING] = t0;
+        ID3D11Texture2D* out = decoder.Decode(frame.data, frame.size, context.Get());
+        auto t1 = std::chrono::steady_clock::now();
+        submitLatency.Add(std::chrono::duration<double, std::milli>(t1 - t0).count());
+        if (out && outputCount < submitCount) {
+            decodeLatency.Add(std::chrono::duration<double, std::milli>(t1 - submitted[outputCount++ % RING]).count());
+        }
+        if (submitCount - outputCount >= RING) outputCount = submitCount - RING + 1; // Lost track, resync
+    }
+    while (outputCount < submitCount && decoder.DrainOutput()) {
+        auto now = std::chrono::steady_clock::now();
+        decodeLatency.Add(std::chrono::duration<double, std::milli>(now - submitted[outputCount++ % RING]).count());
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "[Replay] Decoded " << decodeLatency.GetCount() << "/" << frameCount << " frames in "
+              << seconds << "s (" << decodeLatency.GetCount() / seconds << " fps)" << std::endl;
+    ReportLatency("Submit", submitLatency);
+    ReportLatency("Decode", decodeLatency);
+    decoder.Cleanup();
+    return 0;
+}
+
+int RunReplayHost(ReplaySource& source, double fps) {
+    if (!IsReplayableCodec(source)) return 1;
+    std::cout << "[Replay] Waiting for client..." << std::endl;
+    int clientSock = -1;
+    if (!g_Net.WaitForReceiver(clientSock, DISCOVERY_CAP_REPLAY)) return 1;
+
+    // Handshake: the first frame's SPS/PPS, as a live host sends its encoder's
+    std::vector<uint8_t> parameterSets;
+    if (source.GetFrameCount() > 0) {
+        AnnexBParser parser;
+        const ReplayFrame& first = source.GetFrame(0);
+        AccessUnitInfo au = parser.ParseAccessUnit(first.data, first.size);
+        static const uint8_t startCode[] = { 0, 0, 0, 1 };
+        for (const NalUnit& nal : { au.sps, au.pps }) {
+            if (!nal.data) continue;
+            parameterSets.insert(parameterSets.end(), startCode, startCode + sizeof(startCode));
+            parameterSets.insert(parameterSets.end(), nal.data, nal.data + nal.size);
+        }
+    }
+    g_Net.SendPacket(clientSock, PACKET_TYPE_STREAM_INFO, parameterSets.data(), parameterSets.size());
+
+    size_t frameCount = source.GetFrameCount();
+    LatencyStats sendLatency;
+    sendLatency.Reserve(frameCount);
+
+    ReplayPacer pacer;
+    pacer.Start(fps);
+    auto start = std::chrono::steady_clock::now();
+    size_t sent = 0;
+    for (; sent < frameCount; sent++) {
+        pacer.WaitForFrame(sent);
+        const ReplayFrame& frame = source.GetFrame(sent);
+        auto t0 = std::chrono::steady_clock::now();
+        if (!g_Net.SendPacket(clientSock, PACKET_TYPE_VIDEO, frame.data, frame.size, -1, -1,
+                              (uint32_t)sent, (uint32_t)frame.frameType)) break;
+        sendLatency.Add(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count());
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    closesocket(clientSock);
+
+    std::cout << "[Replay] Sent " << sent << "/" << frameCount << " frames in " << seconds << "s ("
+              << sent / seconds << " fps)" << std::endl;
+    ReportLatency("Send", sendLatency);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    std::string replayFile;
+    bool replayHost = false;
+    double replayFps = -1.0;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if ((arg == "--replay" || arg == "--replay-host") && i + 1 < argc) {
+            replayHost = arg == "--replay-host";
+            replayFile = argv[++i];
+        } else if (arg == "--fps" && i + 1 < argc) {
+            replayFps = atof(argv[++i]);
+        }
+    }
+    if (!replayFile.empty()) {
+        ReplaySource source;
+        if (!source.Open(replayFile)) return 1;
+        double fps = replayFps >= 0 ? replayFps : source.GetSourceFps();
+        return replayHost ? RunReplayHost(source, fps) : RunReplayDecode(source, fps);
+    }
+
     WNDCLASSEX wc = { sizeof(WNDCLASSEX), CS_CLASSDC, WndProc, 0L, 0L, GetModuleHandle(nullptr), nullptr, nullptr, nullptr, nullptr, _T("DXGI Streamer"), nullptr };
     RegisterClassEx(&wc);
     HWND hwnd = CreateWindow(wc.lpszClassName, _T("DXGI Zero Copy Streamer"), WS_OVERLAPPEDWINDOW, 100, 100, 1280, 800, nullptr, nullptr, wc.hInstance, nullptr);
@@ -145,62 +632,50 @@ int main(int, char**) {
 
         // --- LOGIC ---
         if (g_State == AppState::CONNECTING) {
-             int sock = -1;
-             if (g_Net.FindAndConnect(sock)) {
-                 g_Socket = sock;
+             // A short wait per UI frame, so a beacon or the connect completion is seen promptly
+             ConnectState connectState = g_Connector.Poll(4);
+             if (connectState == ConnectState::Connected) {
+                 Metrics::Get().Record(Stage::Connect, std::chrono::steady_clock::now() - g_JoinTime);
+                 g_Socket = g_Connector.TakeSocket();
+                 g_Receiver.Start(g_Socket);
+                 StartClientMedia();
                  g_State = AppState::STREAMING;
-                 g_StatusMsg = "Connected!";
+                 g_StatusMsg = std::string("Connected to ") + g_Connector.GetHost().name;
                  // Init Audio Player
                  g_AudioPlay.Initialize();
-             } else {
+             } else if (connectState == ConnectState::Connecting) {
+                 g_StatusMsg = std::string("Connecting to ") + g_Connector.GetHost().name + "...";
+             } else if (connectState == ConnectState::Failed) {
                  g_State = AppState::MENU; 
-                 g_StatusMsg = "Connection timeout.";
+                 g_StatusMsg = std::string("Connection failed: ") + g_Connector.GetError();
              }
         }
         else if (g_State == AppState::STREAMING) {
-            // Check for data loop
-            while (g_Net.IsDataAvailable(g_Socket)) {
-                PacketHeader header;
-                if (g_Net.ReceiveHeader(g_Socket, header)) {
-                    static std::vector<uint8_t> buffer;
-                    if (g_Net.ReceiveBody(g_Socket, buffer, header.payloadSize)) {
-                        
-                        if (header.packetType == PACKET_TYPE_VIDEO) {
-                            // --- HANDLE VIDEO ---
-                            g_RemoteCursor.x = header.cursorX;
-                            g_RemoteCursor.y = header.cursorY;
-
-                            if (!g_ClientInit) {
-                                g_Decoder.Initialize(g_pd3dDevice, 1920, 1080);
-                                g_Converter.Initialize(g_pd3dDevice, 1920, 1080);
-                                g_ClientInit = true;
-                            }
-
-                            ID3D11Texture2D* decoded = g_Decoder.Decode(buffer.data(), header.payloadSize, g_pd3dDeviceContext);
-                            if (decoded) {
-                                ID3D11Texture2D* newTex = g_Converter.ConvertNV12ToBGRA(decoded);
-                                if (newTex && newTex != g_DisplayTexture) {
-                                    g_DisplayTexture = newTex;
-                                    if (g_DisplaySRV) { g_DisplaySRV->Release(); g_DisplaySRV = nullptr; }
-                                    g_pd3dDevice->CreateShaderResourceView(g_DisplayTexture, nullptr, &g_DisplaySRV);
-                                }
-                            }
-                        } 
-                        else if (header.packetType == PACKET_TYPE_AUDIO) {
-                            // --- HANDLE AUDIO ---
-                            g_AudioPlay.QueueAudio(buffer.data(), header.payloadSize);
-                        }
-                    }
-                } else {
-                    g_State = AppState::MENU;
-                    g_StatusMsg = "Host disconnected.";
-                    closesocket(g_Socket); g_Socket = -1;
-                    break;
-                }
+            // Every packet that has fully arrived on either channel; nothing here blocks
+            PacketHeader header;
+            PacketRef packet;
+            while (g_Receiver.Poll(header, packet)) HandleStreamPacket(header, packet, false);
+            ReceiveMediaDatagrams();
+            SendMediaFeedback();
+            if (!g_Receiver.IsConnected()) {
+                g_State = AppState::MENU;
+                g_StatusMsg = "Host disconnected.";
+                closesocket(g_Socket); g_Socket = -1;
+                g_Receiver.Stop();
+                StopClientMedia();
+                g_ProbeReader.Stop();
             }
+            g_ProbeReader.Poll(g_pd3dDeviceContext);
+            // Keep audio flowing (and conceal gaps) between packets
+            g_AudioPlay.Pump();
+            Metrics::Get().Set(Gauge::AudioJitterDepth, g_AudioPlay.GetJitterBuffer().GetDepth());
+        }
+        else if (g_State == AppState::HOSTING) {
+            PollHostMedia();
         }
 
         // --- RENDER ---
+        TRACE_SCOPE("Present", g_DisplayFrameId);
         ImGui_ImplDX11_NewFrame();
         ImGui_ImplWin32_NewFrame();
         ImGui::NewFrame();
@@ -213,15 +688,11 @@ int main(int, char**) {
             auto drawList = ImGui::GetBackgroundDrawList();
             drawList->AddImage((void*)g_DisplaySRV, ImVec2(0,0), ImVec2(w,h));
 
-            if (g_RemoteCursor.x != -1) {
-                float scaleX = w / 1920.0f; 
-                float scaleY = h / 1080.0f;
-                float bx = g_RemoteCursor.x * scaleX;
-                float by = g_RemoteCursor.y * scaleY;
-                float cs = 16.0f;
-                drawList->AddTriangleFilled(ImVec2(bx, by), ImVec2(bx, by+cs), ImVec2(bx+cs*0.75f, by+cs*0.75f), IM_COL32(255,255,255,255));
-                drawList->AddTriangle(ImVec2(bx, by), ImVec2(bx, by+cs), ImVec2(bx+cs*0.75f, by+cs*0.75f), IM_COL32(0,0,0,255), 1.5f);
-            }
+            // The pointer is never in the video; drawn here at the host's size, scaled with the stream
+            float scaleX = w / (float)g_StreamWidth;
+            float scaleY = h / (float)g_StreamHeight;
+            uint32_t missingShape = g_CursorOverlay.Draw(drawList, g_RemoteCursor, g_CursorState.GetShapeId(), scaleX, scaleY);
+            if (missingShape) SendControl(g_Net, g_Socket, MakeControlMessage(CONTROL_CURSOR_SHAPE_REQUEST, missingShape));
         }
 
         // 2. Draw UI
@@ -249,6 +720,10 @@ int main(int, char**) {
             } else {
                 ImGui::TextDisabled("No Audio Devices Found");
             }
+            ImGui::Checkbox("Record stream to file (.mkv)", &g_RecordEnabled);
+            ImGui::Checkbox("Zero-copy send", &g_ZeroCopySend);
+            ImGui::Checkbox("Publish to shared memory (" SHARED_TAP_NAME ")", &g_SharedTapEnabled);
+            ImGui::Checkbox("Latency probe (barcode in frame corner)", &g_ProbeEnabled);
             ImGui::Separator();
             // ---------------------
 
@@ -256,32 +731,103 @@ int main(int, char**) {
                 g_StatusMsg = "Waiting for client...";
                 
                 std::thread hostThread([&]() {
+                    // Capture and encoder come up while we wait for the client, so its first
+                    // frame only costs one encode
+                    static bool encInit = false;
+                    g_Capturer.Initialize();
+                    int frameWidth = 0, frameHeight = 0;
+                    if (!encInit && g_Capturer.GetFrameSize(frameWidth, frameHeight)) {
+                        encInit = g_Encoder.Initialize(g_Capturer.GetDevice(), frameWidth, frameHeight);
+                    }
+                    std::vector<uint8_t> parameterSets;
+                    if (encInit) g_Encoder.GetParameterSets(parameterSets);
+
                     int clientSock = -1;
-                    if (g_Net.WaitForReceiver(clientSock)) {
+                    uint16_t capabilities = g_AudioDevices.empty() ? 0 : DISCOVERY_CAP_AUDIO;
+                    if (g_Net.WaitForReceiver(clientSock, capabilities)) {
+                        // Handshake before any media, so the client creates its decoder while the
+                        // first frame is being encoded
+                        g_Net.SendPacket(clientSock, PACKET_TYPE_STREAM_INFO, parameterSets.data(), parameterSets.size());
+                        g_Encoder.RequestKeyframe(); // Opens with an IDR, also on an encoder reused from a previous session
                         g_Socket = clientSock;
                         g_State = AppState::HOSTING;
                         g_StatusMsg = "Streaming...";
                         
-                        // Start Video
-                        static bool encInit = false;
-                        g_Capturer.Initialize();
+                        g_SendQueue.ResetStats();
+                        g_SendQueue.SetZeroCopy(g_ZeroCopySend);
+                        g_SendQueue.Start(&g_Net, clientSock, []() { g_Encoder.RequestKeyframe(); });
+                        g_MediaLoss = 0.0f;
+                        g_ClientKeyframeRequests = 0;
+                        g_HostMedia = HostMedia::Tcp;
+                        g_ControlReceiver.Start(clientSock, OnHostControl);
+                        if (g_RecordEnabled) {
+                            char fileName[64];
+                            sprintf_s(fileName, "recording_%lld.mkv", (long long)time(nullptr));
+                            g_Recorder.Start(fileName, []() { g_Encoder.RequestKeyframe(); });
+                        }
+                        // The recording only gets video, so with WGC it keeps the pointer in the
+                        // frames, and the client sees that one instead of the cursor channel's
+                        g_Capturer.KeepCursorInFrame(g_RecordEnabled);
+                        if (g_SharedTapEnabled) g_SharedTap.Create(SHARED_TAP_NAME);
+
+                        // Start Video. The cursor tracker first: it keeps the pointer shapes the
+                        // capturer reports from its first frame on.
+                        if (!g_Capturer.IsCursorInFrame()) {
+                            g_CursorTracker.Start(g_Capturer.GetOutputRect(), !g_Capturer.ReportsPointerShapes(),
+                                [](const CursorMessage& cursor) {
+                                    PacketRef packet = MakeCursorPacket(g_PacketPool, cursor);
+                                    g_SharedTap.Write(PACKET_TYPE_CURSOR, packet.Data(), packet.Size(), cursor.x, cursor.y);
+                                    g_SendQueue.PushCursor(std::move(packet));
+                                },
+                                [](const CursorShape& shape) {
+                                    PacketRef packet = MakeCursorShapePacket(g_PacketPool, shape);
+                                    g_SharedTap.Write(PACKET_TYPE_CURSOR_SHAPE, packet.Data(), packet.Size());
+                                    g_SendQueue.PushControl(std::move(packet)); // Reliable, sent once
+                                });
+                            g_Capturer.SetPointerShapeCallback([](const CursorShape& shape) { g_CursorTracker.SubmitShape(shape); });
+                        }
+                        g_Capturer.SetLatencyProbe(g_ProbeEnabled);
+                        g_CapturePipeline.Start(&g_Encoder, [](const uint8_t* data, size_t size, uint32_t frameId, POINT pt) {
+                            Metrics::Get().Add(Counter::FramesEncoded);
+                            Metrics::Get().Add(Counter::EncodedBytes, size);
+                            Metrics::Get().Set(Gauge::EncodedFrameBytes, (int64_t)size);
+                            AccessUnitInfo au = g_HostParser.ParseAccessUnit(data, size);
+                            PacketRef packet = g_PacketPool.Acquire(data, size);
+                            packet->packetType = PACKET_TYPE_VIDEO;
+                            packet->frameId = frameId; // Set by the capture loop
+                            packet->frameType = (uint32_t)au.frameType;
+                            packet->cursorX = pt.x;
+                            packet->cursorY = pt.y;
+                            g_Recorder.Push(packet); // Shares the buffer
+                            g_SharedTap.Write(PACKET_TYPE_VIDEO, data, size, pt.x, pt.y, frameId, packet->frameType);
+                            g_SendQueue.Push(std::move(packet));
+                        });
                         g_Capturer.Start([&](ID3D11Texture2D* tex, ID3D11DeviceContext* ctx, POINT pt) {
-                            if (!encInit) {
+                            if (!encInit && tex) { // Frame size wasn't known up front
                                 D3D11_TEXTURE2D_DESC d; tex->GetDesc(&d);
                                 ComPtr<ID3D11Device> dev; ctx->GetDevice(&dev);
                                 g_Encoder.Initialize(dev.Get(), d.Width, d.Height);
                                 encInit = true;
                             }
-                            g_Encoder.EncodeFrame(tex, ctx, [&](const uint8_t* data, size_t size) {
-                                g_Net.SendPacket(g_Socket, PACKET_TYPE_VIDEO, data, size, pt.x, pt.y);
-                                g_BytesSent += size;
-                            });
+                            g_CapturePipeline.Submit(tex, ctx, pt); // Only queues a copy, the surface is released on return
                         });
 
                         // Start Audio
                         if (!g_AudioDevices.empty()) {
+                            g_AudioRed.Reset();
                             g_AudioCap.Start(g_AudioDevices[g_SelectedAudioIndex].id, [&](const uint8_t* data, size_t size) {
-                                g_Net.SendPacket(g_Socket, PACKET_TYPE_AUDIO, data, size);
+                                g_SharedTap.Write(PACKET_TYPE_AUDIO, data, size); // Raw PCM, as recorded
+                                if (g_Recorder.IsRecording()) {
+                                    // Record the raw PCM (no DTX gaps or redundancy framing)
+                                    PacketRef pcm = g_PacketPool.Acquire(data, size);
+                                    pcm->packetType = PACKET_TYPE_AUDIO;
+                                    g_Recorder.Push(pcm);
+                                }
+                                const auto& packet = g_AudioRed.Encode((const int16_t*)data, size / 4);
+                                if (packet.empty()) return;
+                                PacketRef audio = g_PacketPool.Acquire(packet.data(), packet.size());
+                                audio->packetType = PACKET_TYPE_AUDIO;
+                                g_SendQueue.Push(std::move(audio));
                             });
                         }
 
@@ -293,34 +839,95 @@ int main(int, char**) {
             }
 
             if (ImGui::Button("JOIN STREAM", ImVec2(330, 50))) {
-                g_StatusMsg = "Searching...";
-                g_State = AppState::CONNECTING; 
+                g_JoinTime = std::chrono::steady_clock::now();
+                g_FirstFrameDecoded = false;
+                if (g_Connector.Begin(DISCOVERY_PORT)) {
+                    g_StatusMsg = "Searching...";
+                    g_State = AppState::CONNECTING; 
+                } else {
+                    g_StatusMsg = std::string("Connection failed: ") + g_Connector.GetError();
+                }
+            }
+        }
+        else if (g_State == AppState::CONNECTING) {
+            if (ImGui::Button("Cancel")) {
+                g_Connector.Cancel();
+                g_State = AppState::MENU;
+                g_StatusMsg = "Ready";
             }
         }
         else if (g_State == AppState::HOSTING) {
-            ImGui::Text("Sent: %.2f MB", g_BytesSent / 1024.0f / 1024.0f);
+            const SendQueueStats& sq = g_SendQueue.GetStats();
+            ImGui::Text("Sent: %.2f MB", sq.sentBytes / 1024.0f / 1024.0f);
+            ImGui::Text("Send Queue: %zu", g_SendQueue.GetDepth());
+            ImGui::Text("Dropped: %llu non-ref, %llu superseded, %llu cut, %llu awaiting IDR",
+                (unsigned long long)sq.droppedNonReference, (unsigned long long)sq.droppedSuperseded,
+                (unsigned long long)sq.droppedDeepCut, (unsigned long long)sq.droppedAwaitingIdr);
+            ImGui::Text("Keyframe Requests: %llu (client %llu)", (unsigned long long)sq.keyframeRequests,
+                (unsigned long long)g_ClientKeyframeRequests.load());
+            ImGui::Text("Media: %s | loss %.1f%% | %llu control msgs", g_SendQueue.HasMediaChannel() ? "UDP" : "TCP",
+                g_MediaLoss.load() * 100.0f, (unsigned long long)sq.controlPackets);
+            ImGui::Text("Cursor: %llu updates (%llu superseded), %llu shapes", (unsigned long long)sq.cursorPackets,
+                (unsigned long long)sq.cursorSuperseded, (unsigned long long)g_CursorTracker.GetShapesSent());
+            if (g_Recorder.IsRecording()) {
+                const RecorderStats& rs = g_Recorder.GetStats();
+                ImGui::Text("Recording: %.2f MB (%llu dropped, %llu keyframe requests)", rs.bytesWritten / 1024.0f / 1024.0f,
+                    (unsigned long long)rs.droppedPackets, (unsigned long long)rs.keyframeRequests);
+            }
+            ImGui::Checkbox("Performance Overlay", &g_ShowPerfOverlay);
+            if (ImGui::Button("Export Metrics")) ExportMetrics();
+            DrawTraceControls();
             if (ImGui::Button("Stop Hosting")) {
                 g_Capturer.Stop();
+                g_CursorTracker.Stop();
+                g_CapturePipeline.Stop();
                 g_AudioCap.Stop(); // Stop Audio
+                closesocket(g_Socket); g_Socket = -1; // Unblocks a sender stuck in send()
+                g_ControlReceiver.Stop();
+                g_SendQueue.Stop();
+                g_MediaChannel.Close();
+                g_Recorder.Stop();
+                g_SharedTap.Close();
+                g_PerfOverlay.Reset();
                 g_State = AppState::MENU;
-                g_BytesSent = 0;
             }
         }
         else if (g_State == AppState::STREAMING) {
+            if (g_ProbeReader.IsActive()) {
+                const ProbeReaderStats& ps = g_ProbeReader.GetStats();
+                ImGui::Text("Probe: %.1f ms (frame %u) | %llu read, %llu missed", ps.lastLatencyMs, ps.lastFrameId,
+                    (unsigned long long)ps.detected, (unsigned long long)ps.missed);
+            }
+            ImGui::Checkbox("Performance Overlay", &g_ShowPerfOverlay);
+            if (ImGui::Button("Export Metrics")) ExportMetrics();
+            DrawTraceControls();
             if (ImGui::Button("Disconnect")) {
                 closesocket(g_Socket); g_Socket = -1;
+                g_Receiver.Stop();
+                StopClientMedia();
+                g_ProbeReader.Stop();
+                g_PerfOverlay.Reset();
                 g_State = AppState::MENU;
             }
         }
 
         ImGui::End();
+
+        // 3. Performance overlay
+        if (g_ShowPerfOverlay && (g_State == AppState::HOSTING || g_State == AppState::STREAMING)) {
+            g_PerfOverlay.Draw(g_State == AppState::HOSTING);
+        }
         ImGui::Render();
 
         float clearColor[] = { 0.1f, 0.1f, 0.1f, 1.0f };
         g_pd3dDeviceContext->OMSetRenderTargets(1, &g_mainRenderTargetView, nullptr);
         g_pd3dDeviceContext->ClearRenderTargetView(g_mainRenderTargetView, clearColor);
         ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
-        g_pSwapChain->Present(1, 0);
+        {
+            ScopedStageTimer presentTimer(Stage::Present);
+            g_pSwapChain->Present(1, 0);
+        }
+        if (g_State == AppState::STREAMING) Metrics::Get().Add(Counter::FramesPresented);
     }
 
     ImGui_ImplDX11_Shutdown(); ImGui_ImplWin32_Shutdown(); ImGui::DestroyContext();
@@ -0,0 +1,566 @@
+#include "AnnexBParser.h"
+#include <emmintrin.h> // SSE2
+
+#ifdef _MSC_VER
+#include <intrin.h>
+static inline int LowestSetBit(uint32_t mask) {
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (int)index;
+}
+#else
+static inline int LowestSetBit(uint32_t mask) { return __builtin_ctz(mask); }
+#endif
+
+// =============================================================
+// BIT READER (RBSP view over escaped NAL payload)
+// =============================================================
+
+// Reads bits directly from the NAL, dropping 0x03 emulation prevention bytes
+// as they are encountered so the payload never has to be unescaped.
+class RbspReader {
+public:
+    RbspReader(const uint8_t* data, size_t size) : data(data), size(size) {}
+
+    uint32_t ReadBits(int count) {
+        uint32_t value = 0;
+        for (int i = 0; i < count; i++) value = (value << 1) | ReadBit();
+        return value;
+    }
+
+    uint32_t ReadBit() {
+        if (bitPos == 0) {
+            if (!LoadByte()) { overrun = true; return 0; }
+        }
+        bitPos--;
+        return (current >> bitPos) & 1;
+    }
+
+    bool ReadFlag() { return ReadBit() != 0; }
+
+    uint32_t ReadUE() {
+        int leadingZeros = 0;
+        while (ReadBit() == 0) {
+            if (overrun || ++leadingZeros > 31) { overrun = true; return 0; }
+        }
+        if (leadingZeros == 0) return 0;
+        return ((1u << leadingZeros) - 1) + ReadBits(leadingZeros);
+    }
+
+    int32_t ReadSE() {
+        uint32_t v = ReadUE();
+        return (v & 1) ? (int32_t)((v + 1) / 2) : -(int32_t)(v / 2);
+    }
+
+    void SkipBits(int count) { for (int i = 0; i < count; i++) ReadBit(); }
+
+    bool Failed() const { return overrun; }
+
+private:
+    const uint8_t* data;
+    size_t size;
+    size_t pos = 0;
+    int zeroRun = 0;
+    uint8_t current = 0;
+    int bitPos = 0;
+    bool overrun = false;
+
+    bool LoadByte() {
+        if (pos >= size) return false;
+        uint8_t b = data[pos++];
+        if (zeroRun >= 2 && b == 0x03) {
+            zeroRun = 0;
+            if (pos >= size) return false;
+            b = data[pos++];
+        }
+        zeroRun = (b == 0) ? zeroRun + 1 : 0;
+        current = b;
+        bitPos = 8;
+        return true;
+    }
+};
+
+// =============================================================
+// START CODE SCANNING
+// =============================================================
+
+size_t AnnexBParser::FindStartCode(const uint8_t* data, size_t size, size_t pos) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi8(1);
+
+    // Check 16 candidate positions at once: data[i] == 0 && data[i+1] == 0 && data[i+2] == 1
+    while (pos + 18 <= size) {
+        __m128i b0 = _mm_loadu_si128((const __m128i*)(data + pos));
+        __m128i b1 = _mm_loadu_si128((const __m128i*)(data + pos + 1));
+        __m128i b2 = _mm_loadu_si128((const __m128i*)(data + pos + 2));
+        __m128i hit = _mm_and_si128(_mm_and_si128(_mm_cmpeq_epi8(b0, zero), _mm_cmpeq_epi8(b1, zero)),
+                                    _mm_cmpeq_epi8(b2, one));
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(hit);
+        if (mask) return pos + LowestSetBit(mask);
+        pos += 16;
+    }
+
+    for (; pos + 3 <= size; pos++) {
+        if (data[pos] == 0 && data[pos + 1] == 0 && data[pos + 2] == 1) return pos;
+    }
+    return size;
+}
+
+bool AnnexBParser::NextNal(const uint8_t* data, size_t size, size_t& pos, const uint8_t*& nal, size_t& nalSize) {
+    size_t start = FindStartCode(data, size, pos);
+    if (start >= size) {
+        pos = size;
+        return false;
+    }
+    start += 3;
+
+    size_t end = FindStartCode(data, size, start);
+    pos = end;
+    // Strip the zero_byte of a 4-byte start code and any trailing_zero_8bits
+    while (end > start && data[end - 1] == 0) end--;
+
+    nal = data + start;
+    nalSize = end - start;
+    return true;
+}
+
+// =============================================================
+// ACCESS UNIT PARSING
+// =============================================================
+
+NalUnit AnnexBParser::DescribeNal(const uint8_t* nal, size_t size) const {
+    NalUnit unit;
+    unit.data = nal;
+    unit.size = size;
+    if (size == 0) return unit;
+
+    if (codec == VideoCodec::H264) {
+        unit.type = nal[0] & 0x1F;
+        unit.refIdc = (nal[0] >> 5) & 0x3;
+    } else {
+        unit.type = (nal[0] >> 1) & 0x3F;
+        // Even VCL types below 16 are sub-layer non-reference pictures (TRAIL_N, TSA_N, ...)
+        unit.refIdc = (unit.type < HEVC_NAL_IRAP_FIRST && (unit.type & 1) == 0) ? 0 : 1;
+    }
+    return unit;
+}
+
+AccessUnitInfo AnnexBParser::ParseAccessUnit(const uint8_t* data, size_t size) {
+    AccessUnitInfo info;
+    size_t pos = 0;
+    const uint8_t* nalData = nullptr;
+    size_t nalSize = 0;
+
+    while (NextNal(data, size, pos, nalData, nalSize)) {
+        if (nalSize == 0) continue;
+        NalUnit nal = DescribeNal(nalData, nalSize);
+        info.nalCount++;
+
+        if (codec == VideoCodec::H264) {
+            switch (nal.type) {
+            case H264_NAL_SPS: {
+                SequenceInfo parsed;
+                if (ParseH264Sps(nal.data, nal.size, parsed)) sequence = parsed;
+                info.sps = nal;
+                info.hasParameterSets = true;
+                break;
+            }
+            case H264_NAL_PPS:
+                info.pps = nal;
+                break;
+            case H264_NAL_IDR:
+            case H264_NAL_SLICE:
+                ParseH264Slice(nal, info);
+                break;
+            default:
+                break;
+            }
+        } else {
+            if (nal.type == HEVC_NAL_VPS) {
+                info.vps = nal;
+            } else if (nal.type == HEVC_NAL_SPS) {
+                SequenceInfo parsed;
+                if (ParseHevcSps(nal.data, nal.size, parsed)) sequence = parsed;
+                info.sps = nal;
+                info.hasParameterSets = true;
+            } else if (nal.type == HEVC_NAL_PPS) {
+                ParseHevcPps(nal);
+                info.pps = nal;
+            } else if (nal.type <= HEVC_NAL_IRAP_LAST && (nal.type < 10 || nal.type >= HEVC_NAL_IRAP_FIRST)) {
+                // VCL: 0-9 and IRAP 16-21 (10-15 and 22-23 are reserved)
+                ParseHevcSlice(nal, info);
+            }
+        }
+    }
+    return info;
+}
+
+void AnnexBParser::ParseH264Slice(const NalUnit& nal, AccessUnitInfo& info) const {
+    info.sliceCount++;
+
+    FrameType type = FrameType::REFERENCE;
+    if (nal.type == H264_NAL_IDR) type = FrameType::IDR;
+    else if (nal.refIdc == 0) type = FrameType::NON_REFERENCE;
+    // Any slice that others depend on makes the whole picture a dependency
+    if (info.frameType == FrameType::UNKNOWN || type < info.frameType) info.frameType = type;
+
+    if (info.sliceCount > 1) return; // First slice describes the picture
+
+    RbspReader r(nal.data + 1, nal.size - 1);
+    r.ReadUE(); // first_mb_in_slice
+    uint32_t sliceType = r.ReadUE() % 5;
+    r.ReadUE(); // pic_parameter_set_id
+    if (sequence.separateColourPlane) r.SkipBits(2);
+    uint32_t frameNum = r.ReadBits(sequence.log2MaxFrameNum);
+    if (r.Failed()) return;
+
+    static const SliceType sliceTypes[5] = { SliceType::P, SliceType::B, SliceType::I, SliceType::SP, SliceType::SI };
+    info.sliceType = sliceTypes[sliceType];
+    info.frameNum = sequence.valid ? (int)frameNum : -1;
+}
+
+void AnnexBParser::ParseHevcSlice(const NalUnit& nal, AccessUnitInfo& info) const {
+    info.sliceCount++;
+
+    FrameType type = FrameType::REFERENCE;
+    if (nal.type >= HEVC_NAL_IRAP_FIRST) type = FrameType::IDR;
+    else if (nal.refIdc == 0) type = FrameType::NON_REFERENCE;
+    if (info.frameType == FrameType::UNKNOWN || type < info.frameType) info.frameType = type;
+
+    if (nal.size < 3) return;
+    RbspReader r(nal.data + 2, nal.size - 2);
+    bool firstSliceInPic = r.ReadFlag();
+    if (!firstSliceInPic) return; // slice_segment_address needs the CTB count; first slice suffices
+    if (nal.type >= HEVC_NAL_IRAP_FIRST) r.SkipBits(1); // no_output_of_prior_pics_flag
+    r.ReadUE(); // slice_pic_parameter_set_id
+    r.SkipBits(hevcExtraSliceHeaderBits);
+    uint32_t sliceType = r.ReadUE();
+    if (hevcOutputFlagPresent) r.SkipBits(1);
+    if (sequence.separateColourPlane) r.SkipBits(2);
+    int pocLsb = 0;
+    if (nal.type != HEVC_NAL_IDR_W_RADL && nal.type != HEVC_NAL_IDR_N_LP) {
+        pocLsb = (int)r.ReadBits(sequence.log2MaxPocLsb);
+    }
+    if (r.Failed() || sliceType > 2) return;
+
+    static const SliceType sliceTypes[3] = { SliceType::B, SliceType::P, SliceType::I };
+    info.sliceType = sliceTypes[sliceType];
+    info.frameNum = sequence.valid ? pocLsb : -1;
+}
+
+void AnnexBParser::ParseHevcPps(const NalUnit& nal) {
+    if (nal.size < 3) return;
+    RbspReader r(nal.data + 2, nal.size - 2);
+    r.ReadUE(); // pps_pic_parameter_set_id
+    r.ReadUE(); // pps_seq_parameter_set_id
+    r.SkipBits(1); // dependent_slice_segments_enabled_flag (only matters past the first slice)
+    bool outputFlag = r.ReadFlag();
+    int extraBits = (int)r.ReadBits(3);
+    if (r.Failed()) return;
+    hevcOutputFlagPresent = outputFlag;
+    hevcExtraSliceHeaderBits = extraBits;
+}
+
+// =============================================================
+// SEQUENCE PARAMETER SETS
+// =============================================================
+
+static void SkipH264ScalingList(RbspReader& r, int count) {
+    int lastScale = 8, nextScale = 8;
+    for (int j = 0; j < count; j++) {
+        if (nextScale != 0) {
+            int delta = r.ReadSE();
+            nextScale = (lastScale + delta + 256) % 256;
+        }
+        lastScale = (nextScale == 0) ? lastScale : nextScale;
+    }
+}
+
+// Common tail of H.264 / HEVC VUI up to and including the colour description
+static void ParseVuiColour(RbspReader& r, SequenceInfo& out) {
+    if (r.ReadFlag()) {                   // aspect_ratio_info_present_flag
+        if (r.ReadBits(8) == 255) r.SkipBits(32); // Extended_SAR: sar_width, sar_height
+    }
+    if (r.ReadFlag()) r.SkipBits(1);      // overscan_info_present_flag -> overscan_appropriate_flag
+    if (r.ReadFlag()) {                   // video_signal_type_present_flag
+        r.SkipBits(3);                    // video_format
+        out.fullRange = r.ReadFlag();
+        if (r.ReadFlag()) {               // colour_description_present_flag
+            out.colourPrimaries = (int)r.ReadBits(8);
+            out.transferCharacteristics = (int)r.ReadBits(8);
+            out.matrixCoefficients = (int)r.ReadBits(8);
+        }
+    }
+    if (r.ReadFlag()) {                   // chroma_loc_info_present_flag
+        r.ReadUE();
+        r.ReadUE();
+    }
+}
+
+// Cropping / conformance window offset in luma samples
+static bool ReadCropOffset(RbspReader& r, int unit, int& out) {
+    uint32_t offset = r.ReadUE();
+    if (offset > SPS_MAX_DIMENSION) return false;
+    out = (int)offset * unit;
+    return true;
+}
+
+bool AnnexBParser::ParseH264Sps(const uint8_t* nal, size_t size, SequenceInfo& out) {
+    if (size < 4) return false;
+    RbspReader r(nal + 1, size - 1);
+
+    out.profileIdc = (int)r.ReadBits(8);
+    r.SkipBits(8); // constraint flags
+    out.levelIdc = (int)r.ReadBits(8);
+    r.ReadUE();    // seq_parameter_set_id
+
+    out.chromaFormatIdc = 1;
+    out.separateColourPlane = false;
+    int p = out.profileIdc;
+    if (p == 100 || p == 110 || p == 122 || p == 244 || p == 44 || p == 83 || p == 86 ||
+        p == 118 || p == 128 || p == 138 || p == 139 || p == 134 || p == 135) {
+        out.chromaFormatIdc = (int)r.ReadUE();
+        if (out.chromaFormatIdc == 3) out.separateColourPlane = r.ReadFlag();
+        uint32_t bitDepthMinus8 = r.ReadUE();
+        if (bitDepthMinus8 > SPS_MAX_BIT_DEPTH - 8) return false;
+        out.bitDepthLuma = (int)bitDepthMinus8 + 8;
+        r.ReadUE();    // bit_depth_chroma_minus8
+        r.SkipBits(1); // qpprime_y_zero_transform_bypass_flag
+        if (r.ReadFlag()) { // seq_scaling_matrix_present_flag
+            int lists = (out.chromaFormatIdc != 3) ? 8 : 12;
+            for (int i = 0; i < lists; i++) {
+                if (r.ReadFlag()) SkipH264ScalingList(r, i < 6 ? 16 : 64);
+            }
+        }
+    }
+
+    uint32_t log2MaxFrameNumMinus4 = r.ReadUE();
+    if (log2MaxFrameNumMinus4 > SPS_MAX_LOG2_COUNTER - 4) return false;
+    out.log2MaxFrameNum = (int)log2MaxFrameNumMinus4 + 4;
+    uint32_t pocType = r.ReadUE();
+    if (pocType == 0) {
+        uint32_t log2MaxPocLsbMinus4 = r.ReadUE();
+        if (log2MaxPocLsbMinus4 > SPS_MAX_LOG2_COUNTER - 4) return false;
+        out.log2MaxPocLsb = (int)log2MaxPocLsbMinus4 + 4;
+    } else if (pocType == 1) {
+        r.SkipBits(1); // delta_pic_order_always_zero_flag
+        r.ReadSE();    // offset_for_non_ref_pic
+        r.ReadSE();    // offset_for_top_to_bottom_field
+        uint32_t cycle = r.ReadUE();
+        for (uint32_t i = 0; i < cycle && !r.Failed(); i++) r.ReadSE();
+    }
+    r.ReadUE();    // max_num_ref_frames
+    r.SkipBits(1); // gaps_in_frame_num_value_allowed_flag
+
+    uint32_t widthMbs = r.ReadUE() + 1;
+    uint32_t heightMapUnits = r.ReadUE() + 1;
+    out.frameMbsOnly = r.ReadFlag();
+    if (!out.frameMbsOnly) r.SkipBits(1); // mb_adaptive_frame_field_flag
+    r.SkipBits(1); // direct_8x8_inference_flag
+    if (widthMbs > SPS_MAX_DIMENSION / 16 || heightMapUnits > SPS_MAX_DIMENSION / 16 / (out.frameMbsOnly ? 1 : 2)) {
+        return false;
+    }
+
+    out.codedWidth = (int)widthMbs * 16;
+    out.codedHeight = (out.frameMbsOnly ? 1 : 2) * (int)heightMapUnits * 16;
+
+    out.cropLeft = out.cropRight = out.cropTop = out.cropBottom = 0;
+    if (r.ReadFlag()) { // frame_cropping_flag
+        int chromaArrayType = out.separateColourPlane ? 0 : out.chromaFormatIdc;
+        int cropUnitX = (chromaArrayType == 0 || chromaArrayType == 3) ? 1 : 2;
+        int cropUnitY = (chromaArrayType == 1) ? 2 : 1;
+        cropUnitY *= out.frameMbsOnly ? 1 : 2;
+        if (!ReadCropOffset(r, cropUnitX, out.cropLeft) || !ReadCropOffset(r, cropUnitX, out.cropRight) ||
+            !ReadCropOffset(r, cropUnitY, out.cropTop) || !ReadCropOffset(r, cropUnitY, out.cropBottom)) {
+            return false;
+        }
+    }
+
+    if (r.Failed() || out.codedWidth <= out.cropLeft + out.cropRight || out.codedHeight <= out.cropTop + out.cropBottom) {
+        return false;
+    }
+    out.width = out.codedWidth - out.cropLeft - out.cropRight;
+    out.height = out.codedHeight - out.cropTop - out.cropBottom;
+    out.valid = true;
+
+    // VUI is optional information; a truncated one doesn't invalidate the geometry
+    if (r.ReadFlag()) { // vui_parameters_present_flag
+        ParseVuiColour(r, out);
+        if (r.ReadFlag()) { // timing_info_present_flag
+            uint32_t unitsInTick = r.ReadBits(32);
+            uint32_t timeScale = r.ReadBits(32);
+            // Doubled below, so a tick past UINT32_MAX / 2 would wrap to a bogus denominator
+            if (unitsInTick > 0 && unitsInTick <= UINT32_MAX / 2 && timeScale > 0 && !r.Failed()) {
+                out.fpsNum = timeScale;
+                out.fpsDen = unitsInTick * 2; // Field rate -> frame rate
+            }
+        }
+    }
+
+    if (r.Failed()) {
+        // Keep the geometry, drop partially parsed timing
+        out.fpsNum = out.fpsDen = 0;
+    }
+    return true;
+}
+
+bool AnnexBParser::ParseHevcSps(const uint8_t* nal, size_t size, SequenceInfo& out) {
+    if (size < 4) return false;
+    RbspReader r(nal + 2, size - 2);
+
+    r.SkipBits(4); // sps_video_parameter_set_id
+    int maxSubLayersMinus1 = (int)r.ReadBits(3);
+    r.SkipBits(1); // sps_temporal_id_nesting_flag
+
+    // profile_tier_level(1, maxSubLayersMinus1)
+    r.SkipBits(3); // general_profile_space, general_tier_flag
+    out.profileIdc = (int)r.ReadBits(5);
+    r.SkipBits(32); // general_profile_compatibility_flags
+    r.SkipBits(48); // progressive/interlaced/constraint flags
+    out.levelIdc = (int)r.ReadBits(8);
+    bool subProfile[8] = {}, subLevel[8] = {};
+    for (int i = 0; i < maxSubLayersMinus1; i++) {
+        subProfile[i] = r.ReadFlag();
+        subLevel[i] = r.ReadFlag();
+    }
+    if (maxSubLayersMinus1 > 0) {
+        for (int i = maxSubLayersMinus1; i < 8; i++) r.SkipBits(2);
+    }
+    for (int i = 0; i < maxSubLayersMinus1; i++) {
+        if (subProfile[i]) r.SkipBits(88);
+        if (subLevel[i]) r.SkipBits(8);
+    }
+
+    r.ReadUE(); // sps_seq_parameter_set_id
+    out.chromaFormatIdc = (int)r.ReadUE();
+    out.separateColourPlane = false;
+    if (out.chromaFormatIdc == 3) out.separateColourPlane = r.ReadFlag();
+    uint32_t codedWidth = r.ReadUE();
+    uint32_t codedHeight = r.ReadUE();
+    if (codedWidth > SPS_MAX_DIMENSION || codedHeight > SPS_MAX_DIMENSION) return false;
+    out.codedWidth = (int)codedWidth;
+    out.codedHeight = (int)codedHeight;
+    out.frameMbsOnly = true;
+
+    out.cropLeft = out.cropRight = out.cropTop = out.cropBottom = 0;
+    if (r.ReadFlag()) { // conformance_window_flag
+        int chromaArrayType = out.separateColourPlane ? 0 : out.chromaFormatIdc;
+        int subWidthC = (chromaArrayType == 1 || chromaArrayType == 2) ? 2 : 1;
+        int subHeightC = (chromaArrayType == 1) ? 2 : 1;
+        if (!ReadCropOffset(r, subWidthC, out.cropLeft) || !ReadCropOffset(r, subWidthC, out.cropRight) ||
+            !ReadCropOffset(r, subHeightC, out.cropTop) || !ReadCropOffset(r, subHeightC, out.cropBottom)) {
+            return false;
+        }
+    }
+
+    uint32_t bitDepthMinus8 = r.ReadUE();
+    if (bitDepthMinus8 > SPS_MAX_BIT_DEPTH - 8) return false;
+    out.bitDepthLuma = (int)bitDepthMinus8 + 8;
+    r.ReadUE(); // bit_depth_chroma_minus8
+    uint32_t log2MaxPocLsbMinus4 = r.ReadUE();
+    if (log2MaxPocLsbMinus4 > SPS_MAX_LOG2_COUNTER - 4) return false;
+    out.log2MaxPocLsb = (int)log2MaxPocLsbMinus4 + 4;
+    bool orderingInfoAll = r.ReadFlag();
+    for (int i = orderingInfoAll ? 0 : maxSubLayersMinus1; i <= maxSubLayersMinus1; i++) {
+        r.ReadUE(); r.ReadUE(); r.ReadUE();
+    }
+    r.ReadUE(); // log2_min_luma_coding_block_size_minus3
+    r.ReadUE(); // log2_diff_max_min_luma_coding_block_size
+    r.ReadUE(); // log2_min_luma_transform_block_size_minus2
+    r.ReadUE(); // log2_diff_max_min_luma_transform_block_size
+    r.ReadUE(); // max_transform_hierarchy_depth_inter
+    r.ReadUE(); // max_transform_hierarchy_depth_intra
+
+    if (r.ReadFlag()) {     // scaling_list_enabled_flag
+        if (r.ReadFlag()) { // sps_scaling_list_data_present_flag
+            for (int sizeId = 0; sizeId < 4; sizeId++) {
+                for (int matrixId = 0; matrixId < 6; matrixId += (sizeId == 3) ? 3 : 1) {
+                    if (!r.ReadFlag()) {
+                        r.ReadUE(); // scaling_list_pred_matrix_id_delta
+                    } else {
+                        int coefNum = (1 << (4 + (sizeId << 1)));
+                        if (coefNum > 64) coefNum = 64;
+                        if (sizeId > 1) r.ReadSE(); // scaling_list_dc_coef_minus8
+                        for (int i = 0; i < coefNum; i++) r.ReadSE();
+                    }
+                }
+            }
+        }
+    }
+    r.SkipBits(1); // amp_enabled_flag
+    r.SkipBits(1); // sample_adaptive_offset_enabled_flag
+    if (r.ReadFlag()) { // pcm_enabled_flag
+        r.SkipBits(8);
+        r.ReadUE();
+        r.ReadUE();
+        r.SkipBits(1);
+    }
+
+    // st_ref_pic_set(i) for each set; only NumDeltaPocs needs tracking for prediction
+    uint32_t numShortTermSets = r.ReadUE();
+    if (numShortTermSets > 64) return false;
+    int numDeltaPocs[64] = {};
+    for (uint32_t idx = 0; idx < numShortTermSets && !r.Failed(); idx++) {
+        bool interPrediction = (idx != 0) && r.ReadFlag();
+        if (interPrediction) {
+            r.SkipBits(1); // delta_rps_sign
+            r.ReadUE();    // abs_delta_rps_minus1
+            int refIdx = (int)idx - 1;
+            int count = 0;
+            for (int j = 0; j <= numDeltaPocs[refIdx]; j++) {
+                bool used = r.ReadFlag();
+                bool useDelta = used ? true : r.ReadFlag();
+                if (used || useDelta) count++;
+            }
+            numDeltaPocs[idx] = count;
+        } else {
+            uint32_t negative = r.ReadUE();
+            uint32_t positive = r.ReadUE();
+            if (negative + positive > 32) return false;
+            for (uint32_t j = 0; j < negative + positive; j++) {
+                r.ReadUE();    // delta_poc_s0/s1_minus1
+                r.SkipBits(1); // used_by_curr_pic_flag
+            }
+            numDeltaPocs[idx] = (int)(negative + positive);
+        }
+    }
+
+    if (r.ReadFlag()) { // long_term_ref_pics_present_flag
+        uint32_t numLongTerm = r.ReadUE();
+        for (uint32_t i = 0; i < numLongTerm && !r.Failed(); i++) {
+            r.SkipBits(out.log2MaxPocLsb);
+            r.SkipBits(1);
+        }
+    }
+    r.SkipBits(1); // sps_temporal_mvp_enabled_flag
+    r.SkipBits(1); // strong_intra_smoothing_enabled_flag
+
+    if (r.Failed() || out.codedWidth <= out.cropLeft + out.cropRight || out.codedHeight <= out.cropTop + out.cropBottom) {
+        return false;
+    }
+    out.width = out.codedWidth - out.cropLeft - out.cropRight;
+    out.height = out.codedHeight - out.cropTop - out.cropBottom;
+    out.valid = true;
+
+    if (r.ReadFlag()) { // vui_parameters_present_flag
+        ParseVuiColour(r, out);
+        r.SkipBits(3);      // neutral_chroma, field_seq, frame_field_info_present
+        if (r.ReadFlag()) { // default_display_window_flag
+            r.ReadUE(); r.ReadUE(); r.ReadUE(); r.ReadUE();
+        }
+        if (r.ReadFlag()) { // vui_timing_info_present_flag
+            uint32_t unitsInTick = r.ReadBits(32);
+            uint32_t timeScale = r.ReadBits(32);
+            if (unitsInTick > 0 && timeScale > 0 && !r.Failed()) {
+                out.fpsNum = timeScale;
+                out.fpsDen = unitsInTick;
+            }
+        }
+    }
+
+    if (r.Failed()) {
+        // Keep the geometry, drop partially parsed timing
+        out.fpsNum = out.fpsDen = 0;
+    }
+    return true;
+}
@@ -0,0 +1,140 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+// Zero-copy H.264 / HEVC Annex-B parser.
+// All results point into the caller's buffer; emulation prevention bytes are
+// skipped while reading bits instead of unescaping into a copy.
+
+enum class VideoCodec {
+    H264,
+    HEVC
+};
+
+// What later frames depend on this one (used for drop decisions)
+enum class FrameType : uint32_t {
+    UNKNOWN = 0,
+    IDR = 1,           // Random access point, nothing before it is needed
+    REFERENCE = 2,     // Later frames may predict from it
+    NON_REFERENCE = 3  // Disposable
+};
+
+enum class SliceType {
+    UNKNOWN,
+    P,
+    B,
+    I,
+    SP,
+    SI
+};
+
+// H.264 NAL types
+#define H264_NAL_SLICE     1
+#define H264_NAL_IDR       5
+#define H264_NAL_SEI       6
+#define H264_NAL_SPS       7
+#define H264_NAL_PPS       8
+#define H264_NAL_AUD       9
+
+// HEVC NAL types
+#define HEVC_NAL_IRAP_FIRST 16
+#define HEVC_NAL_IDR_W_RADL 19
+#define HEVC_NAL_IDR_N_LP   20
+#define HEVC_NAL_IRAP_LAST  23
+#define HEVC_NAL_VPS        32
+#define HEVC_NAL_SPS        33
+#define HEVC_NAL_PPS        34
+#define HEVC_NAL_AUD        35
+
+// SPS values outside these are rejected: slice headers read log2 counters bit by bit,
+// and picture sizes are multiplied up in int
+#define SPS_MAX_LOG2_COUNTER 16 // log2_max_frame_num / log2_max_pic_order_cnt_lsb (4..16)
+#define SPS_MAX_DIMENSION 8192  // Luma samples per side
+#define SPS_MAX_BIT_DEPTH 16
+
+struct NalUnit {
+    const uint8_t* data = nullptr; // NAL header (first byte after the start code)
+    size_t size = 0;               // Up to the next start code, trailing zeros stripped
+    int type = -1;
+    int refIdc = 0;                // H.264 nal_ref_idc / HEVC: 1 unless a sub-layer non-reference picture
+};
+
+struct SequenceInfo {
+    bool valid = false;
+    int profileIdc = 0;
+    int levelIdc = 0;
+    int chromaFormatIdc = 1;
+    int bitDepthLuma = 8;
+
+    int codedWidth = 0;   // Macroblock / CTB aligned
+    int codedHeight = 0;
+    int cropLeft = 0;     // In luma samples
+    int cropRight = 0;
+    int cropTop = 0;
+    int cropBottom = 0;
+    int width = 0;        // Display size after cropping
+    int height = 0;
+
+    // VUI
+    bool fullRange = false;
+    int colourPrimaries = 2;         // 2 = unspecified
+    int transferCharacteristics = 2;
+    int matrixCoefficients = 2;
+    uint32_t fpsNum = 0;
+    uint32_t fpsDen = 0;
+
+    // Needed to parse slice headers
+    int log2MaxFrameNum = 4;
+    int log2MaxPocLsb = 4;
+    bool frameMbsOnly = true;
+    bool separateColourPlane = false;
+};
+
+struct AccessUnitInfo {
+    FrameType frameType = FrameType::UNKNOWN;
+    SliceType sliceType = SliceType::UNKNOWN;
+    int frameNum = -1;       // H.264 frame_num / HEVC slice_pic_order_cnt_lsb
+    int nalCount = 0;
+    int sliceCount = 0;
+    bool hasParameterSets = false;
+
+    // Parameter set NALs inside this access unit (point into the parsed buffer)
+    NalUnit sps;
+    NalUnit pps;
+    NalUnit vps;
+};
+
+class AnnexBParser {
+public:
+    explicit AnnexBParser(VideoCodec codec = VideoCodec::H264) : codec(codec) {}
+
+    // Offset of the next 00 00 01 at or after pos, or size if there is none (SSE2 scan)
+    static size_t FindStartCode(const uint8_t* data, size_t size, size_t pos);
+
+    // Splits an Annex-B buffer into NAL units without copying.
+    // Returns false once the buffer is exhausted.
+    static bool NextNal(const uint8_t* data, size_t size, size_t& pos, const uint8_t*& nal, size_t& nalSize);
+
+    // Parses one encoder packet / access unit. Updates the cached SPS/PPS state.
+    AccessUnitInfo ParseAccessUnit(const uint8_t* data, size_t size);
+
+    const SequenceInfo& GetSequenceInfo() const { return sequence; }
+    VideoCodec GetCodec() const { return codec; }
+
+    // Standalone SPS parsers (nal points at the NAL header)
+    static bool ParseH264Sps(const uint8_t* nal, size_t size, SequenceInfo& out);
+    static bool ParseHevcSps(const uint8_t* nal, size_t size, SequenceInfo& out);
+
+private:
+    VideoCodec codec;
+    SequenceInfo sequence;
+
+    // HEVC PPS fields needed for slice headers
+    bool hevcOutputFlagPresent = false;
+    int hevcExtraSliceHeaderBits = 0;
+
+    NalUnit DescribeNal(const uint8_t* nal, size_t size) const;
+    void ParseH264Slice(const NalUnit& nal, AccessUnitInfo& info) const;
+    void ParseHevcSlice(const NalUnit& nal, AccessUnitInfo& info) const;
+    void ParseHevcPps(const NalUnit& nal);
+};
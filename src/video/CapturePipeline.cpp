@@ -0,0 +1,150 @@
+#include "CapturePipeline.h"
+#include "../common/Metrics.h"
+#include "../common/Tracer.h"
+#include "../common/Logger.h"
+#include <d3d10.h> // ID3D10Multithread
+
+using Microsoft::WRL::ComPtr;
+
+void CapturePipeline::Start(HardwareEncoder* encoder, PipelinePacketCallback onPacket) {
+    if (running) return;
+    this->encoder = encoder;
+    this->onPacket = std::move(onPacket);
+    ring.Reset();
+    running = true;
+    convertThread = std::thread(&CapturePipeline::ConvertLoop, this);
+    encodeThread = std::thread(&CapturePipeline::EncodeLoop, this);
+}
+
+void CapturePipeline::Stop() {
+    running = false;
+    ring.Stop(); // Frames still in the ring are discarded
+    if (convertThread.joinable()) convertThread.join();
+    if (encodeThread.joinable()) encodeThread.join();
+
+    // The next session may capture on a new device
+    for (size_t i = 0; i < ring.Capacity(); i++) ring.At(i) = CaptureSlot();
+    device.Reset();
+    context.Reset();
+}
+
+bool CapturePipeline::CreateSlots(ID3D11Texture2D* texture, ID3D11DeviceContext* ctx) {
+    D3D11_TEXTURE2D_DESC desc;
+    texture->GetDesc(&desc);
+    if (device) {
+        if (desc.Width == slotWidth && desc.Height == slotHeight) return true;
+        LOG_ERROR_RATE("Pipeline", 1, "No ring slots for a %dx%d frame, dropping", (int)desc.Width, (int)desc.Height);
+        return false;
+    }
+
+    ctx->GetDevice(&device);
+    context = ctx;
+
+    // Three threads now share the immediate context
+    ComPtr<ID3D10Multithread> multithread;
+    if (SUCCEEDED(device.As(&multithread))) multithread->SetMultithreadProtected(TRUE);
+
+    convertStage = encoder->UsesConvertStage();
+
+    D3D11_TEXTURE2D_DESC bgraDesc = desc;
+    bgraDesc.MipLevels = 1;
+    bgraDesc.ArraySize = 1;
+    bgraDesc.Usage = D3D11_USAGE_DEFAULT;
+    bgraDesc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+    bgraDesc.CPUAccessFlags = 0;
+    bgraDesc.MiscFlags = 0;
+
+    D3D11_TEXTURE2D_DESC nv12Desc = bgraDesc;
+    nv12Desc.Format = DXGI_FORMAT_NV12;
+
+    D3D11_QUERY_DESC fenceDesc = {};
+    fenceDesc.Query = D3D11_QUERY_EVENT;
+
+    for (size_t i = 0; i < ring.Capacity(); i++) {
+        CaptureSlot& slot = ring.At(i);
+        slot = CaptureSlot();
+        if (FAILED(device->CreateTexture2D(&bgraDesc, nullptr, &slot.bgra)) ||
+            (convertStage && FAILED(device->CreateTexture2D(&nv12Desc, nullptr, &slot.nv12))) ||
+            FAILED(device->CreateQuery(&fenceDesc, &slot.fence))) {
+            LOG_ERROR("Pipeline", "Failed to create ring slot %d", (int)i);
+            return false; // slotWidth stays 0, so every later frame is dropped
+        }
+    }
+    slotWidth = desc.Width;
+    slotHeight = desc.Height;
+    LOG_INFO("Pipeline", "%dx%d ring with %d slots (%s)", (int)slotWidth, (int)slotHeight, (int)ring.Capacity(),
+             convertStage ? "capture/convert/encode" : "capture/encode");
+    return true;
+}
+
+void CapturePipeline::Submit(ID3D11Texture2D* texture, ID3D11DeviceContext* ctx, POINT cursor) {
+    if (!running || !texture) return;
+
+    // Never block here: the capturer is still holding the surface
+    CaptureSlot* slot = ring.TryAcquire((int)PipelineStage::Capture);
+    if (!slot) {
+        Metrics::Get().Add(Counter::CaptureFramesDropped);
+        return;
+    }
+    // Slots are created on the first frame, while the other stages wait for it
+    if (!CreateSlots(texture, ctx)) {
+        slot->ready = false;
+        ring.Release((int)PipelineStage::Capture, slot);
+        return;
+    }
+
+    ctx->CopyResource(slot->bgra.Get(), texture);
+    ctx->End(slot->fence.Get());
+    ctx->Flush();
+    slot->frameId = Tracer::GetCurrentFrame();
+    slot->cursor = cursor;
+    slot->ready = true;
+    ring.Release((int)PipelineStage::Capture, slot);
+    Metrics::Get().Set(Gauge::CaptureRingDepth, (int64_t)ring.GetDepth());
+}
+
+void CapturePipeline::WaitForFence(ID3D11Query* fence) {
+    // The producing stage already flushed; S_OK once its GPU work has completed
+    while (running && context->GetData(fence, nullptr, 0, D3D11_ASYNC_GETDATA_DONOTFLUSH) == S_FALSE) {
+        std::this_thread::yield();
+    }
+}
+
+void CapturePipeline::ConvertLoop() {
+    Tracer::SetThreadName("Convert");
+    while (CaptureSlot* slot = ring.Acquire((int)PipelineStage::Convert)) {
+        if (slot->ready && convertStage) {
+            Tracer::SetCurrentFrame(slot->frameId);
+            WaitForFence(slot->fence.Get());
+            slot->ready = encoder->ConvertFrame(slot->bgra.Get(), slot->nv12.Get());
+            if (slot->ready) {
+                context->End(slot->fence.Get());
+                context->Flush();
+            }
+        }
+        ring.Release((int)PipelineStage::Convert, slot);
+    }
+}
+
+void CapturePipeline::EncodeLoop() {
+    HRESULT coInit = CoInitializeEx(nullptr, COINIT_MULTITHREADED); // Media Foundation encoder
+    Tracer::SetThreadName("Encode");
+    while (CaptureSlot* slot = ring.Acquire((int)PipelineStage::Encode)) {
+        if (!slot->ready) {
+            ring.Release((int)PipelineStage::Encode, slot);
+            continue;
+        }
+        Tracer::SetCurrentFrame(slot->frameId);
+        WaitForFence(slot->fence.Get());
+        POINT cursor = slot->cursor;
+        // Staging-readback encoders emit a frame late and re-tag the current frame for it
+        auto forward = [&](const uint8_t* data, size_t size) { onPacket(data, size, Tracer::GetCurrentFrame(), cursor); };
+        if (convertStage) {
+            encoder->EncodeConverted(slot->nv12.Get(), forward);
+        } else {
+            encoder->EncodeFrame(slot->bgra.Get(), context.Get(), forward);
+        }
+        ring.Release((int)PipelineStage::Encode, slot);
+    }
+    if (SUCCEEDED(coInit)) CoUninitialize();
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <windows.h>
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <functional>
+#include <thread>
+#include <atomic>
+#include "HardwareEncoder.h"
+#include "../common/FrameRing.h"
+
+#define CAPTURE_PIPELINE_SLOTS 3
+
+enum class PipelineStage : int {
+    Capture, // Capture thread: copy of the DXGI/WGC surface
+    Convert, // BGRA -> NV12 into the slot (pass-through for Media Foundation / cross-GPU)
+    Encode,  // Encoder call + packet callback
+    Count
+};
+
+// Texture-ring backend for FrameRing. Each stage ends its fence after submitting its GPU
+// work and the next stage waits on it, so a stage never reads a half-written surface.
+struct CaptureSlot {
+    Microsoft::WRL::ComPtr<ID3D11Texture2D> bgra;
+    Microsoft::WRL::ComPtr<ID3D11Texture2D> nv12; // Only for encoders with a convert stage
+    Microsoft::WRL::ComPtr<ID3D11Query> fence;    // D3D11_QUERY_EVENT
+    uint32_t frameId = 0;
+    POINT cursor = { -1, -1 };
+    bool ready = false; // Cleared by a failed stage, later stages skip the slot
+};
+
+// Invoked on the encode thread for every output packet
+using PipelinePacketCallback = std::function<void(const uint8_t* data, size_t size, uint32_t frameId, POINT cursor)>;
+
+// Capture -> convert -> encode on three threads over a ring of CAPTURE_PIPELINE_SLOTS
+// intermediate frames, so the capturer releases its surface right after a GPU copy and
+// capture of frame N+1 overlaps conversion/encode of frame N. When every slot is busy
+// the newest frame is dropped rather than stalling capture.
+class CapturePipeline {
+public:
+    ~CapturePipeline() { Stop(); }
+
+    // The encoder must be initialized before the first Submit
+    void Start(HardwareEncoder* encoder, PipelinePacketCallback onPacket);
+    void Stop();
+
+    // Called from the capture callback: queues a copy of `texture` and returns without
+    // waiting for the GPU, so the caller may release the surface immediately
+    void Submit(ID3D11Texture2D* texture, ID3D11DeviceContext* context, POINT cursor);
+
+    size_t GetDepth() { return ring.GetDepth(); }
+
+private:
+    FrameRing<CaptureSlot, (int)PipelineStage::Count> ring{ CAPTURE_PIPELINE_SLOTS };
+    HardwareEncoder* encoder = nullptr;
+    PipelinePacketCallback onPacket;
+    Microsoft::WRL::ComPtr<ID3D11Device> device;
+    Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+    UINT slotWidth = 0;
+    UINT slotHeight = 0;
+    bool convertStage = false; // Encoder takes NV12 from the convert stage
+
+    std::thread convertThread;
+    std::thread encodeThread;
+    std::atomic<bool> running = false;
+
+    bool CreateSlots(ID3D11Texture2D* texture, ID3D11DeviceContext* ctx);
+    void WaitForFence(ID3D11Query* fence);
+    void ConvertLoop();
+    void EncodeLoop();
+};
@@ -0,0 +1,107 @@
+#pragma once
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include "../common/CursorChannel.h"
+#include "../imgui/imgui.h"
+
+// Client side: draws the remote pointer over the video from shapes the host sent once.
+// Shapes are kept as textures in a CURSOR_SHAPE_CACHE entry LRU, keyed by their content
+// hash, so switching between a handful of pointers costs nothing after the first time.
+// Ids are content hashes, so the cache stays valid across sessions.
+class CursorOverlay {
+public:
+    // False if the texture can't be created
+    bool AddShape(ID3D11Device* device, const CursorShape& shape) {
+        if (Entry* entry = Find(shape.id)) {
+            entry->lastUsed = ++tick;
+            return true;
+        }
+        D3D11_TEXTURE2D_DESC desc = {};
+        desc.Width = shape.width;
+        desc.Height = shape.height;
+        desc.MipLevels = 1;
+        desc.ArraySize = 1;
+        desc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+        desc.SampleDesc.Count = 1;
+        desc.Usage = D3D11_USAGE_IMMUTABLE;
+        desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+        D3D11_SUBRESOURCE_DATA data = {};
+        data.pSysMem = shape.pixels.data();
+        data.SysMemPitch = (UINT)shape.width * 4;
+        Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+        Entry entry;
+        if (FAILED(device->CreateTexture2D(&desc, &data, &texture)) ||
+            FAILED(device->CreateShaderResourceView(texture.Get(), nullptr, &entry.srv))) {
+            return false;
+        }
+        entry.id = shape.id;
+        entry.width = shape.width;
+        entry.height = shape.height;
+        entry.hotX = shape.hotX;
+        entry.hotY = shape.hotY;
+        entry.lastUsed = ++tick;
+        if (entries.size() >= CURSOR_SHAPE_CACHE) {
+            size_t oldest = 0;
+            for (size_t i = 1; i < entries.size(); i++) {
+                if (entries[i].lastUsed < entries[oldest].lastUsed) oldest = i;
+            }
+            entries[oldest] = std::move(entry);
+        } else {
+            entries.push_back(std::move(entry));
+        }
+        return true;
+    }
+
+    // Draws shape `shapeId` with its hotspot at `position` (stream pixels, {-1, -1} = hidden).
+    // Returns a shape id to request from the host (CONTROL_CURSOR_SHAPE_REQUEST), or 0. A
+    // missing shape is normally already on its way, so it is only requested once it has been
+    // missing for CURSOR_SHAPE_REQUEST_GAP_MS, and then at most that often.
+    uint32_t Draw(ImDrawList* drawList, POINT position, uint32_t shapeId, float scaleX, float scaleY) {
+        if (position.x == -1 || shapeId == 0) return 0;
+        if (Entry* entry = Find(shapeId)) {
+            entry->lastUsed = ++tick;
+            ImVec2 topLeft((position.x - entry->hotX) * scaleX, (position.y - entry->hotY) * scaleY);
+            ImVec2 bottomRight(topLeft.x + entry->width * scaleX, topLeft.y + entry->height * scaleY);
+            drawList->AddImage((void*)entry->srv.Get(), topLeft, bottomRight);
+            return 0;
+        }
+        auto now = std::chrono::steady_clock::now();
+        const auto gap = std::chrono::milliseconds(CURSOR_SHAPE_REQUEST_GAP_MS);
+        if (shapeId != missingId) {
+            missingId = shapeId;
+            requestAt = now + gap;
+            return 0;
+        }
+        if (now < requestAt) return 0;
+        requestAt = now + gap;
+        return shapeId;
+    }
+
+    size_t GetCachedCount() const { return entries.size(); }
+
+private:
+    struct Entry {
+        uint32_t id = 0;
+        uint16_t width = 0;
+        uint16_t height = 0;
+        int16_t hotX = 0;
+        int16_t hotY = 0;
+        Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+        uint64_t lastUsed = 0;
+    };
+
+    std::vector<Entry> entries;
+    uint64_t tick = 0;
+    uint32_t missingId = 0;
+    std::chrono::steady_clock::time_point requestAt;
+
+    Entry* Find(uint32_t id) {
+        for (Entry& entry : entries) {
+            if (entry.id == id) return &entry;
+        }
+        return nullptr;
+    }
+};
@@ -0,0 +1,155 @@
+#pragma once
+#include <windows.h>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <functional>
+#include <vector>
+#include "../common/CursorChannel.h"
+#include "../common/Tracer.h"
+#include "PointerShape.h"
+
+// Host side: samples the pointer at CURSOR_POLL_INTERVAL_US on its own thread and reports
+// every change of position or visibility (plus a refresh every CURSOR_REFRESH_MS).
+// Desktop duplication only reports the pointer with an acquired frame, at capture rate;
+// polling gets every move within a millisecond. Positions are physical pixels relative to
+// the captured output; a pointer on another monitor is reported hidden.
+//
+// Every update carries the id of the current pointer shape. Shapes come from the capturer
+// (SubmitShape, desktop duplication) or, with `pollShapes`, from the cursor handle the
+// poll sees (WGC). A shape goes to onShape the first time it is seen in a session; after
+// that only its id travels, and ResendShape answers a client that evicted it.
+class CursorTracker {
+public:
+    using Callback = std::function<void(const CursorMessage&)>;
+    using ShapeCallback = std::function<void(const CursorShape&)>;
+
+    ~CursorTracker() { Stop(); }
+
+    // `output`: the captured output in physical desktop coordinates
+    void Start(const RECT& output, bool pollShapes, Callback onChange, ShapeCallback onShape) {
+        Stop();
+        this->output = output;
+        this->pollShapes = pollShapes;
+        this->onChange = onChange;
+        this->onShape = onShape;
+        {
+            std::lock_guard<std::mutex> guard(shapeLock);
+            shapes.clear();
+        }
+        currentShape = 0;
+        shapesSent = 0;
+        running = true;
+        poller = std::thread(&CursorTracker::PollLoop, this);
+    }
+
+    void Stop() {
+        running = false;
+        if (poller.joinable()) poller.join();
+    }
+
+    // Makes `shape` current, sending it if this session hasn't yet. Any thread.
+    void SubmitShape(const CursorShape& shape) {
+        bool known;
+        {
+            std::lock_guard<std::mutex> guard(shapeLock);
+            known = FindShape(shape.id) != nullptr;
+            if (!known) {
+                if (shapes.size() >= CURSOR_SHAPE_CACHE * 2) shapes.erase(shapes.begin()); // Oldest first
+                shapes.push_back(shape);
+            }
+        }
+        if (!known) {
+            shapesSent++;
+            if (onShape) onShape(shape);
+        }
+        currentShape = shape.id; // After the shape, so no update names one that wasn't sent
+    }
+
+    // A client asked for a shape again (CONTROL_CURSOR_SHAPE_REQUEST)
+    void ResendShape(uint32_t id) {
+        CursorShape shape;
+        {
+            std::lock_guard<std::mutex> guard(shapeLock);
+            const CursorShape* found = FindShape(id);
+            if (!found) return;
+            shape = *found;
+        }
+        shapesSent++;
+        if (onShape) onShape(shape);
+    }
+
+    uint64_t GetUpdates() const { return updates; }
+    uint64_t GetShapesSent() const { return shapesSent; }
+
+private:
+    RECT output = {};
+    bool pollShapes = false;
+    Callback onChange;
+    ShapeCallback onShape;
+    std::thread poller;
+    std::atomic<bool> running = false;
+    std::atomic<uint64_t> updates = 0;
+    std::atomic<uint64_t> shapesSent = 0;
+    std::atomic<uint32_t> currentShape = 0;
+    std::mutex shapeLock;
+    std::vector<CursorShape> shapes; // Sent this session, for resends
+
+    const CursorShape* FindShape(uint32_t id) const {
+        for (const CursorShape& shape : shapes) {
+            if (shape.id == id) return &shape;
+        }
+        return nullptr;
+    }
+
+    CursorMessage Sample(HCURSOR& handle) const {
+        CursorMessage cursor = {};
+        CURSORINFO info = {};
+        info.cbSize = sizeof(info);
+        POINT position;
+        if (!GetCursorInfo(&info) || !GetPhysicalCursorPos(&position)) return cursor;
+        handle = info.hCursor;
+        cursor.x = position.x - output.left;
+        cursor.y = position.y - output.top;
+        bool inside = position.x >= output.left && position.x < output.right && position.y >= output.top && position.y < output.bottom;
+        if ((info.flags & CURSOR_SHOWING) && inside) cursor.flags |= CURSOR_FLAG_VISIBLE;
+        return cursor;
+    }
+
+    void PollLoop() {
+        Tracer::SetThreadName("Cursor");
+        const auto interval = std::chrono::microseconds(CURSOR_POLL_INTERVAL_US);
+        const auto refresh = std::chrono::milliseconds(CURSOR_REFRESH_MS);
+        CursorMessage last = {};
+        uint32_t sequence = 0;
+        HCURSOR lastHandle = nullptr;
+        auto lastSent = std::chrono::steady_clock::time_point();
+        auto next = std::chrono::steady_clock::now();
+        while (running) {
+            next += interval;
+            HCURSOR handle = nullptr;
+            CursorMessage cursor = Sample(handle);
+            if (pollShapes && handle && handle != lastHandle) {
+                // Animated cursors keep their handle and are sent as their current frame
+                CursorShape shape;
+                if (CaptureCursorShape(handle, shape)) SubmitShape(shape);
+                lastHandle = handle;
+            }
+            cursor.shapeId = currentShape;
+            auto now = std::chrono::steady_clock::now();
+            bool changed = cursor.flags != last.flags || cursor.shapeId != last.shapeId ||
+                           ((cursor.flags & CURSOR_FLAG_VISIBLE) && (cursor.x != last.x || cursor.y != last.y));
+            if (changed || sequence == 0 || now - lastSent >= refresh) {
+                cursor.sequence = ++sequence;
+                last = cursor;
+                lastSent = now;
+                updates++;
+                if (onChange) onChange(cursor);
+            }
+            // The capturer raised the timer resolution (timeBeginPeriod(1)), so this is ~1ms
+            std::this_thread::sleep_until(next);
+            if (std::chrono::steady_clock::now() - next > refresh) next = std::chrono::steady_clock::now(); // Don't burst after a stall
+        }
+    }
+};
@@ -1,4 +1,9 @@
+#include <winsock2.h> // Before windows.h, for CursorChannel.h
 #include "DXGICapturer.h"
+#include "PointerShape.h"
+#include "../common/Metrics.h"
+#include "../common/Tracer.h"
+#include "../common/Logger.h"
 #include <iostream>
 #include <chrono>
 #include <objbase.h>
@@ -17,6 +22,40 @@ namespace winrt {
     using namespace winrt::Windows::Graphics::DirectX::Direct3D11;
 }
 
+// The client draws the pointer from the cursor channel, so WGC leaves it out of the frames
+// (and a moving pointer no longer produces new ones). Needs Windows 10 2004.
+static bool ExcludeCursor(winrt::GraphicsCaptureSession& session) {
+    try {
+        session.IsCursorCaptureEnabled(false);
+        return true;
+    } catch (const winrt::hresult_error&) {
+        std::cout << "[Capturer] WGC can't exclude the cursor, it stays in the frame" << std::endl;
+        return false;
+    }
+}
+
+// Desktop rect of the captured monitor in physical pixels, the space GetPhysicalCursorPos
+// reports in. The process isn't DPI aware, so GetMonitorInfo would give scaled (logical)
+// coordinates on a scaled display; DXGI outputs aren't virtualized, and the capture item's
+// size is the physical frame size.
+static RECT PhysicalMonitorRect(IDXGIFactory1* factory, HMONITOR monitor, winrt::Windows::Graphics::SizeInt32 size) {
+    RECT rect = { 0, 0, size.Width, size.Height }; // The primary monitor sits at 0,0 in either space
+    ComPtr<IDXGIAdapter1> adapter;
+    for (UINT i = 0; factory->EnumAdapters1(i, &adapter) != DXGI_ERROR_NOT_FOUND; i++) {
+        ComPtr<IDXGIOutput> output;
+        for (UINT j = 0; adapter->EnumOutputs(j, &output) != DXGI_ERROR_NOT_FOUND; j++) {
+            DXGI_OUTPUT_DESC desc;
+            if (FAILED(output->GetDesc(&desc)) || desc.Monitor != monitor) continue;
+            rect.left = desc.DesktopCoordinates.left;
+            rect.top = desc.DesktopCoordinates.top;
+            rect.right = rect.left + size.Width;
+            rect.bottom = rect.top + size.Height;
+            return rect;
+        }
+    }
+    return rect;
+}
+
 DXGICapturer::DXGICapturer() : capturing(false), useWGC(false) {
     timeBeginPeriod(1);
     winrt::init_apartment(winrt::apartment_type::multi_threaded);
@@ -32,6 +71,20 @@ DXGICapturer::~DXGICapturer() {
     timeEndPeriod(1);
 }
 
+void DXGICapturer::KeepCursorInFrame(bool keep) {
+    if (!useWGC || !captureSession) return;
+    if (!keep) {
+        cursorInFrame = !ExcludeCursor(captureSession);
+        return;
+    }
+    try {
+        captureSession.IsCursorCaptureEnabled(true);
+    } catch (const winrt::hresult_error&) {
+        // Before Windows 10 2004 the pointer is always captured
+    }
+    cursorInFrame = true;
+}
+
 bool DXGICapturer::Initialize() {
     HRESULT hr;
     
@@ -129,6 +182,7 @@ bool DXGICapturer::Initialize() {
             std::cerr << "[Capturer] Failed to create GraphicsCaptureItem: 0x" << std::hex << hr << std::endl;
             return false;
         }
+        outputRect = PhysicalMonitorRect(factory.Get(), hMonitor, captureItem.Size());
         
         // Create frame pool
         framePool = winrt::Direct3D11CaptureFramePool::CreateFreeThreaded(
@@ -145,6 +199,7 @@ bool DXGICapturer::Initialize() {
         
         // Create capture session
         captureSession = framePool.CreateCaptureSession(captureItem);
+        cursorInFrame = !ExcludeCursor(captureSession);
         
         std::cout << "[Capturer] Windows.Graphics.Capture initialized successfully" << std::endl;
         return true;
@@ -173,6 +228,11 @@ bool DXGICapturer::Initialize() {
         goto USE_WGC_FALLBACK;
     }
     
+    {
+        DXGI_OUTPUT_DESC outputDesc;
+        selectedOutput->GetDesc(&outputDesc);
+        outputRect = outputDesc.DesktopCoordinates;
+    }
     std::cout << "[Capturer] DXGI Desktop Duplication initialized successfully" << std::endl;
     return true;
 
@@ -206,6 +266,7 @@ USE_WGC_FALLBACK:
         std::cerr << "[Capturer] Failed to create GraphicsCaptureItem: 0x" << std::hex << hr << std::endl;
         return false;
     }
+    outputRect = PhysicalMonitorRect(factory.Get(), hMonitor, captureItem.Size());
     
     // Create frame pool
     framePool = winrt::Direct3D11CaptureFramePool::CreateFreeThreaded(
@@ -222,6 +283,7 @@ USE_WGC_FALLBACK:
     
     // Create capture session
     captureSession = framePool.CreateCaptureSession(captureItem);
+    cursorInFrame = !ExcludeCursor(captureSession);
     
     std::cout << "[Capturer] Windows.Graphics.Capture initialized successfully" << std::endl;
     return true;
@@ -245,6 +307,42 @@ void DXGICapturer::Stop() {
     }
 }
 
+bool DXGICapturer::GetFrameSize(int& width, int& height) {
+    if (useWGC) {
+        if (!captureItem) return false;
+        auto size = captureItem.Size();
+        width = size.Width;
+        height = size.Height;
+        return true;
+    }
+    if (!deskDupl) return false;
+    DXGI_OUTDUPL_DESC desc;
+    deskDupl->GetDesc(&desc);
+    width = (int)desc.ModeDesc.Width;
+    height = (int)desc.ModeDesc.Height;
+    return true;
+}
+
+void DXGICapturer::ReadPointerShape(UINT bufferSize) {
+    if (!onPointerShape) return;
+    if (pointerShapeBuffer.size() < bufferSize) pointerShapeBuffer.resize(bufferSize);
+    UINT required = 0;
+    DXGI_OUTDUPL_POINTER_SHAPE_INFO shapeInfo;
+    HRESULT hr = deskDupl->GetFramePointerShape((UINT)pointerShapeBuffer.size(), pointerShapeBuffer.data(), &required, &shapeInfo);
+    if (FAILED(hr)) {
+        LOG_ERROR("Capturer", "GetFramePointerShape failed: 0x%08X", (unsigned)hr);
+        return;
+    }
+    CursorShape shape;
+    if (ConvertPointerShape(shapeInfo, pointerShapeBuffer.data(), shape)) onPointerShape(shape);
+}
+
+static uint64_t QpcToNs(int64_t ticks) {
+    static const int64_t frequency = []() { LARGE_INTEGER f; QueryPerformanceFrequency(&f); return f.QuadPart; }();
+    if (ticks <= 0) return 0;
+    return (uint64_t)(ticks / frequency) * 1000000000ull + (uint64_t)(ticks % frequency) * 1000000000ull / frequency;
+}
+
 // --------------------------------------------------------------------------------
 // CORE CAPTURE LOOP (Updated with Heartbeat + Cursor)
 // --------------------------------------------------------------------------------
@@ -263,6 +361,8 @@ void DXGICapturer::CaptureLoop(FrameCallback onFrameCaptured) {
     
     // Cache current cursor to send during heartbeats
     POINT lastCursorPos = { -1, -1 };
+    uint32_t frameId = 0;
+    Tracer::SetThreadName("Capture");
 
     std::cout << "[Capturer] Capture loop started (Heartbeat Enabled)..." << std::endl;
 
@@ -271,10 +371,36 @@ void DXGICapturer::CaptureLoop(FrameCallback onFrameCaptured) {
 
         // 1. Acquire the raw desktop frame
         // Reduced timeout to 10ms to allow us to control the 60FPS heartbeat manually
-        HRESULT hr = deskDupl->AcquireNextFrame(10, &frameInfo, &desktopResource);
+        HRESULT hr;
+        {
+            TRACE_SCOPE("AcquireNextFrame", frameId);
+            hr = deskDupl->AcquireNextFrame(10, &frameInfo, &desktopResource);
+        }
 
         if (SUCCEEDED(hr)) {
+            // A new pointer shape comes with whichever acquire reports it
+            if (frameInfo.PointerShapeBufferSize > 0) ReadPointerShape(frameInfo.PointerShapeBufferSize);
+            if (frameInfo.LastPresentTime.QuadPart == 0) {
+                // Pointer-only update: the desktop image is unchanged and the client draws the
+                // pointer itself, so this tick is a heartbeat rather than a new frame
+                if (frameInfo.LastMouseUpdateTime.QuadPart > 0) {
+                    lastCursorPos = frameInfo.PointerPosition.Visible ? frameInfo.PointerPosition.Position : POINT{ -1, -1 };
+                }
+                deskDupl->ReleaseFrame();
+                hr = DXGI_ERROR_WAIT_TIMEOUT;
+            }
+        }
+
+        if (SUCCEEDED(hr)) {
+            TRACE_SCOPE("CaptureFrame", frameId);
+            Tracer::SetCurrentFrame(frameId++);
             successCount++;
+
+            // Present -> acquire latency
+            LARGE_INTEGER now;
+            QueryPerformanceCounter(&now);
+            Metrics::Get().Record(Stage::Capture, QpcToNs(now.QuadPart - frameInfo.LastPresentTime.QuadPart));
+            Metrics::Get().Add(Counter::FramesCaptured);
             
             // SKIP THE FIRST FRAME (it's often empty/uninitialized)
             if (successCount == 1) {
@@ -317,21 +443,31 @@ void DXGICapturer::CaptureLoop(FrameCallback onFrameCaptured) {
                 }
                 // ------------------------------
                 
-                // 3. ZERO COPY SHORTCUT:
-                // Pass the raw desktop texture + cursor position
-                onFrameCaptured(acquiredImage.Get(), context.Get(), cursorPos);
+                // 3. Pass the raw desktop texture + cursor position
+                // (probe mode sends the stamped cache copy instead). The host callback only
+                // queues a GPU copy into the capture pipeline ring, so the frame is released
+                // long before it is encoded.
+                if (probeEnabled && lastFrameCache &&
+                    probeStamper.Stamp(context.Get(), lastFrameCache.Get(), Tracer::GetCurrentFrame())) {
+                    onFrameCaptured(lastFrameCache.Get(), context.Get(), cursorPos);
+                } else {
+                    onFrameCaptured(acquiredImage.Get(), context.Get(), cursorPos);
+                }
             }
 
             // 4. Release immediately
             deskDupl->ReleaseFrame();
         }
         else if (hr == DXGI_ERROR_WAIT_TIMEOUT) {
+            TRACE_SCOPE("CaptureHeartbeat", frameId);
+            Tracer::SetCurrentFrame(frameId++);
             // --- HEARTBEAT LOGIC ---
             // The screen hasn't changed (static).
             // We MUST send a frame to keep the decoder's buffer flushing.
             
             if (lastFrameCache) {
                 // Send the cached (previous) frame + last known cursor
+                if (probeEnabled) probeStamper.Stamp(context.Get(), lastFrameCache.Get(), Tracer::GetCurrentFrame());
                 onFrameCaptured(lastFrameCache.Get(), context.Get(), lastCursorPos);
             } else {
                 // Very start of stream, no cache yet
@@ -339,7 +475,7 @@ void DXGICapturer::CaptureLoop(FrameCallback onFrameCaptured) {
             }
         }
         else if (hr == DXGI_ERROR_ACCESS_LOST) {
-            std::cerr << "[Capturer] ERROR: Access lost (resolution change or UAC?)" << std::endl;
+            LOG_ERROR("Capturer", "Access lost (resolution change or UAC?)");
             errorCount++;
             // In a production app, you would re-run Initialize() here.
             // For now, we break to avoid an infinite error loop.
@@ -347,7 +483,7 @@ void DXGICapturer::CaptureLoop(FrameCallback onFrameCaptured) {
         }
         else {
             if (errorCount < 5) {
-                std::cerr << "[Capturer] AcquireNextFrame failed: 0x" << std::hex << hr << std::dec << std::endl;
+                LOG_ERROR("Capturer", "AcquireNextFrame failed: 0x%08X", (unsigned)hr);
             }
             errorCount++;
         }
@@ -368,6 +504,8 @@ void DXGICapturer::CaptureLoopWGC(FrameCallback onFrameCaptured) {
     auto nextFrameTime = std::chrono::steady_clock::now();
     
     int frameCount = 0;
+    uint32_t frameId = 0;
+    Tracer::SetThreadName("Capture");
     
     std::cout << "[Capturer-WGC] Capture loop started..." << std::endl;
     
@@ -381,7 +519,17 @@ void DXGICapturer::CaptureLoopWGC(FrameCallback onFrameCaptured) {
         auto frame = framePool.TryGetNextFrame();
         
         if (frame) {
+            TRACE_SCOPE("CaptureFrame", frameId);
+            Tracer::SetCurrentFrame(frameId++);
             frameCount++;
+
+            // SystemRelativeTime is QPC based, in 100ns units
+            LARGE_INTEGER now;
+            QueryPerformanceCounter(&now);
+            int64_t presentedNs = frame.SystemRelativeTime().count() * 100;
+            int64_t nowNs = (int64_t)QpcToNs(now.QuadPart);
+            if (nowNs > presentedNs) Metrics::Get().Record(Stage::Capture, (uint64_t)(nowNs - presentedNs));
+            Metrics::Get().Add(Counter::FramesCaptured);
             
             // Get the Direct3D11 surface
             auto frameSurface = frame.Surface();
@@ -394,11 +542,26 @@ void DXGICapturer::CaptureLoopWGC(FrameCallback onFrameCaptured) {
             
             if (SUCCEEDED(hr) && texture) {
                 if (frameCount % 60 == 1) {
-                    std::cout << "[Capturer-WGC] Frame #" << frameCount << std::endl;
+                    LOG_DEBUG("Capturer-WGC", "Frame #%d", (int)frameCount);
                 }
                 
-                // ZERO COPY: Pass texture directly to encoder
-                // WGC captures cursor by default, so we pass {-1, -1} to avoid drawing a second one
+                if (probeEnabled) {
+                    // The pool surface goes back to WGC; stamp a private copy
+                    if (!probeTexture) {
+                        D3D11_TEXTURE2D_DESC desc;
+                        texture->GetDesc(&desc);
+                        desc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+                        desc.MiscFlags = 0;
+                        device->CreateTexture2D(&desc, nullptr, &probeTexture);
+                    }
+                    if (probeTexture) {
+                        context->CopyResource(probeTexture.Get(), texture.Get());
+                        if (probeStamper.Stamp(context.Get(), probeTexture.Get(), Tracer::GetCurrentFrame())) texture = probeTexture;
+                    }
+                }
+
+                // Pass the pool surface on (copied into the pipeline ring before we return it)
+                // No pointer position from WGC: the cursor channel has it (or it is in the frame)
                 onFrameCaptured(texture.Get(), context.Get(), { -1, -1 });
             }
             
@@ -406,6 +569,8 @@ void DXGICapturer::CaptureLoopWGC(FrameCallback onFrameCaptured) {
         } else {
             // No new frame available
             // WGC handles its own timing better, but we can send nullptr to signal "no change"
+            TRACE_SCOPE("CaptureHeartbeat", frameId);
+            Tracer::SetCurrentFrame(frameId++);
             onFrameCaptured(nullptr, context.Get(), { -1, -1 });
         }
         
@@ -60,8 +60,10 @@
 #include <dxgi1_2.h>
 #include <wrl/client.h>
 #include <functional>
+#include <vector>
 #include <thread>
 #include <atomic>
+#include "LatencyProbe.h"
 
 // Windows.Graphics.Capture API (C++/WinRT)
 #include <winrt/Windows.Foundation.h>
@@ -72,6 +74,8 @@
 
 // Callback now includes cursor position (POINT)
 using FrameCallback = std::function<void(ID3D11Texture2D*, ID3D11DeviceContext*, POINT)>;
+struct CursorShape; // CursorChannel.h
+using PointerShapeCallback = std::function<void(const CursorShape&)>;
 
 class DXGICapturer {
 public:
@@ -82,6 +86,28 @@ public:
     void Start(FrameCallback onFrameCaptured);
     void Stop();
 
+    // Valid after Initialize: the device frames are captured on, and their size, so the
+    // encoder can be created before the first frame arrives
+    ID3D11Device* GetDevice() const { return device.Get(); }
+    bool GetFrameSize(int& width, int& height);
+
+    // The captured output in physical desktop coordinates, valid after Initialize
+    RECT GetOutputRect() const { return outputRect; }
+    // Desktop duplication reports the pointer separately, and WGC is asked to leave it
+    // out; true only where WGC can't (before Windows 10 2004)
+    bool IsCursorInFrame() const { return cursorInFrame; }
+    // WGC: put the pointer back into the frames, for sinks that only get video (the recorder),
+    // or leave it to the cursor channel again. Desktop duplication frames never have it.
+    void KeepCursorInFrame(bool keep);
+
+    // Only desktop duplication reports pointer shapes; with WGC they are read from the cursor handle
+    bool ReportsPointerShapes() const { return !useWGC; }
+    // Desktop duplication: every new pointer shape, on the capture thread. Set before Start.
+    void SetPointerShapeCallback(PointerShapeCallback onShape) { onPointerShape = onShape; }
+
+    // Stamp a latency barcode into every outgoing frame (see LatencyProbe.h)
+    void SetLatencyProbe(bool enabled) { probeEnabled = enabled; }
+
 private:
     Microsoft::WRL::ComPtr<ID3D11Device> device;
     Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
@@ -94,6 +120,10 @@ private:
     std::thread captureThread;
     std::atomic<bool> capturing; 
     bool useWGC; 
+    bool cursorInFrame = false;
+    RECT outputRect = {};
+    PointerShapeCallback onPointerShape;
+    std::vector<uint8_t> pointerShapeBuffer;
 
     // Windows.Graphics.Capture objects
     winrt::Windows::Graphics::Capture::GraphicsCaptureItem captureItem{ nullptr };
@@ -101,6 +131,12 @@ private:
     winrt::Windows::Graphics::Capture::GraphicsCaptureSession captureSession{ nullptr };
     Microsoft::WRL::ComPtr<IDXGIDevice> dxgiDevice;
 
+    // Latency probe: frames are stamped in a copy, never in the duplication/WGC surface
+    std::atomic<bool> probeEnabled = false;
+    LatencyProbeStamper probeStamper;
+    Microsoft::WRL::ComPtr<ID3D11Texture2D> probeTexture; // WGC only, DXGI stamps lastFrameCache
+
     void CaptureLoop(FrameCallback onFrameCaptured);
     void CaptureLoopWGC(FrameCallback onFrameCaptured);
+    void ReadPointerShape(UINT bufferSize);
 };
\ No newline at end of file
@@ -1,4 +1,7 @@
 #include "HardwareDecoder.h"
+#include "../common/Tracer.h"
+#include "../common/Logger.h"
+#include "PixelConvert.h"
 #include <iostream>
 #include <dxgi.h>
 #include <vector>
@@ -48,6 +51,8 @@ void HardwareDecoder::Cleanup() {
         }
     }
     else if (vendor == DecoderVendor::NVIDIA) {
+        mfInputSamples.Reset();
+        mfOutputSamples.Reset();
         if (mfTransform) {
             static_cast<IMFTransform*>(mfTransform)->Release();
             mfTransform = nullptr;
@@ -192,8 +197,11 @@ bool HardwareDecoder::InitAMD(ID3D11Device* device) {
 }
 
 ID3D11Texture2D* HardwareDecoder::Decode(const uint8_t* data, size_t size, ID3D11DeviceContext* ctx) {
+    TRACE_SCOPE("Decode", Tracer::GetCurrentFrame());
     if (!data || size == 0) return nullptr;
 
+    lastAccessUnit = parser.ParseAccessUnit(data, size);
+
     if (vendor == DecoderVendor::AMD) {
         return DecodeAMD(data, size);
     }
@@ -208,20 +216,17 @@ ID3D11Texture2D* HardwareDecoder::DecodeAMD(const uint8_t* data, size_t size) {
     auto comp = *(static_cast<amf::AMFComponentPtr*>(amfComponent));
     auto ctx = *(static_cast<amf::AMFContextPtr*>(amfContext));
 
-    // Debug: Check NAL type for keyframes only
-    int nalType = 0;
-    if (size > 4 && data[0] == 0 && data[1] == 0 && data[2] == 0 && data[3] == 1) {
-        nalType = data[4] & 0x1F;
-    }
-    
-    if (nalType == 7 || nalType == 5) {
-        std::cout << "[Decoder] Keyframe received: NAL=" << nalType << std::endl;
+    // Debug: Log keyframes only
+    if (lastAccessUnit.frameType == FrameType::IDR) {
+        const SequenceInfo& seq = parser.GetSequenceInfo();
+        LOG_DEBUG("Decoder", "Keyframe received: %d NALs%s | Stream: %dx%d", lastAccessUnit.nalCount,
+                  lastAccessUnit.hasParameterSets ? " (with SPS)" : "", seq.valid ? seq.width : 0, seq.valid ? seq.height : 0);
     }
 
     // Create AMF buffer from input data
     amf::AMFBufferPtr buffer;
     if (ctx->AllocBuffer(amf::AMF_MEMORY_HOST, size, &buffer) != AMF_OK) {
-        std::cerr << "[Decoder] Failed to allocate AMF buffer" << std::endl;
+        LOG_ERROR_RATE("Decoder", 1, "Failed to allocate AMF buffer");
         return nullptr;
     }
 
@@ -238,11 +243,11 @@ ID3D11Texture2D* HardwareDecoder::DecodeAMD(const uint8_t* data, size_t size) {
     if (result == AMF_INPUT_FULL) {
         // Input full, skip submitting but still try to get output
         if (frameCount < 5) {
-            std::cout << "[Decoder] Input buffer full, draining output" << std::endl;
+            LOG_DEBUG("Decoder", "Input buffer full, draining output");
         }
     }
     else if (result != AMF_OK) {
-        std::cerr << "[Decoder] SubmitInput failed: " << result << std::endl;
+        LOG_ERROR_RATE("Decoder", 1, "SubmitInput failed: %d", (int)result);
     }
 
     // ALWAYS try to query output, even if submit failed
@@ -255,7 +260,7 @@ ID3D11Texture2D* HardwareDecoder::DecodeAMD(const uint8_t* data, size_t size) {
         return nullptr;
     }
     else if (result == AMF_EOF) {
-        std::cerr << "[Decoder] AMF_EOF received" << std::endl;
+        LOG_WARN_RATE("Decoder", 1, "AMF_EOF received");
         return nullptr;
     }
     else if (result != AMF_OK || !outputData) {
@@ -265,7 +270,7 @@ ID3D11Texture2D* HardwareDecoder::DecodeAMD(const uint8_t* data, size_t size) {
     // Convert AMFData to AMFSurface
     amf::AMFSurfacePtr surface(outputData);
     if (!surface) {
-        std::cerr << "[Decoder] Failed to get surface from output data" << std::endl;
+        LOG_ERROR_RATE("Decoder", 1, "Failed to get surface from output data");
         return nullptr;
     }
 
@@ -273,7 +278,7 @@ ID3D11Texture2D* HardwareDecoder::DecodeAMD(const uint8_t* data, size_t size) {
     ID3D11Texture2D* d3d11Texture = (ID3D11Texture2D*)surface->GetPlaneAt(0)->GetNative();
     
     if (!d3d11Texture) {
-        std::cerr << "[Decoder] Failed to get D3D11 texture from surface" << std::endl;
+        LOG_ERROR_RATE("Decoder", 1, "Failed to get D3D11 texture from surface");
         return nullptr;
     }
     
@@ -290,9 +295,9 @@ ID3D11Texture2D* HardwareDecoder::DecodeAMD(const uint8_t* data, size_t size) {
 
     frameCount++;
     if (frameCount == 1) {
-        std::cout << "[Decoder] ✓ First frame decoded successfully (Zero-Copy)" << std::endl;
+        LOG_INFO("Decoder", "First frame decoded successfully (Zero-Copy)");
     } else if (frameCount % 60 == 0) {
-        std::cout << "[Decoder] " << frameCount << " frames decoded" << std::endl;
+        LOG_DEBUG("Decoder", "%d frames decoded", frameCount);
     }
 
     // Return the compatible texture (GPU-to-GPU copy, still zero CPU copy!)
@@ -444,19 +449,16 @@ ID3D11Texture2D* HardwareDecoder::DecodeNVIDIA(const uint8_t* data, size_t size,
     IMFTransform* transform = static_cast<IMFTransform*>(mfTransform);
     if (!transform) return nullptr;
 
-    // Create input sample
-    IMFSample* sample = nullptr;
-    IMFMediaBuffer* buffer = nullptr;
-    MFCreateMemoryBuffer((DWORD)size, &buffer);
+    // Input sample (pooled, grows to the largest packet seen)
+    ComPtr<IMFSample> sample;
+    ComPtr<IMFMediaBuffer> buffer;
+    if (!mfInputSamples.Acquire((DWORD)size, sample, buffer)) return nullptr;
     
     BYTE* pData = nullptr;
     buffer->Lock(&pData, nullptr, nullptr);
     memcpy(pData, data, size);
     buffer->Unlock();
     buffer->SetCurrentLength((DWORD)size);
-
-    MFCreateSample(&sample);
-    sample->AddBuffer(buffer);
     
     static LONGLONG timestamp = 0;
     sample->SetSampleTime(timestamp);
@@ -464,9 +466,9 @@ ID3D11Texture2D* HardwareDecoder::DecodeNVIDIA(const uint8_t* data, size_t size,
     timestamp += 166666;
 
     // Submit input
-    HRESULT hr = transform->ProcessInput(0, sample, 0);
-    sample->Release();
-    buffer->Release();
+    HRESULT hr = transform->ProcessInput(0, sample.Get(), 0);
+    sample.Reset();
+    buffer.Reset();
     
     if (FAILED(hr)) return nullptr;
 
@@ -475,23 +477,18 @@ ID3D11Texture2D* HardwareDecoder::DecodeNVIDIA(const uint8_t* data, size_t size,
         MFT_OUTPUT_STREAM_INFO info;
         transform->GetOutputStreamInfo(0, &info);
 
-        IMFSample* outSample = nullptr;
-        IMFMediaBuffer* outBuffer = nullptr;
-        MFCreateMemoryBuffer(info.cbSize, &outBuffer);
-        MFCreateSample(&outSample);
-        outSample->AddBuffer(outBuffer);
+        ComPtr<IMFSample> outSample;
+        ComPtr<IMFMediaBuffer> outBuffer;
+        if (!mfOutputSamples.Acquire(info.cbSize, outSample, outBuffer)) return nullptr;
 
         MFT_OUTPUT_DATA_BUFFER outputData = {};
         outputData.dwStreamID = 0;
-        outputData.pSample = outSample;
+        outputData.pSample = outSample.Get();
         
         DWORD status = 0;
         hr = transform->ProcessOutput(0, 1, &outputData, &status);
 
         if (hr == MF_E_TRANSFORM_STREAM_CHANGE) {
-            outSample->Release();
-            outBuffer->Release();
-            
             IMFMediaType* type = nullptr;
             MFCreateMediaType(&type);
             type->SetGUID(MF_MT_MAJOR_TYPE, MFMediaType_Video);
@@ -502,8 +499,6 @@ ID3D11Texture2D* HardwareDecoder::DecodeNVIDIA(const uint8_t* data, size_t size,
             continue;
         }
         else if (hr == MF_E_TRANSFORM_NEED_MORE_INPUT) {
-            outSample->Release();
-            outBuffer->Release();
             return nullptr;
         }
         else if (SUCCEEDED(hr)) {
@@ -522,21 +517,8 @@ ID3D11Texture2D* HardwareDecoder::DecodeNVIDIA(const uint8_t* data, size_t size,
             if (srcPtr) {
                 D3D11_MAPPED_SUBRESOURCE map;
                 if (SUCCEEDED(ctx->Map(mfStagingTexture, 0, D3D11_MAP_WRITE_DISCARD, 0, &map))) {
-                    BYTE* dstPtr = (BYTE*)map.pData;
-                    UINT dstStride = map.RowPitch;
-                    int alignedHeight = Align16(height);
-                    
-                    // Copy Y plane (only actual height, not aligned)
-                    for (int y = 0; y < height; ++y) {
-                        memcpy(dstPtr + y * dstStride, srcPtr + y * srcStride, width);
-                    }
-
-                    // Copy UV plane - starts at alignedHeight in both source and dest
-                    BYTE* srcUV = srcPtr + (srcStride * alignedHeight);
-                    BYTE* dstUV = dstPtr + (dstStride * alignedHeight);
-                    for (int y = 0; y < height / 2; ++y) {
-                        memcpy(dstUV + y * dstStride, srcUV + y * srcStride, width);
-                    }
+                    // Y plane (only actual height, not aligned); UV starts at alignedHeight in both
+                    CopyNV12(srcPtr, srcStride, (BYTE*)map.pData, map.RowPitch, width, height, Align16(height));
 
                     ctx->Unmap(mfStagingTexture, 0);
                 }
@@ -552,22 +534,18 @@ ID3D11Texture2D* HardwareDecoder::DecodeNVIDIA(const uint8_t* data, size_t size,
                 ctx->CopyResource(mfOutputTexture, mfStagingTexture);
             }
 
-            outSample->Release();
-            outBuffer->Release();
             if (outputData.pEvents) outputData.pEvents->Release();
 
             frameCount++;
             if (frameCount == 1) {
-                std::cout << "[Decoder] ✓ First frame decoded successfully (NVIDIA)" << std::endl;
+                LOG_INFO("Decoder", "First frame decoded successfully (NVIDIA)");
             } else if (frameCount % 60 == 0) {
-                std::cout << "[Decoder] " << frameCount << " frames decoded" << std::endl;
+                LOG_DEBUG("Decoder", "%d frames decoded", frameCount);
             }
 
             return mfOutputTexture;
         }
         else {
-            outSample->Release();
-            outBuffer->Release();
             return nullptr;
         }
     }
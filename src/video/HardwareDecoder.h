@@ -2,6 +2,8 @@
 #include <d3d11.h>
 #include <functional>
 #include <wrl/client.h>
+#include "AnnexBParser.h"
+#include "MFSamplePool.h"
 
 using Microsoft::WRL::ComPtr;
 
@@ -15,6 +17,10 @@ public:
     ID3D11Texture2D* DrainOutput(); // Get buffered output without submitting new input
     void Cleanup();
 
+    // Structure of the most recently submitted packet
+    const AccessUnitInfo& GetLastAccessUnit() const { return lastAccessUnit; }
+    const SequenceInfo& GetSequenceInfo() const { return parser.GetSequenceInfo(); }
+
 private:
     enum class DecoderVendor {
         UNKNOWN,
@@ -44,7 +50,12 @@ private:
     void* mfTransform = nullptr;     // IMFTransform*
     ID3D11Texture2D* mfStagingTexture = nullptr;
     ID3D11Texture2D* mfOutputTexture = nullptr;
+    MFSamplePool mfInputSamples;
+    MFSamplePool mfOutputSamples;
     
     bool firstFrame = true;
     int frameCount = 0;
+
+    AnnexBParser parser;
+    AccessUnitInfo lastAccessUnit;
 };
@@ -1,4 +1,8 @@
 #include "HardwareEncoder.h"
+#include "../common/Metrics.h"
+#include "../common/Tracer.h"
+#include "../common/Logger.h"
+#include "PixelConvert.h"
 #include <iostream>
 #include <string>
 #include <wrl/client.h> 
@@ -35,6 +39,28 @@ inline int Align16(int value) {
     return (value + 15) & ~15;
 }
 
+// Packets from a deferred readback belong to the frame that was copied, not the current one
+struct ScopedCurrentFrame {
+    uint32_t previous;
+    explicit ScopedCurrentFrame(uint32_t frameId) : previous(Tracer::GetCurrentFrame()) { Tracer::SetCurrentFrame(frameId); }
+    ~ScopedCurrentFrame() { Tracer::SetCurrentFrame(previous); }
+};
+
+static void ReleaseStagingRing(StagingRing& ring) {
+    for (size_t i = 0; i < ring.Depth(); i++) ring.At(i).Reset();
+    ring.Reset();
+}
+
+static bool CreateStagingRing(ID3D11Device* device, const D3D11_TEXTURE2D_DESC& desc, StagingRing& ring) {
+    for (size_t i = 0; i < ring.Depth(); i++) {
+        if (FAILED(device->CreateTexture2D(&desc, nullptr, &ring.At(i)))) {
+            ReleaseStagingRing(ring);
+            return false;
+        }
+    }
+    return true;
+}
+
 HardwareEncoder::HardwareEncoder() { 
     HRESULT hr = CoInitializeEx(NULL, COINIT_MULTITHREADED);
     if (FAILED(hr)) std::cerr << "Warning: CoInitializeEx failed: " << std::hex << hr << std::endl;
@@ -52,6 +78,8 @@ HardwareEncoder::~HardwareEncoder() {
 void HardwareEncoder::Cleanup() {
     if (vendor == EncoderVendor::NVIDIA && nvEncoder) {
         auto funcs = static_cast<NV_ENCODE_API_FUNCTION_LIST*>(nvFunctionList);
+        if (funcs && nvBitstreamBuffer) funcs->nvEncDestroyBitstreamBuffer(nvEncoder, nvBitstreamBuffer);
+        nvBitstreamBuffer = nullptr;
         if (funcs && nvRegisteredResource) funcs->nvEncUnregisterResource(nvEncoder, nvRegisteredResource);
         if (funcs) funcs->nvEncDestroyEncoder(nvEncoder);
     }
@@ -63,14 +91,10 @@ void HardwareEncoder::Cleanup() {
         if (amfCachedSurface) delete static_cast<amf::AMFSurfacePtr*>(amfCachedSurface);
         if (amfComponent) static_cast<amf::AMFComponent*>(amfComponent)->Terminate();
     }
-    if (stagingTexture) {
-        stagingTexture->Release();
-        stagingTexture = nullptr;
-    }
-    if (stagingTextureCrossGPU) {
-        stagingTextureCrossGPU->Release();
-        stagingTextureCrossGPU = nullptr;
-    }
+    mfInputSamples.Reset();
+    mfOutputSamples.Reset();
+    ReleaseStagingRing(mfReadback);
+    ReleaseStagingRing(crossGPUReadback);
     if (crossGPUTextureEncoder) {
         crossGPUTextureEncoder->Release();
         crossGPUTextureEncoder = nullptr;
@@ -158,8 +182,8 @@ bool HardwareEncoder::Initialize(ID3D11Device* device, int w, int h) {
                         stagingDesc.Usage = D3D11_USAGE_STAGING;
                         stagingDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
                         
-                        if (FAILED(device->CreateTexture2D(&stagingDesc, nullptr, &stagingTextureCrossGPU))) {
-                            std::cerr << "[Encoder] Failed to create staging texture" << std::endl;
+                        if (!CreateStagingRing(device, stagingDesc, crossGPUReadback)) {
+                            std::cerr << "[Encoder] Failed to create staging textures" << std::endl;
                             encoderDevice->Release();
                             encoderDevice = nullptr;
                             encoderContext->Release();
@@ -181,8 +205,7 @@ bool HardwareEncoder::Initialize(ID3D11Device* device, int w, int h) {
                         
                         if (FAILED(encoderDevice->CreateTexture2D(&uploadDesc, nullptr, &crossGPUTextureEncoder))) {
                             std::cerr << "[Encoder] Failed to create encoder upload texture" << std::endl;
-                            stagingTextureCrossGPU->Release();
-                            stagingTextureCrossGPU = nullptr;
+                            ReleaseStagingRing(crossGPUReadback);
                             encoderDevice->Release();
                             encoderDevice = nullptr;
                             encoderContext->Release();
@@ -222,10 +245,7 @@ bool HardwareEncoder::Initialize(ID3D11Device* device, int w, int h) {
             std::cerr << "[Encoder] NVENC initialization failed!" << std::endl;
             
             // Clean up cross-GPU resources
-            if (stagingTextureCrossGPU) {
-                stagingTextureCrossGPU->Release();
-                stagingTextureCrossGPU = nullptr;
-            }
+            ReleaseStagingRing(crossGPUReadback);
             if (crossGPUTextureEncoder) {
                 crossGPUTextureEncoder->Release();
                 crossGPUTextureEncoder = nullptr;
@@ -265,62 +285,72 @@ bool HardwareEncoder::Initialize(ID3D11Device* device, int w, int h) {
     }
 }
 
+bool HardwareEncoder::GetParameterSets(std::vector<uint8_t>& out) {
+    out.clear();
+    if (vendor == EncoderVendor::NVIDIA && nvEncoder) {
+        auto nv = static_cast<NV_ENCODE_API_FUNCTION_LIST*>(nvFunctionList);
+        uint8_t header[1024];
+        uint32_t headerSize = 0;
+        NV_ENC_SEQUENCE_PARAM_PAYLOAD payload = {};
+        payload.version = NV_ENC_SEQUENCE_PARAM_PAYLOAD_VER;
+        payload.inBufferSize = sizeof(header);
+        payload.spsppsBuffer = header;
+        payload.outSPSPPSPayloadSize = &headerSize;
+        if (nv->nvEncGetSequenceParams(nvEncoder, &payload) != NV_ENC_SUCCESS) return false;
+        out.assign(header, header + headerSize);
+    }
+    else if (vendor == EncoderVendor::AMD && amfComponent) {
+        auto comp = *(static_cast<amf::AMFComponentPtr*>(amfComponent));
+        amf::AMFVariant extraData;
+        if (comp->GetProperty(AMF_VIDEO_ENCODER_EXTRADATA, &extraData) != AMF_OK || !extraData.pInterface) return false;
+        amf::AMFInterfacePtr extraDataInterface(extraData.pInterface);
+        amf::AMFBufferPtr buffer(extraDataInterface); // Queries AMFBuffer
+        if (!buffer) return false;
+        const uint8_t* data = (const uint8_t*)buffer->GetNative();
+        out.assign(data, data + buffer->GetSize());
+    }
+    else if (vendor == EncoderVendor::MF_GENERIC && mfTransform) {
+        ComPtr<IMFMediaType> outputType;
+        UINT32 size = 0;
+        if (FAILED(mfTransform->GetOutputCurrentType(0, &outputType)) ||
+            FAILED(outputType->GetBlobSize(MF_MT_MPEG_SEQUENCE_HEADER, &size)) || size == 0) return false;
+        out.resize(size);
+        if (FAILED(outputType->GetBlob(MF_MT_MPEG_SEQUENCE_HEADER, out.data(), size, nullptr))) {
+            out.clear();
+            return false;
+        }
+    }
+    return !out.empty();
+}
+
 void HardwareEncoder::EncodeFrame(ID3D11Texture2D* texture, ID3D11DeviceContext* context, EncodedPacketCallback onPacketReady) {
+    uint32_t frameId = Tracer::GetCurrentFrame();
+    TRACE_SCOPE("EncodeFrame", frameId);
     ID3D11Texture2D* target = nullptr;
     
-    if (stagingTextureCrossGPU && crossGPUTextureEncoder && encoderDevice) { // Cross-GPU copy via CPU staging
-        static bool firstFrame = true;
-        
-        context->CopyResource(stagingTextureCrossGPU, texture); // GPU -> CPU
-        
-        D3D11_MAPPED_SUBRESOURCE mapped;
-        HRESULT hrMap = context->Map(stagingTextureCrossGPU, 0, D3D11_MAP_READ, 0, &mapped);
-        if (FAILED(hrMap)) {
-            if (firstFrame) {
-                std::cerr << "[Encoder] Failed to map staging texture: 0x" << std::hex << hrMap << std::dec << std::endl;
-            }
-            return;
-        }
-        
-        if (firstFrame) {
-            std::cout << "[Encoder] Cross-GPU copy starting | RowPitch: " << mapped.RowPitch << std::endl;
-        }
-        
-        D3D11_BOX srcBox; // CPU -> encoder GPU
-        srcBox.left = 0;
-        srcBox.top = 0;
-        srcBox.front = 0;
-        srcBox.right = width;
-        srcBox.bottom = height;
-        srcBox.back = 1;
-        
-        encoderContext->UpdateSubresource(crossGPUTextureEncoder, 0, &srcBox, mapped.pData, mapped.RowPitch, 0);
-        context->Unmap(stagingTextureCrossGPU, 0);
-        
-        if (firstFrame) {
-            std::cout << "[Encoder] Cross-GPU copy completed, converting..." << std::endl;
-            firstFrame = false;
-        }
-        
-        // Use converter on encoder GPU side
-        target = converter.Convert(crossGPUTextureEncoder);
-        if (!target) {
-            std::cerr << "[Encoder] Converter failed to convert texture" << std::endl;
-            return;
-        }
-        
-        if (firstFrame) {
-            std::cout << "[Encoder] Conversion successful, calling NVENC..." << std::endl;
-        }
+    if (crossGPUTextureEncoder && encoderDevice) { // Cross-GPU copy via CPU staging ring
+        auto read = [&](ComPtr<ID3D11Texture2D>& staging, uint32_t tag, bool wait) {
+            return ReadCrossGPU(staging.Get(), context, tag, wait, onPacketReady);
+        };
+        ID3D11Texture2D* staging = crossGPUReadback.Next(frameId, read).Get();
+        context->CopyResource(staging, texture); // GPU -> CPU, mapped on a later call
+        context->Flush();
+        crossGPUReadback.Poll(read);
+        return;
     }
     else if (vendor == EncoderVendor::MF_GENERIC) { // Intel: skip VideoProcessor, use BGRA directly
         target = texture;
     } else {
         // NVIDIA/AMD: Use VideoProcessor for BGRA->NV12 conversion
-        target = converter.Convert(texture);
+        {
+            TRACE_SCOPE("Convert", frameId);
+            ScopedStageTimer convertTimer(Stage::Convert);
+            target = converter.Convert(texture);
+        }
         if (!target) return;
     }
 
+    ScopedStageTimer encodeTimer(Stage::Encode);
     if (vendor == EncoderVendor::NVIDIA) {
         // std::cout << "[Encoder] Encoding with NVENC..." << std::endl;
         EncodeNVIDIA(target, onPacketReady);
@@ -330,6 +360,83 @@ void HardwareEncoder::EncodeFrame(ID3D11Texture2D* texture, ID3D11DeviceContext*
     else if (vendor == EncoderVendor::MF_GENERIC) EncodeMF(target, context, onPacketReady);
 }
 
+bool HardwareEncoder::ReadCrossGPU(ID3D11Texture2D* staging, ID3D11DeviceContext* context, uint32_t frameId, bool wait,
+                                   EncodedPacketCallback onPacketReady) {
+    static bool firstFrame = true;
+
+    D3D11_MAPPED_SUBRESOURCE mapped;
+    HRESULT hrMap = context->Map(staging, 0, D3D11_MAP_READ, wait ? 0 : D3D11_MAP_FLAG_DO_NOT_WAIT, &mapped);
+    if (hrMap == DXGI_ERROR_WAS_STILL_DRAWING) return false;
+    if (FAILED(hrMap)) {
+        if (firstFrame) {
+            LOG_ERROR("Encoder", "Failed to map staging texture: 0x%08X", (unsigned)hrMap);
+        }
+        return true;
+    }
+    ScopedCurrentFrame frameScope(frameId);
+
+    if (firstFrame) {
+        LOG_INFO("Encoder", "Cross-GPU copy starting | RowPitch: %u", mapped.RowPitch);
+    }
+
+    D3D11_BOX srcBox; // CPU -> encoder GPU
+    srcBox.left = 0;
+    srcBox.top = 0;
+    srcBox.front = 0;
+    srcBox.right = width;
+    srcBox.bottom = height;
+    srcBox.back = 1;
+
+    encoderContext->UpdateSubresource(crossGPUTextureEncoder, 0, &srcBox, mapped.pData, mapped.RowPitch, 0);
+    context->Unmap(staging, 0);
+
+    if (firstFrame) {
+        LOG_INFO("Encoder", "Cross-GPU copy completed, converting...");
+        firstFrame = false;
+    }
+
+    // Use converter on encoder GPU side
+    ID3D11Texture2D* target = nullptr;
+    {
+        TRACE_SCOPE("Convert", frameId);
+        ScopedStageTimer convertTimer(Stage::Convert);
+        target = converter.Convert(crossGPUTextureEncoder);
+    }
+    if (!target) {
+        LOG_ERROR_RATE("Encoder", 1, "Converter failed to convert texture");
+        return true;
+    }
+
+    ScopedStageTimer encodeTimer(Stage::Encode);
+    if (vendor == EncoderVendor::NVIDIA) EncodeNVIDIA(target, onPacketReady);
+    else if (vendor == EncoderVendor::AMD) EncodeAMD(target, onPacketReady);
+    return true;
+}
+
+bool HardwareEncoder::UsesConvertStage() const {
+    return !encoderDevice && (vendor == EncoderVendor::NVIDIA || vendor == EncoderVendor::AMD);
+}
+
+bool HardwareEncoder::ConvertFrame(ID3D11Texture2D* texture, ID3D11Texture2D* nv12Output) {
+    TRACE_SCOPE("Convert", Tracer::GetCurrentFrame());
+    ScopedStageTimer convertTimer(Stage::Convert);
+    return converter.ConvertInto(texture, nv12Output);
+}
+
+void HardwareEncoder::EncodeConverted(ID3D11Texture2D* nv12Texture, EncodedPacketCallback onPacketReady) {
+    TRACE_SCOPE("EncodeFrame", Tracer::GetCurrentFrame());
+    ScopedStageTimer encodeTimer(Stage::Encode);
+    if (vendor == EncoderVendor::NVIDIA) {
+        EncodeNVIDIA(nv12Texture, onPacketReady); // Copies into nvInputTexture
+    } else if (vendor == EncoderVendor::AMD) {
+        // The AMF surface wraps the converter's output texture, so feed it through there
+        ComPtr<ID3D11DeviceContext> ctx;
+        devicePtr->GetImmediateContext(&ctx);
+        ctx->CopyResource(converter.GetOutputTexture(), nv12Texture);
+        EncodeAMD(converter.GetOutputTexture(), onPacketReady);
+    }
+}
+
 bool HardwareEncoder::InitNVIDIA(ID3D11Device* device) {
     std::cout << "[NVENC] InitNVIDIA starting..." << std::endl;
     
@@ -464,6 +571,13 @@ bool HardwareEncoder::InitNVIDIA(ID3D11Device* device) {
         return false;
     }
     nvRegisteredResource = reg.registeredResource;
+
+    NV_ENC_CREATE_BITSTREAM_BUFFER bitbuf = { NV_ENC_CREATE_BITSTREAM_BUFFER_VER };
+    if (nv->nvEncCreateBitstreamBuffer(nvEncoder, &bitbuf) != NV_ENC_SUCCESS) {
+        std::cerr << "[NVENC] Create bitstream buffer failed" << std::endl;
+        return false;
+    }
+    nvBitstreamBuffer = bitbuf.bitstreamBuffer;
     
     std::cout << "[NVENC] Initialized successfully" << std::endl;
     return true;
@@ -486,23 +600,22 @@ void HardwareEncoder::EncodeNVIDIA(ID3D11Texture2D* texture, EncodedPacketCallba
     
     NVENCSTATUS mapStatus = nv->nvEncMapInputResource(nvEncoder, &map);
     if (mapStatus != NV_ENC_SUCCESS) {
-        std::cerr << "[NVENC] Map failed: " << mapStatus << std::endl;
+        LOG_ERROR_RATE("NVENC", 1, "Map failed: %d", (int)mapStatus);
         return;
     }
     
-    NV_ENC_CREATE_BITSTREAM_BUFFER bitbuf = { NV_ENC_CREATE_BITSTREAM_BUFFER_VER };
-    nv->nvEncCreateBitstreamBuffer(nvEncoder, &bitbuf);
-    
     NV_ENC_PIC_PARAMS pic = { NV_ENC_PIC_PARAMS_VER };
     pic.pictureStruct = NV_ENC_PIC_STRUCT_FRAME;
     pic.inputBuffer = map.mappedResource;
     pic.bufferFmt = map.mappedBufferFmt;
     pic.inputWidth = width;
     pic.inputHeight = height;
-    pic.outputBitstream = bitbuf.bitstreamBuffer;
+    pic.outputBitstream = nvBitstreamBuffer;
     static int nvFrameCount = 0;
     nvFrameCount++;
-    if (nvFrameCount == 1) pic.encodePicFlags = NV_ENC_PIC_FLAG_FORCEIDR;
+    if (keyframeRequested.exchange(false) || nvFrameCount == 1) {
+        pic.encodePicFlags = NV_ENC_PIC_FLAG_FORCEIDR | NV_ENC_PIC_FLAG_OUTPUT_SPSPPS;
+    }
     
     NVENCSTATUS encStatus = nv->nvEncEncodePicture(nvEncoder, &pic);
     // std::cout << "[NVENC] nvEncEncodePicture returned: " << encStatus << std::endl;
@@ -510,13 +623,13 @@ void HardwareEncoder::EncodeNVIDIA(ID3D11Texture2D* texture, EncodedPacketCallba
     // std::cout << "[NVENC] Locking bitstream..." << std::endl;
     
     NV_ENC_LOCK_BITSTREAM lock = { NV_ENC_LOCK_BITSTREAM_VER };
-    lock.outputBitstream = bitbuf.bitstreamBuffer;
+    lock.outputBitstream = nvBitstreamBuffer;
     if (nv->nvEncLockBitstream(nvEncoder, &lock) == NV_ENC_SUCCESS) {
         // std::cout << "[NVENC] Bitstream locked, size: " << lock.bitstreamSizeInBytes << " bytes" << std::endl;
+        Metrics::Get().Set(Gauge::EncoderQP, lock.frameAvgQP);
         if (lock.bitstreamSizeInBytes > 0) callback((const uint8_t*)lock.bitstreamBufferPtr, lock.bitstreamSizeInBytes);
         nv->nvEncUnlockBitstream(nvEncoder, lock.outputBitstream);
     }
-    nv->nvEncDestroyBitstreamBuffer(nvEncoder, bitbuf.bitstreamBuffer);
     nv->nvEncUnmapInputResource(nvEncoder, map.mappedResource); 
 }
 
@@ -565,7 +678,12 @@ void HardwareEncoder::EncodeAMD(ID3D11Texture2D* texture, EncodedPacketCallback
     surface->SetPts(pts++);
     static int amfFrameCount = 0;
     amfFrameCount++;
-    if (amfFrameCount == 1) surface->SetProperty(AMF_VIDEO_ENCODER_FORCE_PICTURE_TYPE, AMF_VIDEO_ENCODER_PICTURE_TYPE_IDR);
+    // Surface is cached, so the picture type must be reset after a forced IDR
+    bool forceIdr = keyframeRequested.exchange(false) || amfFrameCount == 1;
+    surface->SetProperty(AMF_VIDEO_ENCODER_FORCE_PICTURE_TYPE,
+        forceIdr ? AMF_VIDEO_ENCODER_PICTURE_TYPE_IDR : AMF_VIDEO_ENCODER_PICTURE_TYPE_NONE);
+    surface->SetProperty(AMF_VIDEO_ENCODER_INSERT_SPS, forceIdr);
+    surface->SetProperty(AMF_VIDEO_ENCODER_INSERT_PPS, forceIdr);
     if (comp->SubmitInput(surface) == AMF_INPUT_FULL) return;
     amf::AMFDataPtr data;
     if (comp->QueryOutput(&data) == AMF_OK && data) {
@@ -662,7 +780,7 @@ bool HardwareEncoder::InitMF(ID3D11Device* device) {
     desc.Usage = D3D11_USAGE_STAGING;
     desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
     
-    if (FAILED(device->CreateTexture2D(&desc, nullptr, &stagingTexture))) return false;
+    if (!CreateStagingRing(device, desc, mfReadback)) return false;
 
     std::cout << "MF: Setting Output Type..." << std::endl;
     ComPtr<IMFMediaType> outputType;
@@ -756,18 +874,27 @@ bool HardwareEncoder::InitMF(ID3D11Device* device) {
 }
 
 void HardwareEncoder::EncodeMF(ID3D11Texture2D* texture, ID3D11DeviceContext* ctx, EncodedPacketCallback callback) {
-    if (!stagingTexture || !mfTransform) return;
+    if (!mfReadback.At(0) || !mfTransform) return;
 
-    // 1. Copy GPU -> CPU Staging
-    ctx->CopyResource(stagingTexture, texture);
-    
-    // --- FORCE GPU SYNC ---
-    // Ensure the copy completes before we map it
-    ctx->Flush(); 
+    // 1. Copy GPU -> CPU staging (no flush-and-wait: the copy is mapped on a later call)
+    auto read = [&](ComPtr<ID3D11Texture2D>& staging, uint32_t frameId, bool wait) {
+        return ReadMF(staging.Get(), ctx, frameId, wait, callback);
+    };
+    ID3D11Texture2D* staging = mfReadback.Next(Tracer::GetCurrentFrame(), read).Get();
+    ctx->CopyResource(staging, texture);
+    ctx->Flush(); // Start the copy now
+
+    // 2. Encode whichever earlier frames the GPU has finished copying
+    mfReadback.Poll(read);
+}
 
-    // 2. Map
+bool HardwareEncoder::ReadMF(ID3D11Texture2D* staging, ID3D11DeviceContext* ctx, uint32_t frameId, bool wait,
+                             EncodedPacketCallback callback) {
     D3D11_MAPPED_SUBRESOURCE map;
-    if (SUCCEEDED(ctx->Map(stagingTexture, 0, D3D11_MAP_READ, 0, &map))) {
+    HRESULT hrMap = ctx->Map(staging, 0, D3D11_MAP_READ, wait ? 0 : D3D11_MAP_FLAG_DO_NOT_WAIT, &map);
+    if (hrMap == DXGI_ERROR_WAS_STILL_DRAWING) return false;
+    ScopedCurrentFrame frameScope(frameId);
+    if (SUCCEEDED(hrMap)) {
         
         // --- DATA INTEGRITY CHECK (Run once per second) ---
         static int debugFrame = 0;
@@ -778,13 +905,11 @@ void HardwareEncoder::EncodeMF(ID3D11Texture2D* texture, ID3D11DeviceContext* ct
             // Sum first 100 pixels to see if they are empty
             for(int i=0; i<100; i++) sum += check[i];
             
-            std::cout << "MF: Frame " << debugFrame 
-                      << " | Pitch: " << map.RowPitch 
-                      << " | 1st Byte: " << (int)check[0] 
-                      << " | Sum(100): " << sum << std::endl;
+            LOG_DEBUG("MF", "Frame %d | Pitch: %u | 1st Byte: %d | Sum(100): %d", debugFrame, map.RowPitch, (int)check[0], sum);
         }
         // --------------------------------------------------
 
+        ComPtr<IMFSample> sample;
         ComPtr<IMFMediaBuffer> buffer;
         
         if (!useCPUConversion) {
@@ -792,26 +917,14 @@ void HardwareEncoder::EncodeMF(ID3D11Texture2D* texture, ID3D11DeviceContext* ct
             int alignedW = Align16(width);
             int alignedH = Align16(height);
             DWORD bufLen = alignedW * alignedH * 4;
-            MFCreateMemoryBuffer(bufLen, &buffer);
+            if (!mfInputSamples.Acquire(bufLen, sample, buffer)) {
+                ctx->Unmap(staging, 0);
+                return true;
+            }
             
             BYTE* pBufData = nullptr;
             if (SUCCEEDED(buffer->Lock(&pBufData, nullptr, nullptr))) {
-                 BYTE* src = (BYTE*)map.pData;
-                 BYTE* dst = pBufData;
-
-                 // Copy actual frame rows
-                 for (int y = 0; y < height; y++) {
-                     memcpy(dst, src, width * 4);
-                     src += map.RowPitch;
-                     dst += alignedW * 4; // Use aligned width for destination
-                 }
-                 
-                 // Pad remaining rows with black (0,0,0,255)
-                 for (int y = height; y < alignedH; y++) {
-                     memset(dst, 0, alignedW * 4);
-                     dst += alignedW * 4;
-                 }
-                 
+                 CopyBGRAPadded((const BYTE*)map.pData, map.RowPitch, width, height, pBufData, alignedW, alignedH);
                  buffer->Unlock();
                  buffer->SetCurrentLength(bufLen);
             }
@@ -820,71 +933,33 @@ void HardwareEncoder::EncodeMF(ID3D11Texture2D* texture, ID3D11DeviceContext* ct
             int alignedW = Align16(width);
             int alignedH = Align16(height);
             DWORD bufLen = alignedW * alignedH * 3 / 2;
-            MFCreateMemoryBuffer(bufLen, &buffer);
+            if (!mfInputSamples.Acquire(bufLen, sample, buffer)) {
+                ctx->Unmap(staging, 0);
+                return true;
+            }
             
             BYTE* pBufData = nullptr;
             if (SUCCEEDED(buffer->Lock(&pBufData, nullptr, nullptr))) {
                 BYTE* src = (BYTE*)map.pData;
                 BYTE* yPlane = pBufData;
-                BYTE* uvPlane = pBufData + (alignedW * alignedH);
                 
                 // DEBUG: Check first few source pixels
                 static int convDebug = 0;
                 convDebug++;
                 if (convDebug <= 5 || convDebug % 60 == 0) {
-                    std::cout << "[CPU-Conv] Frame " << convDebug << " - First 5 BGRA pixels:" << std::endl;
                     for (int i = 0; i < 5; i++) {
                         int idx = i * 4;
-                        std::cout << "  Pixel " << i << ": B=" << (int)src[idx] 
-                                 << " G=" << (int)src[idx+1] 
-                                 << " R=" << (int)src[idx+2] 
-                                 << " A=" << (int)src[idx+3] << std::endl;
+                        LOG_DEBUG("CPU-Conv", "Frame %d pixel %d: B=%d G=%d R=%d A=%d", convDebug, i,
+                                  (int)src[idx], (int)src[idx + 1], (int)src[idx + 2], (int)src[idx + 3]);
                     }
                     // Also check center of screen
                     int centerIdx = (height/2) * map.RowPitch + (width/2) * 4;
-                    std::cout << "  Center pixel: B=" << (int)src[centerIdx] 
-                             << " G=" << (int)src[centerIdx+1] 
-                             << " R=" << (int)src[centerIdx+2] << std::endl;
+                    LOG_DEBUG("CPU-Conv", "Frame %d center pixel: B=%d G=%d R=%d", convDebug,
+                              (int)src[centerIdx], (int)src[centerIdx + 1], (int)src[centerIdx + 2]);
                 }
                 
-                // Convert BGRA to NV12 (CPU) - actual frame area
-                for (int y = 0; y < height; y++) {
-                    for (int x = 0; x < width; x++) {
-                        int idx = y * map.RowPitch + x * 4;
-                        BYTE B = src[idx];
-                        BYTE G = src[idx + 1];
-                        BYTE R = src[idx + 2];
-                        
-                        // BT.709 for HD
-                        int Y = (66 * R + 129 * G + 25 * B + 128) / 256 + 16;
-                        yPlane[y * alignedW + x] = (BYTE)Y;
-                        
-                        // UV subsampling (4:2:0)
-                        if (y % 2 == 0 && x % 2 == 0) {
-                            int U = (-38 * R - 74 * G + 112 * B + 128) / 256 + 128;
-                            int V = (112 * R - 94 * G - 18 * B + 128) / 256 + 128;
-                            int uvIdx = (y / 2) * alignedW + (x & ~1);
-                            uvPlane[uvIdx] = (BYTE)U;
-                            uvPlane[uvIdx + 1] = (BYTE)V;
-                        }
-                    }
-                    // Pad right edge of each row
-                    for (int x = width; x < alignedW; x++) {
-                        yPlane[y * alignedW + x] = 16; // Black Y
-                    }
-                }
-                
-                // Pad bottom rows
-                for (int y = height; y < alignedH; y++) {
-                    for (int x = 0; x < alignedW; x++) {
-                        yPlane[y * alignedW + x] = 16;
-                        if (y % 2 == 0 && x % 2 == 0) {
-                            int uvIdx = (y / 2) * alignedW + x;
-                            uvPlane[uvIdx] = 128; // Neutral UV
-                            uvPlane[uvIdx + 1] = 128;
-                        }
-                    }
-                }
+                // Convert BGRA to NV12 (CPU), padded to the aligned size
+                ConvertBGRAToNV12(src, map.RowPitch, width, height, pBufData, alignedW, alignedH);
                 
                 // DEBUG: Verify NV12 output
                 static int nv12DebugFrame = 0;
@@ -892,9 +967,7 @@ void HardwareEncoder::EncodeMF(ID3D11Texture2D* texture, ID3D11DeviceContext* ct
                 if (nv12DebugFrame % 60 == 0) {
                     int sum = 0;
                     for (int i = 0; i < 100; i++) sum += yPlane[i];
-                    std::cout << "MF-NV12: Frame " << nv12DebugFrame 
-                             << " | 1st Y: " << (int)yPlane[0] 
-                             << " | Sum(100): " << sum << std::endl;
+                    LOG_DEBUG("MF-NV12", "Frame %d | 1st Y: %d | Sum(100): %d", nv12DebugFrame, (int)yPlane[0], sum);
                 }
                 
                 buffer->Unlock();
@@ -902,18 +975,24 @@ void HardwareEncoder::EncodeMF(ID3D11Texture2D* texture, ID3D11DeviceContext* ct
             }
         }
 
-        ctx->Unmap(stagingTexture, 0);
-
-        // 3. Feed Encoder
-        ComPtr<IMFSample> sample;
-        MFCreateSample(&sample);
-        sample->AddBuffer(buffer.Get());
+        ctx->Unmap(staging, 0);
 
+        // 3. Feed Encoder (pooled sample, already holds the buffer)
         static LONGLONG pts = 10000000;
         sample->SetSampleTime(pts);
         sample->SetSampleDuration(166666);
         pts += 166666;
 
+        if (keyframeRequested.exchange(false)) {
+            ComPtr<ICodecAPI> codecApi;
+            if (SUCCEEDED(mfTransform.As(&codecApi))) {
+                VARIANT var;
+                var.vt = VT_UI4;
+                var.ulVal = 1;
+                codecApi->SetValue(&CODECAPI_AVEncVideoForceKeyFrame, &var);
+            }
+        }
+
         mfTransform->ProcessInput(0, sample.Get(), 0);
     }
 
@@ -924,9 +1003,7 @@ void HardwareEncoder::EncodeMF(ID3D11Texture2D* texture, ID3D11DeviceContext* ct
 
         ComPtr<IMFSample> outSample;
         ComPtr<IMFMediaBuffer> outBuffer;
-        MFCreateMemoryBuffer(info.cbSize, &outBuffer);
-        MFCreateSample(&outSample);
-        outSample->AddBuffer(outBuffer.Get());
+        if (!mfOutputSamples.Acquire(info.cbSize, outSample, outBuffer)) break;
 
         MFT_OUTPUT_DATA_BUFFER outputData = {};
         outputData.dwStreamID = 0;
@@ -943,25 +1020,23 @@ void HardwareEncoder::EncodeMF(ID3D11Texture2D* texture, ID3D11DeviceContext* ct
                     static int pktCount = 0;
                     pktCount++;
                     if (pktCount <= 5 || pktCount % 60 == 0) {
-                        std::cout << "[MF-Output] Packet #" << pktCount << " size: " << len << std::endl;
+                        LOG_DEBUG("MF-Output", "Packet #%d size: %lu", pktCount, (unsigned long)len);
                     }
                     callback(pData, len);
                 }
                 outBuffer->Unlock();
             }
-            if (outputData.pSample) outputData.pSample->Release();
+            // pSample is our pooled sample (the MFT does not add a reference), only events are ours to free
             if (outputData.pEvents) outputData.pEvents->Release();
         } 
         else {
             static bool errorLogged = false;
             if (!errorLogged && hr != MF_E_TRANSFORM_NEED_MORE_INPUT) {
-                std::cerr << "[MF-Output] ProcessOutput failed: 0x" << std::hex << hr << std::dec << std::endl;
-                if (hr == MF_E_TRANSFORM_NEED_MORE_INPUT) {
-                    std::cout << "[MF-Output] (Need more input - normal)" << std::endl;
-                }
+                LOG_ERROR("MF-Output", "ProcessOutput failed: 0x%08X", (unsigned)hr);
                 errorLogged = true;
             }
             break; 
         }
     }
-}
\ No newline at end of file
+    return true;
+}
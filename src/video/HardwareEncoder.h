@@ -2,7 +2,11 @@
 #include <d3d11.h>
 #include <functional>
 #include <vector>
+#include <atomic>
 #include "VideoProcessor.h"
+#include "MFSamplePool.h"
+#include "../common/FunctionRef.h"
+#include "../common/ReadbackRing.h"
 
 // Media Foundation Headers
 #include <mfapi.h>
@@ -12,7 +16,10 @@
 #include <codecapi.h> 
 #include <wrl/client.h> 
 
-using EncodedPacketCallback = std::function<void(const uint8_t* data, size_t size)>;
+using StagingRing = ReadbackRing<Microsoft::WRL::ComPtr<ID3D11Texture2D>>;
+
+// Invoked synchronously from EncodeFrame for every output packet (non-owning, no allocation)
+using EncodedPacketCallback = FunctionRef<void(const uint8_t* data, size_t size)>;
 
 enum class EncoderVendor {
     NVIDIA,
@@ -30,7 +37,23 @@ public:
     void EncodeFrame(ID3D11Texture2D* texture, ID3D11DeviceContext* context, EncodedPacketCallback onPacketReady);
     void Cleanup();
 
+    // Split convert/encode entry points for the pipelined capture path (CapturePipeline.h).
+    // Only NVENC/AMF on the capture device take NV12 from the VideoProcessor; Media
+    // Foundation and cross-GPU encoders return false and go through EncodeFrame.
+    bool UsesConvertStage() const;
+    bool ConvertFrame(ID3D11Texture2D* texture, ID3D11Texture2D* nv12Output);
+    void EncodeConverted(ID3D11Texture2D* nv12Texture, EncodedPacketCallback onPacketReady);
+
+    // Next encoded frame will be an IDR with parameter sets (thread-safe)
+    void RequestKeyframe() { keyframeRequested = true; }
+
+    // Annex-B SPS + PPS the encoder will emit, available right after Initialize so a
+    // receiver can create its decoder before the first frame. False if the encoder
+    // doesn't expose them up front (some Media Foundation MFTs only do after a frame).
+    bool GetParameterSets(std::vector<uint8_t>& out);
+
 private:
+    std::atomic<bool> keyframeRequested = false;
     EncoderVendor vendor = EncoderVendor::UNKNOWN;
     int width = 0;
     int height = 0;
@@ -42,12 +65,15 @@ private:
     ID3D11DeviceContext* encoderContext = nullptr;
     ID3D11Texture2D* crossGPUTexture = nullptr; // Shared texture on capture device
     ID3D11Texture2D* crossGPUTextureEncoder = nullptr; // Same texture opened on encoder device
-    ID3D11Texture2D* stagingTextureCrossGPU = nullptr; // CPU-accessible staging for cross-GPU copy
+    StagingRing crossGPUReadback; // CPU-accessible staging on the capture device, mapped a frame late
+    bool ReadCrossGPU(ID3D11Texture2D* staging, ID3D11DeviceContext* context, uint32_t frameId, bool wait,
+                      EncodedPacketCallback onPacketReady);
 
     // NVIDIA
     void* nvEncoder = nullptr;
     void* nvFunctionList = nullptr;
     void* nvRegisteredResource = nullptr;
+    void* nvBitstreamBuffer = nullptr; // Created once, locked and reused for every frame
     ID3D11Texture2D* nvInputTexture = nullptr; // Dedicated NV12 texture for NVENC
     bool InitNVIDIA(ID3D11Device* device);
     void EncodeNVIDIA(ID3D11Texture2D* texture, EncodedPacketCallback callback);
@@ -63,11 +89,14 @@ private:
     Microsoft::WRL::ComPtr<IMFTransform> mfTransform;
     Microsoft::WRL::ComPtr<IMFDXGIDeviceManager> mfDeviceManager;
     
-    // Staging Texture for Safe Mode (CPU Readback)
-    ID3D11Texture2D* stagingTexture = nullptr;
+    // Staging textures for Safe Mode (CPU readback), mapped a frame late
+    StagingRing mfReadback;
     bool useCPUConversion = false; // Intel workaround flag
+    MFSamplePool mfInputSamples;
+    MFSamplePool mfOutputSamples;
 
     bool InitMF(ID3D11Device* device);
     // Updated signature to accept DeviceContext for CPU readback
     void EncodeMF(ID3D11Texture2D* texture, ID3D11DeviceContext* ctx, EncodedPacketCallback callback);
+    bool ReadMF(ID3D11Texture2D* staging, ID3D11DeviceContext* ctx, uint32_t frameId, bool wait, EncodedPacketCallback callback);
 };
\ No newline at end of file
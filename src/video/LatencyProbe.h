@@ -0,0 +1,265 @@
+#pragma once
+#include <windows.h>
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <emmintrin.h>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <cstdint>
+#include <cstdio>
+#include "../common/Metrics.h"
+#include "../common/Logger.h"
+
+using Microsoft::WRL::ComPtr;
+
+// Glass-to-glass latency probe. The host stamps a barcode of the frame ID and a
+// wall-clock timestamp into the top-left corner of every captured frame; the client
+// reads it back from the decoded NV12 picture and records capture -> decode latency.
+// Because the value travels in the pixels it survives the encoder, so the measurement
+// covers everything between the stamp and the decoder output.
+//
+// Layout: 16x16 blocks (macroblock aligned, so 4:2:0 and quantization only soften the
+// edges), PROBE_COLUMNS x (1 + PROBE_DATA_ROWS). Row 0 alternates white/black and gives
+// the detector its threshold; the data rows carry frameId(32) | timeUs(32) | CRC-8, MSB first.
+//
+// Timestamps are microseconds of system time (low 32 bits, differences taken mod 2^32),
+// so host and client clocks must be synchronized (same machine, or NTP/PTP) for the
+// absolute latency to mean anything.
+
+#define PROBE_BLOCK 16
+#define PROBE_COLUMNS 18
+#define PROBE_DATA_ROWS 4
+#define PROBE_BITS (PROBE_COLUMNS * PROBE_DATA_ROWS) // 72
+#define PROBE_WIDTH (PROBE_COLUMNS * PROBE_BLOCK)
+#define PROBE_HEIGHT ((PROBE_DATA_ROWS + 1) * PROBE_BLOCK)
+#define PROBE_MIN_CONTRAST 64 // Luma difference between calibration white and black
+#define PROBE_READBACK_SLOTS 3
+
+struct ProbeStamp {
+    uint32_t frameId = 0;
+    uint32_t timeUs = 0;
+};
+
+class LatencyProbe {
+public:
+    // Microseconds of system time (wall clock, comparable across synchronized machines)
+    static uint32_t NowUs() {
+        FILETIME ft;
+        GetSystemTimePreciseAsFileTime(&ft);
+        uint64_t ticks = ((uint64_t)ft.dwHighDateTime << 32) | ft.dwLowDateTime; // 100ns
+        return (uint32_t)(ticks / 10);
+    }
+
+    static uint8_t Crc8(const uint8_t* data, size_t size) {
+        uint8_t crc = 0;
+        for (size_t i = 0; i < size; i++) {
+            crc ^= data[i];
+            for (int b = 0; b < 8; b++) crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+        }
+        return crc;
+    }
+
+    static void PackBits(const ProbeStamp& stamp, bool bits[PROBE_BITS]) {
+        uint8_t bytes[9] = {
+            (uint8_t)(stamp.frameId >> 24), (uint8_t)(stamp.frameId >> 16), (uint8_t)(stamp.frameId >> 8), (uint8_t)stamp.frameId,
+            (uint8_t)(stamp.timeUs >> 24), (uint8_t)(stamp.timeUs >> 16), (uint8_t)(stamp.timeUs >> 8), (uint8_t)stamp.timeUs,
+        };
+        bytes[8] = Crc8(bytes, 8);
+        for (int i = 0; i < PROBE_BITS; i++) bits[i] = (bytes[i / 8] >> (7 - i % 8)) & 1;
+    }
+
+    static bool UnpackBits(const bool bits[PROBE_BITS], ProbeStamp& stamp) {
+        uint8_t bytes[9] = {};
+        for (int i = 0; i < PROBE_BITS; i++) if (bits[i]) bytes[i / 8] |= (uint8_t)(0x80 >> (i % 8));
+        if (Crc8(bytes, 8) != bytes[8]) return false;
+        stamp.frameId = ((uint32_t)bytes[0] << 24) | ((uint32_t)bytes[1] << 16) | ((uint32_t)bytes[2] << 8) | bytes[3];
+        stamp.timeUs = ((uint32_t)bytes[4] << 24) | ((uint32_t)bytes[5] << 16) | ((uint32_t)bytes[6] << 8) | bytes[7];
+        return true;
+    }
+
+    // Renders the barcode as BGRA (PROBE_WIDTH x PROBE_HEIGHT, pitch in bytes)
+    static void RenderBGRA(const ProbeStamp& stamp, uint8_t* bgra, int pitch) {
+        bool bits[PROBE_BITS];
+        PackBits(stamp, bits);
+        for (int y = 0; y < PROBE_HEIGHT; y++) {
+            uint32_t* row = (uint32_t*)(bgra + y * pitch);
+            int blockRow = y / PROBE_BLOCK;
+            for (int col = 0; col < PROBE_COLUMNS; col++) {
+                bool white = blockRow == 0 ? (col % 2 == 0) : bits[(blockRow - 1) * PROBE_COLUMNS + col];
+                uint32_t color = white ? 0xFFFFFFFF : 0xFF000000;
+                for (int x = 0; x < PROBE_BLOCK; x++) row[col * PROBE_BLOCK + x] = color;
+            }
+        }
+    }
+
+    // Mean luma of the inner 8x8 of a block (away from the ringing at block edges)
+    static int BlockMean(const uint8_t* luma, int pitch, int col, int row) {
+        const uint8_t* p = luma + (row * PROBE_BLOCK + 4) * pitch + col * PROBE_BLOCK + 4;
+        __m128i zero = _mm_setzero_si128();
+        __m128i sum = zero;
+        for (int y = 0; y < 8; y++) {
+            sum = _mm_add_epi64(sum, _mm_sad_epu8(_mm_loadl_epi64((const __m128i*)(p + y * pitch)), zero));
+        }
+        return _mm_cvtsi128_si32(sum) / 64;
+    }
+
+    // Reads the barcode from the top-left of an 8-bit luma plane (at least PROBE_WIDTH x PROBE_HEIGHT)
+    static bool Detect(const uint8_t* luma, int pitch, ProbeStamp& stamp) {
+        int white = 0, black = 0;
+        for (int col = 0; col < PROBE_COLUMNS; col++) {
+            int mean = BlockMean(luma, pitch, col, 0);
+            if (col % 2 == 0) white += mean;
+            else black += mean;
+        }
+        white /= PROBE_COLUMNS / 2;
+        black /= PROBE_COLUMNS / 2;
+        if (white - black < PROBE_MIN_CONTRAST) return false;
+        int threshold = (white + black) / 2;
+
+        bool bits[PROBE_BITS];
+        for (int i = 0; i < PROBE_BITS; i++) {
+            bits[i] = BlockMean(luma, pitch, i % PROBE_COLUMNS, 1 + i / PROBE_COLUMNS) > threshold;
+        }
+        return UnpackBits(bits, stamp);
+    }
+};
+
+// Host side: writes the barcode into a capture-sized BGRA texture (D3D11_USAGE_DEFAULT)
+class LatencyProbeStamper {
+public:
+    bool Stamp(ID3D11DeviceContext* ctx, ID3D11Texture2D* target, uint32_t frameId) {
+        D3D11_TEXTURE2D_DESC desc;
+        target->GetDesc(&desc);
+        if ((desc.Format != DXGI_FORMAT_B8G8R8A8_UNORM && desc.Format != DXGI_FORMAT_B8G8R8A8_UNORM_SRGB) ||
+            desc.Width < PROBE_WIDTH || desc.Height < PROBE_HEIGHT) {
+            LOG_WARN_RATE("Probe", 1, "Cannot stamp format %d (%ux%u)", (int)desc.Format, desc.Width, desc.Height);
+            return false;
+        }
+        if (pixels.empty()) pixels.resize(PROBE_WIDTH * PROBE_HEIGHT * 4);
+
+        ProbeStamp stamp;
+        stamp.frameId = frameId;
+        stamp.timeUs = LatencyProbe::NowUs();
+        LatencyProbe::RenderBGRA(stamp, pixels.data(), PROBE_WIDTH * 4);
+
+        D3D11_BOX box = { 0, 0, 0, PROBE_WIDTH, PROBE_HEIGHT, 1 };
+        ctx->UpdateSubresource(target, 0, &box, pixels.data(), PROBE_WIDTH * 4, 0);
+        return true;
+    }
+
+private:
+    std::vector<uint8_t> pixels;
+};
+
+struct ProbeReaderStats {
+    uint64_t detected = 0;
+    uint64_t missed = 0;     // Readback done but no valid barcode (probe off on the host, or too lossy)
+    float lastLatencyMs = 0.0f;
+    uint32_t lastFrameId = 0;
+};
+
+// Client side: copies the corner of each decoded NV12 frame into a small staging
+// ring and decodes it a frame or two later (Map with DO_NOT_WAIT), so the readback
+// never stalls the render loop. Every detected frame is recorded in the
+// end_to_end stage and appended to a CSV (frame_id, latency_us).
+class LatencyProbeReader {
+public:
+    ~LatencyProbeReader() { Stop(); }
+
+    bool Start(ID3D11Device* device, const std::string& csvPath) {
+        Stop();
+        D3D11_TEXTURE2D_DESC desc = {};
+        desc.Width = PROBE_WIDTH;
+        desc.Height = PROBE_HEIGHT;
+        desc.MipLevels = 1;
+        desc.ArraySize = 1;
+        desc.Format = DXGI_FORMAT_NV12;
+        desc.SampleDesc.Count = 1;
+        desc.Usage = D3D11_USAGE_STAGING;
+        desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+        for (Slot& slot : slots) {
+            if (FAILED(device->CreateTexture2D(&desc, nullptr, &slot.staging))) {
+                LOG_ERROR("Probe", "Failed to create NV12 staging texture");
+                Stop();
+                return false;
+            }
+            slot.pending = false;
+        }
+        if (fopen_s(&csv, csvPath.c_str(), "w") == 0 && csv) fputs("frame_id,latency_us\n", csv);
+        stats = ProbeReaderStats();
+        next = 0;
+        active = true;
+        std::cout << "[Probe] Reading latency barcodes, logging to " << csvPath << std::endl;
+        return true;
+    }
+
+    void Stop() {
+        for (Slot& slot : slots) slot.staging.Reset();
+        if (csv) { fclose(csv); csv = nullptr; }
+        active = false;
+    }
+
+    bool IsActive() const { return active; }
+    const ProbeReaderStats& GetStats() const { return stats; }
+
+    // Queues a readback of the decoded frame's corner (call right after decode)
+    void Submit(ID3D11DeviceContext* ctx, ID3D11Texture2D* decodedNV12) {
+        if (!active || !decodedNV12) return;
+        Slot& slot = slots[next];
+        if (slot.pending) Read(ctx, slot, 0); // Ring is full; this one has to finish now
+        D3D11_BOX box = { 0, 0, 0, PROBE_WIDTH, PROBE_HEIGHT, 1 };
+        ctx->CopySubresourceRegion(slot.staging.Get(), 0, 0, 0, 0, decodedNV12, 0, &box);
+        slot.decodedUs = LatencyProbe::NowUs();
+        slot.pending = true;
+        next = (next + 1) % PROBE_READBACK_SLOTS;
+    }
+
+    // Decodes whichever readbacks the GPU has finished
+    void Poll(ID3D11DeviceContext* ctx) {
+        if (!active) return;
+        for (int i = 0; i < PROBE_READBACK_SLOTS; i++) {
+            Slot& slot = slots[(next + i) % PROBE_READBACK_SLOTS]; // Oldest first
+            if (slot.pending && !Read(ctx, slot, D3D11_MAP_FLAG_DO_NOT_WAIT)) break;
+        }
+    }
+
+private:
+    struct Slot {
+        ComPtr<ID3D11Texture2D> staging;
+        uint32_t decodedUs = 0;
+        bool pending = false;
+    };
+
+    Slot slots[PROBE_READBACK_SLOTS];
+    int next = 0;
+    bool active = false;
+    FILE* csv = nullptr;
+    ProbeReaderStats stats;
+
+    // Returns false if the copy hasn't finished yet (DO_NOT_WAIT)
+    bool Read(ID3D11DeviceContext* ctx, Slot& slot, UINT mapFlags) {
+        D3D11_MAPPED_SUBRESOURCE mapped;
+        HRESULT hr = ctx->Map(slot.staging.Get(), 0, D3D11_MAP_READ, mapFlags, &mapped);
+        if (hr == DXGI_ERROR_WAS_STILL_DRAWING) return false;
+        slot.pending = false;
+        if (FAILED(hr)) return true;
+
+        ProbeStamp stamp;
+        bool found = LatencyProbe::Detect((const uint8_t*)mapped.pData, (int)mapped.RowPitch, stamp);
+        ctx->Unmap(slot.staging.Get(), 0);
+        if (!found) {
+            stats.missed++;
+            return true;
+        }
+
+        int32_t latencyUs = (int32_t)(slot.decodedUs - stamp.timeUs);
+        stats.detected++;
+        stats.lastFrameId = stamp.frameId;
+        stats.lastLatencyMs = latencyUs / 1000.0f;
+        if (latencyUs >= 0) Metrics::Get().Record(Stage::EndToEnd, (uint64_t)latencyUs * 1000);
+        else LOG_WARN_RATE("Probe", 1, "Negative latency (%d us): host and client clocks are not in sync", latencyUs);
+        if (csv) fprintf(csv, "%u,%d\n", stamp.frameId, latencyUs);
+        return true;
+    }
+};
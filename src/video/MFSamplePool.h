@@ -0,0 +1,57 @@
+#pragma once
+#include <mfapi.h>
+#include <mfidl.h>
+#include <wrl/client.h>
+
+#define MF_SAMPLE_POOL_SLOTS 4
+
+// Reusable IMFSample + memory buffer pairs for the per-frame Media Foundation encode and
+// decode calls, instead of MFCreateSample / MFCreateMemoryBuffer on every frame.
+// A slot is free again once the transform has dropped its reference to the sample.
+class MFSamplePool {
+public:
+    // Sample with a single buffer of at least `size` bytes. Only allocates on first use,
+    // when `size` outgrows the slot, or when every slot is still held by the transform.
+    bool Acquire(DWORD size, Microsoft::WRL::ComPtr<IMFSample>& sample, Microsoft::WRL::ComPtr<IMFMediaBuffer>& buffer) {
+        for (int i = 0; i < MF_SAMPLE_POOL_SLOTS; i++) {
+            Slot& slot = slots[(next + i) % MF_SAMPLE_POOL_SLOTS];
+            if (slot.sample && IsHeldElsewhere(slot.sample.Get())) continue;
+            if (!slot.sample || slot.capacity < size) {
+                slot = Slot();
+                if (!Create(size, slot.sample, slot.buffer)) return false;
+                slot.capacity = size;
+            }
+            next = (next + i + 1) % MF_SAMPLE_POOL_SLOTS;
+            slot.buffer->SetCurrentLength(0);
+            sample = slot.sample;
+            buffer = slot.buffer;
+            return true;
+        }
+        return Create(size, sample, buffer); // All in flight: one-off sample
+    }
+
+    void Reset() {
+        for (Slot& slot : slots) slot = Slot();
+        next = 0;
+    }
+
+private:
+    struct Slot {
+        Microsoft::WRL::ComPtr<IMFSample> sample;
+        Microsoft::WRL::ComPtr<IMFMediaBuffer> buffer;
+        DWORD capacity = 0;
+    };
+    Slot slots[MF_SAMPLE_POOL_SLOTS];
+    int next = 0;
+
+    static bool Create(DWORD size, Microsoft::WRL::ComPtr<IMFSample>& sample, Microsoft::WRL::ComPtr<IMFMediaBuffer>& buffer) {
+        if (FAILED(MFCreateMemoryBuffer(size, &buffer)) || FAILED(MFCreateSample(&sample))) return false;
+        return SUCCEEDED(sample->AddBuffer(buffer.Get()));
+    }
+
+    // True while anyone besides this pool (e.g. an MFT still holding its input) references the sample
+    static bool IsHeldElsewhere(IMFSample* sample) {
+        sample->AddRef();
+        return sample->Release() > 1;
+    }
+};
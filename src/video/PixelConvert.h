@@ -0,0 +1,73 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+
+// CPU pixel kernels shared by the Media Foundation encode/decode paths (and src/bench).
+// Destinations are tightly packed at the encoder's 16-aligned size; the area past the
+// picture is filled with black.
+
+// BGRA -> BGRA with the picture copied row by row and padded to alignedW x alignedH
+inline void CopyBGRAPadded(const uint8_t* src, int srcPitch, int width, int height,
+                           uint8_t* dst, int alignedW, int alignedH) {
+    for (int y = 0; y < height; y++) {
+        memcpy(dst, src, width * 4);
+        src += srcPitch;
+        dst += alignedW * 4;
+    }
+    for (int y = height; y < alignedH; y++) {
+        memset(dst, 0, alignedW * 4);
+        dst += alignedW * 4;
+    }
+}
+
+// BGRA -> NV12 (BT.601 limited range, 4:2:0 from the top-left sample of each 2x2)
+inline void ConvertBGRAToNV12(const uint8_t* src, int srcPitch, int width, int height,
+                              uint8_t* dst, int alignedW, int alignedH) {
+    uint8_t* yPlane = dst;
+    uint8_t* uvPlane = dst + alignedW * alignedH;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            int idx = y * srcPitch + x * 4;
+            uint8_t B = src[idx];
+            uint8_t G = src[idx + 1];
+            uint8_t R = src[idx + 2];
+
+            int Y = (66 * R + 129 * G + 25 * B + 128) / 256 + 16;
+            yPlane[y * alignedW + x] = (uint8_t)Y;
+
+            if (y % 2 == 0 && x % 2 == 0) {
+                int U = (-38 * R - 74 * G + 112 * B + 128) / 256 + 128;
+                int V = (112 * R - 94 * G - 18 * B + 128) / 256 + 128;
+                int uvIdx = (y / 2) * alignedW + (x & ~1);
+                uvPlane[uvIdx] = (uint8_t)U;
+                uvPlane[uvIdx + 1] = (uint8_t)V;
+            }
+        }
+        // Pad right edge of each row
+        for (int x = width; x < alignedW; x++) yPlane[y * alignedW + x] = 16;
+    }
+    // Pad bottom rows (black Y, neutral UV)
+    for (int y = height; y < alignedH; y++) {
+        for (int x = 0; x < alignedW; x++) {
+            yPlane[y * alignedW + x] = 16;
+            if (y % 2 == 0 && x % 2 == 0) {
+                int uvIdx = (y / 2) * alignedW + x;
+                uvPlane[uvIdx] = 128;
+                uvPlane[uvIdx + 1] = 128;
+            }
+        }
+    }
+}
+
+// NV12 -> NV12 between differently pitched surfaces. Both UV planes start at alignedHeight rows.
+inline void CopyNV12(const uint8_t* src, int srcStride, uint8_t* dst, int dstStride,
+                     int width, int height, int alignedHeight) {
+    for (int y = 0; y < height; ++y) {
+        memcpy(dst + y * dstStride, src + y * srcStride, width);
+    }
+    const uint8_t* srcUV = src + srcStride * alignedHeight;
+    uint8_t* dstUV = dst + dstStride * alignedHeight;
+    for (int y = 0; y < height / 2; ++y) {
+        memcpy(dstUV + y * dstStride, srcUV + y * srcStride, width);
+    }
+}
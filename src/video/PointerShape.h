@@ -0,0 +1,104 @@
+#pragma once
+#include <windows.h>
+#include <dxgi1_2.h>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include "../common/CursorChannel.h"
+
+// Host side: pointer images as CursorShape (BGRA, straight alpha), from desktop duplication
+// (GetFramePointerShape) or from a cursor handle (WGC, which has no shape API).
+// Monochrome and masked-color pointers XOR with the screen where their mask is set; the
+// client blends over the video and can't invert it, so inverting pixels are drawn opaque
+// black (the I-beam keeps its outline, only the inside stops inverting).
+
+// One pixel of a masked pointer: mask clear = opaque `rgb`, mask set = screen XOR `rgb`
+inline void SetMaskedPointerPixel(uint8_t* out, bool maskSet, uint32_t rgb) {
+    uint32_t pixel = 0; // Transparent (XOR with 0)
+    if (!maskSet) pixel = 0xFF000000 | rgb;
+    else if (rgb != 0) pixel = 0xFF000000; // Invert
+    memcpy(out, &pixel, 4);
+}
+
+inline bool ConvertPointerShape(const DXGI_OUTDUPL_POINTER_SHAPE_INFO& info, const uint8_t* buffer, CursorShape& out) {
+    bool monochrome = info.Type == DXGI_OUTDUPL_POINTER_SHAPE_TYPE_MONOCHROME;
+    uint32_t width = info.Width;
+    uint32_t height = monochrome ? info.Height / 2 : info.Height; // AND mask above XOR mask
+    if (width == 0 || height == 0 || width > CURSOR_SHAPE_MAX_SIZE || height > CURSOR_SHAPE_MAX_SIZE) return false;
+
+    out.width = (uint16_t)width;
+    out.height = (uint16_t)height;
+    out.hotX = (int16_t)info.HotSpot.x;
+    out.hotY = (int16_t)info.HotSpot.y;
+    out.pixels.resize((size_t)width * height * 4);
+    for (uint32_t y = 0; y < height; y++) {
+        const uint8_t* row = buffer + (size_t)y * info.Pitch;
+        uint8_t* dst = out.pixels.data() + (size_t)y * width * 4;
+        for (uint32_t x = 0; x < width; x++, dst += 4) {
+            if (monochrome) {
+                uint8_t bit = 0x80 >> (x % 8);
+                bool andBit = (row[x / 8] & bit) != 0;
+                bool xorBit = (row[(size_t)height * info.Pitch + x / 8] & bit) != 0;
+                SetMaskedPointerPixel(dst, andBit, xorBit ? 0xFFFFFF : 0);
+            } else if (info.Type == DXGI_OUTDUPL_POINTER_SHAPE_TYPE_MASKED_COLOR) {
+                uint32_t pixel;
+                memcpy(&pixel, row + x * 4, 4);
+                SetMaskedPointerPixel(dst, (pixel >> 24) == 0xFF, pixel & 0xFFFFFF);
+            } else {
+                memcpy(dst, row + x * 4, 4);
+            }
+        }
+    }
+    out.id = HashCursorShape(out);
+    return true;
+}
+
+// 32bpp top-down copy of a GDI bitmap (1bpp masks come out black / white)
+inline bool ReadCursorBitmap(HDC dc, HBITMAP bitmap, int width, int height, std::vector<uint32_t>& out) {
+    BITMAPINFO bmi = {};
+    bmi.bmiHeader.biSize = sizeof(bmi.bmiHeader);
+    bmi.bmiHeader.biWidth = width;
+    bmi.bmiHeader.biHeight = -height;
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biBitCount = 32;
+    bmi.bmiHeader.biCompression = BI_RGB;
+    out.resize((size_t)width * height);
+    return GetDIBits(dc, bitmap, 0, (UINT)height, out.data(), &bmi, DIB_RGB_COLORS) == height;
+}
+
+inline bool CaptureCursorShape(HCURSOR cursor, CursorShape& out) {
+    ICONINFO icon = {};
+    if (!cursor || !GetIconInfo(cursor, &icon)) return false;
+    BITMAP mask = {};
+    bool ok = GetObject(icon.hbmMask, sizeof(mask), &mask) != 0;
+    int width = mask.bmWidth;
+    int height = icon.hbmColor ? mask.bmHeight : mask.bmHeight / 2; // Monochrome: AND above XOR
+    ok = ok && width > 0 && height > 0 && width <= CURSOR_SHAPE_MAX_SIZE && height <= CURSOR_SHAPE_MAX_SIZE;
+
+    std::vector<uint32_t> maskBits, colorBits;
+    HDC dc = GetDC(nullptr);
+    ok = ok && ReadCursorBitmap(dc, icon.hbmMask, width, mask.bmHeight, maskBits) &&
+         (!icon.hbmColor || ReadCursorBitmap(dc, icon.hbmColor, width, height, colorBits));
+    ReleaseDC(nullptr, dc);
+    DeleteObject(icon.hbmMask);
+    if (icon.hbmColor) DeleteObject(icon.hbmColor);
+    if (!ok) return false;
+
+    bool hasAlpha = false;
+    for (uint32_t pixel : colorBits) hasAlpha |= (pixel >> 24) != 0;
+    size_t count = (size_t)width * height;
+    out.width = (uint16_t)width;
+    out.height = (uint16_t)height;
+    out.hotX = (int16_t)icon.xHotspot;
+    out.hotY = (int16_t)icon.yHotspot;
+    out.pixels.resize(count * 4);
+    for (size_t i = 0; i < count; i++) {
+        uint8_t* dst = out.pixels.data() + i * 4;
+        bool maskSet = (maskBits[i] & 0xFFFFFF) != 0;
+        if (hasAlpha) memcpy(dst, &colorBits[i], 4);
+        else if (!colorBits.empty()) SetMaskedPointerPixel(dst, maskSet, colorBits[i] & 0xFFFFFF);
+        else SetMaskedPointerPixel(dst, maskSet, (maskBits[count + i] & 0xFFFFFF) ? 0xFFFFFF : 0);
+    }
+    out.id = HashCursorShape(out);
+    return true;
+}
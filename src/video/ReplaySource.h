@@ -0,0 +1,191 @@
+#pragma once
+#include <windows.h>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <iostream>
+#include "AnnexBParser.h"
+
+// Replays a recorded Annex-B elementary stream (.h264 / .264 / .h265 / .hevc).
+// The file is memory-mapped and split into access units once at Open();
+// every frame handed out afterwards is a slice of the mapping (no copies, no allocation).
+// HEVC files are indexed, but the decoder and the stream handshake are H.264 only, so the
+// replay modes refuse them (see GetCodec).
+
+struct ReplayFrame {
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    FrameType frameType = FrameType::UNKNOWN;
+};
+
+class ReplaySource {
+public:
+    ~ReplaySource() { Close(); }
+
+    bool Open(const std::string& path) {
+        Close();
+        std::string ext = path.size() > 5 ? path.substr(path.size() - 5) : path;
+        VideoCodec codec = (ext.find("265") != std::string::npos || ext.find("hevc") != std::string::npos)
+            ? VideoCodec::HEVC : VideoCodec::H264;
+        parser = AnnexBParser(codec);
+
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                           FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            std::cerr << "[Replay] Cannot open " << path << std::endl;
+            return false;
+        }
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+            Close();
+            return false;
+        }
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping) {
+            Close();
+            return false;
+        }
+        view = (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!view) {
+            Close();
+            return false;
+        }
+        size = (size_t)fileSize.QuadPart;
+
+        IndexAccessUnits();
+        std::cout << "[Replay] " << path << ": " << frames.size() << " frames, "
+                  << parser.GetSequenceInfo().width << "x" << parser.GetSequenceInfo().height << std::endl;
+        return !frames.empty() && parser.GetSequenceInfo().valid;
+    }
+
+    void Close() {
+        if (view) UnmapViewOfFile(view);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        view = nullptr;
+        mapping = nullptr;
+        file = INVALID_HANDLE_VALUE;
+        size = 0;
+        frames.clear();
+    }
+
+    size_t GetFrameCount() const { return frames.size(); }
+    const ReplayFrame& GetFrame(size_t index) const { return frames[index]; }
+    const SequenceInfo& GetSequenceInfo() const { return parser.GetSequenceInfo(); }
+    VideoCodec GetCodec() const { return parser.GetCodec(); }
+
+    // Frame rate from the SPS timing info, 60 if the stream has none
+    double GetSourceFps() const {
+        const SequenceInfo& seq = parser.GetSequenceInfo();
+        if (seq.fpsNum > 0 && seq.fpsDen > 0) return (double)seq.fpsNum / seq.fpsDen;
+        return 60.0;
+    }
+
+private:
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+    const uint8_t* view = nullptr;
+    size_t size = 0;
+    AnnexBParser parser;
+    std::vector<ReplayFrame> frames;
+
+    bool IsSlice(const uint8_t* nal) const {
+        if (parser.GetCodec() == VideoCodec::H264) {
+            int type = nal[0] & 0x1F;
+            return type == H264_NAL_SLICE || type == H264_NAL_IDR;
+        }
+        return ((nal[0] >> 1) & 0x3F) < HEVC_NAL_VPS;
+    }
+
+    // NALs that may only appear before the first slice of an access unit
+    bool IsAccessUnitPrefix(const uint8_t* nal) const {
+        if (parser.GetCodec() == VideoCodec::H264) {
+            int type = nal[0] & 0x1F;
+            return type == H264_NAL_AUD || type == H264_NAL_SEI || type == H264_NAL_SPS || type == H264_NAL_PPS;
+        }
+        int type = (nal[0] >> 1) & 0x3F;
+        return (type >= HEVC_NAL_VPS && type <= HEVC_NAL_AUD) || type == 39; // 39 = prefix SEI
+    }
+
+    // First slice of a picture: H.264 first_mb_in_slice == 0, HEVC first_slice_segment_in_pic_flag
+    bool IsFirstSlice(const uint8_t* nal, size_t nalSize) const {
+        if (parser.GetCodec() == VideoCodec::H264) return nalSize > 1 && (nal[1] & 0x80);
+        return nalSize > 2 && (nal[2] & 0x80);
+    }
+
+    void IndexAccessUnits() {
+        const uint8_t* auStart = nullptr;
+        bool sawSlice = false;
+        size_t pos = 0;
+        const uint8_t* nal;
+        size_t nalSize;
+        while (AnnexBParser::NextNal(view, size, pos, nal, nalSize)) {
+            if (nalSize == 0) continue;
+            // Start code belongs to the access unit (the decoder wants Annex-B input)
+            const uint8_t* start = nal - 3;
+            if (start > view && start[-1] == 0) start--;
+            if (!auStart) auStart = start;
+
+            bool slice = IsSlice(nal);
+            bool boundary = sawSlice && (slice ? IsFirstSlice(nal, nalSize) : IsAccessUnitPrefix(nal));
+            if (boundary) {
+                AddFrame(auStart, start);
+                auStart = start;
+                sawSlice = false;
+            }
+            if (slice) sawSlice = true;
+        }
+        if (auStart) AddFrame(auStart, view + size);
+    }
+
+    void AddFrame(const uint8_t* begin, const uint8_t* end) {
+        ReplayFrame frame;
+        frame.data = begin;
+        frame.size = end - begin;
+        frame.frameType = parser.ParseAccessUnit(frame.data, frame.size).frameType;
+        frames.push_back(frame);
+    }
+};
+
+// Sleeps until frame N is due at the given rate (0 = flat out)
+class ReplayPacer {
+public:
+    void Start(double fps) {
+        interval = fps > 0 ? std::chrono::duration<double>(1.0 / fps) : std::chrono::duration<double>(0);
+        start = std::chrono::steady_clock::now();
+    }
+
+    void WaitForFrame(size_t index) {
+        if (interval.count() <= 0) return;
+        auto due = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(interval * (double)index);
+        // Sleep for most of the wait, spin the last millisecond for accuracy
+        auto now = std::chrono::steady_clock::now();
+        if (due - now > std::chrono::milliseconds(2)) std::this_thread::sleep_until(due - std::chrono::milliseconds(1));
+        while (std::chrono::steady_clock::now() < due) std::this_thread::yield();
+    }
+
+private:
+    std::chrono::duration<double> interval{ 0 };
+    std::chrono::steady_clock::time_point start;
+};
+
+// Collects per-frame latencies into a preallocated buffer and reports percentiles
+class LatencyStats {
+public:
+    void Reserve(size_t count) { samplesMs.reserve(count); }
+    void Add(double ms) { if (samplesMs.size() < samplesMs.capacity()) samplesMs.push_back(ms); }
+    size_t GetCount() const { return samplesMs.size(); }
+
+    // p in [0, 100]. Reorders the samples.
+    double Percentile(double p) {
+        if (samplesMs.empty()) return 0.0;
+        size_t k = (size_t)(p / 100.0 * (samplesMs.size() - 1) + 0.5);
+        std::nth_element(samplesMs.begin(), samplesMs.begin() + k, samplesMs.end());
+        return samplesMs[k];
+    }
+
+private:
+    std::vector<double> samplesMs;
+};
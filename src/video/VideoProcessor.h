@@ -2,15 +2,20 @@
 #include <d3d11.h>
 #include <d3d11_1.h> 
 #include <wrl/client.h>
-#include <map> 
 #include <iostream>
+#include "../common/Logger.h"
 
 using Microsoft::WRL::ComPtr;
 
+#define VIDEO_PROCESSOR_VIEW_CACHE 8 // Capture APIs rotate through a handful of surfaces
+
 class VideoProcessor {
 public:
     bool Initialize(ID3D11Device* device, int width, int height) {
-        inputViewCache.clear();
+        for (CachedInputView& entry : inputViewCache) entry = CachedInputView();
+        for (CachedOutputView& entry : outputViewCache) entry = CachedOutputView();
+        nextViewSlot = 0;
+        nextOutputViewSlot = 0;
         devicePtr = device;
         displayWidth = width;
         displayHeight = height;
@@ -59,26 +64,26 @@ public:
         ComPtr<ID3D11Device> texDevice;
         inputTexture->GetDevice(&texDevice);
         if (texDevice.Get() != devicePtr.Get()) { // Texture must be on same device
-            std::cerr << "[VideoProcessor] ERROR: Input texture is on different device!" << std::endl;
+            LOG_ERROR_RATE("VideoProcessor", 1, "Input texture is on different device!");
             return nullptr;
         }
         
         ID3D11VideoProcessorInputView* pInputView = GetCachedInputView(inputTexture);
         if (!pInputView) {
-            std::cerr << "[VideoProcessor] Failed to create/get input view" << std::endl;
+            LOG_ERROR_RATE("VideoProcessor", 1, "Failed to create/get input view");
             return nullptr;
         }
         
         if (!videoContext) {
-            std::cerr << "[VideoProcessor] videoContext is NULL!" << std::endl;
+            LOG_ERROR_RATE("VideoProcessor", 1, "videoContext is NULL!");
             return nullptr;
         }
         if (!processor) {
-            std::cerr << "[VideoProcessor] processor is NULL!" << std::endl;
+            LOG_ERROR_RATE("VideoProcessor", 1, "processor is NULL!");
             return nullptr;
         }
         if (!outputView) {
-            std::cerr << "[VideoProcessor] outputView is NULL!" << std::endl;
+            LOG_ERROR_RATE("VideoProcessor", 1, "outputView is NULL!");
             return nullptr;
         }
 
@@ -89,7 +94,7 @@ public:
         HRESULT hr = videoContext->VideoProcessorBlt(processor.Get(), outputView.Get(), 0, 1, &stream);
         
         if (FAILED(hr)) {
-            std::cerr << "[VideoProcessor] Blt FAILED: 0x" << std::hex << hr << std::dec << std::endl;
+            LOG_ERROR_RATE("VideoProcessor", 1, "Blt FAILED: 0x%08X", (unsigned)hr);
             return nullptr;
         }
         
@@ -100,6 +105,26 @@ public:
         return outputTexture.Get(); 
     }
 
+    // Converts into a caller-owned NV12 texture (e.g. a capture pipeline ring slot) instead
+    // of the shared output texture. Doesn't flush; the caller fences the slot.
+    bool ConvertInto(ID3D11Texture2D* inputTexture, ID3D11Texture2D* nv12Output) {
+        if (!videoContext || !processor || !inputTexture || !nv12Output) return false;
+
+        ID3D11VideoProcessorInputView* pInputView = GetCachedInputView(inputTexture);
+        ID3D11VideoProcessorOutputView* pOutputView = GetCachedOutputView(nv12Output);
+        if (!pInputView || !pOutputView) return false;
+
+        D3D11_VIDEO_PROCESSOR_STREAM stream = {};
+        stream.Enable = TRUE;
+        stream.pInputSurface = pInputView;
+        HRESULT hr = videoContext->VideoProcessorBlt(processor.Get(), pOutputView, 0, 1, &stream);
+        if (FAILED(hr)) {
+            LOG_ERROR_RATE("VideoProcessor", 1, "Blt FAILED: 0x%08X", (unsigned)hr);
+            return false;
+        }
+        return true;
+    }
+
     ID3D11Texture2D* ConvertNV12ToBGRA(ID3D11Texture2D* nv12Texture) {
         if (!videoContext || !processor || !nv12Texture) return nullptr;
 
@@ -168,14 +193,26 @@ private:
     UINT displayWidth = 0;
     UINT displayHeight = 0;
 
-    std::map<ID3D11Texture2D*, ComPtr<ID3D11VideoProcessorInputView>> inputViewCache;
+    // Fixed-size, round-robin replaced (no allocation per frame). The view holds a reference
+    // to its texture, so a cached pointer can't be recycled for a different texture.
+    struct CachedInputView {
+        ID3D11Texture2D* texture = nullptr;
+        ComPtr<ID3D11VideoProcessorInputView> view;
+    };
+    CachedInputView inputViewCache[VIDEO_PROCESSOR_VIEW_CACHE];
+    int nextViewSlot = 0;
+
+    struct CachedOutputView {
+        ID3D11Texture2D* texture = nullptr;
+        ComPtr<ID3D11VideoProcessorOutputView> view;
+    };
+    CachedOutputView outputViewCache[VIDEO_PROCESSOR_VIEW_CACHE];
+    int nextOutputViewSlot = 0;
 
     ID3D11VideoProcessorInputView* GetCachedInputView(ID3D11Texture2D* tex) {
-        auto it = inputViewCache.find(tex);
-        if (it != inputViewCache.end()) {
-            return it->second.Get();
+        for (const CachedInputView& entry : inputViewCache) {
+            if (entry.texture == tex) return entry.view.Get();
         }
-        if (inputViewCache.size() > 4) inputViewCache.clear();
 
         D3D11_VIDEO_PROCESSOR_INPUT_VIEW_DESC inDesc = {};
         inDesc.FourCC = 0;
@@ -185,11 +222,35 @@ private:
         
         HRESULT hr = videoDevice->CreateVideoProcessorInputView(tex, videoEnum.Get(), &inDesc, &newView);
         if (FAILED(hr)) {
-            std::cerr << "[VideoProcessor] CreateVideoProcessorInputView failed: 0x" << std::hex << hr << std::dec << std::endl;
+            LOG_ERROR_RATE("VideoProcessor", 1, "CreateVideoProcessorInputView failed: 0x%08X", (unsigned)hr);
             return nullptr;
         }
         
-        inputViewCache[tex] = newView;
+        CachedInputView& entry = inputViewCache[nextViewSlot];
+        nextViewSlot = (nextViewSlot + 1) % VIDEO_PROCESSOR_VIEW_CACHE;
+        entry.texture = tex;
+        entry.view = newView;
+        return newView.Get();
+    }
+
+    ID3D11VideoProcessorOutputView* GetCachedOutputView(ID3D11Texture2D* tex) {
+        for (const CachedOutputView& entry : outputViewCache) {
+            if (entry.texture == tex) return entry.view.Get();
+        }
+
+        D3D11_VIDEO_PROCESSOR_OUTPUT_VIEW_DESC outDesc = {};
+        outDesc.ViewDimension = D3D11_VPOV_DIMENSION_TEXTURE2D;
+        ComPtr<ID3D11VideoProcessorOutputView> newView;
+        HRESULT hr = videoDevice->CreateVideoProcessorOutputView(tex, videoEnum.Get(), &outDesc, &newView);
+        if (FAILED(hr)) {
+            LOG_ERROR_RATE("VideoProcessor", 1, "CreateVideoProcessorOutputView failed: 0x%08X", (unsigned)hr);
+            return nullptr;
+        }
+
+        CachedOutputView& entry = outputViewCache[nextOutputViewSlot];
+        nextOutputViewSlot = (nextOutputViewSlot + 1) % VIDEO_PROCESSOR_VIEW_CACHE;
+        entry.texture = tex;
+        entry.view = newView;
         return newView.Get();
     }
 };
\ No newline at end of file